@@ -0,0 +1,280 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - AGGREGATOR (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa a agregação por janela descrita em aggregator.h:
+- add(): localiza (ou abre) a posição do tópico, fecha a janela anterior
+  se for o caso, e acumula soma/mín/máx/último por coluna;
+- emitSlot(): monta a linha agregada (reais com as casas decimais da
+  coluna) e entrega ao AggEmit.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include <stdlib.h>
+#include "aggregator.h"
+#include "column_map.h"
+
+// Só compilado com agregação ligada (evita o estado estático sem uso)
+#if AGG_WINDOW_MS > 0
+
+static const uint8_t STAT_BITS[4] = {
+    AGG_STAT_MEAN, AGG_STAT_MIN, AGG_STAT_MAX, AGG_STAT_LAST
+};
+static const char *const STAT_SUFFIX[4] = { "_mean", "_min", "_max", "_last" };
+
+static size_t statCount() {
+    size_t n = 0;
+    for (size_t k = 0; k < 4; k++) {
+        if (AGG_STATS & STAT_BITS[k]) {
+            n++;
+        }
+    }
+    return n;
+}
+
+// k-ésima estatística habilitada (índice em STAT_BITS)
+static size_t statAt(size_t k) {
+    for (size_t s = 0; s < 4; s++) {
+        if ((AGG_STATS & STAT_BITS[s]) && k-- == 0) {
+            return s;
+        }
+    }
+    return 0;
+}
+
+Aggregator::Aggregator()
+    : _columns(nullptr), _cols(0), _emit(nullptr), _ctx(nullptr) {
+    for (size_t i = 0; i < AGG_MAX_TOPICS; i++) {
+        _slots[i].used = false;
+    }
+}
+
+void Aggregator::begin(const ColumnMap &columns, AggEmit emit, void *ctx) {
+    _columns = &columns;
+    _cols = columns.count();
+    _emit = emit;
+    _ctx = ctx;
+}
+
+size_t Aggregator::outputCount() const {
+    return 1 + _cols * statCount();
+}
+
+size_t Aggregator::outputKey(size_t i, const String *keys, char *buf, size_t cap) const {
+    const char *base = "samples";
+    const char *suffix = "";
+    if (i > 0) {
+        size_t n = statCount();
+        base = keys[(i - 1) / n].c_str();
+        suffix = STAT_SUFFIX[statAt((i - 1) % n)];
+    }
+
+    size_t b = strlen(base);
+    size_t s = strlen(suffix);
+    if (b + s > cap) {
+        b = (cap > s) ? cap - s : 0;
+        s = cap - b;
+    }
+    memcpy(buf, base, b);
+    memcpy(buf + b, suffix, s);
+    return b + s;
+}
+
+int Aggregator::inputOf(size_t i, const char *key, size_t &len) {
+    if (i == 0) {
+        return (len == 7 && memcmp(key, "samples", 7) == 0) ? -1 : -2;
+    }
+
+    size_t n = statCount();
+    if ((i - 1) % n != 0) {
+        return -1;
+    }
+    const char *suffix = STAT_SUFFIX[statAt(0)];
+    size_t s = strlen(suffix);
+    if (len <= s || memcmp(key + len - s, suffix, s) != 0) {
+        return -2;
+    }
+    len -= s;
+    return (int)((i - 1) / n);
+}
+
+void Aggregator::reset(Slot &s, uint32_t window, const char *client, const char *topic) {
+    s.used = true;
+    s.window = window;
+    s.samples = 0;
+    s.textUsed = 0;
+    strncpy(s.client, client, AGG_CLIENT_MAX);
+    s.client[AGG_CLIENT_MAX] = '\0';
+    strncpy(s.topic, topic, MSG_TOPIC_MAX);
+    s.topic[MSG_TOPIC_MAX] = '\0';
+    for (size_t c = 0; c < _cols; c++) {
+        s.cols[c].count = 0;
+        s.cols[c].sum = 0.0;
+        s.cols[c].other = FLAT_ABSENT;
+    }
+}
+
+// Guarda o último texto não numérico da coluna. Quando o buffer enche,
+// compacta mantendo só os textos ainda referenciados.
+bool Aggregator::putText(Slot &s, Column &c, const char *src, size_t len) {
+    if (s.textUsed + len > AGG_TEXT_SIZE) {
+        c.other = FLAT_ABSENT;
+        char tmp[AGG_TEXT_SIZE];
+        size_t used = 0;
+        for (size_t k = 0; k < _cols; k++) {
+            Column &o = s.cols[k];
+            if (o.other == FLAT_TEXT) {
+                memcpy(tmp + used, s.text + o.text.off, o.text.len);
+                o.text.off = (uint16_t)used;
+                used += o.text.len;
+            }
+        }
+        memcpy(s.text, tmp, used);
+        s.textUsed = used;
+        if (s.textUsed + len > AGG_TEXT_SIZE) {
+            return false;
+        }
+    }
+    memcpy(s.text + s.textUsed, src, len);
+    c.other = FLAT_TEXT;
+    c.text.off = (uint16_t)s.textUsed;
+    c.text.len = (uint16_t)len;
+    s.textUsed += len;
+    return true;
+}
+
+void Aggregator::add(uint32_t now, const char *client, const char *topic,
+                     const char *text, const FlatValue *cells) {
+    uint32_t window = now / AGG_WINDOW_MS;
+
+    // Posição do tópico; senão uma livre; senão a de janela mais antiga
+    Slot *slot = nullptr;
+    Slot *victim = &_slots[0];
+    for (size_t i = 0; i < AGG_MAX_TOPICS; i++) {
+        Slot &s = _slots[i];
+        if (!s.used) {
+            if (!slot) {
+                slot = &s;
+            }
+            continue;
+        }
+        if (strcmp(s.topic, topic) == 0) {
+            slot = &s;
+            break;
+        }
+        if (!victim->used || s.window < victim->window) {
+            victim = &s;
+        }
+    }
+
+    if (!slot) {
+        emitSlot(*victim);
+        slot = victim;
+    }
+    if (slot->used && (slot->window != window || strcmp(slot->topic, topic) != 0)) {
+        emitSlot(*slot);
+    }
+    if (!slot->used) {
+        reset(*slot, window, client, topic);
+    }
+
+    slot->samples++;
+    for (size_t i = 0; i < _cols; i++) {
+        const FlatValue &v = cells[i];
+        if (v.type == FLAT_ABSENT) {
+            continue;
+        }
+
+        Column &c = slot->cols[i];
+        if (flatIsNumber(v)) {
+            double x = flatNumber(v);
+            if (c.count == 0 || x < c.min) {
+                c.min = x;
+            }
+            if (c.count == 0 || x > c.max) {
+                c.max = x;
+            }
+            c.sum += x;
+            c.last = x;
+            c.count++;
+            c.other = FLAT_ABSENT;
+        } else if (v.type == FLAT_TEXT) {
+            putText(*slot, c, text + v.text.off, v.text.len);
+        } else {
+            c.other = v.type;
+            c.flag = (v.i != 0);
+        }
+    }
+}
+
+void Aggregator::emitSlot(Slot &s) {
+    if (!s.used) {
+        return;
+    }
+    s.used = false;
+
+    size_t n = statCount();
+    size_t o = 0;
+
+    FlatValue &samples = _cells[o++];
+    samples.type = FLAT_INT;
+    samples.i = s.samples;
+
+    for (size_t i = 0; i < _cols; i++) {
+        const Column &c = s.cols[i];
+        int decimals = _columns->decimals(i);
+
+        for (size_t k = 0; k < n; k++) {
+            FlatValue &cell = _cells[o++];
+            size_t stat = statAt(k);
+            cell.type = FLAT_ABSENT;
+
+            // Último valor não numérico: só em _last
+            if (c.other != FLAT_ABSENT) {
+                if (STAT_BITS[stat] == AGG_STAT_LAST) {
+                    cell.type = c.other;
+                    cell.i = c.flag ? 1 : 0;
+                    cell.text = c.text;
+                }
+                continue;
+            }
+            if (c.count == 0) {
+                continue;
+            }
+
+            cell.type = FLAT_REAL;
+            cell.decimals = (int8_t)decimals;
+            switch (STAT_BITS[stat]) {
+                case AGG_STAT_MEAN: cell.d = c.sum / c.count; break;
+                case AGG_STAT_MIN:  cell.d = c.min;           break;
+                case AGG_STAT_MAX:  cell.d = c.max;           break;
+                default:            cell.d = c.last;          break;
+            }
+        }
+    }
+
+    if (_emit) {
+        _emit(_ctx, s.window * (uint32_t)AGG_WINDOW_MS, s.client, s.topic, s.text, _cells, o);
+    }
+}
+
+void Aggregator::poll(uint32_t now) {
+    uint32_t window = now / AGG_WINDOW_MS;
+    for (size_t i = 0; i < AGG_MAX_TOPICS; i++) {
+        if (_slots[i].used && _slots[i].window < window) {
+            emitSlot(_slots[i]);
+        }
+    }
+}
+
+void Aggregator::flushAll() {
+    for (size_t i = 0; i < AGG_MAX_TOPICS; i++) {
+        emitSlot(_slots[i]);
+    }
+}
+
+#endif  // AGG_WINDOW_MS > 0
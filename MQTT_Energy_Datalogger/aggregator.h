@@ -0,0 +1,111 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - AGGREGATOR (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Agregação por janela de tempo entre o achatamento e o arquivo de log
+(AGG_WINDOW_MS > 0). Em vez de uma linha por publicação, grava uma linha
+por janela e por tópico com, para cada coluna do cabeçalho:
+
+    <chave>_mean, <chave>_min, <chave>_max, <chave>_last
+
+(conforme AGG_STATS), precedidas da coluna "samples" (mensagens na janela).
+Valores que não são números (strings, true/false, null) só preenchem _last.
+As estatísticas usam os números como vieram no JSON (FlatValue), antes
+de qualquer arredondamento, e saem tipadas: o texto fica para o sink.
+
+Janelas:
+--------
+- Alinhadas a múltiplos de AGG_WINDOW_MS desde o boot; o timestamp da
+  linha agregada é o início da janela.
+- Uma janela é gravada quando chega mensagem do mesmo tópico em uma
+  janela posterior, ou por poll() quando o tempo passa do fim dela
+  (tópico que parou de publicar).
+- O relógio é passado pelo chamador (now, em ms): o módulo não lê millis().
+
+Memória:
+--------
+Estado estático para AGG_MAX_TOPICS tópicos simultâneos; ao chegar um
+tópico novo com todas as posições ocupadas, a janela mais antiga é gravada
+antes da hora e a posição é reaproveitada.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+#include "json_flatten.h"
+
+class ColumnMap;
+
+// Linha agregada pronta: células na ordem de outputKey(), strings em text.
+typedef void (*AggEmit)(void *ctx, uint32_t windowStart,
+                        const char *client, const char *topic,
+                        const char *text, const FlatValue *cells, size_t count);
+
+class Aggregator {
+public:
+    Aggregator();
+
+    // Fixa as colunas de entrada (após o cabeçalho) e o destino das linhas.
+    void begin(const ColumnMap &columns, AggEmit emit, void *ctx);
+
+    // Número de colunas de saída e o nome da coluna i (sem '\0').
+    size_t outputCount() const;
+    size_t outputKey(size_t i, const String *keys, char *buf, size_t cap) const;
+
+    // Coluna de entrada de uma chave de saída (para recuperar o cabeçalho
+    // de um arquivo existente): índice >= 0 se key é a primeira estatística
+    // de uma coluna (len passa a ser o tamanho da chave original); -1 se é
+    // "samples" ou outra estatística; -2 se não segue o padrão.
+    static int inputOf(size_t i, const char *key, size_t &len);
+
+    // Acrescenta uma mensagem. cells: valores na ordem das colunas de
+    // entrada, strings em text.
+    void add(uint32_t now, const char *client, const char *topic,
+             const char *text, const FlatValue *cells);
+
+    // Grava as janelas que já terminaram em now.
+    void poll(uint32_t now);
+
+    // Grava todas as janelas abertas (parciais), ex.: antes de desligar.
+    void flushAll();
+
+private:
+    struct Column {
+        double   sum;
+        double   min;
+        double   max;
+        double   last;
+        uint32_t count;     // Amostras numéricas
+        uint8_t  other;     // FlatType do último valor não numérico; FLAT_ABSENT = número
+        bool     flag;      // other == FLAT_BOOL
+        FlatSlice text;     // other == FLAT_TEXT (em Slot::text)
+    };
+
+    struct Slot {
+        bool     used;
+        uint32_t window;    // Índice da janela (now / AGG_WINDOW_MS)
+        uint32_t samples;
+        char     client[AGG_CLIENT_MAX + 1];
+        char     topic[MSG_TOPIC_MAX + 1];
+        Column   cols[MAX_KEYS];
+        char     text[AGG_TEXT_SIZE];
+        size_t   textUsed;
+    };
+
+    void reset(Slot &s, uint32_t window, const char *client, const char *topic);
+    void emitSlot(Slot &s);
+    bool putText(Slot &s, Column &c, const char *src, size_t len);
+
+    const ColumnMap *_columns;
+    size_t  _cols;
+    AggEmit _emit;
+    void   *_ctx;
+
+    Slot      _slots[AGG_MAX_TOPICS];
+    FlatValue _cells[LOG_MAX_COLUMNS];      // Linha agregada (strings em Slot::text)
+};
@@ -0,0 +1,374 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BIN LOG (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa a gravação do formato binário colunar (bin_log_format.h):
+- tipo de cada valor (FlatValue) -> int32/decimal fixo/bool/string;
+- delta (zigzag) contra o valor anterior da coluna;
+- dicionário por sessão para client_id e topic;
+- leitura do esquema de um arquivo existente (retomada após reboot).
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+#include "bin_log.h"
+
+// -----------------------------------------------------------------------------
+// Classificação de um valor
+// -----------------------------------------------------------------------------
+struct BinValue {
+    uint8_t  type;
+    uint8_t  scale;     // BIN_T_DEC: casas decimais
+    int64_t  i;         // INT32 / DEC (mantissa) / BOOL
+};
+
+// Só aceita a forma numérica se a reformatação reproduz o texto original
+static BinValue classify(const char *s, size_t n) {
+    BinValue v = { BIN_T_STR, 0, 0 };
+
+    if (n == 4 && memcmp(s, "true", 4) == 0) {
+        v.type = BIN_T_BOOL;
+        v.i = 1;
+        return v;
+    }
+    if (n == 5 && memcmp(s, "false", 5) == 0) {
+        v.type = BIN_T_BOOL;
+        return v;
+    }
+
+    // [-]dígitos[.dígitos] -> mantissa inteira + casas
+    size_t k = (n > 0 && s[0] == '-') ? 1 : 0;
+    int64_t m = 0;
+    size_t digits = 0;
+    int scale = -1;
+    for (; k < n; k++) {
+        if (s[k] == '.' && scale < 0) {
+            scale = 0;
+            continue;
+        }
+        if (s[k] < '0' || s[k] > '9' || ++digits > BIN_DEC_MAX_DIGITS) {
+            return v;
+        }
+        m = m * 10 + (s[k] - '0');
+        if (scale >= 0) {
+            scale++;
+        }
+    }
+    if (digits == 0 || scale == 0 || scale > BIN_DEC_MAX_SCALE) {
+        return v;
+    }
+    if (s[0] == '-') {
+        m = -m;
+    }
+
+    // Zeros à esquerda, "-0", etc. não voltariam iguais: ficam como texto
+    char out[24];
+    unsigned sc = (scale < 0) ? 0 : (unsigned)scale;
+    if (binRenderDecimal(m, sc, out) != n || memcmp(out, s, n) != 0) {
+        return v;
+    }
+
+    // Inteiro "%ld" (long de 32 bits na ESP32) ou decimal fixo
+    v.type = (sc == 0 && m >= INT32_MIN && m <= INT32_MAX) ? BIN_T_INT32 : BIN_T_DEC;
+    v.scale = (uint8_t)sc;
+    v.i = m;
+    return v;
+}
+
+// Inteiros e bools direto; reais pelo texto do CSV (buf), que também é o
+// conteúdo de um valor que fica como string
+static BinValue classifyValue(const FlatValue &fv, const char *text,
+                              char *buf, size_t cap, const char *&str, size_t &len) {
+    BinValue v = { BIN_T_STR, 0, 0 };
+    str = buf;
+    len = 0;
+
+    switch (fv.type) {
+        case FLAT_BOOL:
+            v.type = BIN_T_BOOL;
+            v.i = fv.i;
+            return v;
+        case FLAT_INT:
+            if (fv.i >= INT32_MIN && fv.i <= INT32_MAX) {
+                v.type = BIN_T_INT32;
+                v.i = fv.i;
+                return v;
+            }
+            break;
+        case FLAT_TEXT:
+            str = text + fv.text.off;
+            len = fv.text.len;
+            return v;
+        case FLAT_NULL:
+            return v;
+        default:
+            break;
+    }
+
+    int n = flatFormat(fv, text, buf, cap);
+    len = (n > 0) ? (size_t)n : 0;
+    return classify(buf, len);
+}
+
+// -----------------------------------------------------------------------------
+// BinLogWriter
+// -----------------------------------------------------------------------------
+BinLogWriter::BinLogWriter()
+    : _out(nullptr), _prevMs(0), _dictCount(0), _dictUsed(0),
+      _layoutCount(0), _layoutUsed(0) {
+}
+
+void BinLogWriter::begin(Print &out) {
+    _out = &out;
+}
+
+void BinLogWriter::putVarint(uint64_t v) {
+    uint8_t buf[10];
+    _out->write(buf, binPutVarint(buf, v));
+}
+
+void BinLogWriter::writeSchema(size_t count) {
+    _out->write((const uint8_t *)BIN_MAGIC, 4);
+    _out->write((uint8_t)BIN_VERSION);
+    putVarint(count);
+}
+
+void BinLogWriter::writeSchemaKey(const char *key, size_t len) {
+    putVarint(len);
+    _out->write((const uint8_t *)key, len);
+}
+
+void BinLogWriter::beginSession() {
+    _prevMs = 0;
+    _dictCount = 0;
+    _dictUsed = 0;
+    _layoutCount = 0;
+    _layoutUsed = 0;
+    memset(_prev, 0, sizeof(_prev));
+    _out->write((uint8_t)BIN_REC_SESSION);
+}
+
+void BinLogWriter::putStrRef(const char *s, size_t len) {
+    for (size_t k = 0; k < _dictCount; k++) {
+        if (_dictLen[k] == len && memcmp(_dictPool + _dictOff[k], s, len) == 0) {
+            putVarint(k + 1);
+            return;
+        }
+    }
+
+    // String nova: vai inline e entra no dicionário se houver espaço
+    putVarint(0);
+    putVarint(len);
+    _out->write((const uint8_t *)s, len);
+
+    if (_dictCount < BIN_DICT_MAX && _dictUsed + len <= BIN_DICT_POOL) {
+        memcpy(_dictPool + _dictUsed, s, len);
+        _dictOff[_dictCount] = (uint16_t)_dictUsed;
+        _dictLen[_dictCount] = (uint16_t)len;
+        _dictUsed += len;
+        _dictCount++;
+    }
+}
+
+void BinLogWriter::putRowStart(uint8_t rec, uint32_t ms, const char *client,
+                               const char *topic) {
+    _out->write(rec);
+    putVarint(ms - _prevMs);
+    _prevMs = ms;
+    putStrRef(client, strlen(client));
+    putStrRef(topic, strlen(topic));
+}
+
+// Byte de tipo + dados, com delta contra _prev[col]
+void BinLogWriter::putValue(size_t col, const FlatValue &cell, const char *text) {
+    char buf[352];      // Maior texto de formatDecimal() (fallback "%.*f")
+    const char *value;
+    size_t len;
+    BinValue v = classifyValue(cell, text, buf, sizeof(buf), value, len);
+
+    switch (v.type) {
+        case BIN_T_INT32:
+            _out->write((uint8_t)BIN_T_INT32);
+            putVarint(binZigzag(v.i - (int32_t)(uint32_t)_prev[col]));
+            _prev[col] = (uint32_t)v.i;
+            break;
+        case BIN_T_DEC:
+            _out->write((uint8_t)(BIN_T_DEC | (v.scale << BIN_T_SCALE_SHIFT)));
+            putVarint(binZigzag(v.i - (int64_t)_prev[col]));
+            _prev[col] = (uint64_t)v.i;
+            break;
+        case BIN_T_BOOL:
+            _out->write((uint8_t)(BIN_T_BOOL | (v.i ? BIN_T_BOOL_TRUE : 0)));
+            break;
+        default:
+            _out->write((uint8_t)BIN_T_STR);
+            putVarint(len);
+            _out->write((const uint8_t *)value, len);
+            break;
+    }
+}
+
+void BinLogWriter::writeRow(uint32_t ms, const char *client, const char *topic,
+                            const char *text, const FlatValue *cells, size_t count) {
+    size_t cols = (count < LOG_MAX_COLUMNS) ? count : LOG_MAX_COLUMNS;
+
+    putRowStart(BIN_REC_ROW, ms, client, topic);
+
+    // Bitmap de presença
+    uint8_t bits = 0;
+    for (size_t i = 0; i < cols; i++) {
+        if (cells[i].type != FLAT_ABSENT) {
+            bits |= (uint8_t)(1 << (i & 7));
+        }
+        if ((i & 7) == 7 || i == cols - 1) {
+            _out->write(bits);
+            bits = 0;
+        }
+    }
+
+    for (size_t i = 0; i < cols; i++) {
+        if (cells[i].type != FLAT_ABSENT) {
+            putValue(i, cells[i], text);
+        }
+    }
+}
+
+void BinLogWriter::writeColumn(size_t id, const char *key, size_t len) {
+    _out->write((uint8_t)BIN_REC_COLUMN);
+    putVarint(id);
+    putVarint(len);
+    _out->write((const uint8_t *)key, len);
+}
+
+// Colunas válidas (fora COLUMN_DROPPED) formam o layout da linha
+static inline bool inLayout(uint16_t col) {
+    return col < LOG_MAX_COLUMNS;
+}
+
+void BinLogWriter::putLayoutRef(const uint16_t *columns, size_t count, size_t n) {
+    for (size_t l = 0; l < _layoutCount; l++) {
+        if (_layoutLen[l] != n) {
+            continue;
+        }
+        const uint16_t *ids = _layoutPool + _layoutOff[l];
+        size_t j = 0;
+        for (size_t k = 0; k < count && j < n; k++) {
+            if (inLayout(columns[k])) {
+                if (ids[j] != columns[k]) {
+                    break;
+                }
+                j++;
+            }
+        }
+        if (j == n) {
+            putVarint(l + 1);
+            return;
+        }
+    }
+
+    // Layout novo: vai inline e entra na tabela se houver espaço
+    bool keep = _layoutCount < BIN_LAYOUT_MAX && _layoutUsed + n <= BIN_LAYOUT_POOL;
+    putVarint(0);
+    putVarint(n);
+    for (size_t k = 0, j = 0; k < count; k++) {
+        if (inLayout(columns[k])) {
+            putVarint(columns[k]);
+            if (keep) {
+                _layoutPool[_layoutUsed + j++] = columns[k];
+            }
+        }
+    }
+    if (keep) {
+        _layoutOff[_layoutCount] = (uint16_t)_layoutUsed;
+        _layoutLen[_layoutCount] = (uint16_t)n;
+        _layoutUsed += n;
+        _layoutCount++;
+    }
+}
+
+void BinLogWriter::writeSparseRow(uint32_t ms, const char *client, const char *topic,
+                                  const char *text, const FlatValue *values,
+                                  const uint16_t *columns, size_t count) {
+    size_t n = 0;
+    for (size_t k = 0; k < count; k++) {
+        if (inLayout(columns[k])) {
+            n++;
+        }
+    }
+
+    putRowStart(BIN_REC_SPARSE, ms, client, topic);
+    putLayoutRef(columns, count, n);
+
+    // Bitmap de presença sobre o layout
+    uint8_t bits = 0;
+    size_t j = 0;
+    for (size_t k = 0; k < count; k++) {
+        if (!inLayout(columns[k])) {
+            continue;
+        }
+        if (values[k].type != FLAT_ABSENT) {
+            bits |= (uint8_t)(1 << (j & 7));
+        }
+        if ((j & 7) == 7 || j == n - 1) {
+            _out->write(bits);
+            bits = 0;
+        }
+        j++;
+    }
+
+    for (size_t k = 0; k < count; k++) {
+        if (inLayout(columns[k]) && values[k].type != FLAT_ABSENT) {
+            putValue(columns[k], values[k], text);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+// binLogReadSchema
+// -----------------------------------------------------------------------------
+static bool readVarint(File &f, uint64_t &v) {
+    v = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        int c = f.read();
+        if (c < 0) {
+            return false;
+        }
+        v |= (uint64_t)(c & 0x7F) << shift;
+        if (!(c & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t binLogReadSchema(File &f, BinSchemaKey onKey, void *ctx) {
+    char magic[5];
+    if (f.read((uint8_t *)magic, 5) != 5 ||
+        memcmp(magic, BIN_MAGIC, 4) != 0 ||
+        magic[4] < 2 || magic[4] > BIN_VERSION) {    // v1: F32/F64, não dá para continuar
+        return 0;
+    }
+
+    uint64_t count;
+    if (!readVarint(f, count) || count > LOG_MAX_COLUMNS) {
+        return 0;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        uint64_t len;
+        char key[FLAT_PATH_SIZE];
+        if (!readVarint(f, len) || len >= sizeof(key) ||
+            f.read((uint8_t *)key, len) != len) {
+            return 0;
+        }
+        key[len] = '\0';
+        if (!onKey(ctx, i, key, (size_t)len)) {
+            return 0;
+        }
+    }
+    return (size_t)count;
+}
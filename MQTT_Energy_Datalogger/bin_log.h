@@ -0,0 +1,100 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BIN LOG (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Gravação opcional do log em formato binário colunar (LOG_FORMAT_BINARY),
+em vez de CSV. O formato está descrito em bin_log_format.h e pode ser
+convertido de volta para o CSV exato com tools/binlog2csv.
+
+Uso:
+----
+- Arquivo novo:      begin(out); writeSchema(n); writeSchemaKey() x n;
+                     beginSession();
+- Arquivo existente: binLogReadSchema() para recuperar o cabeçalho;
+                     begin(out); beginSession();
+- Cada linha:        writeRow(ms, client_id, topic, valores das colunas).
+- Esquema esparso:   writeSchema(0) no arquivo novo; writeColumn() para
+                     cada coluna do dicionário (na sessão e quando surge
+                     uma nova); writeSparseRow() com os pares presentes.
+
+Os valores chegam tipados (FlatValue): inteiros e bools são gravados
+direto, strings como string. Reais passam pelo texto que o CSV teria
+(flatFormat) e viram decimal fixo (mantissa inteira + casas) só se a
+reformatação reproduzir exatamente esse texto. Assim a exportação para CSV
+é byte a byte igual.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#include "config.h"
+#include "bin_log_format.h"
+#include "json_flatten.h"
+
+class BinLogWriter {
+public:
+    BinLogWriter();
+
+    void begin(Print &out);
+
+    // Bloco de esquema (assinatura + count chaves do cabeçalho, cada uma
+    // em seguida com writeSchemaKey()). Só em arquivo novo.
+    void writeSchema(size_t count);
+    void writeSchemaKey(const char *key, size_t len);
+
+    // Registro de sessão: zera timestamps, dicionário e valores anteriores.
+    void beginSession();
+
+    // Linha: count células na ordem do esquema (strings em text).
+    void writeRow(uint32_t ms, const char *client, const char *topic,
+                  const char *text, const FlatValue *cells, size_t count);
+
+    // Esquema esparso: declara a coluna id (BIN_REC_COLUMN).
+    void writeColumn(size_t id, const char *key, size_t len);
+
+    // Esquema esparso: values[k] vai para a coluna columns[k]. Campos com
+    // COLUMN_DROPPED (>= LOG_MAX_COLUMNS) ficam fora do layout; ausentes,
+    // fora do bitmap de presença.
+    void writeSparseRow(uint32_t ms, const char *client, const char *topic,
+                        const char *text, const FlatValue *values,
+                        const uint16_t *columns, size_t count);
+
+private:
+    void putVarint(uint64_t v);
+    void putStrRef(const char *s, size_t len);
+    void putRowStart(uint8_t rec, uint32_t ms, const char *client, const char *topic);
+    void putLayoutRef(const uint16_t *columns, size_t count, size_t n);
+    void putValue(size_t col, const FlatValue &cell, const char *text);
+
+    Print   *_out;
+    uint32_t _prevMs;
+
+    // Dicionário de client_id/topic da sessão
+    uint16_t _dictOff[BIN_DICT_MAX];
+    uint16_t _dictLen[BIN_DICT_MAX];
+    size_t   _dictCount;
+    size_t   _dictUsed;
+    char     _dictPool[BIN_DICT_POOL];
+
+    // Layouts de linha esparsa da sessão (IDs de coluna)
+    uint16_t _layoutOff[BIN_LAYOUT_MAX];
+    uint16_t _layoutLen[BIN_LAYOUT_MAX];
+    size_t   _layoutCount;
+    size_t   _layoutUsed;
+    uint16_t _layoutPool[BIN_LAYOUT_POOL];
+
+    // Valor anterior de cada coluna (int32 ou mantissa decimal)
+    uint64_t _prev[LOG_MAX_COLUMNS];
+};
+
+// Chamado para cada chave do esquema lido; false interrompe a leitura.
+typedef bool (*BinSchemaKey)(void *ctx, size_t index, const char *key, size_t len);
+
+// Lê o esquema de um arquivo binário já existente (f aberto para leitura).
+// Retorna o número de colunas, ou 0 se o arquivo não tem esquema válido.
+size_t binLogReadSchema(File &f, BinSchemaKey onKey, void *ctx);
@@ -0,0 +1,139 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - FORMATO BINÁRIO (DEFINIÇÕES)
+================================================================================
+
+Responsabilidade:
+-----------------
+Constantes e codificação do formato binário colunar do log, compartilhadas
+entre o firmware (bin_log.*) e a ferramenta de exportação em Linux
+(tools/binlog2csv.cpp). Não depende do Arduino.
+
+Layout do arquivo:
+------------------
+    "MQBL" <versão:1 byte>
+    <ncols:varint> { <tam:varint> <chave> } x ncols        (esquema, uma vez)
+    registros...
+
+Registros:
+----------
+- BIN_REC_SESSION ('S'): início de sessão (boot). Zera o estado de delta:
+  timestamp anterior = 0, dicionário vazio, valores anteriores = 0.
+- BIN_REC_ROW ('R'):
+    <dt:varint>                         millis() - millis() da linha anterior
+    <client:str-ref> <topic:str-ref>    referência ao dicionário da sessão
+    <presença: ceil(ncols/8) bytes>     bit i = coluna i tem valor
+    para cada coluna presente: <tipo:1 byte> [dados]
+- BIN_REC_COLUMN ('C'), v3, esquema esparso (LOG_SCHEMA_SPARSE):
+    <id:varint> <tam:varint> <chave>    declara a coluna id (ncols = 0 no
+                                        esquema; vale até o fim do arquivo,
+                                        redeclarar com a mesma chave é ok)
+- BIN_REC_SPARSE ('P'), v3, esquema esparso:
+    <dt:varint> <client:str-ref> <topic:str-ref>   como em BIN_REC_ROW
+    <layout:layout-ref>                 colunas da linha (n IDs, em ordem)
+    <presença: ceil(n/8) bytes>         bit j = j-ésima coluna do layout tem valor
+    para cada coluna presente: <tipo:1 byte> [dados]
+
+str-ref:
+    varint 0         -> string nova: <tam:varint><bytes>; entra no dicionário
+                        (se houver espaço: BIN_DICT_MAX entradas)
+    varint k (k>=1)  -> entrada k-1 do dicionário
+
+layout-ref (mesma ideia, para a lista de colunas de uma linha esparsa):
+    varint 0         -> layout novo: <n:varint> n x <id:varint>; entra na
+                        tabela da sessão (se houver espaço: BIN_LAYOUT_MAX
+                        layouts, BIN_LAYOUT_POOL IDs no total)
+    varint k (k>=1)  -> layout k-1 da sessão
+
+Tipos (bits 0-2 do byte de tipo):
+    BIN_T_INT32 : zigzag varint de (v - anterior da coluna)
+    BIN_T_F32   : varint de (bits ^ bits anteriores da coluna)      (só v1)
+    BIN_T_F64   : varint de (bits ^ bits anteriores da coluna)      (só v1)
+    BIN_T_BOOL  : valor no bit 3 do byte de tipo, sem dados
+    BIN_T_STR   : <tam:varint><bytes>
+    BIN_T_DEC   : decimal fixo: casas nos bits 4-7 do byte de tipo;
+                  zigzag varint de (mantissa - anterior da coluna),
+                  valor = mantissa / 10^casas
+
+Delta (e XOR, na v1) com o valor anterior zera os bits altos de grandezas
+que variam pouco, e o varint descarta esses zeros. A exportação reproduz o
+texto do CSV: INT32 -> "%ld", DEC -> binRenderDecimal(), F32/F64 -> "%.6f",
+BOOL -> true/false, STR -> bytes.
+
+================================================================================
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define BIN_MAGIC        "MQBL"
+#define BIN_VERSION      3       // v2: BIN_T_DEC no lugar de F32/F64; v3: esquema esparso
+
+#define BIN_REC_SESSION  'S'
+#define BIN_REC_ROW      'R'
+#define BIN_REC_COLUMN   'C'
+#define BIN_REC_SPARSE   'P'
+
+#define BIN_T_INT32      0
+#define BIN_T_F32        1
+#define BIN_T_F64        2
+#define BIN_T_BOOL       3
+#define BIN_T_STR        4
+#define BIN_T_DEC        5
+#define BIN_T_MASK       0x07
+#define BIN_T_BOOL_TRUE  0x08
+#define BIN_T_SCALE_SHIFT 4
+#define BIN_DEC_MAX_SCALE 15
+#define BIN_DEC_MAX_DIGITS 18    // Mantissa cabe em int64
+
+#define BIN_DICT_MAX     32      // Strings (client_id/topic) por sessão
+#define BIN_DICT_POOL    2048    // Bytes para o texto do dicionário
+
+#define BIN_LAYOUT_MAX   16      // Layouts de linha esparsa por sessão
+#define BIN_LAYOUT_POOL  512     // IDs de coluna somando todos os layouts
+
+// Escreve v em out (até 10 bytes). Retorna o número de bytes.
+inline size_t binPutVarint(uint8_t *out, uint64_t v) {
+    size_t n = 0;
+    while (v >= 0x80) {
+        out[n++] = (uint8_t)(v | 0x80);
+        v >>= 7;
+    }
+    out[n++] = (uint8_t)v;
+    return n;
+}
+
+inline uint64_t binZigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t binUnzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+// Texto de mantissa / 10^scale (ex.: -2235, 1 -> "-223.5"). out >= 24 bytes.
+// Retorna o tamanho.
+inline size_t binRenderDecimal(int64_t mantissa, unsigned scale, char *out) {
+    char digits[20];
+    size_t n = 0;
+    uint64_t m = (mantissa < 0) ? 0 - (uint64_t)mantissa : (uint64_t)mantissa;
+    do {
+        digits[n++] = (char)('0' + m % 10);
+        m /= 10;
+    } while (m > 0);
+    while (n <= scale) {
+        digits[n++] = '0';   // Pelo menos um dígito antes do ponto
+    }
+
+    size_t o = 0;
+    if (mantissa < 0) {
+        out[o++] = '-';
+    }
+    while (n > 0) {
+        if (n == scale) {
+            out[o++] = '.';
+        }
+        out[o++] = digits[--n];
+    }
+    return o;
+}
@@ -4,7 +4,12 @@
 #include <PubSubClient.h>
 
 #include "config.h"
+#include "logger_task.h"
 #include "logger.h"
+#include "row_sinks.h"
+#include "topic_filter.h"
+#include "metrics.h"
+#include "diag_log.h"
 
 using namespace mqttBrokerName;
 
@@ -15,103 +20,181 @@ static MqttBroker broker(MQTT_BROKER_PORT);
 static WiFiClient espClient;
 static PubSubClient mqttClient(espClient);
 
+// Regras de TOPIC_FILTER, compiladas em brokerInit()
+static TopicFilter topicFilter;
+
 static void mqttCallback(char* topic, byte* payload, unsigned int length) {
-    Serial.println();
-    Serial.println("========== MQTT CALLBACK ==========");
-
-    Serial.print("Tópico recebido: ");
-    Serial.println(topic);
-    Serial.print("Tamanho do payload (bytes): ");
-    Serial.println(length);
-
-    String t = String(topic);
-
-    // Filtro de tópico opcional
-    if (String(TOPIC_FILTER).length() > 0) {
-        if (!t.startsWith(String(TOPIC_FILTER))) {
-            Serial.print("Tópico ignorado pelo filtro TOPIC_FILTER = \"");
-            Serial.print(TOPIC_FILTER);
-            Serial.println("\"");
-            Serial.println("========== FIM MQTT CALLBACK (IGNORADO) ==========");
-            return;
-        }
+    // Pedido de flush (ex.: antes de retirar o cartão)
+    if (strcmp(topic, LOGGER_FLUSH_TOPIC) == 0) {
+        DIAG_INFO("Flush do log pedido em %s", LOGGER_FLUSH_TOPIC);
+        loggerTaskRequestFlush();
+        return;
     }
-
-    String p;
-    p.reserve(length);
-    for (unsigned int i = 0; i < length; i++) {
-        p += (char)payload[i];
+    // Tópicos de sistema (inclusive METRICS_TOPIC, publicado por nós) não
+    // são dados de medição
+    if (topic[0] == '$') {
+        return;
     }
+#if ROW_SINK_MQTT
+    // Linhas republicadas por nós (row_sinks): já estão no log
+    if (strncmp(topic, ROW_SINK_MQTT_PREFIX, sizeof(ROW_SINK_MQTT_PREFIX) - 1) == 0) {
+        return;
+    }
+#endif
+
+    DIAG_DEBUG("MQTT callback: tópico %s, %u bytes", topic, length);
 
-    Serial.print("Payload (string): ");
-    Serial.println(p);
+    uint32_t t = metricsStart();
+    metricsCount(METRIC_MESSAGES);
+    metricsCount(METRIC_BYTES, length);
 
-    Serial.println("Encaminhando para processMessage(\"esp32_logger\", topic, payload)...");
-    processMessage("esp32_logger", t, p);
+    // Filtro de tópico opcional, antes de qualquer cópia do payload
+    if (!topicFilter.accepts(topic)) {
+        metricsCount(METRIC_FILTERED);
+        metricsRecord(METRIC_RECEIVE, t);
+        DIAG_DEBUG("Tópico ignorado pelo filtro TOPIC_FILTER = \"%s\"", TOPIC_FILTER);
+        return;
+    }
 
-    Serial.println("========== FIM MQTT CALLBACK ==========");
+    // Única cópia do payload: buffer do PubSubClient -> slot da fila.
+    // Daí em diante o logger trabalha sobre o slot (ponteiro + tamanho).
+    bool queued = loggerEnqueue(topic, payload, length);
+    metricsRecord(METRIC_RECEIVE, t);
+
+    if (queued) {
+        DIAG_DEBUG("Mensagem enfileirada para a task de logging.");
+    } else {
+        metricsCount(METRIC_DROPS);
+#if DIAG_LEVEL >= DIAG_LEVEL_WARN
+        MsgQueueStats st = loggerQueueStats();
+        DIAG_WARN("Mensagem descartada pela fila. descartes = %lu, grandes demais = %lu",
+                  (unsigned long)st.dropped, (unsigned long)st.oversize);
+#endif
+    }
 }
 
 
 void brokerInit() {
-    Serial.println();
-    Serial.println("==== brokerInit() ====");
-    Serial.println("Iniciando broker EmbeddedMqttBroker...");
+    DIAG_INFO("==== brokerInit() ====");
+    DIAG_INFO("Iniciando broker EmbeddedMqttBroker...");
+
+    topicFilter.compile(TOPIC_FILTER);
+    DIAG_INFO("Regras de tópico: %u", (unsigned)topicFilter.ruleCount());
 
-    broker.setMaxNumClients(8);
+    // +1: o cliente interno de logging não ocupa vaga dos dispositivos
+    broker.setMaxNumClients(MQTT_MAX_CLIENTS + 1);
     broker.startBroker();
 
-    Serial.print("Broker iniciado na porta ");
-    Serial.println(MQTT_BROKER_PORT);
+    DIAG_INFO("Broker iniciado na porta %d", MQTT_BROKER_PORT);
 
     // Só para debug: IP do AP para os dispositivos externos
-    IPAddress apIP = WiFi.softAPIP();
-    Serial.print("IP do broker para clientes remotos (AP da ESP32): ");
-    Serial.println(apIP);
+    DIAG_INFO("IP do broker para clientes remotos (AP da ESP32): %s",
+              WiFi.softAPIP().toString().c_str());
 
     // *** Cliente interno usa loopback ***
+    // O EmbeddedMqttBroker não tem assinante interno: a entrega de uma
+    // publicação só existe para clientes TCP (MqttClient) e não pode ser
+    // substituída de fora da biblioteca. Por isso o logger recebe pelo
+    // loopback, com o custo de uma vaga de cliente (o +1 acima), da pilha
+    // TCP local e de uma cópia a mais do payload (buffer do PubSubClient ->
+    // slot da fila). Entrega direta exigiria alterar a biblioteca.
     IPAddress loopback(127, 0, 0, 1);
     mqttClient.setServer(loopback, MQTT_BROKER_PORT);
     mqttClient.setCallback(mqttCallback);
+    // Padrão do PubSubClient é 256 bytes: publicações maiores seriam perdidas
+    mqttClient.setBufferSize(MSG_TOPIC_MAX + MSG_PAYLOAD_MAX + 16);
 
-    Serial.print("Cliente interno logger apontando para ");
-    Serial.println(loopback); // deve imprimir 127.0.0.1
+    DIAG_INFO("Cliente interno logger apontando para %s",
+              loopback.toString().c_str()); // deve imprimir 127.0.0.1
 
-    Serial.println("Configuração do cliente interno MQTT concluída.");
-    Serial.println("=======================================");
+    DIAG_INFO("Configuração do cliente interno MQTT concluída.");
+    DIAG_INFO("=======================================");
 }
 
 static void ensureMqttConnected() {
     static bool testePublicado = false;  // <--- flag para não ficar publicando sempre
 
     if (!mqttClient.connected()) {
-        Serial.println();
-        Serial.println("---- Cliente logger MQTT desconectado. Tentando reconectar...");
+        DIAG_INFO("---- Cliente logger MQTT desconectado. Tentando reconectar...");
 
         String clientId = "esp32_logger";
-        Serial.print("Tentando conectar ao broker local como ");
-        Serial.println(clientId);
+        DIAG_INFO("Tentando conectar ao broker local como %s", clientId.c_str());
 
         if (mqttClient.connect(clientId.c_str())) {
-            Serial.print("Conectado ao broker como clientId = ");
-            Serial.println(clientId);
+            DIAG_INFO("Conectado ao broker como clientId = %s", clientId.c_str());
 
             if (mqttClient.subscribe("#")) {
-                Serial.println("Inscrição em '#' realizada com sucesso.");
+                DIAG_INFO("Inscrição em '#' realizada com sucesso.");
             } else {
-                Serial.println("Falha ao se inscrever em '#'.");
+                DIAG_ERROR("Falha ao se inscrever em '#'.");
+            }
+            // '#' não cobre tópicos "$..."
+            if (!mqttClient.subscribe(LOGGER_FLUSH_TOPIC)) {
+                DIAG_ERROR("Falha ao se inscrever em %s.", LOGGER_FLUSH_TOPIC);
             }
 
         } else {
-            Serial.print("Falha ao conectar cliente logger MQTT. state = ");
-            Serial.println(mqttClient.state());
+            DIAG_ERROR("Falha ao conectar cliente logger MQTT. state = %d", mqttClient.state());
         }
-        Serial.println("--------------------------------------");
+        DIAG_INFO("--------------------------------------");
     }
 }
 
 
+#if METRICS_ENABLED
+// Snapshot das métricas no broker local, a cada METRICS_PERIOD_MS
+static void publishMetrics() {
+    static unsigned long lastPublish = 0;
+    static char snapshot[METRICS_SNAPSHOT_SIZE];
+
+    unsigned long now = millis();
+    if (now - lastPublish < METRICS_PERIOD_MS || !mqttClient.connected()) {
+        return;
+    }
+    lastPublish = now;
+
+    size_t len = metricsSnapshot(snapshot, sizeof(snapshot));
+    if (len == 0) {
+        DIAG_WARN("Métricas: snapshot maior que METRICS_SNAPSHOT_SIZE.");
+        return;
+    }
+    mqttClient.publish(METRICS_TOPIC, (const uint8_t *)snapshot, len);
+
+    // Fila: totais e descartes/substituições por tópico
+    len = loggerQueueSnapshot(snapshot, sizeof(snapshot));
+    if (len == 0) {
+        DIAG_WARN("Métricas: contadores da fila maiores que METRICS_SNAPSHOT_SIZE.");
+        return;
+    }
+    mqttClient.publish(METRICS_INGEST_TOPIC, (const uint8_t *)snapshot, len);
+}
+#endif
+
+#if ROW_SINK_MQTT
+// Linhas limpas da task de logging, republicadas no broker local. Poucas
+// por volta, para não atrasar o mqttClient.loop(); o resto espera no
+// buffer do MqttRowSink.
+static void publishRows() {
+    static char topic[ROW_SINK_MQTT_TOPIC_MAX + 1];
+    static char payload[ROW_SINK_MQTT_PAYLOAD_MAX];
+    size_t len;
+
+    for (int i = 0; i < 8 && mqttClient.connected(); i++) {
+        if (!loggerRepublishPop(topic, payload, len)) {
+            break;
+        }
+        mqttClient.publish(topic, (const uint8_t *)payload, len);
+    }
+}
+#endif
+
 void brokerLoop() {
     ensureMqttConnected();
     mqttClient.loop();
+#if ROW_SINK_MQTT
+    publishRows();
+#endif
+#if METRICS_ENABLED
+    publishMetrics();
+#endif
 }
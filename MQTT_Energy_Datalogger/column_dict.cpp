@@ -0,0 +1,158 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - COLUMN DICT (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa o dicionário de colunas descrito em column_dict.h:
+- load()/save(): arquivo de chaves no SD, uma por linha;
+- resolve(): cache por tópico com impressão digital do esquema e, na
+  falta, busca campo a campo no ColumnMap (que cresce com add()).
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+#include "column_dict.h"
+
+ColumnDict::ColumnDict() : _tick(0), _torn(false) {
+    for (size_t i = 0; i < SCHEMA_CACHE_TOPICS; i++) {
+        _cache[i].used = false;
+    }
+    _stats.hits = 0;
+    _stats.misses = 0;
+    _stats.dropped = 0;
+    _map.build(_keys, 0);
+}
+
+int ColumnDict::addKey(const char *key, size_t len) {
+    if (_map.count() >= MAX_KEYS) {
+        return -1;
+    }
+    char buf[FLAT_PATH_SIZE];
+    len = (len < sizeof(buf) - 1) ? len : sizeof(buf) - 1;
+    memcpy(buf, key, len);
+    buf[len] = '\0';
+    _keys[_map.count()] = buf;
+    return _map.add();
+}
+
+size_t ColumnDict::load(const char *path) {
+    File f = SD.open(path, FILE_READ);
+    if (!f) {
+        return count();
+    }
+
+    char line[FLAT_PATH_SIZE];
+    size_t len = 0;
+    int c;
+    while ((c = f.read()) >= 0) {
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            if (len < sizeof(line)) {
+                line[len++] = (char)c;
+            }
+            continue;
+        }
+        // Linha vazia também é uma coluna: o número da linha é o ID
+        if (addKey(line, len) < 0) {
+            break;
+        }
+        len = 0;
+    }
+    // Última linha sem '\n' (queda durante o save): não é uma coluna
+    _torn = (len > 0);
+    f.close();
+    return count();
+}
+
+bool ColumnDict::save(const char *path, size_t from) {
+    if (from >= count()) {
+        return true;
+    }
+    File f = SD.open(path, FILE_APPEND);
+    if (!f) {
+        return false;
+    }
+    if (_torn) {
+        f.write((uint8_t)'\n');    // Fecha a linha incompleta (vira uma chave sem uso)
+        _torn = false;
+    }
+    for (size_t i = from; i < count(); i++) {
+        f.write((const uint8_t *)_keys[i].c_str(), _keys[i].length());
+        f.write((uint8_t)'\n');
+    }
+    f.close();
+    return true;
+}
+
+// Posição do tópico; senão uma livre; senão a usada há mais tempo
+ColumnDict::Entry &ColumnDict::entryFor(uint32_t topic) {
+    Entry *victim = &_cache[0];
+    for (size_t i = 0; i < SCHEMA_CACHE_TOPICS; i++) {
+        Entry &e = _cache[i];
+        if (e.used && e.topic == topic) {
+            return e;
+        }
+        if (victim->used && (!e.used || e.lastUse < victim->lastUse)) {
+            victim = &e;
+        }
+    }
+    victim->used = false;
+    victim->topic = topic;
+    return *victim;
+}
+
+const uint16_t *ColumnDict::resolve(const char *topic, const FlatArena &arena) {
+    // Impressão digital: FNV-1a das chaves, cada uma terminada em '\0'
+    uint32_t fp = 2166136261u;
+    for (size_t k = 0; k < arena.count; k++) {
+        const char *key = flatText(arena, arena.keys[k]);
+        for (size_t j = 0; j < arena.keys[k].len; j++) {
+            fp ^= (uint8_t)key[j];
+            fp *= 16777619u;
+        }
+        fp *= 16777619u;
+    }
+
+    Entry &e = entryFor(ColumnMap::hash(topic, strlen(topic)));
+    e.lastUse = ++_tick;
+    if (e.used && e.fingerprint == fp && e.fields == arena.count) {
+        _stats.hits++;
+        return e.column;
+    }
+    _stats.misses++;
+
+    // Esquema novo para o tópico: campo a campo
+    uint8_t seen[(MAX_KEYS + 7) / 8];
+    memset(seen, 0, sizeof(seen));
+    for (size_t k = 0; k < arena.count; k++) {
+        const char *key = flatText(arena, arena.keys[k]);
+        size_t len = arena.keys[k].len;
+
+        int col = _map.find(key, len);
+        if (col < 0) {
+            col = addKey(key, len);
+            if (col < 0) {
+                _stats.dropped++;
+                e.column[k] = COLUMN_DROPPED;
+                continue;
+            }
+        }
+        // Chave repetida na mensagem: vale a 1ª ocorrência
+        if (seen[col / 8] & (1 << (col & 7))) {
+            e.column[k] = COLUMN_DROPPED;
+            continue;
+        }
+        seen[col / 8] |= (uint8_t)(1 << (col & 7));
+        e.column[k] = (uint16_t)col;
+    }
+
+    e.used = true;
+    e.fingerprint = fp;
+    e.fields = (uint16_t)arena.count;
+    return e.column;
+}
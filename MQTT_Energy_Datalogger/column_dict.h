@@ -0,0 +1,92 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - COLUMN DICT (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Dicionário de colunas do esquema esparso (LOG_SCHEMA_SPARSE). Em vez do
+cabeçalho fixado pela 1ª mensagem, cada chave achatada nova recebe um ID
+de coluna estável na hora em que aparece, em qualquer tópico. As linhas
+levam só os pares (ID, valor) presentes (bin_log: BIN_REC_SPARSE), então
+medidores diferentes no mesmo log não geram colunas vazias.
+
+Persistência:
+-------------
+- As chaves ficam em COLUMN_DICT_PATH no SD, uma por linha: a linha i é
+  a coluna i. load() recupera o dicionário no boot; save() acrescenta as
+  colunas novas ao arquivo (raro: só quando aparece uma chave nova).
+- Os IDs nunca mudam nem são reaproveitados; ao chegar a MAX_KEYS
+  colunas, chaves novas são descartadas (dropped()).
+
+Cache por tópico (resolve):
+---------------------------
+- A impressão digital do esquema de uma mensagem é o hash FNV-1a da
+  sequência de chaves achatadas (com o número de campos).
+- Cada tópico em cache (SCHEMA_CACHE_TOPICS) guarda a impressão digital
+  e a coluna de cada campo. Mensagem com o mesmo esquema da anterior do
+  tópico (o caso comum) = uma consulta, sem buscar chave por chave.
+- Senão as chaves são buscadas no ColumnMap (O(1) cada), as novas
+  entram no dicionário e o resultado substitui o do tópico (ou o do
+  tópico usado há mais tempo).
+- Uma colisão de impressão digital (32 bits, mesmo número de campos)
+  levaria os valores para as colunas do outro esquema; na prática
+  esquemas diferentes de um tópico são poucos.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+#include "column_map.h"
+#include "json_flatten.h"
+
+#define COLUMN_DROPPED  0xFFFF   // Campo sem coluna (dicionário cheio, chave repetida)
+
+struct ColumnDictStats {
+    uint32_t hits;       // Mensagens resolvidas pelo cache do tópico
+    uint32_t misses;     // Mensagens com esquema novo para o tópico
+    uint32_t dropped;    // Campos sem coluna (dicionário cheio), por esquema novo
+};
+
+class ColumnDict {
+public:
+    ColumnDict();
+
+    // Lê o dicionário de path (inexistente = vazio). Retorna o número de colunas.
+    size_t load(const char *path);
+
+    // Acrescenta ao arquivo as colunas a partir de from.
+    bool save(const char *path, size_t from);
+
+    // Coluna de cada campo de arena (keys[k] -> resultado[k], ou
+    // COLUMN_DROPPED), criando as colunas que faltam. O resultado vale
+    // até a próxima chamada.
+    const uint16_t *resolve(const char *topic, const FlatArena &arena);
+
+    size_t count() const { return _map.count(); }
+    const String *keys() const { return _keys; }
+    const ColumnMap &columns() const { return _map; }
+    const ColumnDictStats &stats() const { return _stats; }
+
+private:
+    struct Entry {
+        bool     used;
+        uint32_t topic;         // Hash do tópico
+        uint32_t fingerprint;
+        uint16_t fields;
+        uint32_t lastUse;
+        uint16_t column[MAX_KEYS];
+    };
+
+    int addKey(const char *key, size_t len);
+    Entry &entryFor(uint32_t topic);
+
+    String    _keys[MAX_KEYS];
+    ColumnMap _map;
+    Entry     _cache[SCHEMA_CACHE_TOPICS];
+    uint32_t  _tick;
+    bool      _torn;        // Arquivo termina em linha incompleta
+    ColumnDictStats _stats;
+};
@@ -0,0 +1,149 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - COLUMN MAP (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa a tabela hash de colunas descrita em column_map.h.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "column_map.h"
+#include "num_format.h"
+
+ColumnMap::ColumnMap() : _prune(false), _keys(nullptr), _count(0) {
+    for (size_t i = 0; i < COLUMN_MAP_SLOTS; i++) {
+        _slots[i].column = -1;
+    }
+    for (size_t i = 0; i < COLUMN_PREFIX_SLOTS; i++) {
+        _prefixes[i].column = -1;
+    }
+}
+
+uint32_t ColumnMap::hash(const char *key, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (uint8_t)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+void ColumnMap::build(const String *keys, size_t count) {
+    if (count > MAX_KEYS) {
+        count = MAX_KEYS;
+    }
+
+    _keys = keys;
+    _count = count;
+    for (size_t i = 0; i < COLUMN_MAP_SLOTS; i++) {
+        _slots[i].column = -1;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int existing = find(keys[i]);
+        if (existing >= 0) {
+            // Chave repetida: mantém a primeira ocorrência
+            _canonical[i] = (uint16_t)existing;
+            continue;
+        }
+
+        insert(i, hash(keys[i].c_str(), keys[i].length()));
+    }
+    buildPrefixes();
+}
+
+void ColumnMap::insert(size_t i, uint32_t h) {
+    size_t pos = h & (COLUMN_MAP_SLOTS - 1);
+    while (_slots[pos].column >= 0) {
+        pos = (pos + 1) & (COLUMN_MAP_SLOTS - 1);
+    }
+    _slots[pos].hash = h;
+    _slots[pos].column = (int16_t)i;
+    _canonical[i] = (uint16_t)i;
+    _decimals[i] = (int8_t)decimalsForKey(COLUMN_DECIMALS, _keys[i].c_str(),
+                                          _keys[i].length(), FLOAT_DECIMALS);
+}
+
+int ColumnMap::add() {
+    if (_count >= MAX_KEYS) {
+        return -1;
+    }
+    size_t i = _count++;
+    insert(i, hash(_keys[i].c_str(), _keys[i].length()));
+    _prune = false;     // Prefixos da coluna nova não estão na tabela
+    return (int)i;
+}
+
+// Prefixos até cada '_' de cada chave, sem repetição. O hash do prefixo é
+// o estado do FNV-1a da chave naquele ponto.
+void ColumnMap::buildPrefixes() {
+    for (size_t i = 0; i < COLUMN_PREFIX_SLOTS; i++) {
+        _prefixes[i].column = -1;
+    }
+    _prune = true;
+
+    size_t used = 0;
+    for (size_t i = 0; i < _count; i++) {
+        const char *k = _keys[i].c_str();
+        size_t n = _keys[i].length();
+        uint32_t h = 2166136261u;
+
+        for (size_t len = 0; len < n; len++) {
+            if (k[len] == '_' && len > 0 && !wants(k, len)) {
+                if (len > 0xFF || ++used > COLUMN_PREFIX_SLOTS / 2) {
+                    _prune = false;
+                    return;
+                }
+                size_t pos = h & (COLUMN_PREFIX_SLOTS - 1);
+                while (_prefixes[pos].column >= 0) {
+                    pos = (pos + 1) & (COLUMN_PREFIX_SLOTS - 1);
+                }
+                _prefixes[pos].hash = h;
+                _prefixes[pos].column = (int16_t)i;
+                _prefixes[pos].len = (uint8_t)len;
+            }
+            h ^= (uint8_t)k[len];
+            h *= 16777619u;
+        }
+    }
+}
+
+bool ColumnMap::wants(const char *path, size_t len) const {
+    if (!_prune || find(path, len) >= 0) {
+        return true;
+    }
+
+    uint32_t h = hash(path, len);
+    size_t pos = h & (COLUMN_PREFIX_SLOTS - 1);
+    while (_prefixes[pos].column >= 0) {
+        const PrefixSlot &s = _prefixes[pos];
+        if (s.hash == h && s.len == len && memcmp(_keys[s.column].c_str(), path, len) == 0) {
+            return true;
+        }
+        pos = (pos + 1) & (COLUMN_PREFIX_SLOTS - 1);
+    }
+    return false;
+}
+
+int ColumnMap::find(const char *key, size_t len) const {
+    if (_count == 0) {
+        return -1;
+    }
+
+    uint32_t h = hash(key, len);
+    size_t pos = h & (COLUMN_MAP_SLOTS - 1);
+    while (_slots[pos].column >= 0) {
+        const Slot &s = _slots[pos];
+        if (s.hash == h) {
+            const String &k = _keys[s.column];
+            if (k.length() == len && memcmp(k.c_str(), key, len) == 0) {
+                return s.column;
+            }
+        }
+        pos = (pos + 1) & (COLUMN_MAP_SLOTS - 1);
+    }
+    return -1;
+}
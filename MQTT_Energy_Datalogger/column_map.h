@@ -0,0 +1,96 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - COLUMN MAP (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Tabela hash chave -> índice de coluna, montada uma única vez quando o
+cabeçalho do CSV é fixado. Substitui a busca linear de findValueForKey()
+(O(N) comparações de String por coluna, O(N²) por linha) por uma consulta
+O(1) por campo achatado.
+
+Detalhes:
+---------
+- Endereçamento aberto com sondagem linear, COLUMN_MAP_SLOTS entradas
+  (potência de 2, pelo menos 2x MAX_KEYS para manter a carga <= 50%).
+- Hash FNV-1a de 32 bits; a chave só é comparada quando o hash coincide.
+- Chaves repetidas no cabeçalho apontam para a primeira ocorrência
+  (mesma semântica de findValueForKey). canonical(i) devolve essa coluna.
+- Guarda também as casas decimais de cada coluna (COLUMN_DECIMALS),
+  resolvidas uma vez no build().
+- add() acrescenta uma coluna depois do build() (dicionário de colunas,
+  column_dict.h); a partir daí wants() não poda mais nada.
+
+Plano de extração (wants):
+--------------------------
+- Uma segunda tabela guarda os prefixos das chaves até cada '_'
+  ("energia" e "energia_ativa" para "energia_ativa_value"), como
+  (hash, coluna, tamanho): o texto é o da própria chave.
+- wants(caminho) = o caminho é uma coluna ou o início de uma. O achatamento
+  não desce nas subárvores em que wants() é falso (json_flatten/json_stream).
+- Se os prefixos não couberem em COLUMN_PREFIX_SLOTS (carga <= 50%),
+  wants() é sempre verdadeiro: nada é podado.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+
+#define COLUMN_MAP_SLOTS     512   // Potência de 2, >= 2 * MAX_KEYS
+#define COLUMN_PREFIX_SLOTS  256   // Potência de 2; prefixos até '_' das chaves
+
+class ColumnMap {
+public:
+    ColumnMap();
+
+    // Monta a tabela a partir das chaves do cabeçalho (a tabela guarda o
+    // ponteiro: keys deve continuar válido enquanto o mapa for usado).
+    void build(const String *keys, size_t count);
+
+    // Acrescenta keys[count()] (no mesmo array do build) como nova coluna.
+    // Retorna o índice, ou -1 se já há MAX_KEYS colunas.
+    int add();
+
+    // Índice da coluna com a chave informada, ou -1 se não pertence ao cabeçalho.
+    int find(const char *key, size_t len) const;
+    int find(const String &key) const { return find(key.c_str(), key.length()); }
+
+    // true se o caminho achatado é uma coluna ou o prefixo de uma até '_'.
+    bool wants(const char *path, size_t len) const;
+
+    // Primeira coluna com a mesma chave da coluna i.
+    size_t canonical(size_t i) const { return _canonical[i]; }
+
+    size_t count() const { return _count; }
+
+    // Casas decimais dos valores de ponto flutuante da coluna i.
+    int decimals(size_t i) const { return _decimals[i]; }
+
+    static uint32_t hash(const char *key, size_t len);
+
+private:
+    struct Slot {
+        uint32_t hash;
+        int16_t  column;    // -1 = vazio
+    };
+
+    struct PrefixSlot {
+        uint32_t hash;
+        int16_t  column;    // Coluna cuja chave começa com o prefixo; -1 = vazio
+        uint8_t  len;
+    };
+
+    void insert(size_t i, uint32_t h);
+    void buildPrefixes();
+
+    Slot _slots[COLUMN_MAP_SLOTS];
+    PrefixSlot _prefixes[COLUMN_PREFIX_SLOTS];
+    bool _prune;            // false: tabela de prefixos cheia, wants() sempre true
+    uint16_t _canonical[MAX_KEYS];
+    int8_t _decimals[MAX_KEYS];
+    const String *_keys;
+    size_t _count;
+};
@@ -12,12 +12,259 @@
 #define SD_CS_PIN      5
 #define CSV_FILE_PATH  "/energy_log.csv"
 
+// Escrita em blocos no CSV (csv_sink)
+// - O arquivo fica aberto; as linhas acumulam em RAM e vão para o SD
+//   quando o buffer enche ou quando o dado mais antigo passa do tempo limite.
+// - Bloco que o SD não gravou fica no buffer e é regravado depois; com o
+//   buffer cheio, as linhas novas são descartadas (contadas em "lost").
+#define CSV_SINK_BUFFER_SIZE  4096      // Múltiplo de 512 (setor do SD)
+#define CSV_SINK_FLUSH_MS     2000      // Idade máxima de dados não gravados
+#define CSV_SINK_RETRY_MS     1000      // Espera para regravar um bloco após falha do SD
+
+// ----------------------------------------------------
+// Formato do log no SD
+// - LOG_FORMAT_CSV:    texto, uma linha por mensagem (CSV_FILE_PATH)
+// - LOG_FORMAT_BINARY: colunar compacto (bin_log), em BIN_FILE_PATH;
+//                      converter com tools/binlog2csv
+// ----------------------------------------------------
+#define LOG_FORMAT_CSV      0
+#define LOG_FORMAT_BINARY   1
+#define LOG_FORMAT          LOG_FORMAT_CSV
+#define BIN_FILE_PATH       "/energy_log.bin"
+
+// ----------------------------------------------------
+// Esquema das colunas
+// - LOG_SCHEMA_FIXED:  cabeçalho da 1ª mensagem válida; campos que
+//                      aparecem depois (ou em outros tópicos) são descartados
+// - LOG_SCHEMA_SPARSE: dicionário de colunas (column_dict) que cresce com
+//                      cada chave nova, salvo em COLUMN_DICT_PATH; linhas só
+//                      com os pares (coluna, valor) presentes. Exige
+//                      LOG_FORMAT_BINARY e AGG_WINDOW_MS = 0
+// - SCHEMA_CACHE_TOPICS: tópicos com o esquema da última mensagem em cache
+// ----------------------------------------------------
+#define LOG_SCHEMA_FIXED    0
+#define LOG_SCHEMA_SPARSE   1
+#define LOG_SCHEMA          LOG_SCHEMA_FIXED
+#define COLUMN_DICT_PATH    "/columns.txt"
+#define SCHEMA_CACHE_TOPICS 8
+
+// ----------------------------------------------------
+// Segmentos do log (log_segments)
+// - LOG_SEGMENTS = 0: um arquivo só (CSV_FILE_PATH / BIN_FILE_PATH)
+// - LOG_SEGMENTS = 1: arquivos em LOG_DIR, um novo a cada boot e quando
+//   o atual passa de LOG_ROTATE_BYTES ou LOG_ROTATE_MS (0 = sem limite),
+//   cada um com índice de tempo (1 entrada a cada LOG_INDEX_EVERY linhas)
+//   e CRC de cada bloco gravado (recuperação após queda de energia)
+// - LOG_PREALLOCATE = 1: cada segmento é criado já com LOG_ROTATE_BYTES
+//   (+ um bloco) zerados, e as gravações não aumentam o arquivo. A criação
+//   leva alguns segundos por MiB no boot e na rotação.
+// ----------------------------------------------------
+#define LOG_SEGMENTS        0
+#define LOG_DIR             "/log"
+#define LOG_ROTATE_BYTES    (1UL * 1024 * 1024)
+#define LOG_ROTATE_MS       (24UL * 3600 * 1000)
+#define LOG_INDEX_EVERY     64
+#define LOG_PREALLOCATE     1
+#define LOG_RECOVER_MAX_BLOCKS 8       // Blocos conferidos no boot (do fim para o início)
+
+// ----------------------------------------------------
+// Partição do log (log_partitions), só CSV e sem LOG_SEGMENTS
+// - LOG_PARTITION_NONE:   tudo em CSV_FILE_PATH
+// - LOG_PARTITION_TOPIC:  um CSV por tópico em PARTITION_DIR
+// - LOG_PARTITION_CLIENT: um CSV por client_id em PARTITION_DIR
+// - PARTITION_MAX: partições com buffer próprio em RAM (de
+//   PARTITION_BUFFER_SIZE bytes); deve cobrir os tópicos ativos
+// - PARTITION_OPEN_MAX: arquivos abertos ao mesmo tempo (os usados há
+//   mais tempo são fechados). O SD.begin() da ESP32 abre no máximo 5
+//   arquivos; sobra 1 para os demais (dicionário, diagnóstico)
+// - PARTITION_NAME_MAX: caracteres do nome do arquivo (sem ".csv")
+// ----------------------------------------------------
+#define LOG_PARTITION_NONE   0
+#define LOG_PARTITION_TOPIC  1
+#define LOG_PARTITION_CLIENT 2
+#define LOG_PARTITION        LOG_PARTITION_NONE
+#define PARTITION_DIR        "/parts"
+#define PARTITION_MAX        16
+#define PARTITION_BUFFER_SIZE 1024      // Múltiplo de 512 (setor do SD)
+#define PARTITION_OPEN_MAX   4
+#define PARTITION_NAME_MAX   48
+
+// ----------------------------------------------------
+// Compressão do log (log_compress)
+// - LOG_COMPRESS = 1: cada bloco do csv_sink (ou do buffer de uma
+//   partição) vai para o SD como um frame LZ que se descomprime sozinho;
+//   os arquivos ganham LOG_COMPRESS_EXT no nome. No PC: tools/logunpack.
+//   RAM: 10 KiB de tabelas + um bloco de saída por csv_sink/partições
+// - Com LOG_SEGMENTS, cada linha indexada começa um frame (um bloco a
+//   mais no SD a cada LOG_INDEX_EVERY linhas), então cada trecho de
+//   logFindRange() se descomprime sem o resto do arquivo
+// - Binário sem LOG_SEGMENTS só com LOG_SCHEMA_SPARSE: o esquema fixo é
+//   relido do arquivo no boot
+// ----------------------------------------------------
+#define LOG_COMPRESS         0
+#define LOG_COMPRESS_EXT     ".lz"
+
+// ----------------------------------------------------
+// Saídas extras das linhas (row_fanout / row_sinks), além do log no SD
+// - Cada linha achatada (já agregada / filtrada pelo deadband) é entregue
+//   uma vez, por referência, a cada saída ativa; nada é reinterpretado
+// - ROW_SINK_SERIAL = 1: uma linha "tópico chave=valor ..." no Serial
+//   (pelo buffer do diag_log; com ele cheio, a linha é perdida)
+// - ROW_SINK_MQTT = 1: a linha em JSON republicada no broker local em
+//   ROW_SINK_MQTT_PREFIX + tópico (tópicos com o prefixo não são logados).
+//   Buffer próprio de ROW_SINK_MQTT_BUFFER bytes, esvaziado pelo loop();
+//   linhas com mais de ROW_SINK_MQTT_PAYLOAD_MAX bytes de JSON não saem
+// - ROW_SINK_BINARY = 1 (só com LOG_FORMAT_CSV): cópia binária (bin_log)
+//   em BIN_FILE_PATH, com buffer próprio. Ocupa um arquivo aberto a mais
+// - Isolamento: uma saída extra que falha ou passa de ROW_SINK_SLOW_US em
+//   ROW_SINK_STRIKES linhas seguidas fica suspensa por ROW_SINK_BACKOFF_MS
+//   (as linhas do período não vão para ela); idem com ROW_SINK_STRIKES
+//   travamentos (write/poll/flush acima de ROW_SINK_STALL_US, ex.: SD
+//   parado) a menos de ROW_SINK_BACKOFF_MS um do outro, mesmo entre
+//   linhas boas. O log no SD nunca é suspenso
+// - Não valem com LOG_SCHEMA_SPARSE
+// ----------------------------------------------------
+#define ROW_SINK_SERIAL           0
+#define ROW_SINK_MQTT             0
+#define ROW_SINK_MQTT_PREFIX      "clean/"
+#define ROW_SINK_MQTT_BUFFER      4096
+#define ROW_SINK_MQTT_PAYLOAD_MAX 1024    // Até MSG_PAYLOAD_MAX
+#define ROW_SINK_BINARY           0
+#define ROW_SINK_SLOW_US          2000
+#define ROW_SINK_STALL_US         50000   // Acima de um bloco normal no SD
+#define ROW_SINK_STRIKES          3
+#define ROW_SINK_BACKOFF_MS       10000
+#define ROW_SINK_MAX              4       // Saídas registradas (log + extras)
+
 // MQTT Broker
 #define MQTT_BROKER_PORT 1883
+#define MQTT_MAX_CLIENTS 8              // Dispositivos externos (o logger interno é extra)
+
+// Fila entre o callback MQTT e a task de logging (msg_queue / logger_task)
+#define MSG_QUEUE_SLOTS       8         // Mensagens em espera
+#define MSG_TOPIC_MAX         128       // Bytes de tópico por mensagem
+#define MSG_PAYLOAD_MAX       4096      // Bytes de payload por mensagem
+
+// Política quando a fila está cheia
+#define INGEST_DROP_NEWEST    0         // Descarta a mensagem que chegou
+#define INGEST_DROP_OLDEST    1         // Descarta a mais antiga da fila
+#define INGEST_BLOCK          2         // Callback espera abrir espaço
+#define INGEST_OVERFLOW_POLICY INGEST_DROP_OLDEST
+
+// Classes de tópico na fila (regras no formato de TOPIC_FILTER; "" = nenhum)
+// - INGEST_CRITICAL_TOPICS: nunca descartados; as últimas
+//   INGEST_CRITICAL_RESERVE posições (< MSG_QUEUE_SLOTS) são só deles e,
+//   com a fila toda cheia, o callback espera
+// - INGEST_LATEST_TOPICS: com a fila cheia, a mensagem nova substitui a
+//   do mesmo tópico que ainda está na fila ("latest wins")
+#define INGEST_CRITICAL_TOPICS  ""
+#define INGEST_LATEST_TOPICS    ""
+#define INGEST_CRITICAL_RESERVE 2
+#define INGEST_TOPIC_STATS      16      // Tópicos com contadores próprios de descarte
+
+// Task de logging (ESP32: loop() do Arduino roda no núcleo 1)
+#define LOGGER_TASK_CORE      0
+#define LOGGER_TASK_PRIORITY  1
+#define LOGGER_TASK_STACK     8192
+#define LOGGER_TASK_IDLE_MS   100       // Intervalo de flush por idade quando ociosa
+#define LOGGER_TASK_LOOP_EVERY 32       // Sob carga contínua: loggerLoop() a cada N mensagens
+#define LOGGER_TASK_LOOP_MS   100       // ... ou a cada T ms, o que vier antes
+
+// Publicar qualquer coisa neste tópico grava no SD tudo o que está pendente
+// (ex.: antes de retirar o cartão ou desligar a placa)
+#define LOGGER_FLUSH_TOPIC    "$SYS/datalogger/flush"
 
 // JSON / CSV
 #define MAX_KEYS          200           // Máximo de colunas extraídas
 #define JSON_BUFFER_SIZE  12288        // Ajuste conforme tamanho típico do payload
+#define JSON_STREAM_MAX_DEPTH 10        // Aninhamento máximo (mesmo limite padrão do ArduinoJson)
+#define FLAT_ARENA_SIZE   4096         // Texto achatado (chaves+valores) por mensagem, máx. 65535
+#define FLAT_PATH_SIZE    128          // Tamanho máximo de uma chave achatada
+
+// ----------------------------------------------------
+// Casas decimais dos números com ponto flutuante (num_format)
+// - FLOAT_DECIMALS: padrão de todas as colunas;
+//   FLOAT_DECIMALS_SHORTEST = menor texto que relê o mesmo valor
+//   (223.5, 1000000, 0.001); 6 = formato antigo (223.500000)
+// - COLUMN_DECIMALS: por coluna, "chave:casas" separados por ';';
+//   '*' no fim da chave casa prefixo. Ex: "tensao_*:1;fp:3;energia_*:0"
+// Inteiros do JSON não são afetados.
+// ----------------------------------------------------
+#define FLOAT_DECIMALS_SHORTEST  (-1)
+#define FLOAT_DECIMALS           FLOAT_DECIMALS_SHORTEST
+#define COLUMN_DECIMALS          ""
+
+// ----------------------------------------------------
+// Agregação por janela (aggregator)
+// - AGG_WINDOW_MS = 0: uma linha por mensagem (sem agregação)
+// - AGG_WINDOW_MS > 0: uma linha por janela e por tópico, com as
+//   estatísticas de AGG_STATS para cada coluna (ex.: 1000, 10000, 60000)
+// ----------------------------------------------------
+#define AGG_WINDOW_MS     0
+#define AGG_STAT_MEAN     0x01
+#define AGG_STAT_MIN      0x02
+#define AGG_STAT_MAX      0x04
+#define AGG_STAT_LAST     0x08
+#define AGG_STATS         (AGG_STAT_MEAN | AGG_STAT_MIN | AGG_STAT_MAX | AGG_STAT_LAST)
+#define AGG_MAX_TOPICS    4             // Tópicos com janela aberta ao mesmo tempo
+#define AGG_CLIENT_MAX    32            // Bytes de client_id guardados por tópico
+#define AGG_TEXT_SIZE     1024          // Valores não numéricos por tópico/janela
+
+// ----------------------------------------------------
+// Filtro de variação (deadband)
+// - DEADBAND_ENABLED = 1: a linha de um tópico só é gravada se algum
+//   campo mudou além da faixa da coluna desde a última linha gravada do
+//   tópico, ou se ela tem mais de DEADBAND_HEARTBEAT_MS (0 = sem limite)
+// - COLUMN_DEADBAND: faixa por coluna, "chave:faixa" separados por ';',
+//   absoluta ou relativa com '%'; '*' no fim da chave casa prefixo.
+//   Sem regra: qualquer mudança conta. Ex: "freq:0.05;tensao_*:0.5%"
+// - DEADBAND_FIELDS = 1: campos dentro da faixa ficam vazios nas linhas
+//   gravadas (o valor é o da última linha em que aparecem)
+// Só vale sem agregação (AGG_WINDOW_MS = 0).
+// ----------------------------------------------------
+#define DEADBAND_ENABLED       0
+#define COLUMN_DEADBAND        ""
+#define DEADBAND_HEARTBEAT_MS  60000
+#define DEADBAND_FIELDS        0
+#define DEADBAND_MAX_TOPICS    4       // Tópicos com valores guardados ao mesmo tempo
+
+// Colunas de dados no arquivo: MAX_KEYS, ou "samples" + 4 estatísticas
+#define LOG_MAX_COLUMNS   (1 + 4 * MAX_KEYS)
+
+// ----------------------------------------------------
+// Parser do payload JSON
+// - JSON_PARSER_STREAM: uma passada sobre o texto (json_stream), sem DOM;
+//                       memória limitada pela profundidade, não pelo payload
+// - JSON_PARSER_DOM:    DynamicJsonDocument(JSON_BUFFER_SIZE) + json_flatten
+// ----------------------------------------------------
+#define JSON_PARSER_DOM     0
+#define JSON_PARSER_STREAM  1
+#define JSON_PARSER_MODE    JSON_PARSER_STREAM
+
+// ----------------------------------------------------
+// Plano de extração (colunas do cabeçalho)
+// - Nos dois modos, subárvores do JSON que não levam a nenhuma coluna
+//   não são achatadas (só validadas e contadas)
+// - JSON_PARSE_FILTER = 1 (JSON_PARSER_DOM): depois do cabeçalho, o
+//   deserializeJson() usa um filtro com o caminho de cada coluna na 1ª
+//   mensagem, e o resto do payload não ocupa o documento (JSON_BUFFER_SIZE
+//   só precisa comportar os campos gravados). Muda a saída: mensagens sem
+//   nenhum campo do cabeçalho deixam de gerar linha. Desligado por padrão.
+// - JSON_FILTER_SIZE: documento do filtro, alocado uma vez
+// ----------------------------------------------------
+#define JSON_PARSE_FILTER   0
+#define JSON_FILTER_SIZE    4096
+
+// ----------------------------------------------------
+// Documento do modo DOM (json_pool)
+// - O documento de JSON_BUFFER_SIZE é criado uma vez, em uma área
+//   reservada só para ele, e reaproveitado a cada mensagem (sem alocar
+//   e liberar o heap por mensagem)
+// - JSON_POOL_DOCS: documentos que a área comporta (1..32)
+// - JSON_POOL_PSRAM = 1: área na PSRAM (placas com BOARD_HAS_PSRAM)
+// ----------------------------------------------------
+#define JSON_POOL_DOCS      1
+#define JSON_POOL_PSRAM     0
 
 // ----------------------------------------------------
 // Modo de descoberta da estrutura do JSON
@@ -27,9 +274,46 @@
 #define DISCOVERY_MODE 0
 
 // ----------------------------------------------------
-// Filtro de tópico (opcional)
+// Mensagens de diagnóstico no Serial (diag_log)
+// - DIAG_LEVEL: o que está acima é removido na compilação
+//   DIAG_LEVEL_INFO  = inicialização, avisos e erros (uso normal)
+//   DIAG_LEVEL_DEBUG = + uma linha por mensagem
+//   DIAG_LEVEL_TRACE = + payload bruto e cada campo (115200 baud: lento)
+// - As linhas passam por um buffer em RAM; se encher, são descartadas
+// ----------------------------------------------------
+#define DIAG_LEVEL_NONE     0
+#define DIAG_LEVEL_ERROR    1
+#define DIAG_LEVEL_WARN     2
+#define DIAG_LEVEL_INFO     3
+#define DIAG_LEVEL_DEBUG    4
+#define DIAG_LEVEL_TRACE    5
+#define DIAG_LEVEL          DIAG_LEVEL_INFO
+#define DIAG_RING_SIZE      4096        // Bytes de linhas pendentes
+#define DIAG_LINE_MAX       192         // Linha maior é truncada
+#define DIAG_DRAIN_MS       20          // Intervalo de escoamento
+#define DIAG_TASK_CORE      0
+#define DIAG_TASK_PRIORITY  0           // Abaixo da task de logging
+#define DIAG_TASK_STACK     3072
+
+// ----------------------------------------------------
+// Métricas do pipeline (metrics)
+// - Histogramas de latência por etapa e contadores, publicados a cada
+//   METRICS_PERIOD_MS em METRICS_TOPIC pelo cliente interno, e os
+//   contadores da fila (por tópico) em METRICS_INGEST_TOPIC
+// - METRICS_ENABLED = 0: instrumentação removida na compilação
+// ----------------------------------------------------
+#define METRICS_ENABLED        1
+#define METRICS_TOPIC          "$SYS/datalogger/metrics"
+#define METRICS_INGEST_TOPIC   "$SYS/datalogger/ingest"
+#define METRICS_PERIOD_MS      10000
+#define METRICS_SNAPSHOT_SIZE  1792
+
+// ----------------------------------------------------
+// Filtro de tópico (opcional, ver topic_filter.h)
 // - String vazia ""        -> aceita todos os tópicos
-// - Ex: "MiEnergy/"        -> só processa tópicos que
-//                             comecem com "MiEnergy/"
+// - Regras separadas por ';', curingas MQTT "+" e "#",
+//   '!' no início = rejeitar. Ex:
+//     "MiEnergy/#"                     -> só tópicos sob MiEnergy/
+//     "MiEnergy/#;!MiEnergy/+/debug"   -> idem, menos os de debug
 // ----------------------------------------------------
 #define TOPIC_FILTER ""
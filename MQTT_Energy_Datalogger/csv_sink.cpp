@@ -0,0 +1,297 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - CSV SINK (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa:
+-----------
+- Abertura única do arquivo em modo append (FILE_APPEND). Observação: no core
+  da ESP32, FILE_WRITE é "w" e trunca o arquivo a cada abertura.
+- Buffer em RAM de CSV_SINK_BUFFER_SIZE bytes; cada descarregamento é um único
+  File::write() seguido de File::flush(), em vez de um open/close por linha.
+- Reabertura automática na próxima escrita se o handle for perdido.
+- Bloco que falhou fica no buffer e é regravado após CSV_SINK_RETRY_MS. Em
+  append, o que a escrita incompleta já gravou (o arquivo cresceu) não é
+  regravado; com LOG_COMPRESS o frame cortado fica no arquivo.
+- Só linhas completas vão para o SD: a linha aberta fica no buffer (no
+  início dele) até endRow(), a não ser que sozinha passe do buffer.
+- Modo pré-alocado: o arquivo é preenchido com zeros uma vez (no tamanho
+  final) e reaberto em "r+"; cada bloco é escrito na posição seguinte.
+- LOG_COMPRESS: writeBlock() comprime cada bloco em um frame e writeFile()
+  grava o frame como gravaria o bloco.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+#include "csv_sink.h"
+#include "metrics.h"
+#include "diag_log.h"
+
+CsvSink::CsvSink()
+    : _path(nullptr), _prealloc(false), _offset(0), _commit(nullptr),
+      _commitCtx(nullptr), _len(0), _rowStart(0), _inRow(false), _dropping(false),
+      _pendingRows(0), _failed(false), _dropLogged(false), _failedAt(0), _pendingSince(0),
+      _stats{0, 0, 0, 0, 0, 0, 0} {
+}
+
+// Linhas que ainda estavam no buffer quando o arquivo é trocado
+static void discardPending(CsvSinkStats &stats, uint32_t &rows) {
+    if (rows > 0) {
+        stats.dropped += rows;
+        metricsCount(METRIC_LOST, rows);
+        DIAG_ERROR("CsvSink: %lu linha(s) não gravada(s) descartada(s).", (unsigned long)rows);
+        rows = 0;
+    }
+}
+
+bool CsvSink::begin(const char *path) {
+    discardPending(_stats, _pendingRows);
+    _path = path;
+    _prealloc = false;
+    _offset = 0;
+    _len = 0;
+    _failed = false;
+    return ensureOpen();
+}
+
+bool CsvSink::beginPreallocated(const char *path, uint32_t bytes) {
+    discardPending(_stats, _pendingRows);
+    _path = path;
+    _prealloc = true;
+    _offset = 0;
+    _len = 0;
+    _failed = false;
+
+    if (!SD.exists(path)) {
+        File f = SD.open(path, FILE_WRITE);
+        if (!f) {
+            _stats.errors++;
+            DIAG_ERROR("CsvSink: erro ao criar %s", path);
+            return false;
+        }
+        // O buffer ainda está vazio: serve de bloco de zeros
+        memset(_buf, 0, sizeof(_buf));
+        for (uint32_t done = 0; done < bytes; ) {
+            size_t n = (bytes - done < sizeof(_buf)) ? bytes - done : sizeof(_buf);
+            if (f.write(_buf, n) != n) {
+                _stats.errors++;
+                break;
+            }
+            done += n;
+        }
+        f.close();
+    }
+    return ensureOpen();
+}
+
+void CsvSink::setCommit(CsvSinkCommit fn, void *ctx) {
+    _commit = fn;
+    _commitCtx = ctx;
+}
+
+bool CsvSink::ensureOpen() {
+    if (_file) {
+        return true;
+    }
+    if (!_path) {
+        return false;
+    }
+
+    _file = SD.open(_path, _prealloc ? "r+" : FILE_APPEND);
+    _stats.opens++;
+    if (!_file) {
+        _stats.errors++;
+        DIAG_ERROR("CsvSink: erro ao abrir %s", _path);
+        return false;
+    }
+    // Append: continua no fim. Pré-alocado: volta ao fim dos dados (após
+    // uma escrita incompleta, o bloco seguinte grava por cima dela)
+    if (!_prealloc) {
+        _offset = _file.size();
+    } else if (!_file.seek(_offset)) {
+        _stats.errors++;
+        _file.close();
+        return false;
+    }
+    return true;
+}
+
+size_t CsvSink::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+void CsvSink::beginRow() {
+    _rowStart = _len;
+    _inRow = true;
+    _dropping = false;
+}
+
+void CsvSink::endRow() {
+    if (!_dropping) {
+        _pendingRows++;
+    }
+    _inRow = false;
+    _dropping = false;
+}
+
+// Descarta a linha atual (o que dela já está no buffer e o resto)
+void CsvSink::drop() {
+    if (!_dropLogged) {
+        DIAG_ERROR("CsvSink: buffer cheio sem gravar no SD; descartando linhas.");
+        _dropLogged = true;
+    }
+    _stats.dropped++;
+    metricsCount(METRIC_LOST);
+    // Linha maior que o buffer: o que já foi para o SD fica incompleto
+    if (_inRow) {
+        _len = _rowStart;
+        _dropping = true;
+    }
+}
+
+size_t CsvSink::write(const uint8_t *data, size_t len) {
+    if (len == 0 || _dropping) {
+        return 0;
+    }
+
+    // Não cabe no que resta do buffer: descarrega as linhas completas (a
+    // atual vai para o início do buffer)
+    if (_len + len > CSV_SINK_BUFFER_SIZE && !flush()) {
+        drop();
+        return 0;
+    }
+
+    // Linha maior que o buffer: o começo dela vai para o SD antes
+    if (_len + len > CSV_SINK_BUFFER_SIZE && !writeBuffer(_len)) {
+        drop();
+        return 0;
+    }
+
+    // Maior que o buffer inteiro: vai direto para o arquivo
+    if (len > CSV_SINK_BUFFER_SIZE) {
+        if (writeBlock(data, len)) {
+            return len;
+        }
+        drop();
+        return 0;
+    }
+
+    if (_len == 0) {
+        _pendingSince = millis();
+    }
+    memcpy(_buf + _len, data, len);
+    _len += len;
+    return len;
+}
+
+bool CsvSink::writeBlock(const uint8_t *data, size_t len) {
+#if LOG_COMPRESS
+    // Um frame por bloco do tamanho do buffer (o frame cabe em _frame)
+    bool ok = true;
+    while (len > 0) {
+        size_t n = (len < CSV_SINK_BUFFER_SIZE) ? len : CSV_SINK_BUFFER_SIZE;
+        uint32_t t = metricsStart();
+        size_t frame = lzFrameEncode(data, n, _frame);
+        metricsRecord(METRIC_COMPRESS, t);
+        if (writeFile(_frame, frame)) {
+            _stats.rawBytes += n;
+        } else {
+            ok = false;
+        }
+        data += n;
+        len -= n;
+    }
+    return ok;
+#else
+    if (!writeFile(data, len)) {
+        return false;
+    }
+    _stats.rawBytes += len;
+    return true;
+#endif
+}
+
+bool CsvSink::writeFile(const uint8_t *data, size_t len) {
+    if (!ensureOpen()) {
+        return false;
+    }
+    if (_commit) {
+        _commit(_commitCtx, _offset, data, len);
+    }
+
+    uint32_t t = metricsStart();
+    size_t n = _file.write(data, len);
+    _stats.writes++;
+    _stats.bytes += n;
+    if (n != len) {
+        _stats.errors++;
+        DIAG_ERROR("CsvSink: escrita incompleta (%lu/%lu bytes). Arquivo será reaberto.",
+                   (unsigned long)n, (unsigned long)len);
+        _file.close();
+        return false;
+    }
+    _offset += n;
+
+    _file.flush();
+    _stats.flushes++;
+    metricsRecord(METRIC_SD_WRITE, t);
+    return true;
+}
+
+void CsvSink::poll() {
+    if (_len > 0 && (millis() - _pendingSince) >= CSV_SINK_FLUSH_MS) {
+        flush();
+    }
+}
+
+bool CsvSink::flush() {
+    // A linha aberta fica no buffer: vai para o SD só completa
+    return writeBuffer(_inRow ? _rowStart : _len);
+}
+
+// Grava [0, n) do buffer e traz o resto para o início
+bool CsvSink::writeBuffer(size_t n) {
+    if (n == 0) {
+        return true;
+    }
+    if (_failed && (millis() - _failedAt) < CSV_SINK_RETRY_MS) {
+        return false;
+    }
+
+#if !LOG_COMPRESS
+    // Append após escrita incompleta: o começo do bloco já está no arquivo
+    uint32_t expected = _offset;
+    if (_failed && !_prealloc && ensureOpen() && _offset > expected) {
+        size_t landed = _offset - expected;
+        landed = (landed < n) ? landed : n;
+        memmove(_buf, _buf + landed, _len - landed);
+        _len -= landed;
+        _rowStart = (_rowStart > landed) ? _rowStart - landed : 0;
+        n -= landed;
+    }
+#endif
+
+    // Em caso de falha o bloco fica no buffer para a próxima tentativa
+    if (n > 0 && !writeBlock(_buf, n)) {
+        _failed = true;
+        _failedAt = millis();
+        return false;
+    }
+    _failed = false;
+    _dropLogged = false;
+    memmove(_buf, _buf + n, _len - n);
+    _len -= n;
+    _rowStart = (_rowStart > n) ? _rowStart - n : 0;
+    _pendingRows = 0;
+    return true;
+}
+
+void CsvSink::end() {
+    flush();
+    if (_file) {
+        _file.close();
+    }
+}
@@ -0,0 +1,155 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - CSV SINK (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Escrita "write-behind" do CSV no cartão SD:
+
+- Mantém o arquivo aberto durante toda a operação (um único SD.open()).
+- Acumula as linhas em um buffer em RAM.
+- Descarrega o buffer em blocos grandes quando:
+    - o buffer atinge CSV_SINK_BUFFER_SIZE bytes, ou
+    - o dado mais antigo pendente tem mais de CSV_SINK_FLUSH_MS ms.
+
+Uso:
+----
+CsvSink herda de Print, então as linhas são montadas com print()/println()
+exatamente como seria feito em um File. poll() deve ser chamado
+periodicamente (loop) para o descarregamento por idade, e flush()/end()
+antes de desligar ou remover o cartão.
+
+Arquivo pré-alocado (beginPreallocated):
+----------------------------------------
+O arquivo é criado já com o tamanho final, preenchido com zeros, e os
+blocos são escritos por cima a partir do início. Assim as gravações não
+aumentam o arquivo (sem alocar clusters na FAT a cada bloco). O fim dos
+dados válidos não é o tamanho do arquivo: vem do callback de commit.
+
+Falha do SD:
+------------
+Um bloco que não foi gravado continua no buffer e é gravado de novo no
+próximo descarregamento, no mínimo CSV_SINK_RETRY_MS depois da falha.
+Enquanto isso as linhas seguem para o buffer; se ele encher, cada linha
+que não cabe é descartada inteira (entre beginRow() e endRow(); fora
+delas, cada write()) e contada em stats().dropped e em METRIC_LOST.
+Uma linha aberta nunca vai para o SD pela metade (o descarregamento leva
+só as linhas completas), a não ser que sozinha passe do buffer.
+
+Commit (setCommit):
+-------------------
+O callback é chamado com cada bloco ANTES de ele ir para o arquivo
+(write-ahead), com a posição e os bytes, para registrar o bloco
+(ex.: CRC no índice do segmento, ver log_segments.h).
+
+Compressão (LOG_COMPRESS):
+--------------------------
+Cada bloco descarregado vai para o arquivo como um frame de log_compress
+(um por CSV_SINK_BUFFER_SIZE bytes, se a escrita for maior). Posições,
+size() e o commit se referem aos bytes do arquivo (frames). flush() fecha
+o frame atual: a próxima linha começa um frame novo (ponto de leitura).
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#include "config.h"
+
+#if LOG_COMPRESS
+#include "log_compress.h"
+#if CSV_SINK_BUFFER_SIZE > LZ_BLOCK_MAX
+#error "CSV_SINK_BUFFER_SIZE acima de LZ_BLOCK_MAX"
+#endif
+// Maior bloco gravado de uma vez no arquivo
+#define CSV_SINK_BLOCK_MAX  LZ_FRAME_MAX(CSV_SINK_BUFFER_SIZE)
+#else
+#define CSV_SINK_BLOCK_MAX  CSV_SINK_BUFFER_SIZE
+#endif
+
+// Bloco prestes a ser gravado em [offset, offset + len).
+typedef void (*CsvSinkCommit)(void *ctx, uint32_t offset,
+                              const uint8_t *data, size_t len);
+
+struct CsvSinkStats {
+    uint32_t opens;      // Quantas vezes o arquivo foi aberto
+    uint32_t writes;     // Blocos escritos no File
+    uint32_t flushes;    // Chamadas a File::flush() (atualização de metadados FAT)
+    uint32_t bytes;      // Total de bytes escritos no SD
+    uint32_t rawBytes;   // Os mesmos dados antes da compressão (LOG_COMPRESS)
+    uint32_t errors;     // Escritas curtas / falhas de abertura
+    uint32_t dropped;    // Linhas descartadas (buffer cheio com o SD falhando)
+};
+
+class CsvSink : public Print {
+public:
+    CsvSink();
+
+    // Abre (append) o arquivo e mantém o handle aberto.
+    // Retorna false se não foi possível abrir.
+    bool begin(const char *path);
+
+    // Cria o arquivo com bytes zeros (se ainda não existe) e grava a
+    // partir do início, sem append.
+    bool beginPreallocated(const char *path, uint32_t bytes);
+
+    // Callback chamado antes de cada bloco (nullptr = nenhum).
+    void setCommit(CsvSinkCommit fn, void *ctx);
+
+    // Bytes de dados gravados, incluindo o que ainda está no buffer (com
+    // LOG_COMPRESS: bytes do arquivo + pendente ainda não comprimido).
+    uint32_t size() const { return _offset + _len; }
+
+    // Print
+    size_t write(uint8_t c) override;
+    size_t write(const uint8_t *data, size_t len) override;
+    using Print::write;
+
+    // Limites de uma linha: com o buffer cheio e o SD falhando, a linha é
+    // descartada inteira, nunca só o fim dela.
+    void beginRow();
+    void endRow();
+
+    // Descarrega o buffer se o dado pendente mais antigo passou do limite.
+    void poll();
+
+    // Descarrega o buffer (entre beginRow() e endRow(), só as linhas já
+    // completas) e atualiza os metadados do arquivo no SD. false se o bloco
+    // não foi gravado (continua no buffer).
+    bool flush();
+
+    // flush() + fecha o arquivo.
+    void end();
+
+    const CsvSinkStats &stats() const { return _stats; }
+
+private:
+    bool ensureOpen();
+    bool writeBuffer(size_t n);
+    bool writeBlock(const uint8_t *data, size_t len);
+    bool writeFile(const uint8_t *data, size_t len);
+    void drop();
+
+    const char *_path;
+    File _file;
+    bool _prealloc;
+    uint32_t _offset;              // Posição do próximo bloco no arquivo
+    CsvSinkCommit _commit;
+    void *_commitCtx;
+    uint8_t _buf[CSV_SINK_BUFFER_SIZE];
+#if LOG_COMPRESS
+    uint8_t _frame[CSV_SINK_BLOCK_MAX];
+#endif
+    size_t _len;
+    size_t _rowStart;              // Início da linha atual no buffer
+    bool _inRow;
+    bool _dropping;                // Linha atual descartada: ignora o resto
+    uint32_t _pendingRows;         // Linhas completas no buffer
+    bool _failed;                  // Último descarregamento falhou
+    bool _dropLogged;              // Descarte já avisado nesta falha
+    unsigned long _failedAt;
+    unsigned long _pendingSince;   // millis() do primeiro byte pendente
+    CsvSinkStats _stats;
+};
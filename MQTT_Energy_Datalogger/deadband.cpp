@@ -0,0 +1,139 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - DEADBAND (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa o filtro de variação descrito em deadband.h:
+- begin(): faixa de cada coluna (ruleForKey sobre COLUMN_DEADBAND);
+- filter(): compara cada campo com o último valor gravado do tópico e,
+  se a linha vai para o log, atualiza esses valores.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "deadband.h"
+#include "column_map.h"
+#include "num_format.h"
+
+// Só compilado com o filtro ligado (evita o estado estático sem uso)
+#if DEADBAND_ENABLED
+
+Deadband::Deadband() : _cols(0) {
+    for (size_t i = 0; i < DEADBAND_MAX_TOPICS; i++) {
+        _slots[i].used = false;
+    }
+}
+
+void Deadband::begin(const String *keys, size_t count) {
+    _cols = count;
+    for (size_t i = 0; i < count; i++) {
+        _band[i] = 0.0f;
+        _relative[i] = false;
+
+        const char *rule = ruleForKey(COLUMN_DEADBAND, keys[i].c_str(), keys[i].length());
+        if (rule) {
+            char *end;
+            double band = strtod(rule, &end);
+            _relative[i] = (*end == '%');
+            _band[i] = (float)(_relative[i] ? band / 100.0 : band);
+        }
+    }
+}
+
+// Posição do tópico; senão uma livre; senão a de gravação mais antiga.
+// Posição nova ou reaproveitada volta com used = false.
+Deadband::Slot &Deadband::slotFor(const char *topic) {
+    Slot *free = nullptr;
+    Slot *victim = &_slots[0];
+    for (size_t i = 0; i < DEADBAND_MAX_TOPICS; i++) {
+        Slot &s = _slots[i];
+        if (!s.used) {
+            if (!free) {
+                free = &s;
+            }
+            continue;
+        }
+        if (strcmp(s.topic, topic) == 0) {
+            return s;
+        }
+        if (s.lastWrite < victim->lastWrite) {
+            victim = &s;
+        }
+    }
+
+    Slot &s = free ? *free : *victim;
+    s.used = false;
+    strncpy(s.topic, topic, MSG_TOPIC_MAX);
+    s.topic[MSG_TOPIC_MAX] = '\0';
+    memset(s.kind, REF_NONE, sizeof(s.kind));
+    return s;
+}
+
+// Hash de um valor não numérico (string, bool ou null), com o mesmo
+// resultado para o mesmo texto no CSV
+static uint32_t valueHash(const char *text, const FlatValue &v) {
+    switch (v.type) {
+        case FLAT_TEXT: return ColumnMap::hash(text + v.text.off, v.text.len);
+        case FLAT_BOOL: return v.i ? ColumnMap::hash("true", 4) : ColumnMap::hash("false", 5);
+        default:        return ColumnMap::hash("", 0);
+    }
+}
+
+bool Deadband::changed(const Slot &s, size_t i, const char *text, const FlatValue &v) const {
+    if (flatIsNumber(v)) {
+        if (s.kind[i] != REF_NUMBER) {
+            return true;
+        }
+        double ref = s.ref[i].number;
+        double band = _relative[i] ? fabs(ref) * _band[i] : _band[i];
+        return fabs(flatNumber(v) - ref) > band;
+    }
+    return s.kind[i] != REF_TEXT || s.ref[i].hash != valueHash(text, v);
+}
+
+void Deadband::store(Slot &s, size_t i, const char *text, const FlatValue &v) {
+    if (flatIsNumber(v)) {
+        s.kind[i] = REF_NUMBER;
+        s.ref[i].number = flatNumber(v);
+    } else {
+        s.kind[i] = REF_TEXT;
+        s.ref[i].hash = valueHash(text, v);
+    }
+}
+
+bool Deadband::filter(uint32_t now, const char *topic, const char *text, FlatValue *cells) {
+    Slot &s = slotFor(topic);
+    bool full = !s.used ||
+                (DEADBAND_HEARTBEAT_MS > 0 && now - s.lastWrite >= DEADBAND_HEARTBEAT_MS);
+
+    bool diff[MAX_KEYS];
+    bool any = false;
+    for (size_t i = 0; i < _cols; i++) {
+        diff[i] = (cells[i].type != FLAT_ABSENT) && changed(s, i, text, cells[i]);
+        any = any || diff[i];
+    }
+    if (!any && !full) {
+        return false;
+    }
+
+    for (size_t i = 0; i < _cols; i++) {
+        FlatValue &v = cells[i];
+        if (v.type == FLAT_ABSENT) {
+            continue;
+        }
+        if (DEADBAND_FIELDS && !full && !diff[i]) {
+            v.type = FLAT_ABSENT;
+            continue;
+        }
+        store(s, i, text, v);
+    }
+    s.used = true;
+    s.lastWrite = now;
+    return true;
+}
+
+#endif  // DEADBAND_ENABLED
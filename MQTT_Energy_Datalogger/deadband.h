@@ -0,0 +1,92 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - DEADBAND (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Filtro de variação entre o achatamento e o arquivo de log
+(DEADBAND_ENABLED = 1). Guarda, por tópico, o último valor GRAVADO de
+cada coluna e descarta a linha quando todos os campos da mensagem estão
+dentro da faixa (deadband) da sua coluna em relação a esse valor.
+
+Faixas (COLUMN_DEADBAND, mesmo formato de COLUMN_DECIMALS):
+-----------------------------------------------------------
+    "freq:0.05;tensao_*:0.5%;*:0"
+- número: faixa absoluta (|novo - gravado| <= faixa não é mudança);
+- número com '%': relativa ao valor gravado;
+- colunas sem regra (ou valores não numéricos): qualquer diferença conta.
+A comparação usa os números como vieram no JSON (FlatValue), não o texto
+já arredondado para COLUMN_DECIMALS.
+
+Regras da linha:
+----------------
+- Gravada se algum campo mudou além da faixa, se é a primeira do tópico,
+  ou se a última linha gravada do tópico tem mais de DEADBAND_HEARTBEAT_MS
+  (0 = sem esse limite). Linhas de heartbeat e a primeira vão completas.
+- DEADBAND_FIELDS = 1: nas demais linhas gravadas, os campos dentro da
+  faixa ficam vazios.
+- Campos ausentes na mensagem não contam como mudança.
+
+Reconstrução:
+-------------
+Como a comparação é sempre com o último valor gravado, repetir em cada
+coluna o último valor presente no arquivo (forward fill) reproduz todas
+as amostras descartadas com erro dentro da faixa da coluna (mais o
+arredondamento das casas decimais gravadas).
+
+Memória:
+--------
+Estado estático para DEADBAND_MAX_TOPICS tópicos (9 bytes por coluna em cada
+um); um tópico novo com todas as posições ocupadas reaproveita a de
+gravação mais antiga (e a sua próxima linha sai completa).
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+#include "json_flatten.h"
+
+class Deadband {
+public:
+    Deadband();
+
+    // Faixas de cada coluna do cabeçalho (após fixá-lo).
+    void begin(const String *keys, size_t count);
+
+    // Decide a linha de um tópico (cells: valores na ordem das colunas,
+    // strings em text). false = linha descartada. Com DEADBAND_FIELDS, os
+    // campos sem mudança de uma linha gravada viram FLAT_ABSENT em cells.
+    bool filter(uint32_t now, const char *topic, const char *text, FlatValue *cells);
+
+private:
+    enum RefKind : uint8_t {
+        REF_NONE,
+        REF_NUMBER,
+        REF_TEXT
+    };
+
+    union Ref {
+        double   number;
+        uint32_t hash;      // Não numérico: hash FNV-1a (valueHash)
+    };
+
+    struct Slot {
+        bool     used;
+        uint32_t lastWrite;     // ms da última linha gravada
+        char     topic[MSG_TOPIC_MAX + 1];
+        RefKind  kind[MAX_KEYS];
+        Ref      ref[MAX_KEYS];
+    };
+
+    Slot &slotFor(const char *topic);
+    bool changed(const Slot &s, size_t i, const char *text, const FlatValue &v) const;
+    void store(Slot &s, size_t i, const char *text, const FlatValue &v);
+
+    size_t _cols;
+    float  _band[MAX_KEYS];
+    bool   _relative[MAX_KEYS];
+    Slot   _slots[DEADBAND_MAX_TOPICS];
+};
@@ -0,0 +1,212 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - DIAG LOG (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa:
+-----------
+- Buffer circular de bytes com várias fontes (callback MQTT, task de
+  logging, loop) e um consumidor. Cada linha é formatada na pilha de quem
+  chama e copiada inteira para o buffer sob um lock curto (só o memcpy).
+- Task de escoamento: a cada DIAG_DRAIN_MS escreve no Serial o trecho
+  contíguo pendente, fora do lock; a escrita lenta (115200 baud) fica
+  só nessa task.
+- Plataforma:
+    - ESP32: portMUX (seção crítica) + task FreeRTOS.
+    - Linux: std::mutex + std::thread.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "diag_log.h"
+
+static char ring[DIAG_RING_SIZE];
+static size_t head = 0;      // Próximo byte a escrever (produtores, sob lock)
+static size_t tail = 0;      // Próximo byte a enviar (consumidor)
+static size_t used = 0;      // Bytes pendentes (sob lock)
+static DiagStats stats = { 0, 0 };
+
+// -----------------------------------------------------------------------------
+// Lock e task conforme a plataforma
+// -----------------------------------------------------------------------------
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static portMUX_TYPE ringMux = portMUX_INITIALIZER_UNLOCKED;
+
+static void ringLock() {
+    portENTER_CRITICAL(&ringMux);
+}
+
+static void ringUnlock() {
+    portEXIT_CRITICAL(&ringMux);
+}
+
+static void waitMs(uint32_t ms) {
+    vTaskDelay(pdMS_TO_TICKS(ms));
+}
+#else
+#include <mutex>
+#include <thread>
+#include <chrono>
+
+static std::mutex ringMutex;
+
+static void ringLock() {
+    ringMutex.lock();
+}
+
+static void ringUnlock() {
+    ringMutex.unlock();
+}
+
+static void waitMs(uint32_t ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Produtores
+// -----------------------------------------------------------------------------
+// Copia a linha inteira para o buffer, ou nada. false se não coube.
+static bool ringPush(const char *line, size_t len) {
+    bool ok = false;
+    ringLock();
+    if (DIAG_RING_SIZE - used >= len) {
+        size_t first = DIAG_RING_SIZE - head;
+        if (first > len) {
+            first = len;
+        }
+        memcpy(ring + head, line, first);
+        memcpy(ring, line + first, len - first);
+        head = (head + len) % DIAG_RING_SIZE;
+        used += len;
+        stats.lines++;
+        ok = true;
+    }
+    ringUnlock();
+    return ok;
+}
+
+// Formata em line (com '\n' no fim). Retorna o tamanho.
+static size_t formatLine(char *line, const char *fmt, va_list args) {
+    int n = vsnprintf(line, DIAG_LINE_MAX, fmt, args);
+    if (n < 0) {
+        n = 0;
+    }
+    if (n > DIAG_LINE_MAX - 1) {
+        n = DIAG_LINE_MAX - 1;   // Truncada
+    }
+    line[n++] = '\n';
+    return (size_t)n;
+}
+
+void diagPrintf(const char *fmt, ...) {
+    char line[DIAG_LINE_MAX + 1];
+    va_list args;
+    va_start(args, fmt);
+    size_t len = formatLine(line, fmt, args);
+    va_end(args);
+
+    if (!ringPush(line, len)) {
+        ringLock();
+        stats.dropped++;
+        ringUnlock();
+    }
+}
+
+bool diagWrite(const char *text, size_t len) {
+    if (ringPush(text, len)) {
+        return true;
+    }
+    ringLock();
+    stats.dropped++;
+    ringUnlock();
+    return false;
+}
+
+void diagPrintfWait(const char *fmt, ...) {
+    char line[DIAG_LINE_MAX + 1];
+    va_list args;
+    va_start(args, fmt);
+    size_t len = formatLine(line, fmt, args);
+    va_end(args);
+
+    while (!ringPush(line, len)) {
+        waitMs(DIAG_DRAIN_MS);
+    }
+}
+
+DiagStats diagStats() {
+    ringLock();
+    DiagStats s = stats;
+    ringUnlock();
+    return s;
+}
+
+// -----------------------------------------------------------------------------
+// Consumidor
+// -----------------------------------------------------------------------------
+static void drainOnce() {
+    static uint32_t reportedDrops = 0;
+
+    while (true) {
+        ringLock();
+        size_t start = tail;
+        size_t n = used;
+        uint32_t drops = stats.dropped;
+        ringUnlock();
+
+        if (drops != reportedDrops) {
+            Serial.print("[diag] linhas descartadas (buffer cheio): ");
+            Serial.println(drops - reportedDrops);
+            reportedDrops = drops;
+        }
+        if (n == 0) {
+            return;
+        }
+
+        // Só o trecho contíguo; o restante na próxima volta
+        if (n > DIAG_RING_SIZE - start) {
+            n = DIAG_RING_SIZE - start;
+        }
+        Serial.write((const uint8_t *)ring + start, n);
+
+        ringLock();
+        tail = (tail + n) % DIAG_RING_SIZE;
+        used -= n;
+        ringUnlock();
+    }
+}
+
+static void drainTaskBody() {
+    while (true) {
+        drainOnce();
+        waitMs(DIAG_DRAIN_MS);
+    }
+}
+
+#if defined(ESP32)
+static void drainTaskEntry(void *) {
+    drainTaskBody();
+}
+#endif
+
+void diagInit() {
+#if defined(ESP32)
+    BaseType_t ok = xTaskCreatePinnedToCore(drainTaskEntry, "diag",
+                                            DIAG_TASK_STACK, nullptr,
+                                            DIAG_TASK_PRIORITY, nullptr,
+                                            DIAG_TASK_CORE);
+    if (ok != pdPASS) {
+        Serial.println("Falha ao criar a task de diagnóstico.");
+    }
+#else
+    std::thread(drainTaskBody).detach();
+#endif
+}
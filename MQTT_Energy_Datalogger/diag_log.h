@@ -0,0 +1,95 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - DIAG LOG (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Mensagens de diagnóstico no Serial sem bloquear o pipeline:
+
+- Níveis decididos na compilação (DIAG_LEVEL em config.h): as chamadas
+  acima do nível não geram código, sem formatar nem avaliar argumentos
+  (que continuam conferidos pelo compilador, e contam como usados).
+- As linhas vão para um buffer circular em RAM (DIAG_RING_SIZE); uma task
+  de baixa prioridade esvazia o buffer no Serial.
+- Buffer cheio: a linha é descartada e contada; a task avisa no Serial
+  quantas foram descartadas.
+
+Níveis:
+-------
+    DIAG_ERROR   falhas (SD, criação de task, ...)
+    DIAG_WARN    dados perdidos ou ajustados (descartes, JSON inválido)
+    DIAG_INFO    inicialização e eventos raros (rotação, reconexão)
+    DIAG_DEBUG   uma linha por mensagem recebida/gravada
+    DIAG_TRACE   payload bruto e cada campo da linha
+
+Uso:
+----
+    DIAG_INFO("Broker iniciado na porta %d", MQTT_BROKER_PORT);
+
+Formato printf, uma linha por chamada (o '\n' é acrescentado), truncada
+em DIAG_LINE_MAX bytes. DIAG_REPORT() é para saídas pedidas pelo usuário
+(DISCOVERY_MODE): não depende do nível e espera espaço no buffer em vez
+de descartar.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+
+struct DiagStats {
+    uint32_t lines;      // Linhas aceitas no buffer
+    uint32_t dropped;    // Linhas descartadas (buffer cheio)
+};
+
+// Cria a task que esvazia o buffer no Serial. Chamar logo após Serial.begin().
+void diagInit();
+
+// Acrescenta uma linha ao buffer; descarta se não houver espaço.
+void diagPrintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Idem, esperando espaço no buffer.
+void diagPrintfWait(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Texto já pronto (uma ou mais linhas terminadas em '\n'), inteiro ou
+// nada, sem esperar. false se não coube (conta como linha descartada).
+bool diagWrite(const char *text, size_t len);
+
+DiagStats diagStats();
+
+// Nível desligado: expressão constante, diagPrintf() nunca é chamada
+#define DIAG_OFF(...)    ((void)(0 && (diagPrintf(__VA_ARGS__), 0)))
+
+#if DIAG_LEVEL >= DIAG_LEVEL_ERROR
+#define DIAG_ERROR(...)  diagPrintf(__VA_ARGS__)
+#else
+#define DIAG_ERROR(...)  DIAG_OFF(__VA_ARGS__)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_WARN
+#define DIAG_WARN(...)   diagPrintf(__VA_ARGS__)
+#else
+#define DIAG_WARN(...)   DIAG_OFF(__VA_ARGS__)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_INFO
+#define DIAG_INFO(...)   diagPrintf(__VA_ARGS__)
+#else
+#define DIAG_INFO(...)   DIAG_OFF(__VA_ARGS__)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_DEBUG
+#define DIAG_DEBUG(...)  diagPrintf(__VA_ARGS__)
+#else
+#define DIAG_DEBUG(...)  DIAG_OFF(__VA_ARGS__)
+#endif
+
+#if DIAG_LEVEL >= DIAG_LEVEL_TRACE
+#define DIAG_TRACE(...)  diagPrintf(__VA_ARGS__)
+#else
+#define DIAG_TRACE(...)  DIAG_OFF(__VA_ARGS__)
+#endif
+
+#define DIAG_REPORT(...) diagPrintfWait(__VA_ARGS__)
@@ -5,20 +5,29 @@ DATALOGGER ANALISADOR DE ENERGIA MQTT - JSON FLATTEN (IMPLEMENTAÇÃO)
 
 Implementa:
 -----------
-- flattenToArrays():
+- flattenToArena():
     Percorre recursivamente o JSON (objetos, arrays e escalares),
-    preenchendo vetores de chaves e valores para posterior gravação no CSV.
+    gravando chaves (fatias de texto) e valores tipados na FlatArena.
 
-- findValueForKey():
-    Busca o valor correspondente a uma chave dentro dos vetores gerados
-    para montar cada linha conforme o cabeçalho fixo.
+- flattenToColumns():
+    Mesmo percurso, mas coloca cada valor diretamente na coluna do cabeçalho
+    usando o ColumnMap (O(1) por campo). Campos fora do cabeçalho são
+    descartados sem conversão e suas chaves nunca são copiadas; subárvores
+    que não levam a nenhuma coluna (ColumnMap::wants) só têm os campos
+    contados.
+
+- buildParseFilter():
+    Filtro do deserializeJson() com o caminho de cada coluna na mensagem
+    que criou o cabeçalho: o resto do payload nem entra no documento.
 
 Regras principais:
 ------------------
 - Objetos do tipo {"value": X} são tratados como campos escalares:
-    {"tensao_a":{"value":223.5}} -> chave "tensao_a", valor "223.5"
+    {"tensao_a":{"value":223.5}} -> chave "tensao_a", valor 223.5
 - Objetos aninhados e arrays são percorridos recursivamente, concatenando
   nomes com "_" para formar chaves únicas.
+- O caminho é montado em FlatArena::path: cada nível acrescenta "_<nome>"
+  e, ao retornar, apenas restaura o tamanho anterior.
 
 ================================================================================
 */
@@ -26,54 +35,183 @@ Regras principais:
 #include <Arduino.h>
 #include <ArduinoJson.h>
 #include <string.h>
+#include <stdio.h>
 #include "json_flatten.h"
+#include "column_map.h"
+#include "num_format.h"
 
 // -----------------------------------------------------------------------------
-// Função auxiliar: converte um JsonVariantConst escalar em String
+// Função auxiliar: valor tipado de um JsonVariantConst escalar; strings vão
+// para o texto da arena. decimals: casas de um real no texto final.
 // -----------------------------------------------------------------------------
-static String scalarToString(JsonVariantConst v) {
+static bool arenaPutValue(FlatArena &a, JsonVariantConst v, int decimals, FlatValue &out) {
+    out.decimals = (int8_t)decimals;
+
     if (v.isNull()) {
-        return "";
+        out.type = FLAT_NULL;
+    } else if (v.is<bool>()) {
+        out.type = FLAT_BOOL;
+        out.i = v.as<bool>() ? 1 : 0;
+    }
+    // Números inteiros
+    else if (v.is<long>() || v.is<int>()) {
+        out.type = FLAT_INT;
+        out.i = v.as<long>();
+    }
+    // Números com ponto flutuante
+    else if (v.is<float>() || v.is<double>()) {
+        out.type = FLAT_REAL;
+        out.d = v.as<double>();
     }
+    // Strings
+    else {
+        const char *s = v.as<const char*>();
+        if (!s) {
+            out.type = FLAT_NULL;   // Fallback
+            return true;
+        }
+        if (!flatPutText(a, s, strlen(s), out.text)) {
+            return false;
+        }
+        out.type = FLAT_TEXT;
+    }
+    return true;
+}
+
+int flatFormat(const FlatValue &v, const char *text, char *out, size_t cap) {
+    const char *s;
+    size_t n;
 
-    if (v.is<bool>()) {
-        return v.as<bool>() ? "true" : "false";
+    switch (v.type) {
+        case FLAT_INT:
+            return formatInteger(v.i, out, cap);
+        case FLAT_REAL:
+            return formatDecimal(v.d, v.decimals, out, cap);
+        case FLAT_BOOL:
+            s = v.i ? "true" : "false";
+            n = strlen(s);
+            break;
+        case FLAT_TEXT:
+            s = text + v.text.off;
+            n = v.text.len;
+            break;
+        default:
+            return 0;
     }
 
-    // Números inteiros
-    if (v.is<long>() || v.is<int>()) {
-        long x = v.as<long>();
-        return String(x);
+    if (n > cap) {
+        return -1;
     }
+    memcpy(out, s, n);
+    return (int)n;
+}
 
-    // Números com ponto flutuante
-    if (v.is<float>() || v.is<double>()) {
-        double x = v.as<double>();
-        // 6 casas é um bom compromisso (ajuste se quiser menos/more)
-        return String(x, 6);
+void flatClear(FlatValue *values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        values[i].type = FLAT_ABSENT;
     }
+}
 
-    // Strings
-    const char* s = v.as<const char*>();
-    if (s) {
-        return String(s);
+bool flatPutText(FlatArena &a, const char *s, size_t n, FlatSlice &out) {
+    if (n > FLAT_ARENA_SIZE - a.used) {
+        a.overflow = true;
+        return false;
+    }
+    // memmove: s pode ser o próprio fim da arena (texto já escrito no lugar)
+    memmove(a.text + a.used, s, n);
+    out.off = (uint16_t)a.used;
+    out.len = (uint16_t)n;
+    a.used += n;
+    if (a.used > a.peak) {
+        a.peak = a.used;
     }
+    return true;
+}
 
-    // Fallback
-    return "";
+void flatBegin(FlatArena &a) {
+    a.used = 0;
+    a.count = 0;
+    a.overflow = false;
 }
 
 // -----------------------------------------------------------------------------
-// flattenToArrays
+// flattenWalk: percurso recursivo comum; cada campo escalar encontrado é
+// entregue a emit(ctx, arena, caminho, valor) com o caminho em arena.path.
 // -----------------------------------------------------------------------------
-void flattenToArrays(JsonVariantConst v,
-                     const String &prefix,
-                     String *keys,
-                     String *values,
-                     size_t &count,
-                     size_t maxCount) {
-    // Proteções básicas
-    if (!v || count >= maxCount) {
+typedef void (*FlattenEmit)(void *ctx, FlatArena &arena, size_t pathLen,
+                            JsonVariantConst value);
+
+struct FlatWalk {
+    FlatArena  *arena;
+    FlattenEmit emit;
+    void       *ctx;
+    const ColumnMap *columns;   // Poda por ColumnMap::wants(); nullptr = sem poda
+    size_t      count;
+};
+
+// Acrescenta "_<seg>" (ou "<seg>" na raiz) ao caminho. Retorna o novo tamanho,
+// ou 0 se não couber.
+static size_t pathPush(FlatArena &a, size_t pathLen, const char *seg, size_t segLen) {
+    size_t sep = (pathLen > 0) ? 1 : 0;
+    if (pathLen + sep + segLen >= FLAT_PATH_SIZE) {
+        a.overflow = true;
+        return 0;
+    }
+    if (sep) {
+        a.path[pathLen] = '_';
+    }
+    memcpy(a.path + pathLen + sep, seg, segLen);
+    return pathLen + sep + segLen;
+}
+
+static void flattenWalk(JsonVariantConst v, size_t pathLen, FlatWalk &w);
+
+// Conta os campos de uma subárvore podada, com as mesmas regras do percurso
+static void countWalk(JsonVariantConst v, FlatWalk &w) {
+    if (!v) {
+        return;
+    }
+    if (w.count >= MAX_KEYS) {
+        w.arena->overflow = true;
+        return;
+    }
+    if (v.is<JsonObjectConst>()) {
+        JsonObjectConst obj = v.as<JsonObjectConst>();
+        if (obj.size() == 1 && strcmp((*obj.begin()).key().c_str(), "value") == 0) {
+            w.count++;
+            return;
+        }
+        for (JsonPairConst kv : obj) {
+            countWalk(kv.value(), w);
+        }
+        return;
+    }
+    if (v.is<JsonArrayConst>()) {
+        for (JsonVariantConst child : v.as<JsonArrayConst>()) {
+            countWalk(child, w);
+        }
+        return;
+    }
+    w.count++;
+}
+
+// Segue para o filho com caminho em arena.path, ou só o conta se podado
+static void flattenChild(JsonVariantConst v, size_t childLen, FlatWalk &w) {
+    if (w.columns && childLen > 0 && !w.columns->wants(w.arena->path, childLen)) {
+        countWalk(v, w);
+        return;
+    }
+    flattenWalk(v, childLen, w);
+}
+
+static void flattenWalk(JsonVariantConst v, size_t pathLen, FlatWalk &w) {
+    // Proteções básicas; campo além de MAX_KEYS é descartado e sinalizado
+    FlatArena &a = *w.arena;
+    if (!v) {
+        return;
+    }
+    if (w.count >= MAX_KEYS) {
+        a.overflow = true;
         return;
     }
 
@@ -91,11 +229,9 @@ void flattenToArrays(JsonVariantConst v,
 
             if (strcmp(k, "value") == 0) {
                 // Só faz sentido se houver prefixo (nome do campo)
-                if (prefix.length() > 0 && count < maxCount) {
-                    String valStr = scalarToString(inner);
-                    keys[count]   = prefix;
-                    values[count] = valStr;
-                    count++;
+                if (pathLen > 0) {
+                    w.emit(w.ctx, a, pathLen, inner);
+                    w.count++;
                 }
                 return;
             }
@@ -104,20 +240,13 @@ void flattenToArrays(JsonVariantConst v,
         // Caso geral: objeto com N pares chave/valor
         for (JsonPairConst kv : obj) {
             const char* k = kv.key().c_str();
-            JsonVariantConst child = kv.value();
-
-            String newPrefix;
-            if (prefix.length() > 0) {
-                newPrefix.reserve(prefix.length() + 1 + strlen(k));
-                newPrefix  = prefix;
-                newPrefix += "_";
-                newPrefix += k;
-            } else {
-                newPrefix = k;   // nível raiz
-            }
+            size_t len = strlen(k);
+            size_t childLen = pathPush(a, pathLen, k, len);
 
-            flattenToArrays(child, newPrefix, keys, values, count, maxCount);
-            if (count >= maxCount) {
+            if (childLen > 0 || (pathLen == 0 && len == 0)) {
+                flattenChild(kv.value(), childLen, w);
+            }
+            if (a.overflow && w.count >= MAX_KEYS) {
                 break;
             }
         }
@@ -129,16 +258,16 @@ void flattenToArrays(JsonVariantConst v,
     // -------------------------------------------------------------------------
     if (v.is<JsonArrayConst>()) {
         JsonArrayConst arr = v.as<JsonArrayConst>();
-        size_t idx = 0;
+        unsigned idx = 0;
         for (JsonVariantConst child : arr) {
-            String newPrefix = prefix;
-            if (newPrefix.length() > 0) {
-                newPrefix += "_";
-            }
-            newPrefix += idx;  // sufixo com índice do array
+            char num[12];
+            int len = snprintf(num, sizeof(num), "%u", idx);  // sufixo com índice
+            size_t childLen = pathPush(a, pathLen, num, len);
 
-            flattenToArrays(child, newPrefix, keys, values, count, maxCount);
-            if (count >= maxCount) {
+            if (childLen > 0) {
+                flattenChild(child, childLen, w);
+            }
+            if (a.overflow && w.count >= MAX_KEYS) {
                 break;
             }
             idx++;
@@ -149,28 +278,125 @@ void flattenToArrays(JsonVariantConst v,
     // -------------------------------------------------------------------------
     // Caso 3: Escalar (string, número, bool, etc.)
     // -------------------------------------------------------------------------
-    if (prefix.length() == 0 || count >= maxCount) {
+    if (pathLen == 0) {
         // Sem prefixo não temos nome de coluna; ignoramos
         return;
     }
 
-    String valStr = scalarToString(v);
-    keys[count]   = prefix;
-    values[count] = valStr;
-    count++;
+    w.emit(w.ctx, a, pathLen, v);
+    w.count++;
+}
+
+static size_t flattenRun(JsonVariantConst v, FlatArena &arena,
+                         const ColumnMap *columns, FlattenEmit emit, void *ctx) {
+    flatBegin(arena);
+
+    FlatWalk w = { &arena, emit, ctx, columns, 0 };
+    flattenWalk(v, 0, w);
+    return w.count;
+}
+
+// -----------------------------------------------------------------------------
+// flattenToArena
+// -----------------------------------------------------------------------------
+static void emitToArena(void *, FlatArena &a, size_t pathLen, JsonVariantConst value) {
+    size_t i = a.count;
+    size_t mark = a.used;
+
+    if (!flatPutText(a, a.path, pathLen, a.keys[i]) ||
+        !arenaPutValue(a, value, FLOAT_DECIMALS, a.values[i])) {
+        a.used = mark;
+        return;
+    }
+    a.count++;
+}
+
+size_t flattenToArena(JsonVariantConst v, FlatArena &arena) {
+    flattenRun(v, arena, nullptr, emitToArena, nullptr);
+    return arena.count;
+}
+
+// -----------------------------------------------------------------------------
+// flattenToColumns
+// -----------------------------------------------------------------------------
+struct ColumnsCtx {
+    const ColumnMap *columns;
+    FlatValue *slots;
+};
+
+static void emitToColumns(void *ctx, FlatArena &a, size_t pathLen, JsonVariantConst value) {
+    ColumnsCtx *c = static_cast<ColumnsCtx *>(ctx);
+    int col = c->columns->find(a.path, pathLen);
+
+    // Campo fora do cabeçalho, ou chave repetida (vale a 1ª ocorrência)
+    if (col < 0 || c->slots[col].type != FLAT_ABSENT) {
+        return;
+    }
+    arenaPutValue(a, value, c->columns->decimals(col), c->slots[col]);
+}
+
+size_t flattenToColumns(JsonVariantConst v,
+                        const ColumnMap &columns,
+                        FlatArena &arena,
+                        FlatValue *slots) {
+    flatClear(slots, columns.count());
+
+    ColumnsCtx ctx = { &columns, slots };
+    return flattenRun(v, arena, &columns, emitToColumns, &ctx);
 }
 
 // -----------------------------------------------------------------------------
-// findValueForKey
+// buildParseFilter
 // -----------------------------------------------------------------------------
-String findValueForKey(const String &key,
-                       String *keys,
-                       String *values,
-                       size_t count) {
-    for (size_t i = 0; i < count; i++) {
-        if (keys[i] == key) {
-            return values[i];
+// Marca em dst os membros de v que levam a colunas. Um objeto com "value"
+// entre outros membros fica inteiro: sem algum deles, a regra {"value": X}
+// daria outra chave. Arrays: o ArduinoJson aplica o filtro do elemento 0 a
+// todos, então os elementos são reunidos nele.
+static void filterWalk(JsonVariantConst v, size_t pathLen, const ColumnMap &columns,
+                       FlatArena &a, JsonVariant dst) {
+    if (dst.is<bool>()) {
+        return;     // Já mantido inteiro
+    }
+
+    if (v.is<JsonObjectConst>()) {
+        JsonObjectConst obj = v.as<JsonObjectConst>();
+        for (JsonPairConst kv : obj) {
+            if (strcmp(kv.key().c_str(), "value") == 0) {
+                dst.set(true);
+                return;
+            }
+        }
+        for (JsonPairConst kv : obj) {
+            const char *k = kv.key().c_str();
+            size_t childLen = pathPush(a, pathLen, k, strlen(k));
+            if (childLen > 0 && columns.wants(a.path, childLen)) {
+                // char*: o ArduinoJson copia a chave (o documento v é temporário)
+                filterWalk(kv.value(), childLen, columns, a,
+                           dst.getOrAddMember(const_cast<char *>(k)));
+            }
+        }
+        return;
+    }
+
+    if (v.is<JsonArrayConst>()) {
+        unsigned idx = 0;
+        for (JsonVariantConst child : v.as<JsonArrayConst>()) {
+            char num[12];
+            int len = snprintf(num, sizeof(num), "%u", idx++);
+            size_t childLen = pathPush(a, pathLen, num, len);
+            if (childLen > 0 && columns.wants(a.path, childLen)) {
+                filterWalk(child, childLen, columns, a, dst.getOrAddElement(0));
+            }
         }
+        return;
     }
-    return "";
+
+    dst.set(true);
+}
+
+bool buildParseFilter(JsonVariantConst v, const ColumnMap &columns,
+                      FlatArena &arena, JsonDocument &filter) {
+    filter.clear();
+    filterWalk(v, 0, columns, arena, filter.to<JsonVariant>());
+    return !filter.overflowed();
 }
@@ -14,9 +14,28 @@ Regras principais:
     {"tensao_a":{"value":223.5}} -> chave "tensao_a", valor "223.5"
 - Objetos aninhados e arrays são percorridos recursivamente, concatenando nomes
   com "_" para formar chaves únicas.
-- Produz vetores paralelos:
-    - keys[i] = nome da coluna
-    - values[i] = valor convertido para string
+- Cada valor sai tipado (FlatValue): inteiro, real, bool, null ou texto.
+  Reais levam as casas decimais da coluna (COLUMN_DECIMALS) em
+  flattenToColumns(), FLOAT_DECIMALS nos demais; o texto só é gerado por
+  quem grava texto (flatFormat(), no sink CSV).
+
+Saída sem alocação (FlatArena):
+-------------------------------
+- Chaves e strings são escritas em um único buffer fixo (FlatArena::text)
+  e referenciadas por fatias offset/tamanho (FlatSlice); números e bools
+  ficam no próprio FlatValue.
+- O prefixo (caminho) é montado em um único buffer reutilizável
+  (FlatArena::path), sem criar String por nível de recursão.
+- A arena é reaproveitada a cada mensagem: em regime não há uso de heap.
+- Campos que não cabem (texto, caminho ou MAX_KEYS) são descartados e
+  sinalizados em FlatArena::overflow.
+
+Plano de extração:
+------------------
+- flattenToColumns() não desce nas subárvores que não levam a nenhuma
+  coluna (ColumnMap::wants); os campos delas só são contados.
+- buildParseFilter() monta, a partir da mensagem que criou o cabeçalho, o
+  filtro do deserializeJson(): o resto do payload nem entra no documento.
 
 Uso:
 ----
@@ -30,16 +49,89 @@ Chamado pelo módulo logger para extrair colunas a partir do payload JSON.
 #include <Arduino.h>
 #include <ArduinoJson.h>
 
-// Achata o JSON em vetores (keys/values).
+#include "config.h"
+
+class ColumnMap;
+
+#define FLAT_NONE  0xFFFF   // FlatSlice::off de uma fatia vazia/ausente
+
+struct FlatSlice {
+    uint16_t off;
+    uint16_t len;
+};
+
+enum FlatType : uint8_t {
+    FLAT_ABSENT,    // Campo não veio na mensagem (célula vazia)
+    FLAT_NULL,      // null no JSON (célula vazia, mas presente)
+    FLAT_BOOL,
+    FLAT_INT,
+    FLAT_REAL,
+    FLAT_TEXT       // Fatia do buffer de texto que acompanha o valor
+};
+
+struct FlatValue {
+    uint8_t type;           // FlatType
+    int8_t  decimals;       // FLAT_REAL: casas no texto (num_format)
+    FlatSlice text;         // FLAT_TEXT
+    union {
+        int64_t i;          // FLAT_INT; FLAT_BOOL (0/1)
+        double  d;          // FLAT_REAL
+    };
+};
+
+inline bool flatIsNumber(const FlatValue &v) {
+    return v.type == FLAT_INT || v.type == FLAT_REAL;
+}
+
+inline double flatNumber(const FlatValue &v) {
+    return (v.type == FLAT_INT) ? (double)v.i : v.d;
+}
+
+// Texto do valor (o mesmo que ia para o CSV); text é o buffer das fatias
+// FLAT_TEXT. Retorna o tamanho, ou -1 se não couber em cap bytes.
+int flatFormat(const FlatValue &v, const char *text, char *out, size_t cap);
+
+struct FlatArena {
+    char      text[FLAT_ARENA_SIZE];   // Texto de chaves/valores (sem '\0')
+    size_t    used;                    // Bytes ocupados na mensagem atual
+    size_t    peak;                    // Maior ocupação já vista (high-water)
+    FlatSlice keys[MAX_KEYS];          // Só preenchido por flattenToArena()
+    FlatValue values[MAX_KEYS];
+    size_t    count;
+    char      path[FLAT_PATH_SIZE];    // Prefixo corrente do percurso
+    bool      overflow;
+};
+
+inline const char *flatText(const FlatArena &arena, FlatSlice s) {
+    return arena.text + s.off;
+}
+
+// Uso interno (json_flatten / json_stream):
+// - flatBegin(): zera a arena para uma nova mensagem.
+// - flatPutText(): copia n bytes para o fim do texto e devolve a fatia.
+// - flatClear(): marca n valores como FLAT_ABSENT.
+void flatBegin(FlatArena &arena);
+bool flatPutText(FlatArena &arena, const char *s, size_t n, FlatSlice &out);
+void flatClear(FlatValue *values, size_t n);
+
+// Achata o JSON em pares (keys[i], values[i]) dentro da arena.
 // Regra especial: {"value": X} -> chave = prefixo, valor = X.
-void flattenToArrays(JsonVariantConst v,
-                     const String &prefix,
-                     String *keys,
-                     String *values,
-                     size_t &count,
-                     size_t maxCount);
-
-String findValueForKey(const String &key,
-                       String *keys,
-                       String *values,
-                       size_t count);
+// Retorna o número de campos.
+size_t flattenToArena(JsonVariantConst v, FlatArena &arena);
+
+// Achata o JSON colocando cada valor direto na coluna do cabeçalho:
+// slots[col] = valor (strings na arena). Colunas sem valor ficam
+// FLAT_ABSENT; campos fora do cabeçalho não são convertidos.
+// Retorna o total de campos encontrados no JSON.
+size_t flattenToColumns(JsonVariantConst v,
+                        const ColumnMap &columns,
+                        FlatArena &arena,
+                        FlatValue *slots);
+
+// Monta em filter o filtro do deserializeJson() (DeserializationOption::
+// Filter) que mantém só os caminhos de v que levam a colunas de columns.
+// v é a mensagem que criou o cabeçalho: uma coluna que em outra mensagem
+// vier por outro caminho (ex. "a_b" em vez de {"a":{"b":...}}) é filtrada.
+// Retorna false se o filtro não coube em filter.
+bool buildParseFilter(JsonVariantConst v, const ColumnMap &columns,
+                      FlatArena &arena, JsonDocument &filter);
@@ -0,0 +1,91 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - JSON POOL (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa o alocador de json_pool.h: JSON_POOL_DOCS blocos de
+JSON_BUFFER_SIZE bytes e uma máscara de bits dos blocos entregues. Os
+documentos são usados só pela task de logging, então não há lock.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include "json_pool.h"
+
+#if JSON_PARSER_MODE == JSON_PARSER_DOM
+
+#if JSON_POOL_DOCS < 1 || JSON_POOL_DOCS > 32
+#error "JSON_POOL_DOCS deve estar entre 1 e 32"
+#endif
+
+#if JSON_POOL_PSRAM && defined(BOARD_HAS_PSRAM)
+#include <esp_heap_caps.h>
+static uint8_t *poolArea = nullptr;     // Reservada no primeiro uso
+#else
+// Alinhada como o heap (o ArduinoJson guarda ponteiros e doubles no bloco)
+alignas(8) static uint8_t poolStorage[JSON_POOL_DOCS * JSON_BUFFER_SIZE];
+static uint8_t *const poolArea = poolStorage;
+#endif
+
+static uint32_t usedMask = 0;
+static uint32_t failures = 0;
+static uint32_t peak = 0;
+
+static uint8_t *area() {
+#if JSON_POOL_PSRAM && defined(BOARD_HAS_PSRAM)
+    if (!poolArea) {
+        poolArea = (uint8_t *)heap_caps_malloc(JSON_POOL_DOCS * JSON_BUFFER_SIZE,
+                                               MALLOC_CAP_SPIRAM | MALLOC_CAP_8BIT);
+    }
+#endif
+    return poolArea;
+}
+
+void *JsonPoolAllocator::allocate(size_t size) {
+    uint8_t *base = area();
+    if (base && size <= JSON_BUFFER_SIZE) {
+        for (int i = 0; i < JSON_POOL_DOCS; i++) {
+            if (!(usedMask & (1UL << i))) {
+                usedMask |= 1UL << i;
+                return base + (size_t)i * JSON_BUFFER_SIZE;
+            }
+        }
+    }
+    failures++;
+    return nullptr;
+}
+
+void JsonPoolAllocator::deallocate(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    size_t i = ((uint8_t *)ptr - area()) / JSON_BUFFER_SIZE;
+    usedMask &= ~(1UL << i);
+}
+
+// shrinkToFit(): o bloco continua o mesmo
+void *JsonPoolAllocator::reallocate(void *ptr, size_t newSize) {
+    if (newSize <= JSON_BUFFER_SIZE) {
+        return ptr;
+    }
+    failures++;
+    return nullptr;
+}
+
+void jsonPoolNoteUsage(size_t bytes) {
+    if (bytes > peak) {
+        peak = (uint32_t)bytes;
+    }
+}
+
+JsonPoolStats jsonPoolStats() {
+    JsonPoolStats s;
+    s.blocks = JSON_POOL_DOCS;
+    s.inUse = (uint32_t)__builtin_popcount(usedMask);
+    s.failures = failures;
+    s.peak = peak;
+    return s;
+}
+
+#endif
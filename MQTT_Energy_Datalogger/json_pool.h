@@ -0,0 +1,59 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - JSON POOL (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Memória do documento do ArduinoJson no modo DOM (JSON_PARSER_DOM) fora do
+heap. Um DynamicJsonDocument(JSON_BUFFER_SIZE) criado e destruído a cada
+mensagem aloca e libera 12 KB do heap o tempo todo; com as alocações do
+WiFi/broker entre uma mensagem e outra, o heap se fragmenta e, depois de
+semanas, o bloco não cabe mais (deserializeJson -> NoMemory).
+
+- JsonPoolAllocator: alocador do BasicJsonDocument que entrega blocos de
+  JSON_BUFFER_SIZE bytes de uma área reservada uma única vez, com
+  JSON_POOL_DOCS blocos: estática, ou na PSRAM com JSON_POOL_PSRAM (a
+  área é pedida no primeiro uso e nunca devolvida).
+- PooledJsonDocument: documento sobre esse alocador. O logger mantém um
+  só, criado na primeira mensagem e reaproveitado (deserializeJson limpa
+  o documento antes de cada parse).
+
+Sem bloco livre (ou pedido maior que JSON_BUFFER_SIZE), allocate() devolve
+nullptr e o documento fica com capacidade 0: o parse falha com NoMemory,
+como no heap cheio. As falhas são contadas em jsonPoolStats().
+
+Só compilado com JSON_PARSER_MODE == JSON_PARSER_DOM.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+
+#if JSON_PARSER_MODE == JSON_PARSER_DOM
+#include <ArduinoJson.h>
+
+struct JsonPoolAllocator {
+    void *allocate(size_t size);
+    void deallocate(void *ptr);
+    void *reallocate(void *ptr, size_t newSize);
+};
+
+typedef BasicJsonDocument<JsonPoolAllocator> PooledJsonDocument;
+
+struct JsonPoolStats {
+    uint32_t blocks;       // JSON_POOL_DOCS
+    uint32_t inUse;        // Blocos entregues
+    uint32_t failures;     // Pedidos sem bloco (ou maiores que o bloco)
+    uint32_t peak;         // Maior memoryUsage() registrado (jsonPoolNoteUsage)
+};
+
+// Registra a ocupação de um documento após o parse (high-water, para
+// dimensionar JSON_BUFFER_SIZE).
+void jsonPoolNoteUsage(size_t bytes);
+
+JsonPoolStats jsonPoolStats();
+
+#endif
@@ -0,0 +1,672 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - JSON STREAM (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa:
+-----------
+- Um parser descendente recursivo sobre o texto do payload. Cada escalar é
+  guardado apenas como um Token (ponteiro + tamanho no próprio payload) e
+  convertido no valor tipado (FlatValue) no momento da emissão; só strings
+  vão para a arena.
+- O caminho é montado em FlatArena::path, como no json_flatten.
+
+Regra {"value": X} em uma passada:
+----------------------------------
+O DOM sabe de antemão se o objeto tem um único membro; aqui isso só é
+conhecido depois de ler o valor de "value":
+- se o próximo token fecha o objeto, X é emitido com a chave do prefixo;
+- se vier outro membro, "value" vira um campo comum (<prefixo>_value).
+Quando X é objeto/array ele é só validado na primeira leitura; se o objeto
+continuar, o parser volta ao início de X (o payload está em memória) e o
+percorre com o caminho <prefixo>_value.
+
+Poda (streamFlattenToColumns):
+------------------------------
+Subárvores cujo caminho não leva a nenhuma coluna (ColumnMap::wants) são
+só validadas: o caminho não é montado e nenhum valor é convertido. Os
+campos delas continuam contados no retorno, como sem a poda.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <errno.h>
+#include "json_stream.h"
+#include "column_map.h"
+#include "num_format.h"
+
+struct Token {
+    enum Type { NUL, TRUE_, FALSE_, INTEGER, FLOAT, STRING } type;
+    const char *start;   // STRING: conteúdo entre aspas (escapes ainda crus)
+    size_t len;
+};
+
+typedef void (*StreamEmit)(void *ctx, FlatArena &arena, size_t pathLen,
+                           const Token &value);
+
+// Situação do caminho de um valor
+enum PathMode {
+    PATH_NONE,      // Sem nome de coluna: só valida
+    PATH_SKIP,      // Fora do cabeçalho (poda): valida e conta os campos
+    PATH_LIVE       // Caminho em arena.path: campos emitidos
+};
+
+struct Parser {
+    const char *p;
+    const char *end;
+    FlatArena  *arena;
+    StreamEmit  emit;
+    void       *ctx;
+    const ColumnMap *columns;   // Poda por ColumnMap::wants(); nullptr = sem poda
+    size_t      count;
+    int         depth;
+    int         error;
+};
+
+static bool parseValue(Parser &ps, size_t pathLen, PathMode mode);
+
+// -----------------------------------------------------------------------------
+// Léxico
+// -----------------------------------------------------------------------------
+static bool fail(Parser &ps, int code) {
+    if (ps.error == 0) {
+        ps.error = code;
+    }
+    return false;
+}
+
+static void skipWs(Parser &ps) {
+    while (ps.p < ps.end &&
+           (*ps.p == ' ' || *ps.p == '\t' || *ps.p == '\n' || *ps.p == '\r')) {
+        ps.p++;
+    }
+}
+
+static int hexDigit(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+// Lê uma string JSON (ps.p em '"'); t aponta para o conteúdo sem as aspas
+static bool scanString(Parser &ps, Token &t) {
+    ps.p++;
+    t.type = Token::STRING;
+    t.start = ps.p;
+
+    while (ps.p < ps.end) {
+        char c = *ps.p;
+        if (c == '"') {
+            t.len = ps.p - t.start;
+            ps.p++;
+            return true;
+        }
+        if (c == '\\') {
+            if (ps.p + 1 >= ps.end) {
+                return fail(ps, JSON_STREAM_INCOMPLETE);
+            }
+            char e = ps.p[1];
+            if (e == 'u') {
+                if (ps.p + 6 > ps.end) {
+                    return fail(ps, JSON_STREAM_INCOMPLETE);
+                }
+                for (int i = 2; i < 6; i++) {
+                    if (hexDigit(ps.p[i]) < 0) {
+                        return fail(ps, JSON_STREAM_INVALID);
+                    }
+                }
+                ps.p += 6;
+                continue;
+            }
+            if (!strchr("\"\\/bfnrt", e)) {
+                return fail(ps, JSON_STREAM_INVALID);
+            }
+            ps.p += 2;
+            continue;
+        }
+        ps.p++;
+    }
+    return fail(ps, JSON_STREAM_INCOMPLETE);
+}
+
+static bool scanLiteral(Parser &ps, const char *word, Token::Type type, Token &t) {
+    size_t n = strlen(word);
+    size_t avail = ps.end - ps.p;
+    if (avail < n) {
+        return fail(ps, memcmp(ps.p, word, avail) == 0 ? JSON_STREAM_INCOMPLETE
+                                                      : JSON_STREAM_INVALID);
+    }
+    if (memcmp(ps.p, word, n) != 0) {
+        return fail(ps, JSON_STREAM_INVALID);
+    }
+    t.type = type;
+    t.start = ps.p;
+    t.len = n;
+    ps.p += n;
+    return true;
+}
+
+static bool scanDigits(Parser &ps) {
+    const char *s = ps.p;
+    while (ps.p < ps.end && *ps.p >= '0' && *ps.p <= '9') {
+        ps.p++;
+    }
+    return ps.p > s;
+}
+
+static bool scanNumber(Parser &ps, Token &t) {
+    t.type = Token::INTEGER;
+    t.start = ps.p;
+
+    if (*ps.p == '-') {
+        ps.p++;
+    }
+    if (!scanDigits(ps)) {
+        return fail(ps, ps.p >= ps.end ? JSON_STREAM_INCOMPLETE : JSON_STREAM_INVALID);
+    }
+    if (ps.p < ps.end && *ps.p == '.') {
+        ps.p++;
+        t.type = Token::FLOAT;
+        if (!scanDigits(ps)) {
+            return fail(ps, ps.p >= ps.end ? JSON_STREAM_INCOMPLETE : JSON_STREAM_INVALID);
+        }
+    }
+    if (ps.p < ps.end && (*ps.p == 'e' || *ps.p == 'E')) {
+        ps.p++;
+        t.type = Token::FLOAT;
+        if (ps.p < ps.end && (*ps.p == '+' || *ps.p == '-')) {
+            ps.p++;
+        }
+        if (!scanDigits(ps)) {
+            return fail(ps, ps.p >= ps.end ? JSON_STREAM_INCOMPLETE : JSON_STREAM_INVALID);
+        }
+    }
+    t.len = ps.p - t.start;
+    return true;
+}
+
+static bool scanScalar(Parser &ps, Token &t) {
+    char c = *ps.p;
+    if (c == '"') return scanString(ps, t);
+    if (c == 't') return scanLiteral(ps, "true", Token::TRUE_, t);
+    if (c == 'f') return scanLiteral(ps, "false", Token::FALSE_, t);
+    if (c == 'n') return scanLiteral(ps, "null", Token::NUL, t);
+    if (c == '-' || (c >= '0' && c <= '9')) return scanNumber(ps, t);
+    return fail(ps, JSON_STREAM_INVALID);
+}
+
+// -----------------------------------------------------------------------------
+// Conversão de tokens em valores
+// -----------------------------------------------------------------------------
+static size_t putUtf8(uint32_t cp, char *out) {
+    if (cp < 0x80) {
+        out[0] = (char)cp;
+        return 1;
+    }
+    if (cp < 0x800) {
+        out[0] = (char)(0xC0 | (cp >> 6));
+        out[1] = (char)(0x80 | (cp & 0x3F));
+        return 2;
+    }
+    if (cp < 0x10000) {
+        out[0] = (char)(0xE0 | (cp >> 12));
+        out[1] = (char)(0x80 | ((cp >> 6) & 0x3F));
+        out[2] = (char)(0x80 | (cp & 0x3F));
+        return 3;
+    }
+    out[0] = (char)(0xF0 | (cp >> 18));
+    out[1] = (char)(0x80 | ((cp >> 12) & 0x3F));
+    out[2] = (char)(0x80 | ((cp >> 6) & 0x3F));
+    out[3] = (char)(0x80 | (cp & 0x3F));
+    return 4;
+}
+
+static uint32_t readHex4(const char *s) {
+    return (hexDigit(s[0]) << 12) | (hexDigit(s[1]) << 8) |
+           (hexDigit(s[2]) << 4) | hexDigit(s[3]);
+}
+
+// Decodifica o conteúdo de uma string (já validado por scanString).
+// Retorna o tamanho, ou -1 se não couber em cap bytes.
+static int unescape(const char *s, size_t n, char *out, size_t cap) {
+    const char *end = s + n;
+    size_t o = 0;
+
+    while (s < end) {
+        char tmp[4];
+        const char *src = s;
+        size_t len = 1;
+
+        if (*s != '\\') {
+            // Trecho sem escapes: copia de uma vez até a próxima '\\'
+            const char *bs = (const char *)memchr(s, '\\', end - s);
+            len = (bs ? bs : end) - s;
+            s += len;
+        } else if (s[1] != 'u') {
+            switch (s[1]) {
+                case 'b': tmp[0] = '\b'; break;
+                case 'f': tmp[0] = '\f'; break;
+                case 'n': tmp[0] = '\n'; break;
+                case 'r': tmp[0] = '\r'; break;
+                case 't': tmp[0] = '\t'; break;
+                default:  tmp[0] = s[1]; break;   // \" \\ \/
+            }
+            src = tmp;
+            s += 2;
+        } else {
+            uint32_t cp = readHex4(s + 2);
+            s += 6;
+            // Par substituto UTF-16 (caracteres fora do BMP)
+            if (cp >= 0xD800 && cp < 0xDC00 && s + 6 <= end && s[0] == '\\' && s[1] == 'u') {
+                uint32_t lo = readHex4(s + 2);
+                if (lo >= 0xDC00 && lo < 0xE000) {
+                    cp = 0x10000 + ((cp - 0xD800) << 10) + (lo - 0xDC00);
+                    s += 6;
+                }
+            }
+            len = putUtf8(cp, tmp);
+            src = tmp;
+        }
+
+        if (o + len > cap) {
+            return -1;
+        }
+        memcpy(out + o, src, len);
+        o += len;
+    }
+    return (int)o;
+}
+
+// Valor tipado do token, como em flattenToArena(); strings são
+// decodificadas direto no fim da arena.
+static bool putToken(FlatArena &a, const Token &t, int decimals, FlatValue &out) {
+    out.decimals = (int8_t)decimals;
+
+    switch (t.type) {
+        case Token::NUL:
+            out.type = FLAT_NULL;
+            return true;
+        case Token::TRUE_:
+        case Token::FALSE_:
+            out.type = FLAT_BOOL;
+            out.i = (t.type == Token::TRUE_) ? 1 : 0;
+            return true;
+        case Token::STRING: {
+            int n = unescape(t.start, t.len, a.text + a.used, FLAT_ARENA_SIZE - a.used);
+            if (n < 0) {
+                a.overflow = true;
+                return false;
+            }
+            if (!flatPutText(a, a.text + a.used, n, out.text)) {
+                return false;
+            }
+            out.type = FLAT_TEXT;
+            return true;
+        }
+        default:
+            break;
+    }
+
+    // Números: cópia terminada em '\0' (o payload pode não ter terminador)
+    char num[48];
+    size_t n = (t.len < sizeof(num) - 1) ? t.len : sizeof(num) - 1;
+    memcpy(num, t.start, n);
+    num[n] = '\0';
+
+    if (t.type == Token::INTEGER) {
+        char *endp;
+        errno = 0;
+        long long v = strtoll(num, &endp, 10);
+        if (errno == 0 && v >= LONG_MIN && v <= LONG_MAX) {
+            out.type = FLAT_INT;
+            out.i = v;
+            return true;
+        }
+        // Não cabe em long: tratado como ponto flutuante (igual ao ArduinoJson)
+    }
+    out.type = FLAT_REAL;
+    out.d = strtod(num, nullptr);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Caminho
+// -----------------------------------------------------------------------------
+// Acrescenta "_<seg>" (ou "<seg>" na raiz). seg é o conteúdo cru de uma chave
+// (decodificado aqui) ou um índice de array. false se não couber.
+static bool pathPush(FlatArena &a, size_t pathLen, const char *seg, size_t segLen,
+                     bool escaped, size_t &childLen) {
+    size_t sep = (pathLen > 0) ? 1 : 0;
+    if (pathLen + sep >= FLAT_PATH_SIZE) {
+        a.overflow = true;
+        return false;
+    }
+
+    size_t cap = FLAT_PATH_SIZE - 1 - pathLen - sep;
+    int n;
+    if (escaped) {
+        n = unescape(seg, segLen, a.path + pathLen + sep, cap);
+    } else {
+        n = (segLen <= cap) ? (int)segLen : -1;
+        if (n >= 0) {
+            memcpy(a.path + pathLen + sep, seg, segLen);
+        }
+    }
+    if (n < 0) {
+        a.overflow = true;
+        return false;
+    }
+
+    if (sep) {
+        a.path[pathLen] = '_';
+    }
+    childLen = pathLen + sep + n;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Parser
+// -----------------------------------------------------------------------------
+// Valor com nome de coluna (o da raiz, sem prefixo, não tem)
+static bool named(PathMode mode, size_t pathLen) {
+    return mode == PATH_SKIP || (mode == PATH_LIVE && pathLen > 0);
+}
+
+static void emitField(Parser &ps, PathMode mode, size_t pathLen, const Token &t) {
+    if (ps.count >= MAX_KEYS) {
+        ps.arena->overflow = true;
+        return;
+    }
+    if (mode == PATH_LIVE) {
+        ps.emit(ps.ctx, *ps.arena, pathLen, t);
+    }
+    ps.count++;
+}
+
+// Situação do filho "<caminho>_<seg>"; em PATH_LIVE monta o caminho em
+// arena.path e poda se ele não leva a nenhuma coluna.
+static PathMode childMode(Parser &ps, PathMode mode, size_t pathLen, const char *seg,
+                          size_t segLen, bool escaped, size_t &childLen) {
+    childLen = 0;
+    if (mode != PATH_LIVE) {
+        return mode;
+    }
+    if (!pathPush(*ps.arena, pathLen, seg, segLen, escaped, childLen)) {
+        return PATH_NONE;
+    }
+    if (ps.columns && childLen > 0 && !ps.columns->wants(ps.arena->path, childLen)) {
+        return PATH_SKIP;
+    }
+    return PATH_LIVE;
+}
+
+// Primeiro membro "value" de um objeto: aplica a regra {"value": X}.
+// Ao retornar, ps.p está antes do ',' ou '}' seguinte.
+static bool parseValueMember(Parser &ps, size_t pathLen, PathMode mode) {
+    skipWs(ps);
+    if (ps.p >= ps.end) {
+        return fail(ps, JSON_STREAM_INCOMPLETE);
+    }
+
+    const char *valueStart = ps.p;
+    bool container = (*ps.p == '{' || *ps.p == '[');
+    Token t = { Token::NUL, nullptr, 0 };
+
+    if (container) {
+        if (!parseValue(ps, 0, PATH_NONE)) {    // Só valida
+            return false;
+        }
+    } else if (!scanScalar(ps, t)) {
+        return false;
+    }
+
+    skipWs(ps);
+    if (ps.p >= ps.end) {
+        return fail(ps, JSON_STREAM_INCOMPLETE);
+    }
+
+    if (*ps.p == '}') {
+        // {"value": X} sozinho -> chave = prefixo (objeto/array vira vazio)
+        if (named(mode, pathLen)) {
+            emitField(ps, mode, pathLen, t);
+        }
+        return true;
+    }
+
+    // Objeto com mais membros: "value" é um campo comum
+    size_t childLen;
+    PathMode child = childMode(ps, mode, pathLen, "value", 5, false, childLen);
+    if (!container) {
+        if (named(child, childLen) && t.type != Token::NUL) {
+            emitField(ps, child, childLen, t);
+        }
+        return true;
+    }
+    if (child == PATH_NONE) {
+        return true;    // Já validado, nada a emitir ou contar
+    }
+
+    const char *resume = ps.p;
+    ps.p = valueStart;
+    bool ok = parseValue(ps, childLen, child);
+    ps.p = resume;
+    return ok;
+}
+
+static bool parseObject(Parser &ps, size_t pathLen, PathMode mode) {
+    if (++ps.depth > JSON_STREAM_MAX_DEPTH) {
+        return fail(ps, JSON_STREAM_TOO_DEEP);
+    }
+    ps.p++;   // '{'
+
+    skipWs(ps);
+    if (ps.p < ps.end && *ps.p == '}') {
+        ps.p++;
+        ps.depth--;
+        return true;
+    }
+
+    bool first = true;
+    while (true) {
+        skipWs(ps);
+        if (ps.p >= ps.end) {
+            return fail(ps, JSON_STREAM_INCOMPLETE);
+        }
+        if (*ps.p != '"') {
+            return fail(ps, JSON_STREAM_INVALID);
+        }
+
+        Token key;
+        if (!scanString(ps, key)) {
+            return false;
+        }
+        skipWs(ps);
+        if (ps.p >= ps.end) {
+            return fail(ps, JSON_STREAM_INCOMPLETE);
+        }
+        if (*ps.p != ':') {
+            return fail(ps, JSON_STREAM_INVALID);
+        }
+        ps.p++;
+
+        if (first && key.len == 5 && memcmp(key.start, "value", 5) == 0) {
+            if (!parseValueMember(ps, pathLen, mode)) {
+                return false;
+            }
+        } else {
+            size_t childLen;
+            PathMode child = childMode(ps, mode, pathLen, key.start, key.len, true, childLen);
+            if (!parseValue(ps, childLen, child)) {
+                return false;
+            }
+        }
+        first = false;
+
+        skipWs(ps);
+        if (ps.p >= ps.end) {
+            return fail(ps, JSON_STREAM_INCOMPLETE);
+        }
+        if (*ps.p == ',') {
+            ps.p++;
+            continue;
+        }
+        if (*ps.p == '}') {
+            ps.p++;
+            ps.depth--;
+            return true;
+        }
+        return fail(ps, JSON_STREAM_INVALID);
+    }
+}
+
+static bool parseArray(Parser &ps, size_t pathLen, PathMode mode) {
+    if (++ps.depth > JSON_STREAM_MAX_DEPTH) {
+        return fail(ps, JSON_STREAM_TOO_DEEP);
+    }
+    ps.p++;   // '['
+
+    skipWs(ps);
+    if (ps.p < ps.end && *ps.p == ']') {
+        ps.p++;
+        ps.depth--;
+        return true;
+    }
+
+    unsigned idx = 0;
+    while (true) {
+        size_t childLen = 0;
+        PathMode child = mode;
+        if (mode == PATH_LIVE) {
+            char num[12];
+            int len = snprintf(num, sizeof(num), "%u", idx);  // sufixo com índice
+            child = childMode(ps, mode, pathLen, num, len, false, childLen);
+        }
+
+        if (!parseValue(ps, childLen, child)) {
+            return false;
+        }
+        idx++;
+
+        skipWs(ps);
+        if (ps.p >= ps.end) {
+            return fail(ps, JSON_STREAM_INCOMPLETE);
+        }
+        if (*ps.p == ',') {
+            ps.p++;
+            continue;
+        }
+        if (*ps.p == ']') {
+            ps.p++;
+            ps.depth--;
+            return true;
+        }
+        return fail(ps, JSON_STREAM_INVALID);
+    }
+}
+
+// PATH_NONE: apenas valida (subárvore sem nome ou caminho longo demais)
+static bool parseValue(Parser &ps, size_t pathLen, PathMode mode) {
+    skipWs(ps);
+    if (ps.p >= ps.end) {
+        return fail(ps, JSON_STREAM_INCOMPLETE);
+    }
+
+    if (*ps.p == '{') {
+        return parseObject(ps, pathLen, mode);
+    }
+    if (*ps.p == '[') {
+        return parseArray(ps, pathLen, mode);
+    }
+
+    Token t;
+    if (!scanScalar(ps, t)) {
+        return false;
+    }
+    // Sem prefixo não temos nome de coluna; null é ignorado
+    if (named(mode, pathLen) && t.type != Token::NUL) {
+        emitField(ps, mode, pathLen, t);
+    }
+    return true;
+}
+
+static int streamRun(const char *json, size_t len, FlatArena &arena,
+                     const ColumnMap *columns, StreamEmit emit, void *ctx) {
+    flatBegin(arena);
+
+    Parser ps = { json, json + len, &arena, emit, ctx, columns, 0, 0, 0 };
+    skipWs(ps);
+    if (ps.p >= ps.end) {
+        return JSON_STREAM_EMPTY;
+    }
+    // Como no deserializeJson(), o que vier depois do primeiro valor é ignorado
+    if (!parseValue(ps, 0, PATH_LIVE)) {
+        return ps.error;
+    }
+    return (int)ps.count;
+}
+
+// -----------------------------------------------------------------------------
+// streamFlattenToArena
+// -----------------------------------------------------------------------------
+static void emitToArena(void *, FlatArena &a, size_t pathLen, const Token &value) {
+    size_t i = a.count;
+    size_t mark = a.used;
+
+    if (!flatPutText(a, a.path, pathLen, a.keys[i]) ||
+        !putToken(a, value, FLOAT_DECIMALS, a.values[i])) {
+        a.used = mark;
+        return;
+    }
+    a.count++;
+}
+
+int streamFlattenToArena(const char *json, size_t len, FlatArena &arena) {
+    // Como flattenToArena(): campos guardados (sem os que não couberam)
+    int n = streamRun(json, len, arena, nullptr, emitToArena, nullptr);
+    return (n < 0) ? n : (int)arena.count;
+}
+
+// -----------------------------------------------------------------------------
+// streamFlattenToColumns
+// -----------------------------------------------------------------------------
+struct ColumnsCtx {
+    const ColumnMap *columns;
+    FlatValue *slots;
+};
+
+static void emitToColumns(void *ctx, FlatArena &a, size_t pathLen, const Token &value) {
+    ColumnsCtx *c = static_cast<ColumnsCtx *>(ctx);
+    int col = c->columns->find(a.path, pathLen);
+
+    // Campo fora do cabeçalho, ou chave repetida (vale a 1ª ocorrência)
+    if (col < 0 || c->slots[col].type != FLAT_ABSENT) {
+        return;
+    }
+    putToken(a, value, c->columns->decimals(col), c->slots[col]);
+}
+
+int streamFlattenToColumns(const char *json, size_t len,
+                           const ColumnMap &columns,
+                           FlatArena &arena,
+                           FlatValue *slots) {
+    flatClear(slots, columns.count());
+
+    ColumnsCtx ctx = { &columns, slots };
+    return streamRun(json, len, arena, &columns, emitToColumns, &ctx);
+}
+
+const char *jsonStreamErrorStr(int code) {
+    switch (code) {
+        case JSON_STREAM_EMPTY:      return "EmptyInput";
+        case JSON_STREAM_INCOMPLETE: return "IncompleteInput";
+        case JSON_STREAM_INVALID:    return "InvalidInput";
+        case JSON_STREAM_TOO_DEEP:   return "TooDeep";
+        default:                     return "Ok";
+    }
+}
@@ -0,0 +1,57 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - JSON STREAM (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Achatamento do JSON em uma única passada sobre o texto do payload, sem montar
+um documento (DOM) do ArduinoJson. Os pares (caminho, valor) são emitidos à
+medida que os tokens são lidos, direto na FlatArena / nas colunas.
+
+Regras (idênticas ao json_flatten):
+-----------------------------------
+- {"value": X} -> chave = prefixo, valor = X.
+- Objetos aninhados e arrays concatenam nomes/índices com "_".
+- Valores tipados (FlatValue) como em flattenToArena(); null -> FLAT_NULL.
+
+Memória:
+--------
+- Nenhuma cópia do payload e nenhum nó alocado: o uso de pilha é
+  proporcional à profundidade (limitada a JSON_STREAM_MAX_DEPTH), e não
+  ao tamanho do payload. Por isso payloads maiores que JSON_BUFFER_SIZE
+  são aceitos.
+- Strings são decodificadas (escapes, \uXXXX) direto na arena.
+
+Erros:
+------
+As funções retornam o número de campos (>= 0) ou um código negativo
+(JsonStreamError). O conteúdo da arena só é válido se não houve erro.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "json_flatten.h"
+
+class ColumnMap;
+
+enum JsonStreamError {
+    JSON_STREAM_EMPTY      = -1,   // Entrada vazia
+    JSON_STREAM_INCOMPLETE = -2,   // Texto terminou no meio do JSON
+    JSON_STREAM_INVALID    = -3,   // Sintaxe inválida
+    JSON_STREAM_TOO_DEEP   = -4    // Aninhamento > JSON_STREAM_MAX_DEPTH
+};
+
+// Equivalente a flattenToArena(), lendo o texto diretamente.
+int streamFlattenToArena(const char *json, size_t len, FlatArena &arena);
+
+// Equivalente a flattenToColumns(), lendo o texto diretamente.
+int streamFlattenToColumns(const char *json, size_t len,
+                           const ColumnMap &columns,
+                           FlatArena &arena,
+                           FlatValue *slots);
+
+// Nome do erro (para o Serial), no mesmo estilo do DeserializationError.
+const char *jsonStreamErrorStr(int code);
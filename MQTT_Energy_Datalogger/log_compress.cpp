@@ -0,0 +1,253 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOG COMPRESS (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa os frames de log_compress.h:
+- lzFrameEncode(): busca gulosa com hash de 4 bytes; cada entrada é o
+  início de uma cadeia das posições anteriores com o mesmo hash (até
+  LZ_CHAIN_DEPTH candidatas, o match mais longo vence). Em trechos sem
+  match o passo cresce, para não gastar CPU em dados que não comprimem.
+  Se o resultado não fica menor que o bloco, grava o bloco como está
+  (LZ_STORED);
+- lzFrameDecode(): confere cada comprimento e distância contra os limites
+  do frame e da saída.
+
+================================================================================
+*/
+
+#include <string.h>
+#include "log_compress.h"
+
+// Posição + 1 (0 = vazio) da ocorrência mais recente de cada hash, e de
+// cada posição a anterior com o mesmo hash (índice = posição % LZ_CHAIN_SIZE)
+static uint16_t lzHead[LZ_HASH_SIZE];
+static uint16_t lzPrev[LZ_CHAIN_SIZE];
+
+static uint32_t read32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+static uint32_t hash4(const uint8_t *p) {
+    return (read32(p) * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+static uint8_t headerCheck(const uint8_t *h) {
+    return (uint8_t)(LZ_CHECK_SEED ^ h[2] ^ h[4] ^ h[5] ^ h[6] ^ h[7]);
+}
+
+static void insert(const uint8_t *src, size_t i) {
+    uint32_t h = hash4(src + i);
+    lzPrev[i & (LZ_CHAIN_SIZE - 1)] = lzHead[h];
+    lzHead[h] = (uint16_t)(i + 1);
+}
+
+// Match mais longo para a posição i entre as candidatas da cadeia
+static size_t findMatch(const uint8_t *src, size_t n, size_t i, size_t &from) {
+    size_t best = 0;
+    size_t cand = lzHead[hash4(src + i)];
+    for (int d = 0; d < LZ_CHAIN_DEPTH && cand != 0; d++) {
+        size_t c = cand - 1;
+        if (i - c >= LZ_CHAIN_SIZE) {
+            break;      // Elo já reaproveitado por uma posição mais nova
+        }
+        if (read32(src + c) == read32(src + i)) {
+            size_t len = LZ_MIN_MATCH;
+            while (i + len < n && src[c + len] == src[i + len]) {
+                len++;
+            }
+            if (len > best) {
+                best = len;
+                from = c;
+            }
+        }
+        cand = lzPrev[c & (LZ_CHAIN_SIZE - 1)];
+    }
+    return best;
+}
+
+// Comprimento em extensão (após o nibble de 15). false se não cabe.
+static bool putLength(uint8_t *&op, const uint8_t *end, size_t len) {
+    while (len >= 255) {
+        if (op >= end) {
+            return false;
+        }
+        *op++ = 255;
+        len -= 255;
+    }
+    if (op >= end) {
+        return false;
+    }
+    *op++ = (uint8_t)len;
+    return true;
+}
+
+// Sequência: literais [lit, lit + litLen) e match (matchLen = 0: última).
+static bool putSequence(uint8_t *&op, const uint8_t *end, const uint8_t *lit,
+                        size_t litLen, uint16_t distance, size_t matchLen) {
+    if (op >= end) {
+        return false;
+    }
+    size_t m = matchLen ? matchLen - LZ_MIN_MATCH : 0;
+    uint8_t *token = op++;
+    *token = (uint8_t)(((litLen < 15) ? litLen : 15) << 4 | ((m < 15) ? m : 15));
+
+    if (litLen >= 15 && !putLength(op, end, litLen - 15)) {
+        return false;
+    }
+    if ((size_t)(end - op) < litLen) {
+        return false;
+    }
+    memcpy(op, lit, litLen);
+    op += litLen;
+
+    if (matchLen == 0) {
+        return true;
+    }
+    if (end - op < 2) {
+        return false;
+    }
+    *op++ = (uint8_t)distance;
+    *op++ = (uint8_t)(distance >> 8);
+    return m < 15 || putLength(op, end, m - 15);
+}
+
+// Sequências de src em [out, out + cap). 0 se não cabem.
+static size_t compressBlock(const uint8_t *src, size_t n, uint8_t *out, size_t cap) {
+    memset(lzHead, 0, sizeof(lzHead));
+    uint8_t *op = out;
+    const uint8_t *end = out + cap;
+    size_t anchor = 0;
+    size_t i = 0;
+
+    while (i + LZ_MIN_MATCH <= n) {
+        size_t from = 0;
+        size_t len = findMatch(src, n, i, from);
+        insert(src, i);
+        if (len == 0) {
+            i += 1 + ((i - anchor) >> 5);
+            continue;
+        }
+
+        if (!putSequence(op, end, src + anchor, i - anchor, (uint16_t)(i - from), len)) {
+            return 0;
+        }
+        // Posições dentro do match também entram: a próxima linha parecida
+        // pode começar em qualquer uma
+        for (size_t k = i + 1; k < i + len && k + LZ_MIN_MATCH <= n; k++) {
+            insert(src, k);
+        }
+        i += len;
+        anchor = i;
+    }
+
+    if (!putSequence(op, end, src + anchor, n - anchor, 0, 0)) {
+        return 0;
+    }
+    return (size_t)(op - out);
+}
+
+size_t lzFrameEncode(const uint8_t *src, size_t n, uint8_t *frame) {
+    // Frame vazio não é válido (lzFrameHeader)
+    if (n == 0) {
+        return 0;
+    }
+    // Só vale comprimir se ficar menor que o bloco
+    size_t data = compressBlock(src, n, frame + LZ_FRAME_HEADER, n - 1);
+    uint8_t method = LZ_LZ77;
+    if (data == 0) {
+        memcpy(frame + LZ_FRAME_HEADER, src, n);
+        data = n;
+        method = LZ_STORED;
+    }
+
+    frame[0] = LZ_MAGIC0;
+    frame[1] = LZ_MAGIC1;
+    frame[2] = method;
+    frame[4] = (uint8_t)n;
+    frame[5] = (uint8_t)(n >> 8);
+    frame[6] = (uint8_t)data;
+    frame[7] = (uint8_t)(data >> 8);
+    frame[3] = headerCheck(frame);
+    return LZ_FRAME_HEADER + data;
+}
+
+bool lzFrameHeader(const uint8_t *header, LzFrame &frame) {
+    if (header[0] != LZ_MAGIC0 || header[1] != LZ_MAGIC1 ||
+        header[3] != headerCheck(header)) {
+        return false;
+    }
+    frame.method = header[2];
+    frame.rawLen = (uint16_t)(header[4] | header[5] << 8);
+    frame.dataLen = (uint16_t)(header[6] | header[7] << 8);
+
+    if (frame.rawLen == 0 || frame.dataLen == 0) {
+        return false;
+    }
+    if (frame.method == LZ_STORED) {
+        return frame.dataLen == frame.rawLen;
+    }
+    return frame.method == LZ_LZ77 && frame.dataLen < frame.rawLen;
+}
+
+// Comprimento com extensão; false se passa do fim
+static bool getLength(const uint8_t *&ip, const uint8_t *end, size_t &len) {
+    if (len < 15) {
+        return true;
+    }
+    uint8_t c;
+    do {
+        if (ip >= end) {
+            return false;
+        }
+        c = *ip++;
+        len += c;
+    } while (c == 255);
+    return true;
+}
+
+bool lzFrameDecode(const LzFrame &frame, const uint8_t *data, uint8_t *out) {
+    if (frame.method == LZ_STORED) {
+        memcpy(out, data, frame.rawLen);
+        return true;
+    }
+
+    const uint8_t *ip = data;
+    const uint8_t *end = data + frame.dataLen;
+    size_t o = 0;
+    while (ip < end) {
+        uint8_t token = *ip++;
+        size_t lit = token >> 4;
+        if (!getLength(ip, end, lit) || (size_t)(end - ip) < lit ||
+            frame.rawLen - o < lit) {
+            return false;
+        }
+        memcpy(out + o, ip, lit);
+        ip += lit;
+        o += lit;
+        if (ip == end) {
+            break;      // Última sequência
+        }
+
+        if (end - ip < 2) {
+            return false;
+        }
+        size_t distance = ip[0] | ip[1] << 8;
+        ip += 2;
+        size_t len = token & 0x0F;
+        if (!getLength(ip, end, len)) {
+            return false;
+        }
+        len += LZ_MIN_MATCH;
+        if (distance == 0 || distance > o || frame.rawLen - o < len) {
+            return false;
+        }
+        // Byte a byte: o match pode sobrepor o destino
+        for (size_t k = 0; k < len; k++, o++) {
+            out[o] = out[o - distance];
+        }
+    }
+    return o == frame.rawLen;
+}
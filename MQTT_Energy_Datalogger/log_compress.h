@@ -0,0 +1,86 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOG COMPRESS (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Compressão do log em blocos independentes (LOG_COMPRESS = 1), compartilhada
+entre o firmware (csv_sink, log_partitions) e a ferramenta de PC
+tools/logunpack.cpp. Não depende do Arduino.
+
+O CSV (e o binário) se repete muito de linha para linha: as mesmas
+chaves, tópicos e prefixos de números. Um LZ77 simples, no estilo do LZ4,
+reduz o volume gravado no SD várias vezes com pouca CPU e RAM fixa:
+- compressão: tabela hash de LZ_HASH_SIZE posições (2 KiB) e cadeias de
+  LZ_CHAIN_SIZE posições (8 KiB), estáticas;
+- descompressão: nenhuma memória além do bloco de saída.
+
+Frames:
+-------
+Cada bloco descarregado pelo csv_sink vira um frame que se descomprime
+sozinho (sem dicionário compartilhado entre blocos), então a leitura pode
+começar em qualquer frame. Inteiros little-endian:
+
+    'L' 'Z' <método:1> <check:1> <bruto:u16> <dados:u16>   cabeçalho (8 bytes)
+    <dados bytes>
+
+- método LZ_STORED: dados = bloco original (não comprimiu);
+  LZ_LZ77: sequências abaixo.
+- check: LZ_CHECK_SEED ^ método ^ os 4 bytes dos tamanhos. Um frame
+  incompleto (queda de energia) é reconhecido pelo cabeçalho ou pela
+  descompressão, que precisa dar exatamente <bruto> bytes.
+- O arquivo é a sequência dos frames. Um byte que não começa um frame
+  válido (ex.: zeros da pré-alocação) termina os dados.
+
+Sequências (LZ_LZ77):
+---------------------
+    <token:1> [literais+] <literais> [<distância:u16> [match+]]
+
+- token: 4 bits altos = quantidade de literais, 4 bits baixos =
+  comprimento do match - LZ_MIN_MATCH. 15 = continua em bytes extras
+  (255 = soma e segue; < 255 = último).
+- A última sequência do frame só tem literais (termina no fim dos dados).
+- distância: 1..65535 bytes para trás, dentro do mesmo frame (o match
+  pode sobrepor o próprio destino, como em LZ4).
+
+================================================================================
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define LZ_MAGIC0        'L'
+#define LZ_MAGIC1        'Z'
+#define LZ_STORED        0
+#define LZ_LZ77          1
+#define LZ_CHECK_SEED    0x5A
+#define LZ_FRAME_HEADER  8
+#define LZ_BLOCK_MAX     65535   // Bytes de um bloco (tamanhos em u16)
+#define LZ_MIN_MATCH     4
+#define LZ_HASH_BITS     10
+#define LZ_HASH_SIZE     (1 << LZ_HASH_BITS)
+#define LZ_CHAIN_BITS    12      // Alcance das cadeias (distância < 4 KiB)
+#define LZ_CHAIN_SIZE    (1 << LZ_CHAIN_BITS)
+#define LZ_CHAIN_DEPTH   4       // Candidatas por posição (mais = melhor e mais lento)
+
+// Maior frame de um bloco de n bytes (método LZ_STORED)
+#define LZ_FRAME_MAX(n)  (LZ_FRAME_HEADER + (n))
+
+struct LzFrame {
+    uint8_t  method;
+    uint16_t rawLen;     // Bytes do bloco original
+    uint16_t dataLen;    // Bytes após o cabeçalho
+};
+
+// Comprime src[0..n) (n <= LZ_BLOCK_MAX) em um frame completo em frame
+// (LZ_FRAME_MAX(n) bytes). Retorna o tamanho do frame; n = 0: nenhum
+// frame (0). Usa a tabela hash estática: uma compressão por vez.
+size_t lzFrameEncode(const uint8_t *src, size_t n, uint8_t *frame);
+
+// Lê e confere o cabeçalho de LZ_FRAME_HEADER bytes.
+bool lzFrameHeader(const uint8_t *header, LzFrame &frame);
+
+// Descomprime os dados do frame em out (frame.rawLen bytes).
+// false se os dados não formam exatamente rawLen bytes.
+bool lzFrameDecode(const LzFrame &frame, const uint8_t *data, uint8_t *out);
@@ -0,0 +1,273 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOG PARTITIONS (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa o log por partição de log_partitions.h:
+- pathFor(): chave -> PARTITION_DIR/<nome>PARTITION_EXT;
+- sinkFor(): buffer da partição; na falta, o livre ou o de uso mais
+  antigo (contador de acessos), descarregado antes de trocar de dono;
+- fileFor(): arquivo da partição entre os abertos; na falta, fecha o de
+  uso mais antigo e abre o novo no lugar;
+- writeBlock(): com LOG_COMPRESS, um frame por bloco de até
+  PARTITION_BUFFER_SIZE bytes.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string.h>
+#include "log_partitions.h"
+#include "metrics.h"
+#include "diag_log.h"
+
+LogPartitions::LogPartitions() : _header(nullptr), _ctx(nullptr), _tick(0) {
+    for (size_t i = 0; i < PARTITION_MAX; i++) {
+        _writers[i].owner = this;
+        _writers[i].used = false;
+        _writers[i].handle = -1;
+        _writers[i].len = 0;
+    }
+    for (size_t i = 0; i < PARTITION_OPEN_MAX; i++) {
+        _files[i].writer = -1;
+    }
+    memset(&_stats, 0, sizeof(_stats));
+}
+
+bool LogPartitions::begin(PartitionHeader header, void *ctx) {
+    _header = header;
+    _ctx = ctx;
+    SD.mkdir(PARTITION_DIR);
+    return SD.exists(PARTITION_DIR);
+}
+
+static bool nameChar(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '-' || c == '_' || c == '.';
+}
+
+void LogPartitions::pathFor(const char *key, char *out) {
+    size_t n = sizeof(PARTITION_DIR) - 1;
+    memcpy(out, PARTITION_DIR, n);
+    out[n++] = '/';
+
+    size_t start = n;
+    for (const char *p = key; *p && n - start < PARTITION_NAME_MAX; p++) {
+        // Sem '.' no início (".." ou arquivo oculto)
+        char c = *p;
+        if (!nameChar(c) || (c == '.' && n == start)) {
+            c = '_';
+        }
+        out[n++] = c;
+    }
+    if (n == start) {
+        out[n++] = '_';
+    }
+    memcpy(out + n, PARTITION_EXT, sizeof(PARTITION_EXT));
+}
+
+// -----------------------------------------------------------------------------
+// Arquivos abertos
+// -----------------------------------------------------------------------------
+File *LogPartitions::fileFor(Writer &w) {
+    if (w.handle >= 0) {
+        Handle &h = _files[w.handle];
+        h.lastUse = ++_tick;
+        return &h.file;
+    }
+
+    // Posição livre; senão a usada há mais tempo
+    size_t victim = 0;
+    for (size_t i = 0; i < PARTITION_OPEN_MAX; i++) {
+        if (_files[i].writer < 0) {
+            victim = i;
+            break;
+        }
+        if (_files[i].lastUse < _files[victim].lastUse) {
+            victim = i;
+        }
+    }
+
+    Handle &h = _files[victim];
+    if (h.writer >= 0) {
+        h.file.close();
+        _writers[h.writer].handle = -1;
+        h.writer = -1;
+    }
+
+    h.file = SD.open(w.path, FILE_APPEND);
+    _stats.opens++;
+    if (!h.file) {
+        _stats.errors++;
+        DIAG_ERROR("LogPartitions: erro ao abrir %s", w.path);
+        return nullptr;
+    }
+    h.writer = (int)(&w - _writers);
+    h.lastUse = ++_tick;
+    w.handle = (int)victim;
+    return &h.file;
+}
+
+bool LogPartitions::writeBlock(Writer &w, const uint8_t *data, size_t len) {
+#if LOG_COMPRESS
+    bool ok = true;
+    while (len > 0) {
+        size_t n = (len < PARTITION_BUFFER_SIZE) ? len : PARTITION_BUFFER_SIZE;
+        uint32_t t = metricsStart();
+        size_t frame = lzFrameEncode(data, n, _frame);
+        metricsRecord(METRIC_COMPRESS, t);
+        ok = writeFile(w, _frame, frame) && ok;
+        data += n;
+        len -= n;
+    }
+    return ok;
+#else
+    return writeFile(w, data, len);
+#endif
+}
+
+bool LogPartitions::writeFile(Writer &w, const uint8_t *data, size_t len) {
+    File *f = fileFor(w);
+    if (!f) {
+        return false;
+    }
+
+    uint32_t t = metricsStart();
+    size_t n = f->write(data, len);
+    _stats.blocks++;
+    if (n != len) {
+        _stats.errors++;
+        DIAG_ERROR("LogPartitions: escrita incompleta em %s (%lu/%lu bytes).",
+                   w.path, (unsigned long)n, (unsigned long)len);
+        Handle &h = _files[w.handle];
+        h.file.close();
+        h.writer = -1;
+        w.handle = -1;
+        return false;
+    }
+    f->flush();
+    metricsRecord(METRIC_SD_WRITE, t);
+    return true;
+}
+
+// Em caso de falha o conteúdo é descartado para não travar o logger
+bool LogPartitions::flushWriter(Writer &w) {
+    if (w.len == 0) {
+        return true;
+    }
+    bool ok = writeBlock(w, w.buf, w.len);
+    w.len = 0;
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+// Buffers
+// -----------------------------------------------------------------------------
+size_t LogPartitions::Writer::write(uint8_t c) {
+    return write(&c, 1);
+}
+
+size_t LogPartitions::Writer::write(const uint8_t *data, size_t n) {
+    if (n == 0) {
+        return 0;
+    }
+    if (len + n > PARTITION_BUFFER_SIZE) {
+        owner->flushWriter(*this);
+    }
+    // Maior que o buffer inteiro: vai direto para o arquivo
+    if (n > PARTITION_BUFFER_SIZE) {
+        return owner->writeBlock(*this, data, n) ? n : 0;
+    }
+    if (len == 0) {
+        pendingSince = millis();
+    }
+    memcpy(buf + len, data, n);
+    len += n;
+    return n;
+}
+
+Print *LogPartitions::sinkFor(const char *key) {
+    char path[PARTITION_PATH_SIZE];
+    pathFor(key, path);
+
+    // Partição com buffer; senão um livre; senão o usado há mais tempo
+    Writer *victim = &_writers[0];
+    for (size_t i = 0; i < PARTITION_MAX; i++) {
+        Writer &w = _writers[i];
+        if (w.used && strcmp(w.path, path) == 0) {
+            w.lastUse = ++_tick;
+            _stats.hits++;
+            return &w;
+        }
+        if (victim->used && (!w.used || w.lastUse < victim->lastUse)) {
+            victim = &w;
+        }
+    }
+
+    _stats.misses++;
+    Writer &w = *victim;
+    if (w.used) {
+        flushWriter(w);
+        if (w.handle >= 0) {
+            // O arquivo aberto era da partição antiga
+            Handle &h = _files[w.handle];
+            h.file.close();
+            h.writer = -1;
+            w.handle = -1;
+        }
+        w.used = false;
+    }
+
+    memcpy(w.path, path, sizeof(path));
+    w.len = 0;
+    File *f = fileFor(w);
+    if (!f) {
+        return nullptr;
+    }
+    w.used = true;
+    w.lastUse = ++_tick;
+    if (f->size() == 0 && _header) {
+        _header(_ctx, w);
+    }
+    return &w;
+}
+
+void LogPartitions::poll() {
+    for (size_t i = 0; i < PARTITION_MAX; i++) {
+        Writer &w = _writers[i];
+        if (w.used && w.len > 0 && (millis() - w.pendingSince) >= CSV_SINK_FLUSH_MS) {
+            flushWriter(w);
+        }
+    }
+}
+
+void LogPartitions::flush() {
+    for (size_t i = 0; i < PARTITION_MAX; i++) {
+        if (_writers[i].used) {
+            flushWriter(_writers[i]);
+        }
+    }
+}
+
+void LogPartitions::end() {
+    flush();
+    for (size_t i = 0; i < PARTITION_OPEN_MAX; i++) {
+        if (_files[i].writer >= 0) {
+            _files[i].file.close();
+            _writers[_files[i].writer].handle = -1;
+            _files[i].writer = -1;
+        }
+    }
+    for (size_t i = 0; i < PARTITION_MAX; i++) {
+        _writers[i].used = false;
+    }
+}
+
+size_t LogPartitions::openCount() const {
+    size_t n = 0;
+    for (size_t i = 0; i < PARTITION_OPEN_MAX; i++) {
+        n += (_files[i].writer >= 0) ? 1 : 0;
+    }
+    return n;
+}
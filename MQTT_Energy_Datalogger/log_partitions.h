@@ -0,0 +1,138 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOG PARTITIONS (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Log CSV dividido por tópico ou por client_id (LOG_PARTITION): cada chave
+vai para PARTITION_DIR/<nome>.csv, com cabeçalho próprio, e a análise de
+um medidor não precisa mais separar o arquivo inteiro.
+
+Buffers e arquivos abertos:
+---------------------------
+- Partição: buffer próprio em RAM (PARTITION_BUFFER_SIZE bytes, até
+  PARTITION_MAX partições). As linhas só vão para o buffer; o SD é
+  acessado quando ele enche ou quando o dado mais antigo passa de
+  CSV_SINK_FLUSH_MS (poll()), como no csv_sink.
+- Arquivos abertos: cache LRU de PARTITION_OPEN_MAX handles, usado só no
+  descarregamento de um bloco. Partição com arquivo aberto grava sem
+  SD.open(); senão fecha o arquivo usado há mais tempo e abre o dela
+  (append). O limite respeita o número de arquivos abertos do FatFS no
+  SD.begin().
+- Partição nova (ou sem buffer): ocupa um buffer livre ou o da partição
+  usada há mais tempo (descarregado antes). Arquivo vazio recebe o
+  cabeçalho (callback).
+- Com mais tópicos ativos que PARTITION_MAX, as partições trocam de
+  buffer a cada linha e cada linha vira uma escrita no SD.
+
+Nome do arquivo:
+----------------
+A chave com [A-Za-z0-9._-] mantidos e os demais caracteres como '_'
+("MiEnergy/01" -> "MiEnergy_01.csv"), até PARTITION_NAME_MAX caracteres.
+Chaves com o mesmo nome (ex.: "a/b" e "a_b") dividem o arquivo e o
+buffer; a coluna topic/client_id continua separando as linhas.
+
+Com LOG_COMPRESS, o nome termina em ".csv" LOG_COMPRESS_EXT e cada bloco
+descarregado é um frame de log_compress (o cabeçalho fica no 1º frame).
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#include "config.h"
+
+#if LOG_COMPRESS
+#include "log_compress.h"
+#define PARTITION_EXT ".csv" LOG_COMPRESS_EXT
+#if PARTITION_BUFFER_SIZE > LZ_BLOCK_MAX
+#error "PARTITION_BUFFER_SIZE acima de LZ_BLOCK_MAX"
+#endif
+#else
+#define PARTITION_EXT ".csv"
+#endif
+
+#if PARTITION_MAX < 1 || PARTITION_OPEN_MAX < 1
+#error "PARTITION_MAX e PARTITION_OPEN_MAX devem ser pelo menos 1"
+#endif
+
+// PARTITION_DIR + '/' + nome + PARTITION_EXT + '\0'
+#define PARTITION_PATH_SIZE (sizeof(PARTITION_DIR) + PARTITION_NAME_MAX + sizeof(PARTITION_EXT))
+
+// Cabeçalho de um arquivo de partição novo.
+typedef void (*PartitionHeader)(void *ctx, Print &out);
+
+struct LogPartitionStats {
+    uint32_t hits;         // Linhas de partição que já tinha buffer
+    uint32_t misses;       // Linhas que precisaram de um buffer
+    uint32_t opens;        // SD.open() (arquivo fora do cache)
+    uint32_t blocks;       // Blocos gravados no SD
+    uint32_t errors;       // Falhas ao abrir / escritas curtas
+};
+
+class LogPartitions {
+public:
+    LogPartitions();
+
+    // Cria PARTITION_DIR; header é chamado para cada arquivo vazio.
+    bool begin(PartitionHeader header, void *ctx);
+
+    // Buffer da partição de key (Print), ocupando um se preciso.
+    // nullptr se o arquivo da partição não abriu.
+    Print *sinkFor(const char *key);
+
+    // Descarrega os buffers com dado pendente mais antigo que CSV_SINK_FLUSH_MS.
+    void poll();
+
+    // Descarrega todos os buffers.
+    void flush();
+
+    // flush() + fecha todos os arquivos.
+    void end();
+
+    // Caminho do arquivo de key (PARTITION_PATH_SIZE bytes em out).
+    static void pathFor(const char *key, char *out);
+
+    size_t openCount() const;
+    const LogPartitionStats &stats() const { return _stats; }
+
+private:
+    class Writer : public Print {
+    public:
+        size_t write(uint8_t c) override;
+        size_t write(const uint8_t *data, size_t len) override;
+        using Print::write;
+
+        LogPartitions *owner;
+        bool     used;
+        int      handle;              // Posição em _files, ou -1
+        uint32_t lastUse;
+        unsigned long pendingSince;   // millis() do primeiro byte pendente
+        size_t   len;
+        char     path[PARTITION_PATH_SIZE];
+        uint8_t  buf[PARTITION_BUFFER_SIZE];
+    };
+
+    struct Handle {
+        File     file;
+        int      writer;              // Partição dona do arquivo, ou -1
+        uint32_t lastUse;
+    };
+
+    File *fileFor(Writer &w);
+    bool writeBlock(Writer &w, const uint8_t *data, size_t len);
+    bool writeFile(Writer &w, const uint8_t *data, size_t len);
+    bool flushWriter(Writer &w);
+
+    PartitionHeader _header;
+    void           *_ctx;
+    uint32_t        _tick;
+    Writer          _writers[PARTITION_MAX];
+    Handle          _files[PARTITION_OPEN_MAX];
+    LogPartitionStats _stats;
+#if LOG_COMPRESS
+    uint8_t         _frame[LZ_FRAME_MAX(PARTITION_BUFFER_SIZE)];   // Compartilhado pelas partições
+#endif
+};
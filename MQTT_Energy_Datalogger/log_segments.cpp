@@ -0,0 +1,594 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOG SEGMENTS (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa a rotação e o índice descritos em log_segments.h:
+- o índice fica aberto junto com o arquivo de dados; cada entrada tem
+  12 bytes e vai para o SD assim que é escrita (uma a cada
+  LOG_INDEX_EVERY linhas);
+- commit() grava o CRC-32 do bloco no índice antes do bloco (write-ahead);
+  recover() confere esses CRCs de trás para frente no boot seguinte;
+- logFindRange() percorre os segmentos do mais novo para o mais antigo
+  (consultas costumam ser recentes) e para no primeiro índice ausente ou
+  anterior ao intervalo;
+- LOG_DIR/last é gravado em last.tmp e renomeado (o FAT não renomeia por
+  cima: last é apagado antes); na leitura vale o maior dos dois que
+  estiver completo, e sem nenhum o diretório é listado.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "log_segments.h"
+#include "diag_log.h"
+
+#define IDX_MAGIC    "MQIX"
+#define IDX_VERSION  2
+#define IDX_CLOSE    0xFFFFFFFFu
+#define IDX_COMMIT   0xFE000000u   // | tamanho do bloco (< 16 MiB)
+#define IDX_LEN_MASK 0x00FFFFFFu
+
+#define LAST_PATH     LOG_DIR "/last"
+#define LAST_TMP_PATH LOG_DIR "/last.tmp"
+
+static bool isCommit(uint32_t tag) {
+    return tag != IDX_CLOSE && (tag & ~IDX_LEN_MASK) == IDX_COMMIT;
+}
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+#define SEG_FORMAT_EXT "bin"
+#else
+#define SEG_FORMAT_EXT "csv"
+#endif
+
+#if LOG_COMPRESS
+#define SEG_DATA_EXT SEG_FORMAT_EXT LOG_COMPRESS_EXT
+#else
+#define SEG_DATA_EXT SEG_FORMAT_EXT
+#endif
+
+void logSegmentDataPath(uint32_t segment, char *buf, size_t cap) {
+    snprintf(buf, cap, "%s/seg_%05lu.%s", LOG_DIR, (unsigned long)segment, SEG_DATA_EXT);
+}
+
+void logSegmentIndexPath(uint32_t segment, char *buf, size_t cap) {
+    snprintf(buf, cap, "%s/seg_%05lu.idx", LOG_DIR, (unsigned long)segment);
+}
+
+static void putU32(uint8_t *p, uint32_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+    p[2] = (uint8_t)(v >> 16);
+    p[3] = (uint8_t)(v >> 24);
+}
+
+static uint32_t getU32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) |
+           ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// CRC-32 (IEEE, refletido), tabela de 4 bits
+static uint32_t crc32Update(uint32_t crc, const uint8_t *p, size_t n) {
+    static const uint32_t table[16] = {
+        0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+        0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+        0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+        0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+    };
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc ^= p[i];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+        crc = (crc >> 4) ^ table[crc & 0x0F];
+    }
+    return ~crc;
+}
+
+// Lê o registro i do índice (após o cabeçalho). false se não há.
+static bool readRecord(File &f, uint32_t i, uint32_t &a, uint32_t &b, uint32_t &c) {
+    uint8_t rec[12];
+    if (!f.seek(16 + i * 12) || f.read(rec, 12) != 12) {
+        return false;
+    }
+    a = getU32(rec);
+    b = getU32(rec + 4);
+    c = getU32(rec + 8);
+    return true;
+}
+
+// Abre o índice e confere o cabeçalho. records = registros completos
+// (um registro cortado no fim é ignorado).
+static File openIndex(uint32_t segment, uint32_t &boot, uint32_t &records) {
+    char path[LOG_SEG_PATH_SIZE];
+    logSegmentIndexPath(segment, path, sizeof(path));
+    File f = SD.open(path, FILE_READ);
+    if (!f) {
+        return f;
+    }
+
+    uint8_t hdr[16];
+    if (f.read(hdr, 16) != 16 || memcmp(hdr, IDX_MAGIC, 4) != 0 ||
+        getU32(hdr + 4) != IDX_VERSION) {
+        f.close();
+        return File();
+    }
+    boot = getU32(hdr + 8);
+    records = (uint32_t)((f.size() - 16) / 12);
+    return f;
+}
+
+// CRC do trecho [start, start + len) do arquivo de dados
+static bool blockCrc(File &data, uint32_t start, uint32_t len, uint32_t &crc) {
+    uint8_t buf[512];
+    if (!data.seek(start)) {
+        return false;
+    }
+    crc = 0;
+    while (len > 0) {
+        size_t n = (len < sizeof(buf)) ? len : sizeof(buf);
+        if (data.read(buf, n) != n) {
+            return false;
+        }
+        crc = crc32Update(crc, buf, n);
+        len -= n;
+    }
+    return true;
+}
+
+uint32_t logSegmentDataEnd(uint32_t segment) {
+    uint32_t boot;
+    uint32_t records;
+    File f = openIndex(segment, boot, records);
+    if (!f) {
+        return 0;
+    }
+
+    uint32_t end = 0;
+    for (uint32_t i = records; i > 0; i--) {
+        uint32_t start, tag, crc;
+        if (!readRecord(f, i - 1, start, tag, crc)) {
+            break;
+        }
+        if (isCommit(tag)) {
+            end = start + (tag & IDX_LEN_MASK);
+            break;
+        }
+    }
+    f.close();
+    return end;
+}
+
+// "<segmento> <boot>\n" de path; false se ausente, cortado ou inválido
+static bool readLast(const char *path, uint32_t &segment, uint32_t &boot) {
+    File f = SD.open(path, FILE_READ);
+    if (!f) {
+        return false;
+    }
+    char buf[32];
+    size_t n = f.read((uint8_t *)buf, sizeof(buf) - 1);
+    f.close();
+    buf[n] = '\0';
+
+    unsigned long seg;
+    unsigned long b;
+    int used = 0;
+    if (n == 0 || buf[n - 1] != '\n' ||
+        sscanf(buf, "%lu %lu\n%n", &seg, &b, &used) != 2 || used != (int)n || seg == 0) {
+        return false;
+    }
+    segment = (uint32_t)seg;
+    boot = (uint32_t)b;
+    return true;
+}
+
+// Maior segmento em LOG_DIR (dados ou índice) e o boot do índice dele.
+// Só usado quando last e last.tmp estão ausentes ou cortados.
+static void scanSegments(uint32_t &segment, uint32_t &boot) {
+    segment = 0;
+    boot = 0;
+    File dir = SD.open(LOG_DIR, FILE_READ);
+    if (!dir || !dir.isDirectory()) {
+        return;
+    }
+    uint32_t indexed = 0;
+    for (File f = dir.openNextFile(); f; f = dir.openNextFile()) {
+        unsigned long seg;
+        char ext[8];
+        if (sscanf(f.name(), "seg_%lu.%7s", &seg, ext) == 2) {
+            if (seg > segment) {
+                segment = (uint32_t)seg;
+            }
+            if (strcmp(ext, "idx") == 0 && seg > indexed) {
+                indexed = (uint32_t)seg;
+            }
+        }
+        f.close();
+    }
+    dir.close();
+
+    uint32_t records;
+    File idx = openIndex(indexed, boot, records);
+    if (idx) {
+        idx.close();
+    }
+}
+
+// Último segmento aberto e boot dele (0 0 com o cartão vazio)
+static void lastSegment(uint32_t &segment, uint32_t &boot) {
+    uint32_t seg = 0;
+    uint32_t b = 0;
+    uint32_t tmpSeg;
+    uint32_t tmpBoot;
+    bool ok = readLast(LAST_PATH, seg, b);
+    // Queda entre gravar last.tmp e renomear: o mais novo está nele
+    if (readLast(LAST_TMP_PATH, tmpSeg, tmpBoot) && (!ok || tmpSeg > seg)) {
+        seg = tmpSeg;
+        b = tmpBoot;
+        ok = true;
+    }
+    if (!ok) {
+        scanSegments(seg, b);
+        if (seg > 0) {
+            DIAG_WARN("LogSegments: %s ilegível; último segmento pela listagem: %lu",
+                      LAST_PATH, (unsigned long)seg);
+        }
+    }
+    segment = seg;
+    boot = b;
+}
+
+static void writeLast(uint32_t segment, uint32_t boot) {
+    char buf[32];
+    int n = snprintf(buf, sizeof(buf), "%lu %lu\n", (unsigned long)segment, (unsigned long)boot);
+
+    File f = SD.open(LAST_TMP_PATH, FILE_WRITE);
+    if (!f) {
+        DIAG_WARN("LogSegments: erro ao criar %s", LAST_TMP_PATH);
+        return;
+    }
+    size_t written = f.write((const uint8_t *)buf, n);
+    f.flush();
+    f.close();
+    if (written != (size_t)n) {
+        return;   // last continua com o valor anterior
+    }
+    SD.remove(LAST_PATH);
+    if (!SD.rename(LAST_TMP_PATH, LAST_PATH)) {
+        DIAG_WARN("LogSegments: erro ao renomear %s", LAST_TMP_PATH);
+    }
+}
+
+// -----------------------------------------------------------------------------
+// LogSegments
+// -----------------------------------------------------------------------------
+LogSegments::LogSegments()
+    : _segment(0), _boot(0), _rows(0), _firstMs(0), _lastMs(0) {
+    _dataPath[0] = '\0';
+}
+
+bool LogSegments::begin() {
+    SD.mkdir(LOG_DIR);
+
+    // Último segmento e boot registrados
+    uint32_t seg;
+    uint32_t boot;
+    lastSegment(seg, boot);
+    if (seg > 0) {
+        recover(seg);
+    }
+
+    _segment = seg + 1;
+    _boot = boot + 1;
+    return openSegment();
+}
+
+bool LogSegments::openSegment() {
+    _rows = 0;
+    _firstMs = 0;
+    _lastMs = 0;
+
+    // Número nunca reaproveitado, mesmo com last atrasado (e o boot
+    // também não volta atrás)
+    char path[LOG_SEG_PATH_SIZE];
+    while (true) {
+        logSegmentDataPath(_segment, _dataPath, sizeof(_dataPath));
+        logSegmentIndexPath(_segment, path, sizeof(path));
+        if (!SD.exists(_dataPath) && !SD.exists(path)) {
+            break;
+        }
+        DIAG_WARN("LogSegments: segmento %lu já existe", (unsigned long)_segment);
+        uint32_t boot;
+        uint32_t records;
+        File idx = openIndex(_segment, boot, records);
+        if (idx) {
+            idx.close();
+            if (boot >= _boot) {
+                _boot = boot + 1;
+            }
+        }
+        _segment++;
+    }
+    writeLast(_segment, _boot);
+
+    _index = SD.open(path, FILE_WRITE);
+    if (!_index) {
+        DIAG_ERROR("LogSegments: erro ao criar %s", path);
+        return false;
+    }
+
+    uint8_t hdr[16];
+    memcpy(hdr, IDX_MAGIC, 4);
+    putU32(hdr + 4, IDX_VERSION);
+    putU32(hdr + 8, _boot);
+    putU32(hdr + 12, _segment);
+    _index.write(hdr, sizeof(hdr));
+    _index.flush();
+
+    DIAG_INFO("Segmento de log: %s", _dataPath);
+    return true;
+}
+
+void LogSegments::putRecord(uint32_t a, uint32_t b, uint32_t c) {
+    if (!_index) {
+        return;
+    }
+    uint8_t rec[12];
+    putU32(rec, a);
+    putU32(rec + 4, b);
+    putU32(rec + 8, c);
+    _index.write(rec, sizeof(rec));
+}
+
+bool LogSegments::shouldRotate(uint32_t ms, uint32_t size) const {
+    if (_rows == 0) {
+        return false;   // Segmento vazio nunca rotaciona
+    }
+    if (LOG_ROTATE_BYTES > 0 && size >= (uint32_t)LOG_ROTATE_BYTES) {
+        return true;
+    }
+    return LOG_ROTATE_MS > 0 && (ms - _firstMs) >= (uint32_t)LOG_ROTATE_MS;
+}
+
+void LogSegments::noteRow(uint32_t ms, uint32_t offset) {
+    if (_rows == 0) {
+        _firstMs = ms;
+    }
+    if (indexDue()) {
+        putRecord(ms, offset, _rows);
+        _index.flush();
+    }
+    _lastMs = ms;
+    _rows++;
+}
+
+void LogSegments::closeIndex() {
+    if (_index) {
+        putRecord(_lastMs, IDX_CLOSE, _rows);
+        _index.close();
+    }
+}
+
+bool LogSegments::rotate() {
+    closeIndex();
+    _segment++;
+    return openSegment();
+}
+
+void LogSegments::commit(uint32_t offset, const uint8_t *data, size_t len) {
+    putRecord(offset, IDX_COMMIT | ((uint32_t)len & IDX_LEN_MASK),
+              crc32Update(0, data, len));
+    flush();   // O commit precisa estar no SD antes do bloco
+}
+
+void LogSegments::recover(uint32_t segment) {
+#if DIAG_LEVEL >= DIAG_LEVEL_WARN
+    unsigned long t0 = millis();
+#endif
+    uint32_t boot;
+    uint32_t records;
+    File idx = openIndex(segment, boot, records);
+    if (!idx) {
+        return;
+    }
+
+    char path[LOG_SEG_PATH_SIZE];
+    logSegmentDataPath(segment, path, sizeof(path));
+    File data = SD.open(path, FILE_READ);
+    uint32_t dataSize = data ? (uint32_t)data.size() : 0;
+
+    // De trás para frente até um bloco íntegro
+    uint32_t good = 0;
+    uint32_t torn = 0;      // Fim dos blocos descartados
+    uint32_t checked = 0;
+    uint32_t discarded = 0;
+    bool last = true;
+    for (uint32_t i = records; i > 0 && checked < LOG_RECOVER_MAX_BLOCKS; i--) {
+        uint32_t start, tag, crc;
+        if (!readRecord(idx, i - 1, start, tag, crc)) {
+            break;
+        }
+        if (tag == IDX_CLOSE && last) {
+            break;   // Fechado na rotação: nada a recuperar
+        }
+        last = false;
+        if (!isCommit(tag)) {
+            continue;
+        }
+
+        checked++;
+        uint32_t len = tag & IDX_LEN_MASK;
+        uint32_t actual;
+        good = start;   // Se nenhum conferir, vale o início do mais antigo
+        if (start + len <= dataSize && blockCrc(data, start, len, actual) && actual == crc) {
+            good = start + len;
+            break;
+        }
+        discarded++;
+        if (start + len > torn) {
+            torn = start + len;
+        }
+    }
+    if (data) {
+        data.close();
+    }
+    idx.close();
+
+    if (discarded == 0) {
+        return;
+    }
+
+    // Zera o que sobrou dos blocos descartados (o arquivo de dados
+    // termina limpo em good, como um segmento pré-alocado)
+    torn = (torn < dataSize) ? torn : dataSize;
+    File wipe = SD.open(path, "r+");
+    if (wipe && torn > good && wipe.seek(good)) {
+        uint8_t zeros[512];
+        memset(zeros, 0, sizeof(zeros));
+        for (uint32_t pos = good; pos < torn; ) {
+            size_t n = (torn - pos < sizeof(zeros)) ? torn - pos : sizeof(zeros);
+            wipe.write(zeros, n);
+            pos += n;
+        }
+    }
+    if (wipe) {
+        wipe.close();
+    }
+
+    // Marca o novo fim: commit vazio em good, após o último registro
+    // completo (por cima de um registro cortado, se houver)
+    char idxPath[LOG_SEG_PATH_SIZE];
+    logSegmentIndexPath(segment, idxPath, sizeof(idxPath));
+    File out = SD.open(idxPath, "r+");
+    if (out && out.seek(16 + records * 12)) {
+        uint8_t rec[12];
+        putU32(rec, good);
+        putU32(rec + 4, IDX_COMMIT);
+        putU32(rec + 8, 0);
+        out.write(rec, sizeof(rec));
+    }
+    if (out) {
+        out.close();
+    }
+
+#if DIAG_LEVEL >= DIAG_LEVEL_WARN
+    DIAG_WARN("Segmento %lu recuperado: %lu bytes válidos, %lu bloco(s) descartado(s), %lu ms.",
+              (unsigned long)segment, (unsigned long)good,
+              (unsigned long)discarded, (unsigned long)(millis() - t0));
+#endif
+}
+
+void LogSegments::flush() {
+    if (_index) {
+        _index.flush();
+    }
+}
+
+// -----------------------------------------------------------------------------
+// logFindRange
+// -----------------------------------------------------------------------------
+// Lê o índice de um segmento e calcula o trecho de [fromMs, toMs].
+// Retorna: 1 = trecho em span; 0 = sem linhas no intervalo;
+//         -1 = segmento anterior ao intervalo (ou de outro boot) ou sem índice.
+static int findInSegment(uint32_t segment, uint32_t boot,
+                         uint32_t fromMs, uint32_t toMs, LogSpan &span) {
+    // Linhas indexadas além do último commit não chegaram ao arquivo
+    uint32_t dataEnd = logSegmentDataEnd(segment);
+
+    uint32_t segBoot;
+    uint32_t records;
+    File f = openIndex(segment, segBoot, records);
+    if (!f) {
+        return -1;
+    }
+    if (segBoot != boot) {
+        f.close();
+        return (segBoot < boot) ? -1 : 0;
+    }
+
+    bool any = false;
+    bool closed = false;
+    uint32_t firstMs = 0;
+    uint32_t lastMs = 0;
+    span.segment = segment;
+    span.start = 0;
+    span.end = dataEnd;
+    bool endFound = false;
+
+    uint8_t rec[12];
+    for (uint32_t i = 0; i < records && f.read(rec, 12) == 12; i++) {
+        uint32_t ms = getU32(rec);
+        uint32_t offset = getU32(rec + 4);
+
+        if (offset == IDX_CLOSE) {
+            closed = true;
+            lastMs = ms;
+            break;
+        }
+        if (isCommit(offset) || offset >= dataEnd) {
+            continue;
+        }
+        if (!any) {
+            firstMs = ms;
+            any = true;
+        }
+        lastMs = ms;
+
+        // Último ponto indexado em ou antes de fromMs: a leitura começa nele
+        if (ms <= fromMs) {
+            span.start = offset;
+        }
+        // Primeiro ponto depois de toMs: a leitura termina nele
+        if (ms > toMs && !endFound) {
+            span.end = offset;
+            endFound = true;
+        }
+    }
+    f.close();
+
+    if (!any) {
+        return 0;
+    }
+    if (closed && lastMs < fromMs) {
+        return -1;
+    }
+    if (firstMs > toMs) {
+        return 0;
+    }
+    // A 1ª linha não está antes de fromMs: inclui o cabeçalho do arquivo
+    if (firstMs >= fromMs) {
+        span.start = 0;
+    }
+    return 1;
+}
+
+size_t logFindRange(uint32_t boot, uint32_t fromMs, uint32_t toMs,
+                    LogSpan *spans, size_t maxSpans) {
+    uint32_t seg;
+    uint32_t lastBoot;
+    lastSegment(seg, lastBoot);
+
+    size_t count = 0;
+    for (uint32_t s = seg; s > 0 && count < maxSpans; s--) {
+        LogSpan span;
+        int r = findInSegment(s, boot, fromMs, toMs, span);
+        if (r < 0) {
+            break;
+        }
+        if (r > 0) {
+            spans[count++] = span;
+        }
+    }
+
+    // Do mais novo para o mais antigo -> ordem cronológica
+    for (size_t i = 0; i < count / 2; i++) {
+        LogSpan t = spans[i];
+        spans[i] = spans[count - 1 - i];
+        spans[count - 1 - i] = t;
+    }
+    return count;
+}
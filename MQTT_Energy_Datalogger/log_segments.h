@@ -0,0 +1,144 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOG SEGMENTS (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Rotação do log em segmentos (LOG_SEGMENTS = 1) e índice esparso de tempo
+por segmento, para ler um intervalo de tempo sem percorrer o cartão todo.
+
+Arquivos (em LOG_DIR):
+----------------------
+    seg_00001.csv (ou .bin)   dados, com cabeçalho/esquema próprio
+                              (LOG_COMPRESS: .csv.lz, em frames)
+    seg_00001.idx             índice do segmento
+    last                      último segmento aberto e boot (texto)
+    last.tmp                  novo conteúdo de last, antes de renomear
+
+- Um segmento novo a cada boot, e quando o atual passa de LOG_ROTATE_BYTES
+  ou de LOG_ROTATE_MS desde a primeira linha (0 = sem esse limite).
+- Numeração sequencial. LOG_DIR/last guarda "<segmento> <boot>" do
+  segmento aberto mais recente; no boot basta lê-lo, sem listar o
+  diretório. Segmentos antigos podem ser apagados (do mais antigo para o
+  mais novo) sem afetar a numeração.
+- last nunca é truncado no lugar: o texto vai para last.tmp, que é
+  renomeado por cima. Se a energia cai no meio, vale last.tmp (se
+  completo); sem nenhum dos dois legível, o diretório é listado e vale o
+  maior seg_* (boot lido do índice dele). Um número cujo arquivo de dados
+  ou índice já existe é pulado: um segmento nunca é reaberto (e o boot
+  passa do registrado no índice dele).
+
+Índice (.idx, inteiros de 32 bits little-endian, registros de 12 bytes):
+-------------------------------------------------------------------------
+    "MQIX" <versão> <boot> <segmento>                  cabeçalho (16 bytes)
+    <ms> <offset> <linha>                              a cada LOG_INDEX_EVERY linhas
+    <início> 0xFE000000|<tam> <crc32>                  commit de bloco
+    <último ms> 0xFFFFFFFF <linhas>                    fechamento (na rotação)
+
+- ms: millis() da linha (início da janela, com agregação); boot: contador
+  de boots, pois os tempos são relativos ao boot.
+- offset: byte do arquivo de dados onde a linha começa. No formato binário
+  cada ponto indexado começa com um registro de sessão, então a leitura
+  pode começar ali (com o esquema lido do início do arquivo).
+  Com LOG_COMPRESS, o byte do frame que começa com a linha (ver
+  csv_sink.h): offsets, commits e trechos são posições no arquivo
+  comprimido.
+- commit: gravado (e descarregado) ANTES de cada bloco do csv_sink ir
+  para o arquivo de dados. O fim dos dados válidos é o fim do bloco do
+  último commit; com LOG_PREALLOCATE o arquivo tem o tamanho final desde
+  a criação e o resto está zerado.
+
+Recuperação (queda de energia):
+-------------------------------
+No boot, o segmento anterior que não foi fechado é verificado a partir do
+fim: os commits são lidos de trás para frente e o CRC do bloco de cada um
+é conferido no arquivo de dados, até achar um bloco íntegro (no máximo
+LOG_RECOVER_MAX_BLOCKS blocos; os anteriores a eles são aceitos sem
+verificar). Se algum bloco foi descartado, seus bytes são zerados no
+arquivo de dados e um commit de tamanho zero marca o novo fim. O tempo de
+boot depende só desse limite, não do tamanho do segmento.
+
+Leitura:
+--------
+logFindRange() devolve, para cada segmento que cruza o intervalo, o trecho
+[start, end) de bytes a ler. O trecho pode conter algumas linhas fora do
+intervalo (granularidade de LOG_INDEX_EVERY linhas): o leitor filtra pelo
+timestamp.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+
+#include "config.h"
+
+#define LOG_SEG_PATH_SIZE  40
+
+struct LogSpan {
+    uint32_t segment;
+    uint32_t start;     // Primeiro byte a ler
+    uint32_t end;       // Fim (exclusivo)
+};
+
+class LogSegments {
+public:
+    LogSegments();
+
+    // Abre um segmento novo (boot seguinte ao registrado em LOG_DIR/last).
+    // false se o índice não pôde ser criado.
+    bool begin();
+
+    // Caminho do arquivo de dados do segmento atual (válido até a rotação).
+    const char *dataPath() const { return _dataPath; }
+    uint32_t segment() const { return _segment; }
+    uint32_t boot() const { return _boot; }
+    uint32_t rows() const { return _rows; }
+
+    // true se a próxima linha (em ms, arquivo com size bytes) deve ir para
+    // um segmento novo.
+    bool shouldRotate(uint32_t ms, uint32_t size) const;
+
+    // true se a próxima linha entra no índice (ponto de leitura).
+    bool indexDue() const { return (_rows % LOG_INDEX_EVERY) == 0; }
+
+    // Registra a linha que começa em offset.
+    void noteRow(uint32_t ms, uint32_t offset);
+
+    // Fecha o segmento atual (registro de fechamento) e abre o próximo.
+    bool rotate();
+
+    // Registra o bloco [offset, offset + len) antes de ele ser gravado
+    // (CsvSinkCommit).
+    void commit(uint32_t offset, const uint8_t *data, size_t len);
+
+    // Grava no SD o que estiver pendente no índice.
+    void flush();
+
+private:
+    bool openSegment();
+    void recover(uint32_t segment);
+    void closeIndex();
+    void putRecord(uint32_t a, uint32_t b, uint32_t c);
+
+    uint32_t _segment;
+    uint32_t _boot;
+    uint32_t _rows;
+    uint32_t _firstMs;
+    uint32_t _lastMs;
+    File     _index;
+    char     _dataPath[LOG_SEG_PATH_SIZE];
+};
+
+// Caminhos dos arquivos de um segmento.
+void logSegmentDataPath(uint32_t segment, char *buf, size_t cap);
+void logSegmentIndexPath(uint32_t segment, char *buf, size_t cap);
+
+// Fim dos dados válidos do segmento (último commit), 0 se não há índice.
+uint32_t logSegmentDataEnd(uint32_t segment);
+
+// Trechos dos segmentos do boot informado com linhas em [fromMs, toMs],
+// em ordem cronológica. Retorna quantos foram preenchidos (até maxSpans).
+size_t logFindRange(uint32_t boot, uint32_t fromMs, uint32_t toMs,
+                    LogSpan *spans, size_t maxSpans);
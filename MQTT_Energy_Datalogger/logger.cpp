@@ -9,22 +9,86 @@ Executar toda a lógica de registro dos dados em CSV:
 
 1. Inicialização (loggerInit):
    - Monta o SD.
-   - Detecta se o arquivo CSV já existe e possui conteúdo.
-   - Em caso afirmativo, assume que o cabeçalho já foi criado.
+   - Abre o arquivo CSV uma única vez (csv_sink) e o mantém aberto.
+   - Se o arquivo já possui conteúdo, assume que o cabeçalho já foi criado.
 
 2. Processamento de mensagens (processMessage):
-   - Tenta desserializar o payload como JSON.
-   - Usa o módulo json_flatten para extrair pares chave/valor.
+   - Interpreta o payload JSON: em uma passada (json_stream) ou via
+     documento do ArduinoJson + json_flatten, conforme JSON_PARSER_MODE.
+     O documento é um só, sobre a área do json_pool, reaproveitado a cada
+     mensagem.
    - Na primeira mensagem válida:
        - Gera o cabeçalho automático: "timestamp,client_id,topic,<chaves JSON>".
+       - Monta o ColumnMap (chave -> índice da coluna).
+   - Usa o módulo json_flatten para colocar cada valor direto na sua coluna.
+     Os valores seguem tipados (FlatValue) por agregação, deadband e
+     bin_log; só a linha CSV os converte em texto (printCell).
    - Para cada mensagem:
        - Gera timestamp relativo ao boot (T+hhmmss).
        - Grava uma linha com os valores alinhados ao cabeçalho.
 
+3. Descarregamento (loggerLoop / loggerFlush):
+   - As linhas ficam no buffer do csv_sink e vão para o SD em blocos,
+     por tamanho ou por idade (ver CSV_SINK_* em config.h).
+
+4. Agregação (AGG_WINDOW_MS > 0):
+   - As linhas passam pelo aggregator, que grava uma linha por janela e
+     tópico (samples + estatísticas por coluna) em vez de uma por mensagem.
+   - loggerLoop() grava as janelas vencidas; loggerFlush() também as
+     parciais.
+
+5. Formato binário (LOG_FORMAT == LOG_FORMAT_BINARY):
+   - Mesmo fluxo, mas cabeçalho e linhas são codificados por bin_log
+     em BIN_FILE_PATH.
+   - Após reboot, o esquema é lido de volta do arquivo, e as novas
+     linhas continuam alinhadas às colunas originais.
+
+6. Segmentos (LOG_SEGMENTS = 1):
+   - Um arquivo novo em LOG_DIR a cada boot (cabeçalho da 1ª mensagem
+     do boot) e na rotação por tamanho/tempo, que repete o cabeçalho.
+   - Cada linha é registrada no índice do segmento (log_segments); no
+     formato binário, cada ponto indexado abre uma sessão nova.
+   - Cada bloco do csv_sink tem commit com CRC no índice; no boot, o
+     segmento anterior é conferido a partir do fim (log_segments).
+   - Com LOG_PREALLOCATE, o arquivo é criado no tamanho final.
+
+7. Filtro de variação (DEADBAND_ENABLED = 1, sem agregação):
+   - Linhas em que nenhum campo mudou além da faixa da coluna
+     (COLUMN_DEADBAND) desde a última gravada do tópico são descartadas
+     pelo deadband, exceto a cada DEADBAND_HEARTBEAT_MS.
+
+8. Esquema esparso (LOG_SCHEMA = LOG_SCHEMA_SPARSE, só binário):
+   - Sem cabeçalho fixo: cada chave nova ganha uma coluna no column_dict
+     (persistido em COLUMN_DICT_PATH), declarada no arquivo na hora.
+   - Cada linha leva só os pares (coluna, valor) presentes.
+
+9. Partição (LOG_PARTITION, só CSV, sem segmentos):
+   - Cada tópico (ou client_id) em um CSV próprio em PARTITION_DIR, com o
+     cabeçalho no início e buffer próprio; os arquivos abertos ficam em
+     um cache LRU de PARTITION_OPEN_MAX (log_partitions).
+
+10. Compressão (LOG_COMPRESS = 1):
+   - Cada bloco do csv_sink (ou de uma partição) vai para o SD como um
+     frame de log_compress; o arquivo ganha LOG_COMPRESS_EXT.
+   - Com segmentos, cada linha indexada começa um frame.
+
+11. Saídas das linhas (row_fanout):
+   - Cada linha pronta para o log (depois da agregação e do deadband) vai
+     uma vez, por referência, ao log e às saídas extras ligadas em
+     ROW_SINK_*: Serial, republicação MQTT e cópia binária (row_sinks).
+   - Uma saída extra que falha ou demora fica suspensa por um tempo; o
+     log segue normalmente.
+
+12. Plano de extração:
+   - O achatamento só desce nas partes do JSON que levam a colunas do
+     cabeçalho (ColumnMap::wants).
+   - Com JSON_PARSER_DOM e JSON_PARSE_FILTER, o cabeçalho criado aqui
+     também gera o filtro do deserializeJson() (buildParseFilter).
+
 Observações:
 ------------
 - Focado em robustez: mensagens inválidas são ignoradas sem travar o sistema.
-- Arquivo: definido em config.h (CSV_FILE_PATH).
+- Arquivo: definido em config.h (CSV_FILE_PATH, BIN_FILE_PATH ou LOG_DIR).
 
 ================================================================================
 */
@@ -32,208 +96,886 @@ Observações:
 #include "logger.h"
 #include "config.h"
 #include "json_flatten.h"
+#include "json_stream.h"
+#include "json_pool.h"
+#include "csv_sink.h"
+#include "column_map.h"
+#include "column_dict.h"
+#include "bin_log.h"
+#include "aggregator.h"
+#include "deadband.h"
+#include "log_segments.h"
+#include "log_partitions.h"
+#include "row_fanout.h"
+#include "row_sinks.h"
+#include "metrics.h"
+#include "diag_log.h"
 
 #include <SD.h>
 #include <ArduinoJson.h>
+#include <string.h>
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+#define LOG_FORMAT_PATH BIN_FILE_PATH
+#else
+#define LOG_FORMAT_PATH CSV_FILE_PATH
+#endif
+
+#if LOG_COMPRESS
+#if LOG_FORMAT == LOG_FORMAT_BINARY && !LOG_SEGMENTS && LOG_SCHEMA != LOG_SCHEMA_SPARSE
+#error "LOG_COMPRESS com LOG_FORMAT_BINARY requer LOG_SEGMENTS ou LOG_SCHEMA_SPARSE"
+#endif
+#define LOG_FILE_PATH LOG_FORMAT_PATH LOG_COMPRESS_EXT
+#else
+#define LOG_FILE_PATH LOG_FORMAT_PATH
+#endif
+
+#if LOG_PARTITION != LOG_PARTITION_NONE
+#define LOG_PARTITIONED 1
+#if LOG_FORMAT != LOG_FORMAT_CSV || LOG_SEGMENTS
+#error "LOG_PARTITION requer LOG_FORMAT_CSV e LOG_SEGMENTS = 0"
+#endif
+// Um CSV por tópico/cliente, cada um com o seu buffer
+static LogPartitions partitions;
+#else
+#define LOG_PARTITIONED 0
+// Arquivo de log (CSV ou binário), em blocos
+static CsvSink csvSink;
+#endif
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+static BinLogWriter binLog;
+#endif
 
 static bool headerWritten = false;
 static String headerKeys[MAX_KEYS];
 static size_t headerCount = 0;
 
+// Mapa chave -> coluna, montado quando o cabeçalho é fixado
+static ColumnMap columnMap;
+
+// Mensagem corrente achatada (reutilizada, sem heap)
+static FlatArena flatArena;
+
+// Valores tipados da linha corrente, já no índice da coluna (strings na flatArena)
+static FlatValue rowSlots[MAX_KEYS];
+
+// Os mesmos valores na ordem do cabeçalho (colunas repetidas resolvidas)
+static FlatValue rowCells[MAX_KEYS];
+
+#if AGG_WINDOW_MS > 0
+static Aggregator aggregator;
+#endif
+
+#if DEADBAND_ENABLED && AGG_WINDOW_MS == 0
+#define LOG_DEADBAND 1
+static Deadband deadband;
+#else
+#define LOG_DEADBAND 0
+#endif
+
+#if LOG_SEGMENTS
+static LogSegments segments;
+#endif
+
+#if LOG_SCHEMA == LOG_SCHEMA_SPARSE
+#define LOG_SPARSE 1
+#if LOG_FORMAT != LOG_FORMAT_BINARY || AGG_WINDOW_MS > 0
+#error "LOG_SCHEMA_SPARSE requer LOG_FORMAT_BINARY e AGG_WINDOW_MS = 0"
+#endif
+// Colunas do esquema esparso (no lugar de headerKeys/columnMap)
+static ColumnDict columnDict;
+#else
+#define LOG_SPARSE 0
+#endif
+
+#if LOG_SPARSE && (ROW_SINK_SERIAL || ROW_SINK_MQTT || ROW_SINK_BINARY)
+#error "ROW_SINK_SERIAL / ROW_SINK_MQTT / ROW_SINK_BINARY não valem com LOG_SCHEMA_SPARSE"
+#endif
+#if ROW_SINK_BINARY && (LOG_FORMAT != LOG_FORMAT_CSV || LOG_COMPRESS)
+#error "ROW_SINK_BINARY requer LOG_FORMAT_CSV e LOG_COMPRESS = 0"
+#endif
+
+#if JSON_PARSER_MODE == JSON_PARSER_DOM && JSON_PARSE_FILTER && !LOG_SPARSE
+#define LOG_PARSE_FILTER 1
+// Caminhos das colunas na mensagem que criou o cabeçalho
+static DynamicJsonDocument parseFilter(JSON_FILTER_SIZE);
+static bool parseFilterReady = false;
+#else
+#define LOG_PARSE_FILTER 0
+#endif
+
+// Arquivo de log atual
+static const char *logPath() {
+#if LOG_SEGMENTS
+  return segments.dataPath();
+#elif LOG_PARTITIONED
+  return PARTITION_DIR;
+#else
+  return LOG_FILE_PATH;
+#endif
+}
+
+#if !LOG_PARTITIONED
+// Abre o arquivo de log atual no csvSink
+static bool openLogFile() {
+#if LOG_SEGMENTS && LOG_PREALLOCATE
+  return csvSink.beginPreallocated(logPath(), LOG_ROTATE_BYTES + CSV_SINK_BLOCK_MAX);
+#else
+  return csvSink.begin(logPath());
+#endif
+}
+#endif
+
+#if LOG_SEGMENTS
+// Cada bloco do csvSink é registrado no índice antes de ir para o SD
+static void commitBlock(void *, uint32_t offset, const uint8_t *data, size_t len) {
+  segments.commit(offset, data, len);
+}
+#endif
+
+#if LOG_FORMAT != LOG_FORMAT_BINARY || DIAG_LEVEL >= DIAG_LEVEL_TRACE
 // Timestamp simples relativo ao boot (T+hhmmss)
-static String getTimestamp() {
-  unsigned long ms = millis();
+static void getTimestamp(unsigned long ms, char *buf, size_t size) {
   unsigned long s = ms / 1000;
   unsigned long m = s / 60;
   unsigned long h = m / 60;
 
-  char buf[32];
-  sprintf(buf, "T+%02luh%02lum%02lus", h, m % 60, s % 60);
-  return String(buf);
+  snprintf(buf, size, "T+%02luh%02lum%02lus", h, m % 60, s % 60);
+}
+#endif
+
+// Colunas gravadas no arquivo e o nome de cada uma
+static size_t outputCount() {
+#if AGG_WINDOW_MS > 0
+  return aggregator.outputCount();
+#else
+  return headerCount;
+#endif
+}
+
+static size_t outputKey(size_t i, char *buf, size_t cap) {
+#if AGG_WINDOW_MS > 0
+  return aggregator.outputKey(i, headerKeys, buf, cap);
+#else
+  size_t n = headerKeys[i].length();
+  n = (n < cap) ? n : cap;
+  memcpy(buf, headerKeys[i].c_str(), n);
+  return n;
+#endif
+}
+
+#if LOG_SPARSE
+// Declara no arquivo as colunas do dicionário a partir de from
+static void declareColumns(size_t from) {
+  const String *keys = columnDict.keys();
+  for (size_t i = from; i < columnDict.count(); i++) {
+    binLog.writeColumn(i, keys[i].c_str(), keys[i].length());
+  }
+}
+#endif
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+// Linha descartada pelo csvSink (SD falhando): o leitor perdeu os deltas e
+// o dicionário da sessão, então a linha seguinte começa uma sessão nova
+static uint32_t binLogDropped;
+
+static void binLogResync() {
+  if (csvSink.stats().dropped == binLogDropped) {
+    return;
+  }
+  binLogDropped = csvSink.stats().dropped;
+  binLog.beginSession();
+#if LOG_SPARSE
+  declareColumns(0);
+#endif
+}
+#endif
+
+#if LOG_FORMAT != LOG_FORMAT_BINARY
+// Cabeçalho CSV: timestamp,client_id,topic,campos...
+static void printHeader(Print &out) {
+  size_t count = outputCount();
+  char key[FLAT_PATH_SIZE + 8];
+
+  out.print("timestamp,client_id,topic");
+  for (size_t i = 0; i < count; i++) {
+    out.print(",");
+    out.write(key, outputKey(i, key, sizeof(key)));
+  }
+  out.println();
+}
+#endif
+
+#if LOG_PARTITIONED
+// Arquivo de partição novo
+static void partitionHeader(void *, Print &out) {
+  printHeader(out);
+}
+#endif
+
+// Cabeçalho (CSV) ou esquema (binário) no início do arquivo atual.
+// Com agregação, as colunas do arquivo são as de outputKey().
+static void writeHeader() {
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+  size_t count = outputCount();
+  char key[FLAT_PATH_SIZE + 8];
+
+  // Esquema binário + início da primeira sessão (com segmentos, a sessão
+  // é aberta pela 1ª linha, que é ponto do índice)
+  binLog.begin(csvSink);
+  binLog.writeSchema(count);
+  for (size_t i = 0; i < count; i++) {
+    binLog.writeSchemaKey(key, outputKey(i, key, sizeof(key)));
+  }
+#if LOG_SPARSE
+  // Esquema vazio (headerCount = 0); as colunas vêm em registros próprios
+  declareColumns(0);
+#endif
+#if !LOG_SEGMENTS
+  binLog.beginSession();
+#endif
+#elif LOG_PARTITIONED
+  // Cada partição recebe o cabeçalho quando o arquivo é criado
+#else
+  csvSink.beginRow();
+  printHeader(csvSink);
+  csvSink.endRow();
+#endif
+}
+
+#if LOG_SEGMENTS
+// Rotaciona se preciso e registra a linha que vai começar no índice
+static void noteSegmentRow(unsigned long ms) {
+  if (segments.shouldRotate(ms, csvSink.size())) {
+    csvSink.end();
+    segments.rotate();
+    openLogFile();
+    writeHeader();
+  }
+
+#if LOG_COMPRESS
+  // Ponto de leitura: a linha começa um frame, que se descomprime sozinho
+  if (segments.indexDue()) {
+    csvSink.flush();
+  }
+#endif
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+  // Ponto de leitura: começa em uma sessão, que zera os deltas
+  if (segments.indexDue()) {
+    segments.noteRow(ms, csvSink.size());
+    binLog.beginSession();
+    return;
+  }
+#endif
+  segments.noteRow(ms, csvSink.size());
+}
+#endif
+
+#if LOG_FORMAT != LOG_FORMAT_BINARY
+// Texto de uma célula direto no buffer; strings sem cópia
+static void printCell(Print &out, const char *text, const FlatValue &v) {
+  if (v.type == FLAT_TEXT) {
+    out.write(text + v.text.off, v.text.len);
+    return;
+  }
+  char buf[352];    // Maior texto de formatDecimal() (fallback "%.*f")
+  int n = flatFormat(v, text, buf, sizeof(buf));
+  if (n > 0) {
+    out.write(buf, n);
+  }
+}
+
+// Linha CSV: timestamp,client_id,topic,...
+static void printRow(Print &out, unsigned long ms, const char *client_id, const char *topic,
+                     const char *text, const FlatValue *cells, size_t count) {
+  char ts[32];
+  getTimestamp(ms, ts, sizeof(ts));
+
+  out.print(ts);
+  out.print(",");
+  out.print(client_id);
+  out.print(",");
+  out.print(topic);
+  for (size_t i = 0; i < count; i++) {
+    out.print(",");
+    printCell(out, text, cells[i]);
+  }
+  out.println();
+}
+#endif
+
+// Grava uma linha no log (CSV ou binário). false se não há onde gravá-la.
+static bool writeLogFile(const LogRow &row) {
+#if LOG_SEGMENTS
+  noteSegmentRow(row.ms);
+#endif
+
+#if LOG_PARTITIONED
+  // Buffer da partição (o arquivo só é acessado quando ele descarrega)
+  Print *out = partitions.sinkFor(LOG_PARTITION == LOG_PARTITION_CLIENT ? row.clientId : row.topic);
+  if (!out) {
+    DIAG_WARN("Partição sem arquivo, linha descartada: %s", row.topic);
+    return false;
+  }
+#else
+  CsvSink *out = &csvSink;
+#endif
+
+  uint32_t t = metricsStart();
+#if !LOG_PARTITIONED
+  csvSink.beginRow();
+#endif
+#if LOG_FORMAT == LOG_FORMAT_BINARY
+  binLogResync();
+  binLog.writeRow(row.ms, row.clientId, row.topic, row.text, row.cells, row.count);
+#else
+  printRow(*out, row.ms, row.clientId, row.topic, row.text, row.cells, row.count);
+#endif
+#if !LOG_PARTITIONED
+  csvSink.endRow();
+#endif
+  metricsRecord(METRIC_FORMAT, t);
+  metricsCount(METRIC_ROWS);
+#if LOG_PARTITIONED
+  partitions.poll();
+#else
+  out->poll();
+#endif
+  return true;
+}
+
+// O log no SD, primeira saída do fan-out (nunca suspensa)
+class LogFileSink : public RowSink {
+public:
+  const char *name() const override { return "log"; }
+
+  bool write(const LogRow &row) override {
+    return writeLogFile(row);
+  }
+
+  void poll() override {
+#if LOG_PARTITIONED
+    partitions.poll();
+#else
+    csvSink.poll();
+#endif
+  }
+
+  void flush() override {
+#if LOG_PARTITIONED
+    partitions.flush();
+#else
+    csvSink.flush();
+#endif
+#if LOG_SEGMENTS
+    segments.flush();
+#endif
+  }
+};
+
+static LogFileSink logFileSink;
+#if ROW_SINK_SERIAL
+static SerialRowSink serialSink;
+#endif
+#if ROW_SINK_MQTT
+static MqttRowSink mqttSink;
+#endif
+#if ROW_SINK_BINARY
+static BinaryRowSink binarySink(BIN_FILE_PATH);
+#endif
+static RowFanout rowFanout;
+
+// Entrega uma linha, com as células já na ordem do cabeçalho, ao log e às
+// saídas extras (ROW_SINK_*). text: buffer das strings das células.
+static void writeLogRow(unsigned long ms, const char *client_id, const char *topic,
+                        const char *text, const FlatValue *cells, size_t count) {
+  LogRow row = { ms, client_id, topic, text, cells, count, outputKey };
+  rowFanout.write(row);
+}
+
+#if LOG_SPARSE
+// Grava uma linha esparsa: values[k] na coluna columns[k]
+static void writeSparseLogRow(unsigned long ms, const char *client_id, const char *topic,
+                              const char *text, const FlatValue *values,
+                              const uint16_t *columns, size_t count) {
+#if LOG_SEGMENTS
+  noteSegmentRow(ms);
+#endif
+
+  uint32_t t = metricsStart();
+  csvSink.beginRow();
+  binLogResync();
+  binLog.writeSparseRow(ms, client_id, topic, text, values, columns, count);
+  csvSink.endRow();
+  metricsRecord(METRIC_FORMAT, t);
+  metricsCount(METRIC_ROWS);
+  csvSink.poll();
+}
+#endif
+
+#if AGG_WINDOW_MS > 0
+static void writeAggregatedRow(void *, uint32_t windowStart,
+                               const char *client_id, const char *topic,
+                               const char *text, const FlatValue *cells, size_t count) {
+  DIAG_DEBUG("Janela agregada gravada: %s", topic);
+  writeLogRow(windowStart, client_id, topic, text, cells, count);
+}
+#endif
+
+// Fixa as colunas de entrada a partir de headerKeys
+static void buildColumns() {
+  columnMap.build(headerKeys, headerCount);
+#if AGG_WINDOW_MS > 0
+  aggregator.begin(columnMap, writeAggregatedRow, nullptr);
+#endif
+#if LOG_DEADBAND
+  deadband.begin(headerKeys, headerCount);
+#endif
+}
+
+#if LOG_FORMAT == LOG_FORMAT_BINARY && !LOG_SPARSE
+// Recupera headerKeys do esquema de um arquivo existente. Com agregação, as
+// chaves do arquivo são "samples" + estatísticas: vale a chave original.
+static bool restoreSchemaKey(void *, size_t i, const char *key, size_t len) {
+#if AGG_WINDOW_MS > 0
+  int col = Aggregator::inputOf(i, key, len);
+  if (col == -1) {
+    return true;
+  }
+  if (col < 0 || (size_t)col >= MAX_KEYS) {
+    return false;
+  }
+  i = (size_t)col;
+#else
+  if (i >= MAX_KEYS) {
+    return false;
+  }
+#endif
+  char buf[FLAT_PATH_SIZE];
+  memcpy(buf, key, len);
+  buf[len] = '\0';
+  headerKeys[i] = buf;
+  headerCount = i + 1;
+  return true;
 }
+#endif
 
 void loggerInit() {
-  Serial.println();
-  Serial.println("==== loggerInit() ====");
-  Serial.print("Inicializando SD...");
+  DIAG_INFO("==== loggerInit() ====");
+  DIAG_INFO("Inicializando SD...");
 
   if (!SD.begin(SD_CS_PIN)) {
-    Serial.println("Falha SD. Verifique fiação / CS / formatação.");
+    DIAG_ERROR("Falha SD. Verifique fiação / CS / formatação.");
     while (true) {
       delay(1000);
     }
   }
-  Serial.println("SD OK.");
-
-  Serial.print("Verificando existência do arquivo CSV: ");
-  Serial.println(CSV_FILE_PATH);
-
-  // Se arquivo já existe e tem conteúdo, assumimos cabeçalho já escrito
-  if (SD.exists(CSV_FILE_PATH)) {
-    File f = SD.open(CSV_FILE_PATH, FILE_READ);
-    if (f) {
-      uint32_t size = f.size();
-      Serial.print("Arquivo encontrado. Tamanho: ");
-      Serial.print(size);
-      Serial.println(" bytes.");
-
-      if (size > 0) {
-        headerWritten = true;
-        Serial.println("Cabeçalho presumido como já existente.");
-      } else {
-        Serial.println("Arquivo existe, mas está vazio. Cabeçalho será criado na primeira mensagem válida.");
+  DIAG_INFO("SD OK.");
+
+  // Saídas das linhas: o log primeiro, depois as extras isoladas
+  rowFanout.add(&logFileSink, false);
+#if ROW_SINK_SERIAL
+  rowFanout.add(&serialSink, true);
+#endif
+#if ROW_SINK_MQTT
+  rowFanout.add(&mqttSink, true);
+#endif
+#if ROW_SINK_BINARY
+  rowFanout.add(&binarySink, true);
+#endif
+  if (rowFanout.count() > 1) {
+    DIAG_INFO("Saídas extras das linhas: %u.", (unsigned)(rowFanout.count() - 1));
+  }
+
+#if LOG_SEGMENTS
+  // Segmento novo a cada boot; o cabeçalho vem da 1ª mensagem
+  if (!segments.begin()) {
+    DIAG_ERROR("Falha ao criar o índice do segmento. Log segue sem índice.");
+  }
+  csvSink.setCommit(commitBlock, nullptr);
+  DIAG_INFO("Boot: %lu", (unsigned long)segments.boot());
+#endif
+
+#if LOG_SPARSE
+  // As colunas vêm do dicionário, não do esquema do arquivo
+  DIAG_INFO("Dicionário de colunas: %u chaves.", (unsigned)columnDict.load(COLUMN_DICT_PATH));
+#if LOG_DEADBAND
+  deadband.begin(columnDict.keys(), columnDict.count());
+#endif
+#elif LOG_FORMAT == LOG_FORMAT_BINARY
+  // Recupera o esquema antes de abrir o arquivo para append
+  File existing = SD.open(logPath(), FILE_READ);
+  if (existing) {
+    if (binLogReadSchema(existing, restoreSchemaKey, nullptr) == 0) {
+      headerCount = 0;
+    }
+    existing.close();
+    if (headerCount > 0) {
+      DIAG_INFO("Esquema binário recuperado: %u campos.", (unsigned)headerCount);
+    }
+  }
+#endif
+
+#if LOG_PARTITIONED
+  // Arquivos abertos sob demanda; as colunas vêm da 1ª mensagem do boot e
+  // cada arquivo novo recebe o cabeçalho
+  if (!partitions.begin(partitionHeader, nullptr)) {
+    DIAG_ERROR("Não foi possível criar %s. Nova tentativa a cada linha.", PARTITION_DIR);
+  }
+  DIAG_INFO("Log por %s em %s (até %u arquivos abertos).",
+            (LOG_PARTITION == LOG_PARTITION_CLIENT) ? "client_id" : "tópico",
+            logPath(), (unsigned)PARTITION_OPEN_MAX);
+#else
+  DIAG_INFO("Abrindo arquivo de log (append): %s", logPath());
+
+  // O arquivo permanece aberto; se já tem conteúdo, assumimos cabeçalho escrito
+  if (openLogFile()) {
+    uint32_t size = csvSink.size();
+    DIAG_INFO("Arquivo aberto. Tamanho: %lu bytes.", (unsigned long)size);
+
+    if (size > 0) {
+      headerWritten = true;
+#if LOG_SPARSE
+      // Nova sessão; as colunas são redeclaradas (o arquivo pode ter sido
+      // criado com outro dicionário)
+      binLog.begin(csvSink);
+      binLog.beginSession();
+      declareColumns(0);
+#else
+      buildColumns();
+      DIAG_INFO("Cabeçalho presumido como já existente.");
+#endif
+#if LOG_FORMAT == LOG_FORMAT_BINARY && !LOG_SPARSE
+      if (headerCount == 0) {
+        DIAG_WARN("Aviso: esquema binário inválido; linhas sem colunas.");
       }
-      f.close();
+      binLog.begin(csvSink);
+      binLog.beginSession();
+#endif
     } else {
-      Serial.println("Arquivo existe, mas não foi possível abrir para leitura.");
+      DIAG_INFO("Arquivo vazio. Cabeçalho será criado na primeira mensagem válida.");
     }
   } else {
-    Serial.println("Arquivo CSV ainda não existe. Será criado na primeira mensagem válida.");
+    DIAG_ERROR("Não foi possível abrir o CSV. Nova tentativa na primeira gravação.");
   }
+#endif
 
-  Serial.println("==== Fim loggerInit() ====");
+  DIAG_INFO("==== Fim loggerInit() ====");
 }
 
+void loggerLoop() {
+#if AGG_WINDOW_MS > 0
+  aggregator.poll(millis());
+#endif
+  rowFanout.poll();
+}
 
-void processMessage(const String &client_id,
-                    const String &topic,
-                    const String &payload) {
-  Serial.println();
-  Serial.println("========== processMessage() ==========");
+void loggerFlush() {
+#if AGG_WINDOW_MS > 0
+  aggregator.flushAll();
+#endif
+  rowFanout.flush();
+}
 
-  Serial.print("client_id: ");
-  Serial.println(client_id);
-  Serial.print("topic: ");
-  Serial.println(topic);
-  Serial.print("payload bruto: ");
-  Serial.println(payload);
+#if ROW_SINK_MQTT
+bool loggerRepublishPop(char *topic, char *payload, size_t &len) {
+  return mqttSink.pop(topic, payload, len);
+}
+#endif
 
-  // Tenta interpretar JSON
-  DynamicJsonDocument doc(JSON_BUFFER_SIZE);
-DeserializationError err = deserializeJson(doc, payload);
-if (err) {
-    Serial.print("JSON inválido, ignorando para CSV: ");
-    Serial.println(err.c_str());
-    Serial.println("======================================");
-    return;
+
+// -----------------------------------------------------------------------------
+// Achatamento conforme JSON_PARSER_MODE. Retorno < 0 = JSON inválido.
+// -----------------------------------------------------------------------------
+#if JSON_PARSER_MODE == JSON_PARSER_STREAM
+// Visão do payload (aponta para o slot da fila, sem cópia)
+struct JsonText {
+  const char *json;
+  size_t len;
+};
+typedef const JsonText &JsonInput;
+
+static int flattenAll(JsonInput in) {
+  return streamFlattenToArena(in.json, in.len, flatArena);
+}
+
+static int flattenRow(JsonInput in) {
+  return streamFlattenToColumns(in.json, in.len, columnMap, flatArena, rowSlots);
+}
+#else
+typedef JsonVariantConst JsonInput;
+
+static int flattenAll(JsonInput in) {
+  return (int)flattenToArena(in, flatArena);
+}
+
+static int flattenRow(JsonInput in) {
+  return (int)flattenToColumns(in, columnMap, flatArena, rowSlots);
+}
+#endif
+
+static void printInvalidJson(int code) {
+  metricsCount(METRIC_JSON_ERRORS);
+  DIAG_WARN("JSON inválido, ignorando para CSV: %s", jsonStreamErrorStr(code));
 }
 
-  Serial.println("JSON desserializado com sucesso.");
+// Cria o cabeçalho a partir da 1ª mensagem válida (já achatada em flatArena)
+// e monta o mapa de colunas. Retorna false se o JSON não gerou nenhum campo.
+static bool createHeader() {
+  if (flatArena.count == 0) {
+    return false;
+  }
+
+  headerCount = flatArena.count;
+
+  DIAG_INFO("Criando cabeçalho CSV com %u campos:", (unsigned)headerCount);
+
+  for (size_t i = 0; i < headerCount; i++) {
+    char key[FLAT_PATH_SIZE];
+    FlatSlice k = flatArena.keys[i];
+    memcpy(key, flatText(flatArena, k), k.len);
+    key[k.len] = '\0';
+    headerKeys[i] = key;
+    DIAG_INFO("  [%u] %s", (unsigned)i, key);
+  }
+  buildColumns();
+  writeHeader();
+
+  headerWritten = true;
+  DIAG_INFO("Cabeçalho CSV criado com sucesso.");
+  return true;
+}
+
+#if DISCOVERY_MODE
+// Modo descoberta: imprime a estrutura achatada sem gravar no SD
+static void printDiscovery(JsonInput input) {
+  int localCount = flattenAll(input);
+  if (localCount < 0) {
+    printInvalidJson(localCount);
+    return;
+  }
+
+  DIAG_REPORT("Total de campos extraídos do JSON: %d", localCount);
+
+  if (localCount == 0) {
+    DIAG_REPORT("Nenhum campo extraído do JSON. Nada será gravado.");
+    DIAG_REPORT("======================================");
+    return;
+  }
 
-  // Achata JSON em arrays locais
-  String keysLocal[MAX_KEYS];
-  String valuesLocal[MAX_KEYS];
-  size_t localCount = 0;
+  DIAG_REPORT("=== MODO DE DESCOBERTA ATIVO (DISCOVERY_MODE = 1) ===");
+  DIAG_REPORT("Estrutura detectada do JSON (chave = exemplo de valor):");
 
-  flattenToArrays(doc.as<JsonVariantConst>(), "", keysLocal, valuesLocal, localCount, MAX_KEYS);
+  for (size_t i = 0; i < flatArena.count; i++) {
+    FlatSlice k = flatArena.keys[i];
+    char v[64];
+    int n = flatFormat(flatArena.values[i], flatArena.text, v, sizeof(v));
+    DIAG_REPORT("  - %.*s = %.*s", (int)k.len, flatText(flatArena, k),
+                (n > 0) ? n : 0, v);
+  }
 
-  Serial.print("Total de campos extraídos do JSON: ");
-  Serial.println(localCount);
+  DIAG_REPORT("Nenhum dado foi gravado no SD.");
+  DIAG_REPORT("Para habilitar o log em CSV, ajuste DISCOVERY_MODE para 0 em config.h.");
+  DIAG_REPORT("======================================");
+}
+#endif
 
+#if LOG_SPARSE
+// Esquema esparso: coluna de cada campo pelo dicionário (que cresce com
+// as chaves novas) e linha só com os campos presentes
+static void processSparse(const char *client_id, const char *topic, JsonInput input) {
+  uint32_t tf = metricsStart();
+  int localCount = flattenAll(input);
+  metricsRecord(METRIC_FLATTEN, tf);
+  if (localCount < 0) {
+    printInvalidJson(localCount);
+    return;
+  }
   if (localCount == 0) {
-    Serial.println("Nenhum campo extraído do JSON. Nada será gravado.");
-    Serial.println("======================================");
+    DIAG_WARN("Nenhum campo extraído do JSON. Nada será gravado.");
+    return;
+  }
+  if (flatArena.overflow) {
+    DIAG_WARN("Aviso: campos descartados (FLAT_ARENA_SIZE / FLAT_PATH_SIZE / MAX_KEYS excedido).");
+  }
+
+  size_t before = columnDict.count();
+  const uint16_t *columns = columnDict.resolve(topic, flatArena);
+  if (columnDict.count() > before) {
+    DIAG_INFO("Colunas novas (%s): %u, total %u.", topic,
+              (unsigned)(columnDict.count() - before), (unsigned)columnDict.count());
+    if (!columnDict.save(COLUMN_DICT_PATH, before)) {
+      DIAG_ERROR("Falha ao gravar %s.", COLUMN_DICT_PATH);
+    }
+    if (headerWritten) {
+      declareColumns(before);
+    }
+#if LOG_DEADBAND
+    deadband.begin(columnDict.keys(), columnDict.count());
+#endif
+  }
+
+  static bool fullWarned = false;
+  if (columnDict.stats().dropped > 0 && !fullWarned) {
+    DIAG_WARN("Dicionário de colunas cheio (MAX_KEYS): chaves novas descartadas.");
+    fullWarned = true;
+  }
+
+  if (!headerWritten) {
+    writeHeader();
+    headerWritten = true;
+  }
+
+  unsigned long ms = millis();
+  const FlatValue *values = flatArena.values;
+
+#if LOG_DEADBAND
+  // O deadband trabalha por coluna: espalha, filtra e recolhe
+  flatClear(rowCells, columnDict.count());
+  for (size_t k = 0; k < flatArena.count; k++) {
+    if (columns[k] != COLUMN_DROPPED) {
+      rowCells[columns[k]] = flatArena.values[k];
+    }
+  }
+  if (!deadband.filter(ms, topic, flatArena.text, rowCells)) {
+    metricsCount(METRIC_UNCHANGED);
+    DIAG_DEBUG("Linha sem mudança (deadband): %s", topic);
     return;
   }
+  for (size_t k = 0; k < flatArena.count; k++) {
+    rowSlots[k] = (columns[k] != COLUMN_DROPPED) ? rowCells[columns[k]] : flatArena.values[k];
+  }
+  values = rowSlots;
+#endif
+
+  writeSparseLogRow(ms, client_id, topic, flatArena.text, values, columns, flatArena.count);
+  DIAG_DEBUG("Linha registrada no log: %s", logPath());
+}
+#endif
+
+void processMessage(const char *client_id,
+                    const char *topic,
+                    const char *payload,
+                    size_t length) {
+  DIAG_DEBUG("processMessage(): client_id = %s, topic = %s, %u bytes",
+             client_id, topic, (unsigned)length);
+  DIAG_TRACE("payload bruto: %.*s", (int)length, payload);
+
+  // Tenta interpretar JSON
+#if JSON_PARSER_MODE == JSON_PARSER_STREAM
+  // Sem DOM: o texto é validado durante o próprio achatamento
+  JsonText input = { payload, length };
+#else
+  // Criado na 1ª mensagem e mantido: o bloco fica no json_pool, fora do heap
+  static PooledJsonDocument doc(JSON_BUFFER_SIZE);
+  uint32_t t = metricsStart();
+#if LOG_PARSE_FILTER
+  DeserializationError err = parseFilterReady
+      ? deserializeJson(doc, payload, length, DeserializationOption::Filter(parseFilter))
+      : deserializeJson(doc, payload, length);
+#else
+  DeserializationError err = deserializeJson(doc, payload, length);
+#endif
+  metricsRecord(METRIC_PARSE, t);
+  jsonPoolNoteUsage(doc.memoryUsage());
+  if (err) {
+    metricsCount(METRIC_JSON_ERRORS);
+    DIAG_WARN("JSON inválido, ignorando para CSV: %s", err.c_str());
+    return;
+  }
+
+  DIAG_TRACE("JSON desserializado com sucesso.");
+  JsonInput input = doc.as<JsonVariantConst>();
+#endif
 
   // ============================================================
   // MODO DESCOBERTA: só imprime estrutura e NÃO grava no SD
   // ============================================================
 #if DISCOVERY_MODE
-  Serial.println();
-  Serial.println("=== MODO DE DESCOBERTA ATIVO (DISCOVERY_MODE = 1) ===");
-  Serial.println("Estrutura detectada do JSON (chave = exemplo de valor):");
-
-  for (size_t i = 0; i < localCount; i++) {
-    Serial.print("  - ");
-    Serial.print(keysLocal[i]);
-    Serial.print(" = ");
-    Serial.println(valuesLocal[i]);
-  }
-
-  Serial.println("Nenhum dado foi gravado no SD.");
-  Serial.println("Para habilitar o log em CSV, ajuste DISCOVERY_MODE para 0 em config.h.");
-  Serial.println("======================================");
+  printDiscovery(input);
   return;
 #endif
 
-  String ts = getTimestamp();
-  Serial.print("Timestamp gerado: ");
-  Serial.println(ts);
-
+#if LOG_SPARSE
+  processSparse(client_id, topic, input);
+  return;
+#endif
 
   // Cria cabeçalho na 1ª mensagem válida, se ainda não existir
   if (!headerWritten) {
-    headerCount = (localCount > MAX_KEYS) ? MAX_KEYS : localCount;
-
-    Serial.print("Criando cabeçalho CSV com ");
-    Serial.print(headerCount);
-    Serial.println(" campos:");
-
-    for (size_t i = 0; i < headerCount; i++) {
-      headerKeys[i] = keysLocal[i];
-      Serial.print("  [");
-      Serial.print(i);
-      Serial.print("] ");
-      Serial.println(headerKeys[i]);
+    int n = flattenAll(input);
+    if (n < 0) {
+      printInvalidJson(n);
+      return;
     }
-
-    File f = SD.open(CSV_FILE_PATH, FILE_WRITE);
-    if (!f) {
-      Serial.print("Erro ao abrir CSV para cabeçalho: ");
-      Serial.println(CSV_FILE_PATH);
-      Serial.println("======================================");
+    if (!createHeader()) {
+      DIAG_WARN("Nenhum campo extraído do JSON. Nada será gravado.");
       return;
     }
-
-    // Cabeçalho: timestamp,client_id,topic,campos...
-    f.print("timestamp,client_id,topic");
-    for (size_t i = 0; i < headerCount; i++) {
-      f.print(",");
-      f.print(headerKeys[i]);
+#if LOG_PARSE_FILTER
+    parseFilterReady = buildParseFilter(input, columnMap, flatArena, parseFilter);
+    if (!parseFilterReady) {
+      DIAG_WARN("Filtro do JSON não coube em JSON_FILTER_SIZE; parse sem filtro.");
     }
-    f.println();
-    f.close();
+#endif
+  }
 
-    headerWritten = true;
-    Serial.println("Cabeçalho CSV criado com sucesso.");
+  // Achata JSON direto nas colunas do cabeçalho
+  uint32_t tf = metricsStart();
+  int localCount = flattenRow(input);
+  metricsRecord(METRIC_FLATTEN, tf);
+  if (localCount < 0) {
+    printInvalidJson(localCount);
+    return;
   }
 
-  // Abre arquivo para append da linha
-  File f = SD.open(CSV_FILE_PATH, FILE_WRITE);
-  if (!f) {
-    Serial.print("Erro ao abrir CSV para escrita: ");
-    Serial.println(CSV_FILE_PATH);
-    Serial.println("======================================");
+  DIAG_DEBUG("Total de campos extraídos do JSON: %d", localCount);
+
+  if (localCount == 0) {
+    DIAG_WARN("Nenhum campo extraído do JSON. Nada será gravado.");
     return;
   }
 
-  Serial.print("Gravando linha no CSV: ");
-  Serial.println(CSV_FILE_PATH);
+  if (flatArena.overflow) {
+    DIAG_WARN("Aviso: campos descartados (FLAT_ARENA_SIZE / FLAT_PATH_SIZE / MAX_KEYS excedido).");
+  }
 
-  // timestamp,client_id,topic,...
-  f.print(ts);
-  f.print(",");
-  f.print(client_id);
-  f.print(",");
-  f.print(topic);
+  unsigned long ms = millis();
+#if DIAG_LEVEL >= DIAG_LEVEL_TRACE
+  char ts[32];
+  getTimestamp(ms, ts, sizeof(ts));
+  DIAG_TRACE("Timestamp gerado: %s", ts);
+#endif
 
   // Colunas em ordem fixa do cabeçalho
   for (size_t i = 0; i < headerCount; i++) {
-    f.print(",");
-    String v = findValueForKey(headerKeys[i], keysLocal, valuesLocal, localCount);
-    f.print(v);
+    rowCells[i] = rowSlots[columnMap.canonical(i)];
 
-    Serial.print("  Campo '");
-    Serial.print(headerKeys[i]);
-    Serial.print("' = '");
-    Serial.print(v);
-    Serial.println("'");
+#if DIAG_LEVEL >= DIAG_LEVEL_TRACE
+    char v[64];
+    int n = flatFormat(rowCells[i], flatArena.text, v, sizeof(v));
+    DIAG_TRACE("  Campo '%s' = '%.*s'", headerKeys[i].c_str(), (n > 0) ? n : 0, v);
+#endif
   }
 
-  f.println();
-  f.close();
+#if AGG_WINDOW_MS > 0
+  // Acumula na janela do tópico; a linha sai quando a janela fecha
+  aggregator.add(ms, client_id, topic, flatArena.text, rowCells);
+  DIAG_DEBUG("Mensagem acumulada na janela de agregação.");
+  return;
+#endif
+
+#if LOG_DEADBAND
+  // Nenhum campo mudou além da faixa: a linha não vai para o log
+  if (!deadband.filter(ms, topic, flatArena.text, rowCells)) {
+    metricsCount(METRIC_UNCHANGED);
+    DIAG_DEBUG("Linha sem mudança (deadband): %s", topic);
+    return;
+  }
+#endif
 
-  Serial.println("Linha registrada no CSV com sucesso.");
-  Serial.println("======================================");
+  // Linha vai para o buffer do csvSink; o SD só é acessado no flush
+  writeLogRow(ms, client_id, topic, flatArena.text, rowCells, headerCount);
+  DIAG_DEBUG("Linha registrada no log: %s", logPath());
 }
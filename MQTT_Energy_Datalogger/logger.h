@@ -18,19 +18,46 @@ Funções:
     gera o cabeçalho (na primeira mensagem válida) e grava linhas no CSV com:
         timestamp_relativo, client_id, topic, colunas de dados.
 
+- loggerLoop():
+    Chamado periodicamente pela task de logging (logger_task); descarrega
+    no SD as linhas pendentes há mais de CSV_SINK_FLUSH_MS.
+
+- loggerFlush():
+    Força a gravação de tudo o que está no buffer (ex.: antes de desligar).
+
+- loggerRepublishPop() (ROW_SINK_MQTT):
+    Linhas limpas a republicar no broker, lidas pelo loop() do Arduino.
+
 ================================================================================
 */
 #pragma once
 #include <Arduino.h>
 
+#include "config.h"
+
 // Inicializa SD e estado do logger.
 // Não recria cabeçalho se o arquivo já existir.
 void loggerInit();
 
+// Descarrega o buffer por idade. Chamar no mesmo contexto de processMessage().
+void loggerLoop();
+
+// Grava imediatamente no SD todas as linhas pendentes.
+void loggerFlush();
+
 // Processa uma mensagem recebida do broker:
-// - payload JSON
+// - payload JSON (visão: ponteiro + tamanho, sem cópia; não precisa de '\0')
 // - gera/corrige cabeçalho (na 1ª mensagem)
 // - grava linha: timestamp, client_id, topic, colunas
-void processMessage(const String &client_id,
-                    const String &topic,
-                    const String &payload);
+void processMessage(const char *client_id,
+                    const char *topic,
+                    const char *payload,
+                    size_t length);
+
+#if ROW_SINK_MQTT
+// Próxima linha a republicar (consumidor único, outro contexto que o de
+// processMessage()): tópico com ROW_SINK_MQTT_PREFIX, terminado em '\0'
+// (ROW_SINK_MQTT_TOPIC_MAX + 1 bytes), e payload JSON com len bytes
+// (ROW_SINK_MQTT_PAYLOAD_MAX bytes). false se não há nenhuma.
+bool loggerRepublishPop(char *topic, char *payload, size_t &len);
+#endif
@@ -0,0 +1,241 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOGGER TASK (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa:
+-----------
+- A fila global (MsgQueue) entre o callback MQTT e a task de logging, com
+  a classe de cada tópico (INGEST_CRITICAL_TOPICS / INGEST_LATEST_TOPICS).
+- A task consumidora:
+    - espera uma notificação do produtor (ou LOGGER_TASK_IDLE_MS);
+    - esvazia a fila chamando processMessage() para cada mensagem;
+    - chama loggerLoop() (flush do CSV por idade) ao esvaziar a fila e,
+      sob carga contínua, a cada LOGGER_TASK_LOOP_EVERY mensagens ou
+      LOGGER_TASK_LOOP_MS;
+    - loggerFlush() quando pedido (loggerTaskRequestFlush()).
+- Plataforma:
+    - ESP32: xTaskCreatePinnedToCore + notificações de task.
+    - Linux: std::thread + condition_variable.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include "logger_task.h"
+#include "logger.h"
+#include "config.h"
+#include "topic_filter.h"
+#include "diag_log.h"
+
+static MsgQueue msgQueue;
+static TopicFilter criticalTopics;
+static TopicFilter latestTopics;
+static QueuedMsg current;                 // Cópia de trabalho do consumidor
+static std::atomic<bool> flushRequested(false);
+
+// -----------------------------------------------------------------------------
+// Espera/notificação do consumidor
+// -----------------------------------------------------------------------------
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+
+static TaskHandle_t loggerTaskHandle = nullptr;
+
+static void consumerWait(uint32_t ms) {
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(ms));
+}
+
+static void consumerWake() {
+    if (loggerTaskHandle) {
+        xTaskNotifyGive(loggerTaskHandle);
+    }
+}
+#else
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+static std::mutex wakeMutex;
+static std::condition_variable wakeCond;
+static bool wakePending = false;
+
+static void consumerWait(uint32_t ms) {
+    std::unique_lock<std::mutex> lock(wakeMutex);
+    wakeCond.wait_for(lock, std::chrono::milliseconds(ms), [] { return wakePending; });
+    wakePending = false;
+}
+
+static void consumerWake() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        wakePending = true;
+    }
+    wakeCond.notify_one();
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Task de logging
+// -----------------------------------------------------------------------------
+// Flush pedido por loggerTaskRequestFlush() ou, sem pedido, o de idade
+static void loggerTaskService() {
+    if (flushRequested.exchange(false)) {
+        loggerFlush();
+    } else {
+        loggerLoop();
+    }
+}
+
+static void loggerTaskBody() {
+    while (true) {
+        consumerWait(LOGGER_TASK_IDLE_MS);
+
+        // Com a fila sempre cheia o laço não termina: serviço a cada
+        // LOGGER_TASK_LOOP_EVERY mensagens ou LOGGER_TASK_LOOP_MS
+        uint32_t count = 0;
+        unsigned long last = millis();
+        while (msgQueue.pop(current)) {
+            processMessage("esp32_logger", current.topic,
+                           current.payload, current.payloadLen);
+            if (++count >= LOGGER_TASK_LOOP_EVERY || millis() - last >= LOGGER_TASK_LOOP_MS) {
+                loggerTaskService();
+                count = 0;
+                last = millis();
+            }
+        }
+
+        loggerTaskService();
+    }
+}
+
+#if defined(ESP32)
+static void loggerTaskEntry(void *) {
+    loggerTaskBody();
+}
+#endif
+
+void loggerTaskStart() {
+    DIAG_INFO("==== loggerTaskStart() ====");
+
+    // Sem regras o filtro aceita tudo: a classe só vale com regras
+    criticalTopics.compile(INGEST_CRITICAL_TOPICS);
+    latestTopics.compile(INGEST_LATEST_TOPICS);
+    if (criticalTopics.ruleCount() > 0) {
+        msgQueue.setCriticalReserve(INGEST_CRITICAL_RESERVE);
+    }
+    DIAG_INFO("Tópicos críticos: %u regra(s), latest wins: %u regra(s).",
+              (unsigned)criticalTopics.ruleCount(), (unsigned)latestTopics.ruleCount());
+
+#if defined(ESP32)
+    BaseType_t ok = xTaskCreatePinnedToCore(loggerTaskEntry, "logger",
+                                            LOGGER_TASK_STACK, nullptr,
+                                            LOGGER_TASK_PRIORITY,
+                                            &loggerTaskHandle, LOGGER_TASK_CORE);
+    if (ok != pdPASS) {
+        DIAG_ERROR("Falha ao criar a task de logging.");
+        while (true) {
+            delay(1000);
+        }
+    }
+    DIAG_INFO("Task de logging criada no núcleo %d", LOGGER_TASK_CORE);
+#else
+    std::thread(loggerTaskBody).detach();
+    DIAG_INFO("Task de logging criada (std::thread).");
+#endif
+
+    DIAG_INFO("Fila: %d mensagens de até %d bytes.", MSG_QUEUE_SLOTS, MSG_PAYLOAD_MAX);
+    DIAG_INFO("===========================");
+}
+
+static MsgClass classify(const char *topic) {
+    if (criticalTopics.ruleCount() > 0 && criticalTopics.accepts(topic)) {
+        return MSG_CRITICAL;
+    }
+    if (latestTopics.ruleCount() > 0 && latestTopics.accepts(topic)) {
+        return MSG_LATEST;
+    }
+    return MSG_NORMAL;
+}
+
+bool loggerEnqueue(const char *topic, const uint8_t *payload, size_t length) {
+    bool ok = msgQueue.push(topic, strlen(topic), payload, length, classify(topic));
+    if (ok) {
+        consumerWake();
+    }
+    return ok;
+}
+
+void loggerTaskRequestFlush() {
+    flushRequested.store(true);
+    consumerWake();
+}
+
+MsgQueueStats loggerQueueStats() {
+    return msgQueue.stats();
+}
+
+// Acrescenta texto em buf; false (e nada escrito além de cap) se não coube
+static bool append(char *buf, size_t cap, size_t &len, const char *fmt, ...)
+    __attribute__((format(printf, 4, 5)));
+
+static bool append(char *buf, size_t cap, size_t &len, const char *fmt, ...) {
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + len, cap - len, fmt, ap);
+    va_end(ap);
+    if (n < 0 || (size_t)n >= cap - len) {
+        return false;
+    }
+    len += n;
+    return true;
+}
+
+// Acrescenta s como string JSON (escapes como os do LineBuf de row_sinks.cpp)
+static bool appendJsonString(char *buf, size_t cap, size_t &len, const char *s) {
+    bool ok = append(buf, cap, len, "\"");
+    for (; ok && *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') {
+            ok = append(buf, cap, len, "\\%c", c);
+        } else if (c < 0x20) {
+            ok = append(buf, cap, len, "\\u%04x", (unsigned)c);
+        } else {
+            ok = append(buf, cap, len, "%c", c);
+        }
+    }
+    return ok && append(buf, cap, len, "\"");
+}
+
+size_t loggerQueueSnapshot(char *buf, size_t cap) {
+    MsgQueueStats st = msgQueue.stats();
+    size_t len = 0;
+    bool ok = append(buf, cap, len,
+                     "{\"pushed\":%lu,\"dropped\":%lu,\"coalesced\":%lu,\"oversize\":%lu,"
+                     "\"blocked\":%lu,\"depth\":%lu,\"high\":%lu,\"topics\":[",
+                     (unsigned long)st.pushed, (unsigned long)st.dropped,
+                     (unsigned long)st.coalesced, (unsigned long)st.oversize,
+                     (unsigned long)st.blocked, (unsigned long)st.depth,
+                     (unsigned long)st.highWater);
+
+    // Entrada final (topic = nullptr): demais tópicos, sob "*"
+    size_t count = msgQueue.topicStatsCount();
+    for (size_t i = 0; ok && i <= count; i++) {
+        MsgTopicStats t = msgQueue.topicStats(i);
+        if (!t.topic && t.dropped == 0 && t.coalesced == 0) {
+            continue;
+        }
+        // O tópico vem do broker: pode ter aspas, barras e controles
+        ok = append(buf, cap, len, "%s{\"t\":", i ? "," : "") &&
+             appendJsonString(buf, cap, len, t.topic ? t.topic : "*") &&
+             append(buf, cap, len, ",\"drop\":%lu,\"coal\":%lu}",
+                    (unsigned long)t.dropped, (unsigned long)t.coalesced);
+    }
+    ok = ok && append(buf, cap, len, "]}");
+    return ok ? len : 0;
+}
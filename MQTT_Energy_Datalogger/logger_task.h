@@ -0,0 +1,45 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOGGER TASK (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Desacoplar a recepção MQTT da gravação no SD:
+
+- loggerEnqueue(): chamado no callback MQTT; só copia tópico/payload para a
+  MsgQueue e retorna. Nunca toca no SD nem no parser JSON.
+- loggerTaskStart(): cria a task de logging (na ESP32, fixada em
+  LOGGER_TASK_CORE, o núcleo oposto ao loop() do Arduino). A task consome a
+  fila, chama processMessage() e faz o descarregamento por idade do CSV.
+
+Em Linux a mesma task roda em uma std::thread, o que permite medir a vazão
+da fila e do pipeline fora da placa.
+
+Depois de loggerTaskStart(), loggerLoop()/loggerFlush() pertencem à task;
+use loggerTaskRequestFlush() a partir de outros contextos.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "msg_queue.h"
+
+// Cria a task consumidora. Chamar depois de loggerInit().
+void loggerTaskStart();
+
+// Produtor: enfileira uma mensagem. false se descartada (ver MsgQueueStats).
+bool loggerEnqueue(const char *topic, const uint8_t *payload, size_t length);
+
+// Pede à task que grave no SD tudo o que está pendente (broker_handler
+// chama ao receber LOGGER_FLUSH_TOPIC).
+void loggerTaskRequestFlush();
+
+// Contadores da fila (profundidade, descartes, etc.).
+MsgQueueStats loggerQueueStats();
+
+// Contadores da fila e por tópico em JSON (mesmo contexto do produtor):
+//   {"pushed":n,...,"high":n,"topics":[{"t":"<tópico>","drop":n,"coal":n},...]}
+// Retorna o tamanho, ou 0 se não coube em cap.
+size_t loggerQueueSnapshot(char *buf, size_t cap);
@@ -9,10 +9,12 @@ Função principal do sistema. Realiza a sequência de inicialização dos módu
 
 1. setupAccessPoint()  → Cria o Access Point da ESP32 (rede MQTT_Energy_LOGGER).
 2. loggerInit()        → Inicializa o cartão SD e o arquivo CSV.
+   loggerTaskStart()   → Cria a task de logging, que consome a fila de
+                         mensagens e grava no SD.
 3. brokerInit()        → Inicia o broker MQTT embarcado (EmbeddedMqttBroker) 
                          e o cliente interno de logging (PubSubClient).
-4. loop()              → Mantém o cliente interno conectado e processando 
-                         mensagens recebidas para registro no CSV.
+4. loop()              → Mantém o cliente interno conectado; o callback apenas
+                         enfileira as mensagens para a task de logging.
 
 Fluxo de execução:
 ------------------
@@ -28,17 +30,21 @@ Fluxo de execução:
 #include <WiFi.h>
 #include "wifi_ap.h"
 #include "logger.h"
+#include "logger_task.h"
 #include "broker_handler.h"
+#include "diag_log.h"
 
 static unsigned long lastPrint = 0;  // controle do print de estações conectadas
 
 void setup() {
     Serial.begin(115200);
+    diagInit();          // Mensagens de diagnóstico via buffer + task
     delay(500);
 
     setupAccessPoint();  // Cria o AP e mostra IP do broker
     delay(500);
     loggerInit();        // Inicializa SD / CSV
+    loggerTaskStart();   // Task de logging (consome a fila de mensagens)
     delay(500);
     brokerInit();        // Sobe o broker MQTT interno + cliente logger
     delay(500);
@@ -50,9 +56,7 @@ void loop() {
 
     unsigned long now = millis();
     if (now - lastPrint > 5000) {  // a cada 5 segundos
-        int n = WiFi.softAPgetStationNum();
-        Serial.print("Estações conectadas ao AP: ");
-        Serial.println(n);
+        DIAG_DEBUG("Estações conectadas ao AP: %d", WiFi.softAPgetStationNum());
         lastPrint = now;
     }
 }
@@ -0,0 +1,155 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - METRICS (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa os histogramas e contadores de metrics.h e o snapshot:
+
+    {"up":<ms>,"msgs":n,"bytes":n,"filtered":n,"drops":n,"json_err":n,
+     "rows":n,"unchanged":n,"lost":n,"heap":n,"heap_min":n,"heap_block":n,
+     "heap_frag":n,
+     "json_peak":n,"json_fail":n,                  (JSON_PARSER_DOM)
+     "recv":{"n":n,"sum_us":n,"max_us":n,"h":[16 buckets]},
+     "parse":{...},"flatten":{...},"format":{...},"sd":{...}}
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "metrics.h"
+#include "json_pool.h"
+#include "num_format.h"
+
+#if METRICS_ENABLED
+
+struct MetricHistogram {
+    uint32_t count;
+    uint32_t sumUs;
+    uint32_t maxUs;
+    uint32_t buckets[METRIC_BUCKETS];
+};
+
+static MetricHistogram histograms[METRIC_STAGES];
+static uint32_t counters[METRIC_COUNTERS];
+
+static const char *const stageNames[METRIC_STAGES] = {
+    "recv", "parse", "flatten", "format", "sd", "lz"
+};
+
+static const char *const counterNames[METRIC_COUNTERS] = {
+    "msgs", "bytes", "filtered", "drops", "json_err", "rows",
+    "unchanged", "lost"
+};
+
+void metricsRecord(MetricStage stage, uint32_t startUs) {
+    uint32_t us = micros() - startUs;
+    MetricHistogram &h = histograms[stage];
+
+    // Bucket = número de bits de us (0 -> 0, 1 -> 1, 2..3 -> 2, ...)
+    unsigned b = us ? 32 - __builtin_clz(us) : 0;
+    if (b >= METRIC_BUCKETS) {
+        b = METRIC_BUCKETS - 1;
+    }
+    h.buckets[b]++;
+    h.count++;
+    h.sumUs += us;
+    if (us > h.maxUs) {
+        h.maxUs = us;
+    }
+}
+
+void metricsCount(MetricCounter counter, uint32_t n) {
+    counters[counter] += n;
+}
+
+// -----------------------------------------------------------------------------
+// Snapshot
+// -----------------------------------------------------------------------------
+struct SnapshotOut {
+    char  *buf;
+    size_t cap;
+    size_t len;
+    bool   overflow;
+};
+
+static void put(SnapshotOut &o, const char *s) {
+    size_t n = strlen(s);
+    if (o.len + n >= o.cap) {
+        o.overflow = true;
+        return;
+    }
+    memcpy(o.buf + o.len, s, n);
+    o.len += n;
+}
+
+static void putNum(SnapshotOut &o, uint32_t v) {
+    char num[16];
+    int n = formatInteger((long long)v, num, sizeof(num));
+    if (n < 0 || o.len + (size_t)n >= o.cap) {
+        o.overflow = true;
+        return;
+    }
+    memcpy(o.buf + o.len, num, n);
+    o.len += n;
+}
+
+static void putField(SnapshotOut &o, const char *name, uint32_t v) {
+    put(o, "\"");
+    put(o, name);
+    put(o, "\":");
+    putNum(o, v);
+    put(o, ",");
+}
+
+size_t metricsSnapshot(char *buf, size_t cap) {
+    SnapshotOut o = { buf, cap, 0, false };
+
+    put(o, "{");
+    putField(o, "up", millis());
+    for (int c = 0; c < METRIC_COUNTERS; c++) {
+        putField(o, counterNames[c], counters[c]);
+    }
+#if defined(ESP32)
+    putField(o, "heap", ESP.getFreeHeap());
+    putField(o, "heap_min", ESP.getMinFreeHeap());
+
+    // Fragmentação: quanto do heap livre não está no maior bloco (%)
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t block = ESP.getMaxAllocHeap();
+    putField(o, "heap_block", block);
+    putField(o, "heap_frag", freeHeap ? 100 - (uint32_t)((uint64_t)block * 100 / freeHeap) : 0);
+#endif
+#if JSON_PARSER_MODE == JSON_PARSER_DOM
+    JsonPoolStats pool = jsonPoolStats();
+    putField(o, "json_peak", pool.peak);
+    putField(o, "json_fail", pool.failures);
+#endif
+
+    for (int s = 0; s < METRIC_STAGES; s++) {
+        const MetricHistogram &h = histograms[s];
+        put(o, "\"");
+        put(o, stageNames[s]);
+        put(o, "\":{");
+        putField(o, "n", h.count);
+        putField(o, "sum_us", h.sumUs);
+        putField(o, "max_us", h.maxUs);
+        put(o, "\"h\":[");
+        for (int b = 0; b < METRIC_BUCKETS; b++) {
+            if (b > 0) {
+                put(o, ",");
+            }
+            putNum(o, h.buckets[b]);
+        }
+        put(o, (s + 1 < METRIC_STAGES) ? "]}," : "]}");
+    }
+    put(o, "}");
+
+    if (o.overflow) {
+        return 0;
+    }
+    buf[o.len] = '\0';
+    return o.len;
+}
+
+#endif
@@ -0,0 +1,97 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - METRICS (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Instrumentação de baixo custo do pipeline, publicada periodicamente em um
+tópico do broker local (METRICS_TOPIC, no estilo $SYS):
+
+- Histograma de latência por etapa, com buckets fixos em potências de 2
+  de microssegundos (bucket 0: < 1 µs; bucket i: [2^(i-1), 2^i) µs;
+  o último acumula tudo acima).
+- Contadores de mensagens, bytes, descartes, erros de JSON etc.
+- Heap livre atual e mínima desde o boot (low-water), maior bloco livre e
+  fragmentação (% do livre fora do maior bloco), na ESP32.
+- No modo DOM, maior ocupação do documento JSON e falhas do json_pool.
+
+Etapas:
+-------
+    METRIC_RECEIVE   callback MQTT: filtro de tópico + cópia para a fila
+    METRIC_PARSE     deserializeJson (JSON_PARSER_DOM)
+    METRIC_FLATTEN   achatamento nas colunas (no modo stream, a validação
+                     do JSON acontece aqui, na mesma passada)
+    METRIC_FORMAT    montagem da linha (CSV ou binário) no buffer; inclui a
+                     gravação quando a linha enche o buffer do csv_sink
+    METRIC_SD_WRITE  gravação de um bloco do csv_sink no SD (write + flush)
+    METRIC_COMPRESS  compressão de um bloco em frame (LOG_COMPRESS), antes
+                     da gravação
+
+Uso:
+----
+    uint32_t t = metricsStart();
+    ... etapa ...
+    metricsRecord(METRIC_PARSE, t);
+
+Custo: uma leitura de micros() em cada ponta e alguns incrementos. Cada
+etapa/contador tem um único escritor (callback MQTT ou task de logging),
+então não há lock; o snapshot lê os valores sem parar o pipeline e pode
+misturar contagens de mensagens consecutivas. Os valores são acumulados
+desde o boot: quem consome calcula as taxas pela diferença.
+
+Com METRICS_ENABLED = 0 todas as funções viram vazias.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+
+enum MetricStage {
+    METRIC_RECEIVE,
+    METRIC_PARSE,
+    METRIC_FLATTEN,
+    METRIC_FORMAT,
+    METRIC_SD_WRITE,
+    METRIC_COMPRESS,
+    METRIC_STAGES
+};
+
+enum MetricCounter {
+    METRIC_MESSAGES,       // Recebidas no callback
+    METRIC_BYTES,          // Bytes de payload recebidos
+    METRIC_FILTERED,       // Ignoradas por TOPIC_FILTER
+    METRIC_DROPS,          // Não couberam na fila
+    METRIC_JSON_ERRORS,    // JSON inválido
+    METRIC_ROWS,           // Linhas gravadas no log
+    METRIC_UNCHANGED,      // Linhas descartadas pelo deadband
+    METRIC_LOST,           // Linhas descartadas com o SD falhando (csv_sink)
+    METRIC_COUNTERS
+};
+
+#define METRIC_BUCKETS  16
+
+#if METRICS_ENABLED
+
+inline uint32_t metricsStart() {
+    return micros();
+}
+
+// Registra a duração da etapa iniciada em metricsStart().
+void metricsRecord(MetricStage stage, uint32_t startUs);
+
+void metricsCount(MetricCounter counter, uint32_t n = 1);
+
+// Snapshot em JSON compacto. Retorna o tamanho (0 se não coube em cap).
+size_t metricsSnapshot(char *buf, size_t cap);
+
+#else
+
+inline uint32_t metricsStart() { return 0; }
+inline void metricsRecord(MetricStage, uint32_t) {}
+inline void metricsCount(MetricCounter, uint32_t = 1) {}
+inline size_t metricsSnapshot(char *, size_t) { return 0; }
+
+#endif
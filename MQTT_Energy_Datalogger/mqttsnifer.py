@@ -1,14 +1,37 @@
+import struct
+import sys
+import time
+
 import paho.mqtt.client as mqtt
 
 BROKER = "192.168.4.1"
 PORT   = 1883
 
+# Uso:
+#   python mqttsnifer.py                         -> só imprime
+#   python mqttsnifer.py --capture dia.mqcap     -> imprime e grava a captura
+#                                                   (reenviar com tools/replay)
+# Formato: "MQCP" + versão 1, depois por mensagem (little-endian):
+#   ms desde o início (u32), tam. tópico (u16), tam. payload (u32), tópico, payload
+capture = None
+if len(sys.argv) == 3 and sys.argv[1] == "--capture":
+    capture = open(sys.argv[2], "wb")
+    capture.write(b"MQCP\x01")
+t0 = time.monotonic()
+
 def on_connect(client, userdata, flags, rc):
     print("Conectado ao broker, rc =", rc)
     client.subscribe("#")  # assina tudo
 
 def on_message(client, userdata, msg):
     print(f"[{msg.topic}] {msg.payload.decode(errors='ignore')[:200]}")
+    if capture and not msg.topic.startswith("$"):
+        topic = msg.topic.encode()
+        ms = int((time.monotonic() - t0) * 1000) & 0xFFFFFFFF
+        capture.write(struct.pack("<IHI", ms, len(topic), len(msg.payload)))
+        capture.write(topic)
+        capture.write(msg.payload)
+        capture.flush()
 
 client = mqtt.Client(client_id="pc_sniffer")
 client.on_connect = on_connect
@@ -0,0 +1,244 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - MSG QUEUE (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa a fila SPSC descrita em msg_queue.h. Compila tanto na ESP32
+(FreeRTOS) quanto em Linux; a única dependência de plataforma é a espera do
+produtor na política INGEST_BLOCK.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "msg_queue.h"
+
+#if defined(ESP32)
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+static inline void producerWait() { vTaskDelay(1); }
+static inline void consumerWait() { taskYIELD(); }
+#else
+#include <thread>
+static inline void producerWait() { std::this_thread::yield(); }
+static inline void consumerWait() { std::this_thread::yield(); }
+#endif
+
+// Flag "ocupada" de cada posição (_busy)
+#define SLOT_IDLE  0
+#define SLOT_BUSY  1
+
+MsgQueue::MsgQueue()
+    : _reserve(0), _head(0), _tail(0),
+      _pushed(0), _popped(0), _dropped(0), _coalesced(0), _oversize(0), _blocked(0),
+      _highWater(0), _topicCount(0) {
+    for (size_t i = 0; i < MSG_QUEUE_SLOTS; i++) {
+        _busy[i].store(SLOT_IDLE, std::memory_order_relaxed);
+    }
+    _otherTopics.topic[0] = '\0';
+    _otherTopics.dropped = 0;
+    _otherTopics.coalesced = 0;
+}
+
+MsgQueue::TopicCount &MsgQueue::countFor(const char *topic, size_t topicLen) {
+    for (size_t i = 0; i < _topicCount; i++) {
+        if (strncmp(_topics[i].topic, topic, topicLen) == 0 && _topics[i].topic[topicLen] == '\0') {
+            return _topics[i];
+        }
+    }
+    if (_topicCount == INGEST_TOPIC_STATS) {
+        return _otherTopics;
+    }
+    TopicCount &t = _topics[_topicCount++];
+    memcpy(t.topic, topic, topicLen);
+    t.topic[topicLen] = '\0';
+    t.dropped = 0;
+    t.coalesced = 0;
+    return t;
+}
+
+MsgTopicStats MsgQueue::topicStats(size_t i) const {
+    const TopicCount &t = (i < _topicCount) ? _topics[i] : _otherTopics;
+    MsgTopicStats st = { (i < _topicCount) ? t.topic : nullptr, t.dropped, t.coalesced };
+    return st;
+}
+
+// Descarta a entrada em tail, se não for crítica. Se o consumidor a levou
+// antes, tail já andou (e o chamador reavalia a ocupação). A entrada só é
+// reescrita pelo próprio produtor, então continua legível após o CAS; o
+// consumidor ainda pode estar copiando-a (ver push()).
+bool MsgQueue::dropOldest(uint32_t &tail) {
+    const QueuedMsg &oldest = _slots[tail % MSG_QUEUE_SLOTS];
+    if (oldest.cls == MSG_CRITICAL) {
+        return false;
+    }
+    if (_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_acq_rel)) {
+        _dropped.fetch_add(1, std::memory_order_relaxed);
+        countFor(oldest.topic, oldest.topicLen).dropped++;
+        tail++;
+    }
+    return true;
+}
+
+// Substitui o payload da entrada mais recente do mesmo tópico, da mais
+// nova até a em tail (com o flag, o consumidor não está copiando).
+bool MsgQueue::coalesce(const char *topic, size_t topicLen,
+                        const uint8_t *payload, size_t payloadLen) {
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+
+    for (uint32_t pos = head - 1; (int32_t)(pos - tail) >= 0; pos--) {
+        QueuedMsg &slot = _slots[pos % MSG_QUEUE_SLOTS];
+        if (slot.topicLen != topicLen || memcmp(slot.topic, topic, topicLen) != 0) {
+            continue;
+        }
+
+        uint8_t idle = SLOT_IDLE;
+        if (!_busy[pos % MSG_QUEUE_SLOTS].compare_exchange_strong(idle, SLOT_BUSY,
+                                                                   std::memory_order_acquire)) {
+            return false;
+        }
+        // O consumidor só solta o flag depois de avançar tail
+        bool queued = (int32_t)(pos - _tail.load(std::memory_order_acquire)) >= 0;
+        if (queued) {
+            memcpy(slot.payload, payload, payloadLen);
+            slot.payload[payloadLen] = '\0';
+            slot.payloadLen = (uint16_t)payloadLen;
+        }
+        _busy[pos % MSG_QUEUE_SLOTS].store(SLOT_IDLE, std::memory_order_release);
+
+        if (queued) {
+            _coalesced.fetch_add(1, std::memory_order_relaxed);
+            countFor(topic, topicLen).coalesced++;
+        }
+        return queued;
+    }
+    return false;
+}
+
+bool MsgQueue::push(const char *topic, size_t topicLen,
+                    const uint8_t *payload, size_t payloadLen, MsgClass cls) {
+    if (topicLen > MSG_TOPIC_MAX || payloadLen > MSG_PAYLOAD_MAX) {
+        _oversize.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Posições de reserva: só para mensagens críticas
+    uint32_t limit = (cls == MSG_CRITICAL) ? MSG_QUEUE_SLOTS : MSG_QUEUE_SLOTS - _reserve;
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+
+    while (head - tail >= limit) {
+        if (cls == MSG_LATEST && coalesce(topic, topicLen, payload, payloadLen)) {
+            return true;
+        }
+
+#if INGEST_OVERFLOW_POLICY == INGEST_DROP_OLDEST
+        // Descarta a mais antiga, se não for crítica
+        if (dropOldest(tail)) {
+            continue;
+        }
+#endif
+#if INGEST_OVERFLOW_POLICY != INGEST_BLOCK
+        if (cls != MSG_CRITICAL) {
+            _dropped.fetch_add(1, std::memory_order_relaxed);
+            countFor(topic, topicLen).dropped++;
+            return false;
+        }
+#endif
+        // INGEST_BLOCK, ou mensagem crítica sem posição livre: espera
+        _blocked.fetch_add(1, std::memory_order_relaxed);
+        producerWait();
+        tail = _tail.load(std::memory_order_acquire);
+    }
+
+#if INGEST_OVERFLOW_POLICY == INGEST_DROP_OLDEST
+    // A posição pode ser a que acabou de ser descartada, com o consumidor
+    // ainda copiando a entrada antiga: espera o flag
+    std::atomic<uint8_t> &busy = _busy[head % MSG_QUEUE_SLOTS];
+    uint8_t idle = SLOT_IDLE;
+    while (!busy.compare_exchange_weak(idle, SLOT_BUSY, std::memory_order_acquire)) {
+        idle = SLOT_IDLE;
+        producerWait();
+    }
+#endif
+    QueuedMsg &slot = _slots[head % MSG_QUEUE_SLOTS];
+    slot.cls = cls;
+    memcpy(slot.topic, topic, topicLen);
+    slot.topic[topicLen] = '\0';
+    slot.topicLen = (uint16_t)topicLen;
+    memcpy(slot.payload, payload, payloadLen);
+    slot.payload[payloadLen] = '\0';
+    slot.payloadLen = (uint16_t)payloadLen;
+#if INGEST_OVERFLOW_POLICY == INGEST_DROP_OLDEST
+    busy.store(SLOT_IDLE, std::memory_order_release);
+#endif
+
+    _head.store(head + 1, std::memory_order_release);
+    _pushed.fetch_add(1, std::memory_order_relaxed);
+
+    // Ocupação agora (o consumidor pode ter andado desde a leitura de tail)
+    uint32_t d = head + 1 - _tail.load(std::memory_order_acquire);
+    if (d > _highWater.load(std::memory_order_relaxed)) {
+        _highWater.store(d, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+bool MsgQueue::pop(QueuedMsg &out) {
+    uint32_t tail = _tail.load(std::memory_order_acquire);
+
+    while (true) {
+        uint32_t head = _head.load(std::memory_order_acquire);
+        if (tail == head) {
+            return false;
+        }
+
+        // Espera o produtor terminar uma substituição nesta posição
+        std::atomic<uint8_t> &busy = _busy[tail % MSG_QUEUE_SLOTS];
+        uint8_t idle = SLOT_IDLE;
+        if (!busy.compare_exchange_weak(idle, SLOT_BUSY, std::memory_order_acquire)) {
+            consumerWait();
+            tail = _tail.load(std::memory_order_acquire);
+            continue;
+        }
+
+        // Com o flag, nem uma substituição nem (DROP_OLDEST) a reescrita
+        // da posição descartada mexem na entrada durante a cópia
+        const QueuedMsg &slot = _slots[tail % MSG_QUEUE_SLOTS];
+        out.cls = slot.cls;
+        out.topicLen = slot.topicLen;
+        out.payloadLen = slot.payloadLen;
+        memcpy(out.topic, slot.topic, out.topicLen);
+        out.topic[out.topicLen] = '\0';
+        memcpy(out.payload, slot.payload, out.payloadLen);
+        out.payload[out.payloadLen] = '\0';
+
+        // Só vale se a entrada não foi descartada durante a cópia
+        bool ok = _tail.compare_exchange_strong(tail, tail + 1, std::memory_order_acq_rel);
+        busy.store(SLOT_IDLE, std::memory_order_release);
+        if (ok) {
+            _popped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        // CAS falhou: tail foi atualizado com o valor atual; tenta de novo
+    }
+}
+
+uint32_t MsgQueue::depth() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+MsgQueueStats MsgQueue::stats() const {
+    MsgQueueStats s;
+    s.pushed    = _pushed.load(std::memory_order_relaxed);
+    s.popped    = _popped.load(std::memory_order_relaxed);
+    s.dropped   = _dropped.load(std::memory_order_relaxed);
+    s.coalesced = _coalesced.load(std::memory_order_relaxed);
+    s.oversize  = _oversize.load(std::memory_order_relaxed);
+    s.blocked   = _blocked.load(std::memory_order_relaxed);
+    s.depth     = depth();
+    s.highWater = _highWater.load(std::memory_order_relaxed);
+    return s;
+}
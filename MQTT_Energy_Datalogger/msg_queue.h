@@ -0,0 +1,139 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - MSG QUEUE (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Fila circular limitada, sem locks, de um produtor e um consumidor (SPSC),
+entre o callback MQTT (produtor) e a task de logging (consumidor).
+
+Detalhes:
+---------
+- MSG_QUEUE_SLOTS entradas de tamanho fixo (tópico + payload copiados).
+- head/tail são contadores monotônicos de 32 bits (índice = contador % N).
+- Política de estouro (INGEST_OVERFLOW_POLICY em config.h):
+    - INGEST_DROP_NEWEST: a mensagem nova é descartada.
+    - INGEST_DROP_OLDEST: o produtor avança tail e descarta a mais antiga.
+    - INGEST_BLOCK:       o produtor espera até abrir espaço.
+- Para permitir DROP_OLDEST sem lock, o consumidor copia a entrada e só então
+  a libera com compare-and-swap em tail; se o produtor a descartou nesse
+  meio-tempo, a cópia é ignorada e o consumidor tenta a próxima. A posição
+  descartada só é reescrita com o flag "ocupada" (abaixo), que o
+  consumidor segura durante a cópia.
+
+Classes de mensagem (MsgClass, escolhida pelo produtor por tópico):
+-------------------------------------------------------------------
+- MSG_CRITICAL: nunca descartada. As últimas posições
+  (setCriticalReserve, INGEST_CRITICAL_RESERVE quando há tópicos
+  críticos) são só dela; com a fila toda cheia o produtor espera (ou, em
+  DROP_OLDEST, descarta a mais antiga se ela não for crítica).
+- MSG_LATEST: com a fila cheia, substitui a entrada mais recente do mesmo
+  tópico ainda na fila ("latest wins"); só sem uma, vale a política.
+- MSG_NORMAL: política de estouro. DROP_OLDEST nunca descarta uma
+  entrada crítica: nesse caso a nova é que é descartada.
+- Substituição sem lock: cada posição tem um flag "ocupada", tomado com
+  CAS pelo consumidor durante a cópia (e até avançar tail) e pelo produtor
+  durante a substituição. Depois de tomar o flag o produtor confere se a
+  entrada continua na fila (inclusive a em tail, que o consumidor pode
+  ter acabado de liberar).
+
+Contadores por tópico:
+----------------------
+Descartes e substituições dos primeiros INGEST_TOPIC_STATS tópicos que
+os tiveram (os demais somam em "outros"). Escritos só pelo produtor e
+lidos no mesmo contexto (loop() do Arduino).
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+#include "config.h"
+
+enum MsgClass : uint8_t {
+    MSG_NORMAL,
+    MSG_LATEST,         // Com a fila cheia, substitui a do mesmo tópico
+    MSG_CRITICAL        // Nunca descartada
+};
+
+struct QueuedMsg {
+    MsgClass cls;
+    uint16_t topicLen;
+    uint16_t payloadLen;
+    char     topic[MSG_TOPIC_MAX + 1];      // Terminado em '\0'
+    char     payload[MSG_PAYLOAD_MAX + 1];  // Terminado em '\0'
+};
+
+struct MsgQueueStats {
+    uint32_t pushed;       // Mensagens aceitas
+    uint32_t popped;       // Mensagens entregues ao consumidor
+    uint32_t dropped;      // Descartadas pela política de estouro
+    uint32_t coalesced;    // Substituídas por uma mais nova do mesmo tópico
+    uint32_t oversize;     // Tópico/payload maior que o slot
+    uint32_t blocked;      // Vezes em que o produtor esperou (INGEST_BLOCK)
+    uint32_t depth;        // Ocupação atual
+    uint32_t highWater;    // Maior ocupação observada
+};
+
+struct MsgTopicStats {
+    const char *topic;     // nullptr = tópicos fora da tabela
+    uint32_t dropped;
+    uint32_t coalesced;
+};
+
+class MsgQueue {
+public:
+    MsgQueue();
+
+    // Posições finais reservadas a MSG_CRITICAL (padrão 0). Antes do uso.
+    void setCriticalReserve(uint32_t slots) { _reserve = slots; }
+
+    // Produtor. Retorna false se a mensagem não foi enfileirada (uma
+    // substituição conta como enfileirada).
+    bool push(const char *topic, size_t topicLen,
+              const uint8_t *payload, size_t payloadLen,
+              MsgClass cls = MSG_NORMAL);
+
+    // Consumidor. Copia a mensagem mais antiga em out; false se vazia.
+    bool pop(QueuedMsg &out);
+
+    uint32_t depth() const;
+    MsgQueueStats stats() const;
+
+    // Contadores por tópico (contexto do produtor): i < topicStatsCount(),
+    // e mais uma entrada final com topic = nullptr para os demais.
+    size_t topicStatsCount() const { return _topicCount; }
+    MsgTopicStats topicStats(size_t i) const;
+
+private:
+    struct TopicCount {
+        char     topic[MSG_TOPIC_MAX + 1];
+        uint32_t dropped;
+        uint32_t coalesced;
+    };
+
+    bool dropOldest(uint32_t &tail);
+    bool coalesce(const char *topic, size_t topicLen,
+                  const uint8_t *payload, size_t payloadLen);
+    TopicCount &countFor(const char *topic, size_t topicLen);
+
+    QueuedMsg _slots[MSG_QUEUE_SLOTS];
+    std::atomic<uint8_t> _busy[MSG_QUEUE_SLOTS];
+    uint32_t _reserve;
+    std::atomic<uint32_t> _head;      // Escrito só pelo produtor
+    std::atomic<uint32_t> _tail;      // CAS pelo consumidor e (DROP_OLDEST) produtor
+
+    std::atomic<uint32_t> _pushed;
+    std::atomic<uint32_t> _popped;
+    std::atomic<uint32_t> _dropped;
+    std::atomic<uint32_t> _coalesced;
+    std::atomic<uint32_t> _oversize;
+    std::atomic<uint32_t> _blocked;
+    std::atomic<uint32_t> _highWater;
+
+    TopicCount _topics[INGEST_TOPIC_STATS];
+    size_t     _topicCount;
+    TopicCount _otherTopics;
+};
@@ -0,0 +1,214 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - NUM FORMAT (IMPLEMENTAÇÃO)
+================================================================================
+
+Caminho rápido de formatDecimal():
+- m = round(|v| * 10^d) em um inteiro de 64 bits (exato enquanto < 2^53),
+  arredondando o valor exato como o printf (empate -> par);
+- o texto é a parte inteira de m / 10^d, '.', e os d dígitos restantes.
+  Com casas fixas o resultado é o mesmo texto de "%.*f".
+
+Menor texto (FLOAT_DECIMALS_SHORTEST): tenta d = 0, 1, 2... e para no
+primeiro em que m / 10^d == v. Como m e 10^d são exatos em double e a
+divisão IEEE é corretamente arredondada, esse quociente é exatamente o que
+strtod() devolve para o texto gerado, então a releitura é garantida.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "num_format.h"
+
+static const double POW10[NUM_FAST_DECIMALS + 1] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9
+};
+
+#define NUM_FAST_LIMIT  9007199254740992.0   // 2^53
+
+// Dígitos de m em ordem, com pelo menos minDigits (zeros à esquerda)
+static size_t putDigits(uint64_t m, size_t minDigits, char *out) {
+    char tmp[20];
+    size_t n = 0;
+    do {
+        tmp[n++] = (char)('0' + m % 10);
+        m /= 10;
+    } while (m > 0);
+    while (n < minDigits) {
+        tmp[n++] = '0';
+    }
+    for (size_t i = 0; i < n; i++) {
+        out[i] = tmp[n - 1 - i];
+    }
+    return n;
+}
+
+// m / 10^d em texto decimal fixo
+static int putFixed(bool negative, uint64_t m, int d, char *out, size_t cap) {
+    char buf[48];
+    size_t n = 0;
+
+    uint64_t p = (uint64_t)POW10[d];
+    if (negative) {
+        buf[n++] = '-';     // Como printf: -0.0001 com 2 casas -> "-0.00"
+    }
+    n += putDigits(m / p, 1, buf + n);
+    if (d > 0) {
+        buf[n++] = '.';
+        n += putDigits(m % p, (size_t)d, buf + n);
+    }
+
+    if (n > cap) {
+        return -1;
+    }
+    memcpy(out, buf, n);
+    return (int)n;
+}
+
+// round(a * p) com empate para o par, como o printf faz com o valor exato.
+// O produto em double pode ter sido arredondado; fma() recupera o erro,
+// que só importa quando a parte fracionária deu exatamente 0,5.
+static uint64_t roundScaled(double a, double p) {
+    double scaled = a * p;
+    double whole = floor(scaled);
+    double frac = scaled - whole;      // Exato (scaled < 2^53)
+    uint64_t m = (uint64_t)whole;
+
+    if (frac > 0.5) {
+        return m + 1;
+    }
+    if (frac < 0.5) {
+        return m;
+    }
+    double err = fma(a, p, -scaled);
+    if (err != 0.0) {
+        return (err > 0.0) ? m + 1 : m;
+    }
+    return m + (m & 1);
+}
+
+static int printfFallback(double v, int decimals, char *out, size_t cap) {
+    // snprintf precisa de espaço para o '\0'
+    char buf[352];
+    int w;
+
+    if (decimals >= 0) {
+        w = snprintf(buf, sizeof(buf), "%.*f", decimals, v);
+    } else {
+        // Menor precisão %g que relê o mesmo valor
+        for (int prec = 15; ; prec++) {
+            w = snprintf(buf, sizeof(buf), "%.*g", prec, v);
+            if (prec >= 17 || strtod(buf, nullptr) == v) {
+                break;
+            }
+        }
+    }
+
+    if (w < 0 || (size_t)w >= sizeof(buf) || (size_t)w > cap) {
+        return -1;
+    }
+    memcpy(out, buf, w);
+    return w;
+}
+
+int formatDecimal(double v, int decimals, char *out, size_t cap) {
+    if (!isfinite(v)) {
+        return printfFallback(v, decimals, out, cap);
+    }
+
+    bool negative = signbit(v);
+    double a = fabs(v);
+
+    if (decimals >= 0) {
+        if (decimals > NUM_FAST_DECIMALS || a * POW10[decimals] >= NUM_FAST_LIMIT) {
+            return printfFallback(v, decimals, out, cap);
+        }
+        uint64_t m = roundScaled(a, POW10[decimals]);
+        return putFixed(negative, m, decimals, out, cap);
+    }
+
+    for (int d = 0; d <= NUM_FAST_DECIMALS; d++) {
+        double scaled = a * POW10[d];
+        if (scaled >= NUM_FAST_LIMIT) {
+            break;
+        }
+        uint64_t m = roundScaled(a, POW10[d]);
+        if ((double)m / POW10[d] == a) {
+            return putFixed(negative, m, d, out, cap);
+        }
+    }
+    return printfFallback(v, decimals, out, cap);
+}
+
+int formatInteger(long long v, char *out, size_t cap) {
+    char buf[24];
+    size_t n = 0;
+
+    // Magnitude em unsigned: evita overflow em LLONG_MIN
+    uint64_t m = (uint64_t)v;
+    if (v < 0) {
+        buf[n++] = '-';
+        m = 0 - m;
+    }
+    n += putDigits(m, 1, buf + n);
+
+    if (n > cap) {
+        return -1;
+    }
+    memcpy(out, buf, n);
+    return (int)n;
+}
+
+const char *ruleForKey(const char *rules, const char *key, size_t len) {
+    const char *p = rules;
+    while (*p) {
+        const char *end = strchr(p, ';');
+        size_t ruleLen = end ? (size_t)(end - p) : strlen(p);
+        const char *colon = (const char *)memchr(p, ':', ruleLen);
+
+        if (colon) {
+            size_t nameLen = colon - p;
+            bool prefix = (nameLen > 0 && p[nameLen - 1] == '*');
+            if (prefix) {
+                nameLen--;
+            }
+
+            bool match = prefix ? (len >= nameLen && memcmp(key, p, nameLen) == 0)
+                                : (len == nameLen && memcmp(key, p, nameLen) == 0);
+            if (match) {
+                return colon + 1;
+            }
+        }
+
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    return nullptr;
+}
+
+int decimalsForKey(const char *rules, const char *key, size_t len, int def) {
+    const char *value = ruleForKey(rules, key, len);
+    if (!value) {
+        return def;
+    }
+    int d = atoi(value);
+    return (d < 0) ? FLOAT_DECIMALS_SHORTEST : (d > 17 ? 17 : d);
+}
+
+bool parseNumber(const char *s, size_t len, double &v) {
+    char buf[48];
+    if (len == 0 || len >= sizeof(buf) || !(s[0] == '-' || (s[0] >= '0' && s[0] <= '9'))) {
+        return false;
+    }
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+    char *end;
+    v = strtod(buf, &end);
+    return end == buf + len;
+}
@@ -0,0 +1,45 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - NUM FORMAT (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Conversão de números para texto direto no buffer do chamador, sem alocar
+e sem passar por snprintf no caso comum.
+
+- formatDecimal(): ponto flutuante com N casas (mesmo texto de "%.*f")
+  ou, com FLOAT_DECIMALS_SHORTEST, o
+  menor texto decimal que relido (strtod) devolve exatamente o mesmo double:
+      223.5 -> "223.5"   1000000.0 -> "1000000"   0.1 -> "0.1"
+- formatInteger(): inteiro com sinal, mesmo texto de "%lld".
+- decimalsForKey(): casas de uma coluna segundo as regras de COLUMN_DECIMALS
+  (ruleForKey(): o mesmo formato "chave:valor" para outras regras por coluna).
+- parseNumber(): volta do texto de um valor numérico para double.
+
+Valores fora da faixa do caminho rápido (|v| * 10^casas >= 2^53, ou que
+precisariam de mais de NUM_FAST_DECIMALS casas) usam snprintf.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+
+#define NUM_FAST_DECIMALS  9    // Casas tratadas com aritmética inteira
+
+// Retorna o tamanho do texto, ou -1 se não couber em cap bytes.
+int formatDecimal(double v, int decimals, char *out, size_t cap);
+int formatInteger(long long v, char *out, size_t cap);
+
+// Casas decimais da coluna key segundo rules ("chave:casas;prefixo*:casas"),
+// ou def se nenhuma regra casa. A primeira regra que casa vale.
+int decimalsForKey(const char *rules, const char *key, size_t len, int def);
+
+// Valor (texto após ':') da primeira regra de rules que casa com key, ou
+// nullptr. O valor termina em ';' ou no fim de rules.
+const char *ruleForKey(const char *rules, const char *key, size_t len);
+
+// Texto de um número JSON já formatado -> double; false se não é número.
+bool parseNumber(const char *s, size_t len, double &v);
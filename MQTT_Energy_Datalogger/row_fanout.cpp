@@ -0,0 +1,147 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - ROW FANOUT (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa o fan-out de row_fanout.h: cada write(), poll() e flush() de
+uma saída é cronometrado com micros(); a contagem de falhas seguidas de
+write() zera na primeira linha boa, a de travamentos depois de
+ROW_SINK_BACKOFF_MS sem nenhum. flush() chega também às saídas
+suspensas, sem mudar a suspensão.
+
+================================================================================
+*/
+
+#include <string.h>
+#include "row_fanout.h"
+#include "diag_log.h"
+
+RowFanout::RowFanout() : _count(0) {
+    memset(_sinks, 0, sizeof(_sinks));
+}
+
+bool RowFanout::add(RowSink *sink, bool isolated) {
+    if (_count >= ROW_SINK_MAX) {
+        return false;
+    }
+    Entry &e = _sinks[_count++];
+    memset(&e, 0, sizeof(e));
+    e.sink = sink;
+    e.isolated = isolated;
+    return true;
+}
+
+void RowFanout::suspend(Entry &e) {
+    e.suspended = true;
+    e.resumeAt = millis() + ROW_SINK_BACKOFF_MS;
+    e.stats.suspensions++;
+    DIAG_WARN("Saída %s suspensa por %lu ms (falhas: %lu, lentas: %lu).",
+              e.sink->name(), (unsigned long)ROW_SINK_BACKOFF_MS,
+              (unsigned long)e.stats.failures, (unsigned long)e.stats.slow);
+}
+
+void RowFanout::strike(Entry &e) {
+    if (++e.strikes >= ROW_SINK_STRIKES) {
+        suspend(e);
+    }
+}
+
+// false durante a suspensão; no fim dela a saída volta em observação: a
+// próxima falha ou lentidão suspende de novo
+bool RowFanout::active(Entry &e) {
+    if (!e.suspended) {
+        return true;
+    }
+    if ((long)(millis() - e.resumeAt) < 0) {
+        return false;
+    }
+    e.suspended = false;
+    e.strikes = ROW_SINK_STRIKES - 1;
+    e.stallStrikes = ROW_SINK_STRIKES - 1;
+    e.lastStall = millis();
+    return true;
+}
+
+// Tempo de uma chamada: maxUs e a contagem de travamentos
+void RowFanout::timed(Entry &e, uint32_t us) {
+    if (us > e.stats.maxUs) {
+        e.stats.maxUs = us;
+    }
+    if (us <= ROW_SINK_STALL_US) {
+        return;
+    }
+    e.stats.stalls++;
+    // Suspensa (flush() total): não estende a suspensão
+    if (!e.isolated || e.suspended) {
+        return;
+    }
+    unsigned long now = millis();
+    if (now - e.lastStall >= ROW_SINK_BACKOFF_MS) {
+        e.stallStrikes = 0;
+    }
+    e.lastStall = now;
+    if (++e.stallStrikes >= ROW_SINK_STRIKES) {
+        suspend(e);
+    }
+}
+
+void RowFanout::write(const LogRow &row) {
+    for (size_t i = 0; i < _count; i++) {
+        Entry &e = _sinks[i];
+        if (!active(e)) {
+            e.stats.skipped++;
+            continue;
+        }
+
+        uint32_t t = micros();
+        bool ok = e.sink->write(row);
+        uint32_t us = micros() - t;
+
+        if (ok) {
+            e.stats.rows++;
+        } else {
+            e.stats.failures++;
+        }
+        bool slow = ok && us > ROW_SINK_SLOW_US;
+        if (slow) {
+            e.stats.slow++;
+        }
+        timed(e, us);
+        // Já suspensa pelo travamento
+        if (!e.isolated || e.suspended) {
+            continue;
+        }
+        if (ok && !slow) {
+            e.strikes = 0;
+        } else {
+            strike(e);
+        }
+    }
+}
+
+void RowFanout::drain(bool all) {
+    for (size_t i = 0; i < _count; i++) {
+        Entry &e = _sinks[i];
+        // O flush() total (antes de tirar o cartão) vale também para as
+        // suspensas: o buffer delas não pode esperar o fim da suspensão
+        if (!active(e) && !all) {
+            continue;
+        }
+
+        uint32_t t = micros();
+        if (all) {
+            e.sink->flush();
+        } else {
+            e.sink->poll();
+        }
+        timed(e, micros() - t);
+    }
+}
+
+void RowFanout::poll() {
+    drain(false);
+}
+
+void RowFanout::flush() {
+    drain(true);
+}
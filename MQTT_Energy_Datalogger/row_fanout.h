@@ -0,0 +1,133 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - ROW FANOUT (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Entregar cada linha achatada a várias saídas (log no SD, cópia binária,
+Serial, republicação MQTT) sem interpretar nem formatar a mensagem de novo
+para cada uma.
+
+- LogRow: a linha como o logger a tem depois do achatamento, agregação e
+  deadband (valores tipados na ordem do cabeçalho, strings em text). As
+  saídas recebem a mesma LogRow por referência; ela só vale durante
+  write().
+- RowSink: uma saída. write() formata no buffer próprio da saída e
+  retorna sem esperar pelo meio lento (SD, Serial, rede); poll()/flush()
+  descarregam esse buffer (o I/O normal fica neles).
+- RowFanout: até ROW_SINK_MAX saídas, na ordem de add().
+
+Isolamento:
+-----------
+Todas as saídas rodam na task de logging, uma depois da outra. Uma saída
+isolada (add(..., true)) que falha (write() = false, ex.: buffer cheio) ou
+demora mais que ROW_SINK_SLOW_US em ROW_SINK_STRIKES linhas seguidas fica
+suspensa por ROW_SINK_BACKOFF_MS: as linhas do período são contadas em
+skipped e não chegam a ela. Depois, uma falha já a suspende de novo. A
+saída principal (o log) não é isolada: nunca é suspensa.
+
+poll() e flush() também são cronometrados. poll() pula as saídas
+suspensas (o buffer delas espera o fim da suspensão); flush() não, porque
+é o descarregamento antes de desligar ou tirar o cartão: o buffer de uma
+saída suspensa também vai, e um travamento nele é contado em stalls sem
+estender a suspensão. O I/O de uma saída (um bloco
+no SD a cada tantas linhas) vem espaçado, entre escritas rápidas, e por
+isso tem contagem própria: ROW_SINK_STRIKES chamadas (write(), poll()
+ou flush()) acima de ROW_SINK_STALL_US, cada uma a menos de
+ROW_SINK_BACKOFF_MS da anterior, também suspendem a saída. Assim um
+cartão travado numa saída extra custa à task de logging no máximo
+ROW_SINK_STRIKES travamentos por suspensão (um, depois da primeira).
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#include "config.h"
+#include "json_flatten.h"
+
+#if ROW_SINK_MAX < 1 || ROW_SINK_STRIKES < 1
+#error "ROW_SINK_MAX e ROW_SINK_STRIKES devem ser pelo menos 1"
+#endif
+
+// Nome da coluna i da linha em buf (até cap bytes, sem '\0'). Retorna o tamanho.
+typedef size_t (*RowKeyFn)(size_t i, char *buf, size_t cap);
+
+struct LogRow {
+    unsigned long   ms;         // millis() da mensagem (início da janela, se agregada)
+    const char     *clientId;
+    const char     *topic;
+    const char     *text;       // Strings das células
+    const FlatValue *cells;     // Na ordem do cabeçalho
+    size_t          count;
+    RowKeyFn        key;        // Nomes das colunas
+};
+
+class RowSink {
+public:
+    virtual ~RowSink() {}
+
+    // Nome curto (diagnóstico).
+    virtual const char *name() const = 0;
+
+    // Uma linha. false se não foi aceita (ex.: buffer cheio, arquivo com
+    // outro esquema).
+    virtual bool write(const LogRow &row) = 0;
+
+    // Descarregamento por idade e total (mesmo contexto de write()).
+    virtual void poll() {}
+    virtual void flush() {}
+};
+
+struct RowSinkStats {
+    uint32_t rows;          // Linhas aceitas
+    uint32_t failures;      // write() = false
+    uint32_t slow;          // write() acima de ROW_SINK_SLOW_US
+    uint32_t stalls;        // write()/poll()/flush() acima de ROW_SINK_STALL_US
+    uint32_t skipped;       // Linhas não entregues (saída suspensa)
+    uint32_t suspensions;   // Vezes em que a saída foi suspensa
+    uint32_t maxUs;         // Maior tempo de um write()/poll()/flush()
+};
+
+class RowFanout {
+public:
+    RowFanout();
+
+    // Registra uma saída. isolated = false: nunca suspensa (o log).
+    // false se já há ROW_SINK_MAX saídas.
+    bool add(RowSink *sink, bool isolated);
+
+    // Entrega a linha a cada saída não suspensa.
+    void write(const LogRow &row);
+
+    // Descarregamento por idade de cada saída não suspensa.
+    void poll();
+    // Descarregamento total de todas as saídas, inclusive as suspensas.
+    void flush();
+
+    size_t count() const { return _count; }
+    const RowSink *sink(size_t i) const { return _sinks[i].sink; }
+    const RowSinkStats &stats(size_t i) const { return _sinks[i].stats; }
+
+private:
+    struct Entry {
+        RowSink      *sink;
+        bool          isolated;
+        bool          suspended;
+        uint8_t       strikes;       // Falhas / lentidões seguidas
+        uint8_t       stallStrikes;  // Travamentos próximos
+        unsigned long lastStall;     // millis() do último deles
+        unsigned long resumeAt;      // millis() do fim da suspensão
+        RowSinkStats  stats;
+    };
+
+    bool active(Entry &e);
+    void suspend(Entry &e);
+    void strike(Entry &e);
+    void timed(Entry &e, uint32_t us);
+    void drain(bool all);
+
+    Entry  _sinks[ROW_SINK_MAX];
+    size_t _count;
+};
@@ -0,0 +1,296 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - ROW SINKS (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa as saídas de row_sinks.h. O texto de cada linha é montado num
+buffer de tamanho fixo (LineBuf). O JSON que não cabe não é publicado
+(nunca sai cortado); no Serial, a linha é cortada com " ...".
+
+Buffer do MqttRowSink: registros [tópico:u16][payload:u16][tópico][payload]
+contíguos no anel (um registro pode dar a volta no fim). O produtor só
+publica _head depois de copiar o registro inteiro; o consumidor só libera
+_tail depois de copiá-lo para fora.
+
+================================================================================
+*/
+
+#include <SD.h>
+#include <string.h>
+#include "row_sinks.h"
+#include "diag_log.h"
+
+// Texto acumulado em buf; ok = false quando algo não coube
+struct LineBuf {
+    char  *buf;
+    size_t cap;
+    size_t len;
+    bool   ok;
+
+    LineBuf(char *b, size_t c) : buf(b), cap(c), len(0), ok(true) {}
+
+    void add(const char *s, size_t n) {
+        if (!ok || n > cap - len) {
+            ok = false;
+            return;
+        }
+        memcpy(buf + len, s, n);
+        len += n;
+    }
+
+    void add(const char *s) {
+        add(s, strlen(s));
+    }
+
+    void add(char c) {
+        add(&c, 1);
+    }
+
+    // Valor da célula como no CSV (ausente: nada)
+    void addValue(const FlatValue &v, const char *text) {
+        int n = ok ? flatFormat(v, text, buf + len, cap - len) : 0;
+        if (n < 0) {
+            ok = false;
+            return;
+        }
+        len += (size_t)n;
+    }
+
+    // String JSON entre aspas
+    void addJsonString(const char *s, size_t n) {
+        add('"');
+        for (size_t i = 0; i < n; i++) {
+            char c = s[i];
+            if (c == '"' || c == '\\') {
+                add('\\');
+                add(c);
+            } else if ((unsigned char)c < 0x20) {
+                char esc[8];
+                snprintf(esc, sizeof(esc), "\\u%04x", (unsigned)c);
+                add(esc);
+            } else {
+                add(c);
+            }
+        }
+        add('"');
+    }
+};
+
+// -----------------------------------------------------------------------------
+// SerialRowSink
+// -----------------------------------------------------------------------------
+bool SerialRowSink::write(const LogRow &row) {
+    static const char cut[] = " ...\n";
+    char line[DIAG_RING_SIZE / 4];
+    // Sobra espaço para o corte de uma linha longa demais
+    LineBuf out(line, sizeof(line) - (sizeof(cut) - 1));
+
+    out.add(row.topic);
+    out.add(" [");
+    out.add(row.clientId);
+    out.add(']');
+    for (size_t i = 0; i < row.count && out.ok; i++) {
+        if (row.cells[i].type == FLAT_ABSENT) {
+            continue;
+        }
+        char key[FLAT_PATH_SIZE + 8];
+        out.add(' ');
+        out.add(key, row.key(i, key, sizeof(key)));
+        out.add('=');
+        out.addValue(row.cells[i], row.text);
+    }
+    out.add('\n');
+
+    if (!out.ok) {
+        memcpy(line + out.len, cut, sizeof(cut) - 1);
+        out.len += sizeof(cut) - 1;
+    }
+    return diagWrite(line, out.len);
+}
+
+// -----------------------------------------------------------------------------
+// MqttRowSink
+// -----------------------------------------------------------------------------
+MqttRowSink::MqttRowSink() : _head(0), _tail(0) {
+}
+
+uint32_t MqttRowSink::pending() const {
+    return _head.load(std::memory_order_acquire) - _tail.load(std::memory_order_acquire);
+}
+
+void MqttRowSink::put(uint32_t pos, const void *data, size_t len) {
+    size_t at = pos % ROW_SINK_MQTT_BUFFER;
+    size_t first = ROW_SINK_MQTT_BUFFER - at;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(_ring + at, data, first);
+    memcpy(_ring, (const uint8_t *)data + first, len - first);
+}
+
+void MqttRowSink::get(uint32_t pos, void *data, size_t len) const {
+    size_t at = pos % ROW_SINK_MQTT_BUFFER;
+    size_t first = ROW_SINK_MQTT_BUFFER - at;
+    if (first > len) {
+        first = len;
+    }
+    memcpy(data, _ring + at, first);
+    memcpy((uint8_t *)data + first, _ring, len - first);
+}
+
+bool MqttRowSink::push(const char *topic, size_t topicLen, const char *payload, size_t len) {
+    size_t record = 4 + topicLen + len;
+    uint32_t head = _head.load(std::memory_order_relaxed);
+    uint32_t used = head - _tail.load(std::memory_order_acquire);
+    if (record > ROW_SINK_MQTT_BUFFER - used) {
+        return false;
+    }
+
+    uint8_t lens[4] = { (uint8_t)topicLen, (uint8_t)(topicLen >> 8),
+                        (uint8_t)len, (uint8_t)(len >> 8) };
+    put(head, lens, sizeof(lens));
+    put(head + 4, topic, topicLen);
+    put(head + 4 + topicLen, payload, len);
+    _head.store(head + record, std::memory_order_release);
+    return true;
+}
+
+bool MqttRowSink::write(const LogRow &row) {
+    LineBuf out(_payload, sizeof(_payload));
+    char num[16];
+
+    snprintf(num, sizeof(num), "%lu", row.ms);
+    out.add("{\"ts\":");
+    out.add(num);
+    out.add(",\"client_id\":");
+    out.addJsonString(row.clientId, strlen(row.clientId));
+    for (size_t i = 0; i < row.count && out.ok; i++) {
+        const FlatValue &v = row.cells[i];
+        if (v.type == FLAT_ABSENT) {
+            continue;
+        }
+        char key[FLAT_PATH_SIZE + 8];
+        out.add(',');
+        out.addJsonString(key, row.key(i, key, sizeof(key)));
+        out.add(':');
+        if (v.type == FLAT_NULL) {
+            out.add("null");
+        } else if (v.type == FLAT_TEXT) {
+            out.addJsonString(row.text + v.text.off, v.text.len);
+        } else {
+            out.addValue(v, row.text);
+        }
+    }
+    out.add('}');
+    if (!out.ok) {
+        return false;
+    }
+
+    char topic[ROW_SINK_MQTT_TOPIC_MAX];
+    size_t prefix = sizeof(ROW_SINK_MQTT_PREFIX) - 1;
+    size_t n = strlen(row.topic);
+    if (n > MSG_TOPIC_MAX) {
+        return false;
+    }
+    memcpy(topic, ROW_SINK_MQTT_PREFIX, prefix);
+    memcpy(topic + prefix, row.topic, n);
+    return push(topic, prefix + n, _payload, out.len);
+}
+
+bool MqttRowSink::pop(char *topic, char *payload, size_t &len) {
+    uint32_t tail = _tail.load(std::memory_order_relaxed);
+    if (_head.load(std::memory_order_acquire) == tail) {
+        return false;
+    }
+
+    uint8_t lens[4];
+    get(tail, lens, sizeof(lens));
+    size_t topicLen = lens[0] | lens[1] << 8;
+    len = lens[2] | lens[3] << 8;
+    get(tail + 4, topic, topicLen);
+    topic[topicLen] = '\0';
+    get(tail + 4 + topicLen, payload, len);
+    _tail.store(tail + 4 + topicLen + len, std::memory_order_release);
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// BinaryRowSink
+// -----------------------------------------------------------------------------
+BinaryRowSink::BinaryRowSink(const char *path)
+    : _path(path), _started(false), _disabled(false), _columns(0), _dropped(0) {
+}
+
+// Chave i do esquema do arquivo contra a coluna i das linhas
+static bool sameKey(void *ctx, size_t i, const char *key, size_t len) {
+    const LogRow &row = *(const LogRow *)ctx;
+    char buf[FLAT_PATH_SIZE + 8];
+    return i < row.count && row.key(i, buf, sizeof(buf)) == len &&
+           memcmp(buf, key, len) == 0;
+}
+
+bool BinaryRowSink::start(const LogRow &row) {
+    size_t existing = 0;
+    File f = SD.open(_path, FILE_READ);
+    if (f) {
+        if (f.size() > 0) {
+            // Arquivo com dados: só continua com o mesmo esquema
+            existing = binLogReadSchema(f, sameKey, (void *)&row);
+            _disabled = (existing == 0 || existing != row.count);
+        }
+        f.close();
+    }
+    if (_disabled) {
+        DIAG_ERROR("Saída binária: esquema de %s não é o das linhas; saída desligada.", _path);
+        return false;
+    }
+    if (!_sink.begin(_path)) {
+        DIAG_ERROR("Saída binária: não foi possível abrir %s.", _path);
+        return false;
+    }
+
+    _bin.begin(_sink);
+    if (existing == 0) {
+        char key[FLAT_PATH_SIZE + 8];
+        _bin.writeSchema(row.count);
+        for (size_t i = 0; i < row.count; i++) {
+            _bin.writeSchemaKey(key, row.key(i, key, sizeof(key)));
+        }
+    }
+    _bin.beginSession();
+    _columns = row.count;
+    _started = true;
+    DIAG_INFO("Saída binária em %s (%u colunas).", _path, (unsigned)_columns);
+    return true;
+}
+
+bool BinaryRowSink::write(const LogRow &row) {
+    if (_disabled || (!_started && !start(row))) {
+        return false;
+    }
+    if (row.count != _columns) {
+        return false;
+    }
+    // Linha anterior descartada (SD falhando): recomeça a sessão
+    uint32_t dropped = _sink.stats().dropped;
+    _sink.beginRow();
+    if (dropped != _dropped) {
+        _dropped = dropped;
+        _bin.beginSession();
+    }
+    _bin.writeRow(row.ms, row.clientId, row.topic, row.text, row.cells, row.count);
+    _sink.endRow();
+    return _sink.stats().dropped == dropped;
+}
+
+void BinaryRowSink::poll() {
+    if (_started) {
+        _sink.poll();
+    }
+}
+
+void BinaryRowSink::flush() {
+    if (_started) {
+        _sink.flush();
+    }
+}
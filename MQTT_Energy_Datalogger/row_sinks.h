@@ -0,0 +1,107 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - ROW SINKS (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Saídas extras das linhas (RowSink, ver row_fanout.h), cada uma com o seu
+buffer:
+
+- SerialRowSink (ROW_SINK_SERIAL): uma linha de texto por linha do log,
+      <tópico> [<client_id>] chave=valor chave=valor ...
+  (colunas ausentes omitidas) no buffer do diag_log, que a task dele
+  escreve no Serial. Buffer cheio: write() = false e a linha se perde.
+
+- MqttRowSink (ROW_SINK_MQTT): a linha em JSON,
+      {"ts":<ms>,"client_id":"<id>","<chave>":<valor>,...}
+  num buffer circular de ROW_SINK_MQTT_BUFFER bytes, de um produtor (a
+  task de logging) e um consumidor (loop() do Arduino, que publica com o
+  cliente interno em ROW_SINK_MQTT_PREFIX + tópico), sem lock: contadores
+  monotônicos como na msg_queue. Buffer cheio (broker desconectado, loop()
+  atrasado): write() = false e a linha se perde.
+
+- BinaryRowSink (ROW_SINK_BINARY): cópia em bin_log num arquivo próprio,
+  com CsvSink próprio (buffer de CSV_SINK_BUFFER_SIZE bytes). O esquema é
+  gravado na 1ª linha; se o arquivo já existe, o esquema dele tem que ser
+  o das linhas (mesmas chaves, na mesma ordem), senão a saída fica
+  desligada até o próximo boot (o arquivo não é alterado). write() só
+  monta a linha no buffer (vai ao SD só se ele encher); o descarregamento
+  por idade fica no poll().
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <atomic>
+
+#include "config.h"
+#include "row_fanout.h"
+#include "csv_sink.h"
+#include "bin_log.h"
+
+#if ROW_SINK_MQTT_PAYLOAD_MAX > MSG_PAYLOAD_MAX
+#error "ROW_SINK_MQTT_PAYLOAD_MAX acima de MSG_PAYLOAD_MAX (buffer do cliente interno)"
+#endif
+
+// Tópico republicado: prefixo + tópico original
+#define ROW_SINK_MQTT_TOPIC_MAX  (sizeof(ROW_SINK_MQTT_PREFIX) - 1 + MSG_TOPIC_MAX)
+
+#if ROW_SINK_MQTT_BUFFER < ROW_SINK_MQTT_PAYLOAD_MAX + MSG_TOPIC_MAX + 64
+#error "ROW_SINK_MQTT_BUFFER deve comportar um payload e um tópico máximos"
+#endif
+
+class SerialRowSink : public RowSink {
+public:
+    const char *name() const override { return "serial"; }
+    bool write(const LogRow &row) override;
+};
+
+class MqttRowSink : public RowSink {
+public:
+    MqttRowSink();
+
+    const char *name() const override { return "mqtt"; }
+    bool write(const LogRow &row) override;
+
+    // Consumidor: a publicação mais antiga. topic (ROW_SINK_MQTT_TOPIC_MAX
+    // + 1 bytes) terminado em '\0'; payload (ROW_SINK_MQTT_PAYLOAD_MAX
+    // bytes) com len bytes. false se não há nenhuma.
+    bool pop(char *topic, char *payload, size_t &len);
+
+    // Bytes ocupados no buffer (qualquer contexto).
+    uint32_t pending() const;
+
+private:
+    bool push(const char *topic, size_t topicLen, const char *payload, size_t len);
+    void put(uint32_t pos, const void *data, size_t len);
+    void get(uint32_t pos, void *data, size_t len) const;
+
+    uint8_t  _ring[ROW_SINK_MQTT_BUFFER];
+    std::atomic<uint32_t> _head;      // Bytes escritos (só o produtor)
+    std::atomic<uint32_t> _tail;      // Bytes lidos (só o consumidor)
+    char     _payload[ROW_SINK_MQTT_PAYLOAD_MAX];
+};
+
+class BinaryRowSink : public RowSink {
+public:
+    explicit BinaryRowSink(const char *path);
+
+    const char *name() const override { return "bin"; }
+    bool write(const LogRow &row) override;
+    void poll() override;
+    void flush() override;
+
+    const CsvSinkStats &fileStats() const { return _sink.stats(); }
+
+private:
+    bool start(const LogRow &row);
+
+    const char  *_path;
+    bool         _started;
+    bool         _disabled;        // Esquema do arquivo diferente do das linhas
+    size_t       _columns;
+    uint32_t     _dropped;         // stats().dropped na última sessão
+    CsvSink      _sink;
+    BinLogWriter _bin;
+};
@@ -0,0 +1,123 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - CONFERÊNCIAS DOS TESTES (PC)
+================================================================================
+
+Apoio dos testes de tests/ (um executável por módulo, com o config.h em
+vigor, compilados pelo CMakeLists.txt):
+
+- CHECK(cond) / CHECK_EQ(a, b): conferem e, na falha, imprimem arquivo,
+  linha e valores no stderr; o teste continua.
+- testSdDir(): "cartão" (tools/host) em um diretório temporário novo.
+- testReadFile() / testReadLog(): conteúdo de um arquivo do cartão; o
+  segundo, com LOG_COMPRESS, já descomprimido por testUnpack() (como o
+  tools/logunpack: frame inválido pulado, fim nos zeros da pré-alocação).
+- testDone(): resumo no stderr; código de saída 1 se algo falhou.
+
+Resultados medidos (contagens, tempos) vão para o stdout, uma linha JSON
+por caso, como nas ferramentas de tools/.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <SD.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include "config.h"
+#include "log_compress.h"
+
+static unsigned long testChecks;
+static unsigned long testFailures;
+
+static inline bool testCheck(bool ok, const char *file, int line, const char *what) {
+    testChecks++;
+    if (!ok) {
+        testFailures++;
+        fprintf(stderr, "%s:%d: falhou: %s\n", file, line, what);
+    }
+    return ok;
+}
+
+#define CHECK(cond) testCheck((cond), __FILE__, __LINE__, #cond)
+
+#define CHECK_EQ(a, b)                                                            \
+    do {                                                                          \
+        long long va_ = (long long)(a), vb_ = (long long)(b);                     \
+        if (!testCheck(va_ == vb_, __FILE__, __LINE__, #a " == " #b)) {          \
+            fprintf(stderr, "    %lld != %lld\n", va_, vb_);                      \
+        }                                                                         \
+    } while (0)
+
+static inline std::string testSdDir() {
+    char dir[] = "/tmp/datalogger_test_XXXXXX";
+    if (!mkdtemp(dir)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    hostSdRoot(dir);
+    return dir;
+}
+
+// Conteúdo de um arquivo do "cartão"
+static inline std::string testReadFile(const char *path) {
+    std::string out;
+    File f = SD.open(path, FILE_READ);
+    if (!f) {
+        return out;
+    }
+    uint8_t buf[512];
+    size_t n;
+    while ((n = f.read(buf, sizeof(buf))) > 0) {
+        out.append((const char *)buf, n);
+    }
+    f.close();
+    return out;
+}
+
+// Frames de log_compress.h descomprimidos, na ordem. Um frame inválido
+// (escrita incompleta) é pulado byte a byte até o próximo válido; zeros
+// onde começaria um frame terminam os dados. skipped: bytes pulados.
+static inline std::string testUnpack(const std::string &data, size_t *skipped = nullptr) {
+    static uint8_t block[LZ_BLOCK_MAX];
+    const uint8_t *p = (const uint8_t *)data.data();
+    std::string out;
+    size_t pos = 0;
+    if (skipped) {
+        *skipped = 0;
+    }
+    while (pos < data.size()) {
+        if (data.find_first_not_of('\0', pos) == std::string::npos) {
+            break;
+        }
+        LzFrame frame;
+        if (data.size() - pos >= LZ_FRAME_HEADER && lzFrameHeader(p + pos, frame) &&
+            data.size() - pos - LZ_FRAME_HEADER >= frame.dataLen &&
+            lzFrameDecode(frame, p + pos + LZ_FRAME_HEADER, block)) {
+            out.append((const char *)block, frame.rawLen);
+            pos += LZ_FRAME_HEADER + frame.dataLen;
+        } else {
+            pos++;
+            if (skipped) {
+                (*skipped)++;
+            }
+        }
+    }
+    return out;
+}
+
+// O texto gravado em path (len: só os primeiros bytes do arquivo)
+static inline std::string testReadLog(const char *path, size_t len = std::string::npos) {
+    std::string data = testReadFile(path).substr(0, len);
+#if LOG_COMPRESS
+    return testUnpack(data);
+#else
+    return data;
+#endif
+}
+
+static inline int testDone(const char *name) {
+    fprintf(stderr, "%s: %lu conferências, %lu falha(s)\n", name, testChecks, testFailures);
+    return testFailures ? 1 : 0;
+}
@@ -0,0 +1,148 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - PAYLOADS DOS TESTES (PC)
+================================================================================
+
+Payloads JSON para os testes de achatamento e colunas:
+
+- corpusFixed: casos escritos à mão: formato do MiEnergy ({"value": X},
+  arrays de {"value"}), aninhamento, arrays dentro de arrays, null, bool,
+  strings com escapes e \uXXXX, inteiros grandes, reais pequenos e
+  negativos, objetos/arrays vazios, chave repetida, "value" ao lado de
+  outros membros, chaves com '_' que são prefixo de outras.
+- corpusRandom(seed): mensagens de medidores sintéticos (mesma semente =
+  mesma mensagem), com chaves de um vocabulário curto para que caminhos e
+  prefixos se repitam entre mensagens.
+
+================================================================================
+*/
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+
+static const char *const corpusFixed[] = {
+    "{\"device\":\"mi-0\",\"tensao_a\":{\"value\":222.8},\"tensao_b\":{\"value\":224.01},"
+    "\"corrente\":[{\"value\":0.631},{\"value\":1.179},{\"value\":3}],"
+    "\"energia\":{\"ativa\":{\"value\":1000000},\"reativa\":{\"value\":123.456789}},"
+    "\"freq\":{\"value\":60.0},\"ok\":true,\"nulo\":null}",
+
+    "{\"cfg\":{\"a\":1,\"b\":[1,2,[3,4]],\"c\":{\"value\":\"x\\\"y\"}},\"big\":12345678901,"
+    "\"neg\":-0.00325,\"empty\":{},\"ea\":[],\"extra\":{\"value\":0}}",
+
+    "{\"s\":\"tab\\tnl\\nbs\\\\sl\\/u\\u00e9\\u20ac\",\"t\":\"\",\"f\":false,"
+    "\"e\":1.5e3,\"e2\":-2E-2,\"z\":-0,\"i\":-9007199254740993}",
+
+    "{\"a\":{\"value\":1,\"unit\":\"V\"},\"a_value\":2,\"b\":{\"value\":{\"x\":1}},"
+    "\"c\":{\"value\":[1,2]}}",
+
+    "{\"energia\":5,\"energia_ativa\":6,\"energia_ativa_total\":7,\"energia\":8}",
+
+    "[1,{\"value\":2},[{\"x\":3}],\"txt\"]",
+
+    "{\"d1\":{\"d2\":{\"d3\":{\"d4\":{\"d5\":{\"d6\":{\"d7\":{\"value\":7}}}}}}},"
+    "\"arr\":[[[[[1]]]]]}",
+
+    "{\"device\":\"mi-1\",\"tensao_a\":{\"value\":223.9},\"corrente\":[{\"value\":0.283}],"
+    "\"fp\":{\"value\":0.92},\"energia\":{\"ativa\":{\"value\":1000001}},"
+    "\"status\":{\"rede\":\"ok\",\"rssi\":-67}}",
+};
+
+static const size_t corpusFixedCount = sizeof(corpusFixed) / sizeof(corpusFixed[0]);
+
+struct CorpusRng {
+    uint32_t s;
+
+    uint32_t next() {
+        s ^= s << 13;
+        s ^= s >> 17;
+        s ^= s << 5;
+        return s;
+    }
+    uint32_t below(uint32_t n) { return next() % n; }
+};
+
+static const char *const corpusKeys[] = {
+    "tensao", "tensao_a", "corrente", "energia", "energia_ativa", "fp", "freq",
+    "status", "value", "device", "a", "b", "rssi", "temp"
+};
+
+static inline void corpusValue(CorpusRng &r, std::string &out, int depth);
+
+static inline void corpusScalar(CorpusRng &r, std::string &out) {
+    char buf[48];
+    switch (r.below(8)) {
+    case 0:
+        snprintf(buf, sizeof(buf), "%d", (int)r.below(100000) - 50000);
+        break;
+    case 1:
+        snprintf(buf, sizeof(buf), "%u.%02u", r.below(400), r.below(100));
+        break;
+    case 2:
+        snprintf(buf, sizeof(buf), "-0.%05u", r.below(100000));
+        break;
+    case 3:
+        snprintf(buf, sizeof(buf), "%s", r.below(2) ? "true" : "false");
+        break;
+    case 4:
+        snprintf(buf, sizeof(buf), "null");
+        break;
+    case 5:
+        snprintf(buf, sizeof(buf), "\"mi-%u\"", r.below(50));
+        break;
+    case 6:
+        snprintf(buf, sizeof(buf), "%u%05u", 1 + r.below(9000), r.below(100000));
+        break;
+    default:
+        snprintf(buf, sizeof(buf), "%u.%u", r.below(1000), r.below(1000000));
+        break;
+    }
+    out += buf;
+}
+
+static inline void corpusObject(CorpusRng &r, std::string &out, int depth) {
+    size_t n = 1 + r.below(depth == 0 ? 12 : 4);
+    out += '{';
+    for (size_t i = 0; i < n; i++) {
+        if (i) {
+            out += ',';
+        }
+        out += '"';
+        out += corpusKeys[r.below(sizeof(corpusKeys) / sizeof(corpusKeys[0]))];
+        out += "\":";
+        corpusValue(r, out, depth + 1);
+    }
+    out += '}';
+}
+
+static inline void corpusValue(CorpusRng &r, std::string &out, int depth) {
+    uint32_t k = (depth >= 4) ? 0 : r.below(10);
+    if (k < 5) {
+        corpusScalar(r, out);
+    } else if (k < 7) {
+        // Formato do MiEnergy
+        out += "{\"value\":";
+        corpusScalar(r, out);
+        out += '}';
+    } else if (k < 9) {
+        corpusObject(r, out, depth);
+    } else {
+        size_t n = r.below(4);
+        out += '[';
+        for (size_t i = 0; i < n; i++) {
+            if (i) {
+                out += ',';
+            }
+            corpusValue(r, out, depth + 1);
+        }
+        out += ']';
+    }
+}
+
+// Mensagem sintética da semente seed (objeto na raiz)
+static inline std::string corpusRandom(uint32_t seed) {
+    CorpusRng r = { seed * 2654435761u + 1 };
+    std::string out;
+    corpusObject(r, out, 0);
+    return out;
+}
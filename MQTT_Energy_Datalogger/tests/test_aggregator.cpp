@@ -0,0 +1,279 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO AGGREGATOR (PC)
+================================================================================
+
+Confere a agregação por janela (aggregator.cpp) com um relógio sintético
+(o módulo recebe now do chamador). O aggregator.cpp entra aqui com
+AGG_WINDOW_MS = 1000, o resto do config.h em vigor.
+
+- windows: mean/min/max/last e samples de uma janela; a linha sai com o
+  início da janela quando chega mensagem de uma janela seguinte, ou por
+  poll() depois do fim dela (não antes); janelas vazias não geram linha.
+- topics: tópicos intercalados têm janelas próprias; com mais de
+  AGG_MAX_TOPICS, a janela mais antiga sai antes da hora.
+- values: strings, bools e null só em _last (o último vence, número
+  depois de texto volta às estatísticas); colunas sem valor ficam
+  vazias; textos além de AGG_TEXT_SIZE compactam sem perder o último.
+- keys: outputKey() e inputOf() (recuperação do cabeçalho).
+- reference: sequência aleatória contra médias/mín/máx calculados à parte.
+
+================================================================================
+*/
+
+#include "config.h"
+#undef AGG_WINDOW_MS
+#define AGG_WINDOW_MS 1000
+#include "aggregator.cpp"
+
+#include <string>
+#include <vector>
+#include "num_format.h"
+#include "check.h"
+#include "corpus.h"
+
+static ColumnMap columns;
+static Aggregator agg;
+static String keys[4];
+static std::vector<std::string> rows;
+
+static std::string cellText(const FlatValue &v, const char *text) {
+    char buf[400];
+    int n = flatFormat(v, text, buf, sizeof(buf));
+    return (n > 0) ? std::string(buf, n) : std::string();
+}
+
+// Linha agregada como "início|client|tópico|célula,célula,..."
+static void capture(void *, uint32_t windowStart, const char *client, const char *topic,
+                    const char *text, const FlatValue *cells, size_t count) {
+    std::string row = std::to_string(windowStart) + "|" + client + "|" + topic + "|";
+    for (size_t i = 0; i < count; i++) {
+        row += (i ? "," : "") + cellText(cells[i], text);
+    }
+    rows.push_back(row);
+}
+
+static FlatValue num(double d) {
+    FlatValue v = {};
+    v.type = FLAT_REAL;
+    v.decimals = FLOAT_DECIMALS;
+    v.d = d;
+    return v;
+}
+
+static FlatValue integer(long long i) {
+    FlatValue v = {};
+    v.type = FLAT_INT;
+    v.i = i;
+    return v;
+}
+
+static FlatValue other(uint8_t type, long long i = 0) {
+    FlatValue v = {};
+    v.type = type;
+    v.i = i;
+    return v;
+}
+
+static char payload[256];
+static size_t payloadUsed;
+
+static FlatValue str(const char *s) {
+    FlatValue v = {};
+    v.type = FLAT_TEXT;
+    v.text.off = (uint16_t)payloadUsed;
+    v.text.len = (uint16_t)strlen(s);
+    memcpy(payload + payloadUsed, s, v.text.len);
+    payloadUsed = (payloadUsed + v.text.len) % 128;
+    return v;
+}
+
+static void add(uint32_t now, const char *topic, FlatValue a, FlatValue b, FlatValue c) {
+    FlatValue cells[3] = { a, b, c };
+    agg.add(now, "esp32_logger", topic, payload, cells);
+}
+
+static void begin() {
+    keys[0] = "tensao";
+    keys[1] = "corrente";
+    keys[2] = "status";
+    columns.build(keys, 3);
+    agg.begin(columns, capture, nullptr);
+    rows.clear();
+}
+
+static bool expectRows(const std::vector<std::string> &expected) {
+    bool ok = CHECK(rows == expected);
+    if (!ok) {
+        for (const std::string &r : rows) {
+            fprintf(stderr, "    obtido:   %s\n", r.c_str());
+        }
+        for (const std::string &r : expected) {
+            fprintf(stderr, "    esperado: %s\n", r.c_str());
+        }
+    }
+    rows.clear();
+    return ok;
+}
+
+static void testWindows() {
+    begin();
+    add(100, "m/1", num(220.0), integer(2), str("ok"));
+    add(500, "m/1", num(224.0), integer(6), str("ok"));
+    add(999, "m/1", num(222.5), integer(1), str("alarme"));
+    agg.poll(999);
+    CHECK(rows.empty());
+
+    // Mensagem na janela seguinte fecha a anterior
+    add(1000, "m/1", num(230.0), integer(3), other(FLAT_ABSENT));
+    expectRows({ "0|esp32_logger|m/1|3,222.16666666666666,220,224,222.5,3,1,6,1,,,,alarme" });
+
+    // poll(): só depois do fim da janela
+    agg.poll(1999);
+    CHECK(rows.empty());
+    agg.poll(2000);
+    expectRows({ "1000|esp32_logger|m/1|1,230,230,230,230,3,3,3,3,,,," });
+
+    // Janelas vazias não geram linha; o início é o da janela da mensagem
+    add(7250, "m/1", num(1.0), integer(1), other(FLAT_NULL));
+    agg.poll(7999);
+    CHECK(rows.empty());
+    agg.poll(60000);
+    expectRows({ "7000|esp32_logger|m/1|1,1,1,1,1,1,1,1,1,,,," });
+    agg.poll(120000);
+    CHECK(rows.empty());
+}
+
+static void testTopics() {
+    begin();
+    add(10, "m/1", num(1.0), integer(1), str("a"));
+    add(20, "m/2", num(2.0), integer(2), str("b"));
+    add(30, "m/1", num(3.0), integer(3), str("c"));
+    agg.poll(1000);
+    CHECK_EQ(rows.size(), 2);
+    CHECK(rows.size() == 2 && rows[0].compare(0, 18, "0|esp32_logger|m/1") == 0 &&
+          rows[0].compare(19, 2, "2,") == 0);
+    rows.clear();
+
+    // Mais tópicos que posições: a janela mais antiga sai antes da hora
+    for (uint32_t t = 0; t < AGG_MAX_TOPICS; t++) {
+        add(2000 + t * 1000, ("m/" + std::to_string(t)).c_str(), num(t), integer(t), str("x"));
+    }
+    CHECK(rows.empty());
+    add(2000 + AGG_MAX_TOPICS * 1000, "novo", num(9.0), integer(9), str("y"));
+    expectRows({ "2000|esp32_logger|m/0|1,0,0,0,0,0,0,0,0,,,,x" });
+    agg.flushAll();
+    CHECK_EQ(rows.size(), AGG_MAX_TOPICS);
+    rows.clear();
+    agg.flushAll();
+    CHECK(rows.empty());
+}
+
+static void testValues() {
+    begin();
+    // Texto depois de número: só _last; número depois de texto: estatísticas
+    add(0, "m/1", num(5.0), str("texto"), other(FLAT_BOOL, 1));
+    add(1, "m/1", str("falha"), integer(7), other(FLAT_BOOL, 0));
+    add(2, "m/1", other(FLAT_ABSENT), integer(9), other(FLAT_NULL));
+    agg.flushAll();
+    expectRows({ "0|esp32_logger|m/1|3,,,,falha,8,7,9,9,,,," });
+
+    add(3000, "m/1", num(5.0), other(FLAT_ABSENT), other(FLAT_BOOL, 1));
+    agg.flushAll();
+    expectRows({ "3000|esp32_logger|m/1|1,5,5,5,5,,,,,,,,true" });
+
+    // Muitos textos na mesma janela: o buffer compacta e o último fica
+    std::string last;
+    for (int i = 0; i < 200; i++) {
+        payloadUsed = 0;
+        last = "status-" + std::to_string(i) + std::string(40, 'z');
+        add(5000 + i, "m/1", num(i), str(last.c_str()), str("fixo"));
+    }
+    agg.flushAll();
+    CHECK_EQ(rows.size(), 1);
+    CHECK(rows.size() == 1 && rows[0].find("," + last + ",") != std::string::npos);
+    CHECK(rows.size() == 1 && rows[0].size() > 5 && rows[0].substr(rows[0].size() - 5) == ",fixo");
+    rows.clear();
+    payloadUsed = 0;
+}
+
+static void testKeys() {
+    begin();
+    size_t n = 4;
+    CHECK_EQ(agg.outputCount(), 1 + 3 * n);
+    char buf[64];
+    std::vector<std::string> names;
+    for (size_t i = 0; i < agg.outputCount(); i++) {
+        names.push_back(std::string(buf, agg.outputKey(i, keys, buf, sizeof(buf))));
+    }
+    CHECK(names[0] == "samples");
+    CHECK(names[1] == "tensao_mean" && names[4] == "tensao_last");
+    CHECK(names[5] == "corrente_mean" && names[12] == "status_last");
+    CHECK_EQ(agg.outputKey(1, keys, buf, 8), 8);
+    CHECK(std::string(buf, 8) == "ten_mean");
+
+    for (size_t i = 0; i < names.size(); i++) {
+        size_t len = names[i].size();
+        int in = Aggregator::inputOf(i, names[i].data(), len);
+        if (i == 0 || (i - 1) % n != 0) {
+            CHECK_EQ(in, -1);
+        } else {
+            CHECK_EQ(in, (i - 1) / n);
+            CHECK(std::string(names[i].data(), len) == keys[in].c_str());
+        }
+    }
+    size_t len = 5;
+    CHECK_EQ(Aggregator::inputOf(1, "tensa", len), -2);
+    len = 4;
+    CHECK_EQ(Aggregator::inputOf(0, "rows", len), -2);
+}
+
+static void testReference() {
+    begin();
+    CorpusRng r = { 4242 };
+    uint32_t now = 0;
+    size_t windows = 0;
+    for (int w = 0; w < 300; w++) {
+        size_t n = 1 + r.below(20);
+        double sum = 0, mn = 0, mx = 0, last = 0;
+        uint32_t start = now / 1000 * 1000;
+        for (size_t i = 0; i < n; i++) {
+            double x = ((int)r.below(200000) - 100000) / 100.0;
+            sum += x;
+            mn = (i == 0 || x < mn) ? x : mn;
+            mx = (i == 0 || x > mx) ? x : mx;
+            last = x;
+            add(start + (uint32_t)(i * 999 / n), "m/ref", num(x), other(FLAT_ABSENT),
+                other(FLAT_ABSENT));
+        }
+        now = start + 1000 * (1 + r.below(3));
+        agg.poll(now);
+
+        char expected[256];
+        std::string stats[4];
+        double values[4] = { sum / n, mn, mx, last };
+        for (size_t k = 0; k < 4; k++) {
+            char buf[64];
+            stats[k].assign(buf, formatDecimal(values[k], FLOAT_DECIMALS, buf, sizeof(buf)));
+        }
+        snprintf(expected, sizeof(expected), "%u|esp32_logger|m/ref|%u,%s,%s,%s,%s,,,,,,,,",
+                 (unsigned)start, (unsigned)n, stats[0].c_str(), stats[1].c_str(),
+                 stats[2].c_str(), stats[3].c_str());
+        if (!CHECK(rows.size() == 1 && rows[0] == expected)) {
+            fprintf(stderr, "    esperado: %s\n    obtido:   %s\n", expected,
+                    rows.empty() ? "(nada)" : rows[0].c_str());
+        }
+        rows.clear();
+        windows++;
+    }
+    printf("{\"case\":\"reference\",\"windows\":%u}\n", (unsigned)windows);
+}
+
+int main() {
+    testWindows();
+    testTopics();
+    testValues();
+    testKeys();
+    testReference();
+    return testDone("aggregator");
+}
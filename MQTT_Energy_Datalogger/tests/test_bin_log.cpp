@@ -0,0 +1,295 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO LOG BINÁRIO (PC)
+================================================================================
+
+Ida e volta do log binário: grava com BinLogWriter (bin_log.cpp), converte
+com a ferramenta tools/binlog2csv (caminho do executável no 1º argumento,
+passado pelo CMakeLists.txt) e compara com o CSV que o firmware gravaria
+com LOG_FORMAT_CSV (mesmo texto de printRow() em logger.cpp), byte a byte:
+
+- dense: esquema fixo (cabeçalho de um medidor), payloads de tests/corpus.h
+  com colunas ausentes, strings, reais, inteiros grandes, vários
+  client_id/tópicos, sessões novas no meio do arquivo e intervalos longos.
+- sparse: esquema esparso (LOG_SCHEMA_SPARSE): colunas declaradas quando
+  surgem, cabeçalho final com a união delas; chave repetida e campos
+  além de LOG_MAX_COLUMNS fora.
+- truncated: o arquivo cortado em vários pontos vira um prefixo do CSV
+  esperado (só linhas completas).
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include <vector>
+#include "bin_log.h"
+#include "column_dict.h"
+#include "column_map.h"
+#include "json_flatten.h"
+#include "json_stream.h"
+#include "check.h"
+#include "corpus.h"
+
+static const char *binlog2csv;
+static std::string dir;
+
+// Bytes gravados pelo BinLogWriter
+class StringPrint : public Print {
+public:
+    std::string data;
+
+    size_t write(uint8_t c) override {
+        data += (char)c;
+        return 1;
+    }
+    size_t write(const uint8_t *p, size_t len) override {
+        data.append((const char *)p, len);
+        return len;
+    }
+};
+
+static FlatArena arena;
+static FlatValue slots[MAX_KEYS];
+static String keys[MAX_KEYS];
+
+static std::string cellText(const FlatValue &v, const char *text) {
+    char buf[400];
+    int n = flatFormat(v, text, buf, sizeof(buf));
+    return (n > 0) ? std::string(buf, n) : std::string();
+}
+
+// "timestamp,client_id,topic" como em getTimestamp()/printRow()
+static std::string rowStart(uint32_t ms, const char *client, const char *topic) {
+    unsigned long s = ms / 1000;
+    unsigned long m = s / 60;
+    unsigned long h = m / 60;
+    char ts[32];
+    snprintf(ts, sizeof(ts), "T+%02luh%02lum%02lus", h, m % 60, s % 60);
+    return std::string(ts) + "," + client + "," + topic;
+}
+
+// Saída do binlog2csv para os bytes data
+static std::string convert(const std::string &data, const char *name) {
+    std::string path = dir + "/" + name;
+    FILE *f = fopen(path.c_str(), "wb");
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+
+    std::string cmd = std::string("\"") + binlog2csv + "\" \"" + path + "\" 2>/dev/null";
+    FILE *p = popen(cmd.c_str(), "r");
+    std::string out;
+    if (!CHECK(p != nullptr)) {
+        return out;
+    }
+    char buf[4096];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), p)) > 0) {
+        out.append(buf, n);
+    }
+    pclose(p);
+    return out;
+}
+
+// Primeira linha diferente, para o stderr
+static void showDiff(const std::string &got, const std::string &expected) {
+    size_t i = 0;
+    while (i < got.size() && i < expected.size() && got[i] == expected[i]) {
+        i++;
+    }
+    size_t start = expected.rfind('\n', i);
+    start = (start == std::string::npos) ? 0 : start + 1;
+    fprintf(stderr, "    esperado: %s\n    obtido:   %s\n",
+            expected.substr(start, expected.find('\n', i) - start).c_str(),
+            got.substr(start, got.find('\n', i) - start).c_str());
+}
+
+static const char *clients[] = { "esp32_logger", "mi-1", "gateway_2" };
+static const char *topics[] = { "MiEnergy/01", "MiEnergy/02/fase_b", "casa/quadro" };
+
+// Mensagem k do teste: fixas primeiro, depois sintéticas
+static std::string message(uint32_t k) {
+    return (k < corpusFixedCount) ? std::string(corpusFixed[k]) : corpusRandom(k);
+}
+
+static std::string denseExpected;
+
+static std::string writeDense(StringPrint &bin) {
+    static ColumnMap map;
+    BinLogWriter w;
+
+    // Cabeçalho: 1ª mensagem mais as chaves de algumas sintéticas
+    size_t count = 0;
+    for (uint32_t k : { 0u, 7u, 11u, 23u }) {
+        std::string m = message(k);
+        int n = streamFlattenToArena(m.data(), m.size(), arena);
+        for (int i = 0; i < n && count < MAX_KEYS; i++) {
+            std::string key(flatText(arena, arena.keys[i]), arena.keys[i].len);
+            bool seen = false;
+            for (size_t c = 0; c < count && !seen; c++) {
+                seen = (key == keys[c].c_str());
+            }
+            if (!seen) {
+                keys[count++] = key.c_str();
+            }
+        }
+    }
+    map.build(keys, count);
+
+    std::string csv = "timestamp,client_id,topic";
+    w.begin(bin);
+    w.writeSchema(count);
+    for (size_t c = 0; c < count; c++) {
+        w.writeSchemaKey(keys[c].c_str(), keys[c].length());
+        csv += "," + std::string(keys[c].c_str());
+    }
+    csv += "\r\n";
+    w.beginSession();
+
+    uint32_t ms = 0;
+    for (uint32_t k = 0; k < 600; k++) {
+        std::string m = message(k);
+        if (streamFlattenToColumns(m.data(), m.size(), map, arena, slots) < 0) {
+            continue;
+        }
+        // Sessões novas (reabertura do arquivo) e saltos de tempo
+        if (k % 97 == 96) {
+            w.beginSession();
+        }
+        ms += (k % 53 == 0) ? 3600000u + k : 250 + k % 700;
+        const char *client = clients[k % 3];
+        const char *topic = topics[(k / 3) % 3];
+
+        FlatValue cells[MAX_KEYS];
+        csv += rowStart(ms, client, topic);
+        for (size_t c = 0; c < count; c++) {
+            cells[c] = slots[map.canonical(c)];
+            csv += "," + cellText(cells[c], arena.text);
+        }
+        csv += "\r\n";
+        w.writeRow(ms, client, topic, arena.text, cells, count);
+    }
+    return csv;
+}
+
+static void testDense() {
+    StringPrint bin;
+    denseExpected = writeDense(bin);
+    std::string got = convert(bin.data, "dense.bin");
+    if (!CHECK(got == denseExpected)) {
+        showDiff(got, denseExpected);
+    }
+    printf("{\"case\":\"dense\",\"bin_bytes\":%u,\"csv_bytes\":%u}\n",
+           (unsigned)bin.data.size(), (unsigned)denseExpected.size());
+
+    // Cortado: só linhas completas, na ordem
+    size_t cuts = 0;
+    for (size_t cut = bin.data.size() / 7; cut < bin.data.size(); cut += bin.data.size() / 7) {
+        std::string part = convert(bin.data.substr(0, cut), "truncated.bin");
+        CHECK(part.size() < denseExpected.size());
+        CHECK(denseExpected.compare(0, part.size(), part) == 0);
+        CHECK(part.empty() || part.compare(part.size() - 2, 2, "\r\n") == 0);
+        cuts++;
+    }
+    printf("{\"case\":\"truncated\",\"cuts\":%u}\n", (unsigned)cuts);
+}
+
+static void testSparse() {
+    StringPrint bin;
+    BinLogWriter w;
+    w.begin(bin);
+    w.writeSchema(0);
+    w.beginSession();
+
+    std::map<std::string, uint16_t> dict;
+    std::vector<std::string> names;
+    std::vector<std::string> lines;
+    std::vector<std::map<uint16_t, std::string>> cells;
+
+    uint32_t ms = 0;
+    unsigned dropped = 0;
+    for (uint32_t k = 0; k < 400; k++) {
+        std::string m = message(k);
+        int n = streamFlattenToArena(m.data(), m.size(), arena);
+        if (n < 0) {
+            continue;
+        }
+        if (k % 131 == 130) {
+            // Sessão nova: o dicionário de colunas é declarado de novo
+            w.beginSession();
+            for (size_t i = 0; i < names.size(); i++) {
+                w.writeColumn(i, names[i].data(), names[i].size());
+            }
+        }
+
+        uint16_t columns[MAX_KEYS];
+        std::map<uint16_t, std::string> row;
+        for (int i = 0; i < n; i++) {
+            std::string key(flatText(arena, arena.keys[i]), arena.keys[i].len);
+            auto it = dict.find(key);
+            // Dicionário cheio: campo fora do arquivo
+            if (it == dict.end() && names.size() >= LOG_MAX_COLUMNS) {
+                columns[i] = COLUMN_DROPPED;
+                dropped++;
+                continue;
+            }
+            if (it == dict.end()) {
+                it = dict.emplace(key, (uint16_t)names.size()).first;
+                names.push_back(key);
+                w.writeColumn(it->second, key.data(), key.size());
+            }
+            // Chave repetida na mesma mensagem: vale a 1ª
+            if (row.count(it->second)) {
+                columns[i] = COLUMN_DROPPED;
+                continue;
+            }
+            columns[i] = it->second;
+            row[it->second] = cellText(arena.values[i], arena.text);
+        }
+
+        ms += 1000 + k % 333;
+        const char *client = clients[k % 3];
+        const char *topic = topics[k % 3];
+        w.writeSparseRow(ms, client, topic, arena.text, arena.values, columns, n);
+        lines.push_back(rowStart(ms, client, topic));
+        cells.push_back(row);
+    }
+
+    std::string expected = "timestamp,client_id,topic";
+    for (const std::string &name : names) {
+        expected += "," + name;
+    }
+    expected += "\r\n";
+    for (size_t r = 0; r < lines.size(); r++) {
+        expected += lines[r];
+        for (size_t c = 0; c < names.size(); c++) {
+            auto it = cells[r].find((uint16_t)c);
+            expected += "," + (it == cells[r].end() ? std::string() : it->second);
+        }
+        expected += "\r\n";
+    }
+
+    std::string got = convert(bin.data, "sparse.bin");
+    if (!CHECK(got == expected)) {
+        showDiff(got, expected);
+    }
+    CHECK(dropped > 0);
+    printf("{\"case\":\"sparse\",\"rows\":%u,\"columns\":%u,\"dropped\":%u,"
+           "\"bin_bytes\":%u,\"csv_bytes\":%u}\n",
+           (unsigned)lines.size(), (unsigned)names.size(), dropped,
+           (unsigned)bin.data.size(), (unsigned)expected.size());
+}
+
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        fprintf(stderr, "uso: %s <binlog2csv>\n", argv[0]);
+        return 2;
+    }
+    binlog2csv = argv[1];
+    dir = testSdDir();
+
+    testDense();
+    testSparse();
+    return testDone("bin_log");
+}
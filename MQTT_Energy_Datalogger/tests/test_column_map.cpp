@@ -0,0 +1,159 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO COLUMN MAP (PC)
+================================================================================
+
+Confere o ColumnMap (column_map.cpp) e flattenToColumns() contra a busca
+linear que eles substituíram (findValueForKey: para cada coluna do
+cabeçalho, o 1º campo achatado com a mesma chave):
+
+- lookup: MAX_KEYS chaves, todas achadas na coluna certa; chave repetida
+  no cabeçalho aponta para a 1ª ocorrência (canonical); chaves de fora,
+  prefixos e chaves vazias dão -1; add() depois do build().
+- columns: para cada payload de tests/corpus.h, com o cabeçalho de outra
+  mensagem (mais uma coluna repetida e uma que nunca aparece), o valor de
+  cada coluna em flattenToColumns() (com a poda de wants()) é o da busca
+  linear sobre flattenToArena(), no mesmo texto do CSV.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <string>
+#include <vector>
+#include "column_map.h"
+#include "json_flatten.h"
+#include "check.h"
+#include "corpus.h"
+
+static FlatArena arena;
+static FlatArena refArena;
+static FlatValue slots[MAX_KEYS];
+static String keys[MAX_KEYS + 1];
+
+static std::string cellText(const FlatValue &v, const char *text) {
+    char buf[400];
+    int n = flatFormat(v, text, buf, sizeof(buf));
+    return (n > 0) ? std::string(buf, n) : std::string();
+}
+
+static void testLookup() {
+    static ColumnMap map;
+    char key[32];
+    for (size_t i = 0; i < MAX_KEYS; i++) {
+        snprintf(key, sizeof(key), "campo_%u_%c", (unsigned)(i * 7919u), 'a' + (char)(i % 26));
+        keys[i] = key;
+    }
+    // Repetida: aponta para a 1ª
+    keys[MAX_KEYS - 1] = keys[3];
+    map.build(keys, MAX_KEYS);
+
+    for (size_t i = 0; i < MAX_KEYS - 1; i++) {
+        CHECK_EQ(map.find(keys[i]), i);
+        CHECK_EQ(map.canonical(i), i);
+    }
+    CHECK_EQ(map.canonical(MAX_KEYS - 1), 3);
+    CHECK_EQ(map.find("campo_0", 7), -1);
+    CHECK_EQ(map.find("", 0), -1);
+    CHECK_EQ(map.find("nao_existe", 10), -1);
+    CHECK_EQ(map.add(), -1);
+
+    // add(): coluna nova depois do build()
+    static ColumnMap small;
+    keys[0] = "tensao";
+    keys[1] = "corrente";
+    small.build(keys, 2);
+    CHECK_EQ(small.find("fp", 2), -1);
+    keys[2] = "fp";
+    CHECK_EQ(small.add(), 2);
+    CHECK_EQ(small.find("fp", 2), 2);
+    CHECK(small.wants("qualquer", 8));
+}
+
+// Cabeçalho: chaves achatadas de header (na ordem), mais uma repetida e
+// uma que não aparece em nenhuma mensagem
+static size_t headerFrom(const char *header) {
+    DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+    deserializeJson(doc, header);
+    size_t n = flattenToArena(doc.as<JsonVariantConst>(), arena);
+    size_t count = 0;
+    for (size_t i = 0; i < n && count < MAX_KEYS - 2; i++) {
+        keys[count++] = std::string(flatText(arena, arena.keys[i]), arena.keys[i].len).c_str();
+    }
+    if (count > 0) {
+        keys[count] = keys[0];
+        count++;
+    }
+    keys[count++] = "coluna_ausente";
+    return count;
+}
+
+// Compara as duas formas para a mensagem json; devolve as colunas conferidas
+static size_t compare(const ColumnMap &map, size_t count, const char *json) {
+    DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+    if (deserializeJson(doc, json)) {
+        return 0;
+    }
+    JsonVariantConst root = doc.as<JsonVariantConst>();
+
+    size_t n = flattenToArena(root, refArena);
+    flattenToColumns(root, map, arena, slots);
+    CHECK(!refArena.overflow);
+
+    for (size_t c = 0; c < count; c++) {
+        std::string expected;
+        bool found = false;
+        for (size_t j = 0; j < n && !found; j++) {
+            FlatSlice k = refArena.keys[j];
+            if (k.len == keys[c].length() &&
+                memcmp(flatText(refArena, k), keys[c].c_str(), k.len) == 0) {
+                expected = cellText(refArena.values[j], refArena.text);
+                found = true;
+            }
+        }
+        const FlatValue &v = slots[map.canonical(c)];
+        std::string got = cellText(v, arena.text);
+        if (!CHECK(got == expected) || !CHECK(found == (v.type != FLAT_ABSENT))) {
+            fprintf(stderr, "    coluna %s: '%s' != '%s'\n    %s\n",
+                    keys[c].c_str(), got.c_str(), expected.c_str(), json);
+        }
+    }
+    return count;
+}
+
+static void testColumns() {
+    static ColumnMap map;
+    size_t messages = 0;
+    size_t cells = 0;
+
+    // Cabeçalho de cada payload fixo contra todos os fixos
+    for (size_t h = 0; h < corpusFixedCount; h++) {
+        size_t count = headerFrom(corpusFixed[h]);
+        map.build(keys, count);
+        for (size_t m = 0; m < corpusFixedCount; m++) {
+            cells += compare(map, count, corpusFixed[m]);
+            messages++;
+        }
+    }
+
+    // Medidores sintéticos: cabeçalho de uma mensagem, as seguintes contra ele
+    for (uint32_t seed = 1; seed <= 200; seed++) {
+        std::string header = corpusRandom(seed);
+        size_t count = headerFrom(header.c_str());
+        map.build(keys, count);
+        for (uint32_t k = 0; k < 20; k++) {
+            std::string msg = corpusRandom(seed * 1000 + k);
+            cells += compare(map, count, msg.c_str());
+            messages++;
+        }
+    }
+    printf("{\"case\":\"columns\",\"messages\":%u,\"cells\":%u}\n",
+           (unsigned)messages, (unsigned)cells);
+}
+
+int main() {
+    testLookup();
+    testColumns();
+    return testDone("column_map");
+}
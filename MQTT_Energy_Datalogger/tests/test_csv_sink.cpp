@@ -0,0 +1,229 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO CSV SINK (PC)
+================================================================================
+
+Confere o csv_sink.cpp (config.h em vigor) sobre o "cartão" de tools/host,
+que conta aberturas, escritas e flushes e simula escritas incompletas:
+
+- per_1000_rows: 1000 linhas de um medidor = um SD.open(), um write() e
+  um flush() por bloco de CSV_SINK_BUFFER_SIZE bytes; o arquivo tem as
+  linhas na ordem. Imprime as contagens.
+- retry: o bloco que o SD gravou pela metade fica no buffer e é regravado
+  após CSV_SINK_RETRY_MS, sem repetir o que já chegou ao arquivo (append)
+  e por cima do mesmo trecho (pré-alocado); nenhuma linha se perde.
+- overflow: com o SD falhando, o buffer enche e as linhas seguintes são
+  descartadas inteiras; o arquivo só tem linhas completas, na ordem, e
+  gravadas + stats().dropped = enviadas.
+- row_flush: uma linha longa enche o buffer no meio; o descarregamento
+  falha (metade gravada) e a linha é descartada sem deixar nada dela no
+  arquivo; depois outra linha longa passa inteira, com o começo dela
+  levado para o início do buffer.
+
+Com LOG_COMPRESS, o arquivo é lido descomprimido (testReadLog()) e as
+contagens de bytes são as do texto (stats().rawBytes).
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string>
+#include "csv_sink.h"
+#include "check.h"
+
+static std::string rowText(unsigned i) {
+    char line[96];
+    snprintf(line, sizeof(line), "T+%u,esp32_logger,MiEnergy/01,%u.%02u,%u,%u.%03u\r\n",
+             i * 1000, 220 + i % 7, i % 100, i % 50, i % 3, i % 1000);
+    return line;
+}
+
+static void putRow(CsvSink &sink, unsigned i) {
+    std::string line = rowText(i);
+    sink.beginRow();
+    // Em pedaços, como o printRow() do logger
+    size_t half = line.size() / 2;
+    sink.write((const uint8_t *)line.data(), half);
+    sink.write((const uint8_t *)line.data() + half, line.size() - half);
+    sink.endRow();
+    sink.poll();
+}
+
+// Linhas do arquivo: todas completas e em ordem crescente; devolve quantas
+static unsigned checkLines(const std::string &data, unsigned total) {
+    unsigned count = 0;
+    unsigned next = 0;
+    size_t pos = 0;
+    while (pos < data.size()) {
+        size_t end = data.find("\r\n", pos);
+        if (!CHECK(end != std::string::npos)) {
+            break;
+        }
+        std::string line = data.substr(pos, end + 2 - pos);
+        while (next < total && rowText(next) != line) {
+            next++;
+        }
+        if (!CHECK(next < total)) {
+            break;
+        }
+        next++;
+        count++;
+        pos = end + 2;
+    }
+    return count;
+}
+
+static void testPer1000Rows() {
+    hostFs = HostFsStats();
+    CsvSink sink;
+    CHECK(sink.begin("/rows.csv"));
+
+    std::string expected;
+    for (unsigned i = 0; i < 1000; i++) {
+        putRow(sink, i);
+        expected += rowText(i);
+    }
+    sink.end();
+
+    HostFsStats sd = hostFs;
+    unsigned long blocks = (expected.size() + CSV_SINK_BUFFER_SIZE - 1) / CSV_SINK_BUFFER_SIZE;
+    CHECK_EQ(sd.opens, 1);
+    CHECK_EQ(sd.writes, blocks);
+    CHECK_EQ(sd.flushes, blocks);
+#if LOG_COMPRESS
+    CHECK_EQ(sink.stats().rawBytes, expected.size());
+    CHECK(sink.stats().bytes < expected.size());
+#else
+    CHECK_EQ(sink.stats().bytes, expected.size());
+#endif
+    CHECK(testReadLog("/rows.csv") == expected);
+
+    printf("{\"case\":\"per_1000_rows\",\"bytes\":%u,\"opens\":%lu,\"writes\":%lu,\"flushes\":%lu}\n",
+           (unsigned)expected.size(), sd.opens, sd.writes, sd.flushes);
+}
+
+static void testRetry(bool prealloc) {
+    const char *path = prealloc ? "/retry_pre.csv" : "/retry.csv";
+    CsvSink sink;
+    CHECK(prealloc ? sink.beginPreallocated(path, 64 * 1024) : sink.begin(path));
+
+    std::string expected;
+    unsigned i = 0;
+    for (; i < 20; i++) {
+        putRow(sink, i);
+        expected += rowText(i);
+    }
+    // Descarregamento por idade sai pela metade
+    hostFs.shortWrites = 1;
+    hostMillis += CSV_SINK_FLUSH_MS;
+    sink.poll();
+    CHECK_EQ(sink.stats().errors, 1);
+    // Antes de CSV_SINK_RETRY_MS nada é regravado
+    unsigned long writes = hostFs.writes;
+    CHECK(!sink.flush());
+    CHECK_EQ(hostFs.writes, writes);
+
+    hostMillis += CSV_SINK_RETRY_MS;
+    for (unsigned n = 0; n < 200; n++) {
+        putRow(sink, i);
+        expected += rowText(i++);
+    }
+    sink.end();
+
+    std::string data = testReadLog(path, prealloc ? sink.size() : std::string::npos);
+    CHECK_EQ(sink.stats().dropped, 0);
+    CHECK_EQ(data.size(), expected.size());
+    CHECK(data == expected);
+    printf("{\"case\":\"retry\",\"prealloc\":%s,\"rows\":%u,\"errors\":%u,\"dropped\":%u}\n",
+           prealloc ? "true" : "false", i, (unsigned)sink.stats().errors,
+           (unsigned)sink.stats().dropped);
+}
+
+static void testOverflow() {
+    CsvSink sink;
+    CHECK(sink.begin("/overflow.csv"));
+
+    // SD falhando por 3 s, uma linha a cada 10 ms
+    const unsigned total = 600;
+    unsigned i = 0;
+    hostFs.shortWrites = 1000000;
+    for (; i < 300; i++) {
+        putRow(sink, i);
+        hostMillis += 10;
+    }
+    CHECK(sink.stats().dropped > 0);
+    hostFs.shortWrites = 0;
+    for (; i < total; i++) {
+        putRow(sink, i);
+        hostMillis += 10;
+    }
+    hostMillis += CSV_SINK_RETRY_MS;
+    sink.end();
+
+    unsigned lines = checkLines(testReadLog("/overflow.csv"), total);
+    CHECK_EQ(lines + sink.stats().dropped, total);
+    printf("{\"case\":\"overflow\",\"rows\":%u,\"written\":%u,\"dropped\":%u}\n",
+           total, lines, (unsigned)sink.stats().dropped);
+}
+
+static void testRowFlush() {
+    CsvSink sink;
+    CHECK(sink.begin("/row_flush.csv"));
+
+    std::string expected;
+    unsigned i = 0;
+    for (; i < 10; i++) {
+        putRow(sink, i);
+        expected += rowText(i);
+    }
+
+    // Linha longa (cabe no buffer) em três pedaços
+    auto longRow = [](char fill) {
+        return "T+999,esp32_logger,MiEnergy/01," + std::string(3900, fill) + "\r\n";
+    };
+    std::string line = longRow('9');
+    auto putLong = [&]() {
+        sink.beginRow();
+        sink.write((const uint8_t *)line.data(), 1000);
+        sink.write((const uint8_t *)line.data() + 1000, 2000);
+        sink.write((const uint8_t *)line.data() + 3000, line.size() - 3000);
+        sink.endRow();
+    };
+
+    // O SD grava metade do bloco no descarregamento do meio da linha
+    hostFs.shortWrites = 1;
+    unsigned long errors = sink.stats().errors;
+    putLong();
+    CHECK_EQ(sink.stats().errors, errors + 1);
+    CHECK_EQ(sink.stats().dropped, 1);
+
+    hostMillis += CSV_SINK_RETRY_MS;
+    line = longRow('8');
+    putLong();
+    expected += line;
+    for (; i < 30; i++) {
+        putRow(sink, i);
+        expected += rowText(i);
+    }
+    sink.end();
+
+    std::string data = testReadLog("/row_flush.csv");
+    CHECK_EQ(sink.stats().dropped, 1);
+    CHECK_EQ(data.size(), expected.size());
+    CHECK(data == expected);
+    printf("{\"case\":\"row_flush\",\"rows\":%u,\"errors\":%u,\"dropped\":%u}\n", i + 2,
+           (unsigned)sink.stats().errors, (unsigned)sink.stats().dropped);
+}
+
+int main() {
+    testSdDir();
+    hostMillis = 0;
+
+    testPer1000Rows();
+    testRetry(false);
+    testRetry(true);
+    testOverflow();
+    testRowFlush();
+    return testDone("csv_sink");
+}
@@ -0,0 +1,373 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO DEADBAND (PC)
+================================================================================
+
+Confere o filtro de variação (deadband.cpp) com um relógio sintético (o
+módulo recebe now do chamador). O deadband.cpp entra aqui ligado, com
+COLUMN_DEADBAND = "freq:0.05;tensao_*:0.5%;fp:0.01",
+DEADBAND_HEARTBEAT_MS = 10000 e DEADBAND_FIELDS = TEST_FIELDS (o
+CMakeLists.txt compila este arquivo com 0 e com 1), o resto do config.h
+em vigor.
+
+- bands: faixa absoluta (freq) e relativa (tensao_*) no limite e além
+  dele, sempre contra o último valor gravado; coluna sem regra e textos:
+  qualquer diferença; campo ausente não conta; com DEADBAND_FIELDS, só os
+  campos que mudaram ficam na linha gravada.
+- heartbeat: valores parados saem a cada DEADBAND_HEARTBEAT_MS da última
+  linha gravada, completos (a primeira do tópico também).
+- topics: tópicos com valores próprios; além de DEADBAND_MAX_TOPICS, o
+  de gravação mais antiga perde os valores e a próxima linha sai completa.
+- reconstruct: dois medidores por 1 h (uma mensagem por segundo):
+  repetindo o último valor gravado de cada coluna (forward fill), toda
+  amostra fica dentro da faixa da sua coluna. Imprime os bytes do CSV
+  sem o filtro, com o filtro de linhas e (DEADBAND_FIELDS) de campos.
+
+================================================================================
+*/
+
+#include "config.h"
+#undef DEADBAND_ENABLED
+#define DEADBAND_ENABLED 1
+#undef COLUMN_DEADBAND
+#define COLUMN_DEADBAND "freq:0.05;tensao_*:0.5%;fp:0.01"
+#undef DEADBAND_HEARTBEAT_MS
+#define DEADBAND_HEARTBEAT_MS 10000
+#undef DEADBAND_FIELDS
+#define DEADBAND_FIELDS TEST_FIELDS
+#include "deadband.cpp"
+
+#include <string>
+#include <vector>
+#include "check.h"
+#include "corpus.h"
+
+enum { C_DEVICE, C_TENSAO_A, C_TENSAO_B, C_FREQ, C_ENERGIA, C_FP, C_STATUS, COLS };
+
+static const char *const keyNames[COLS] = {
+    "device", "tensao_a", "tensao_b", "freq", "energia", "fp", "status"
+};
+
+static Deadband deadband;
+
+// Uma mensagem: números (NAN = campo ausente) e textos (nullptr = ausente)
+struct Sample {
+    const char *device;
+    double tensaoA, tensaoB, freq, energia, fp;
+    const char *status;
+};
+
+static char text[128];
+static FlatValue cells[COLS];
+
+static FlatValue num(double d) {
+    FlatValue v = {};
+    if (!isnan(d)) {
+        v.type = FLAT_REAL;
+        v.decimals = FLOAT_DECIMALS;
+        v.d = d;
+    }
+    return v;
+}
+
+static FlatValue str(const char *s, size_t &used) {
+    FlatValue v = {};
+    if (s) {
+        v.type = FLAT_TEXT;
+        v.text.off = (uint16_t)used;
+        v.text.len = (uint16_t)strlen(s);
+        memcpy(text + used, s, v.text.len);
+        used += v.text.len;
+    }
+    return v;
+}
+
+static void fill(const Sample &s) {
+    size_t used = 0;
+    cells[C_DEVICE] = str(s.device, used);
+    cells[C_TENSAO_A] = num(s.tensaoA);
+    cells[C_TENSAO_B] = num(s.tensaoB);
+    cells[C_FREQ] = num(s.freq);
+    cells[C_ENERGIA] = num(s.energia);
+    cells[C_FP] = num(s.fp);
+    cells[C_STATUS] = str(s.status, used);
+}
+
+static std::string cellText(const FlatValue &v) {
+    char buf[64];
+    int n = flatFormat(v, text, buf, sizeof(buf));
+    return (n > 0) ? std::string(buf, n) : std::string();
+}
+
+// Células da linha como "a,b,..." ("-" se descartada)
+static std::string row(uint32_t now, const char *topic, const Sample &s) {
+    fill(s);
+    if (!deadband.filter(now, topic, text, cells)) {
+        return "-";
+    }
+    std::string r;
+    for (size_t i = 0; i < COLS; i++) {
+        r += (i ? "," : "") + cellText(cells[i]);
+    }
+    return r;
+}
+
+static void begin() {
+    static String keys[COLS];
+    for (size_t i = 0; i < COLS; i++) {
+        keys[i] = keyNames[i];
+    }
+    deadband = Deadband();
+    deadband.begin(keys, COLS);
+}
+
+// Linha gravada: completa, ou (DEADBAND_FIELDS) só com o que mudou
+static std::string changed(const char *full, const char *fields) {
+    return TEST_FIELDS ? fields : full;
+}
+
+static void testBands() {
+    begin();
+    const char *t = "MiEnergy/01";
+    Sample s = { "m1", 220.0, 230.0, 60.0, 100.0, 0.95, "ok" };
+    uint32_t now = 0;
+    CHECK(row(now, t, s) == "m1,220,230,60,100,0.95,ok");
+
+    // Absoluta: 0.05 em freq
+    s.freq = 60.05;
+    CHECK(row(now += 1000, t, s) == "-");
+    s.freq = 59.95;
+    CHECK(row(now += 1000, t, s) == "-");
+    s.freq = 60.06;
+    CHECK(row(now += 1000, t, s) == changed("m1,220,230,60.06,100,0.95,ok", ",,,60.06,,,"));
+    // Contra o último gravado (60.06), não o primeiro
+    s.freq = 60.1;
+    CHECK(row(now += 1000, t, s) == "-");
+    s.freq = 60.0;
+    CHECK(row(now += 1000, t, s) == changed("m1,220,230,60,100,0.95,ok", ",,,60,,,"));
+
+    // Relativa: 0.5% de 220 = 1.1
+    s.tensaoA = 221.0;
+    CHECK(row(now += 1000, t, s) == "-");
+    s.tensaoA = 218.95;
+    CHECK(row(now += 1000, t, s) == "-");
+    s.tensaoA = 221.2;
+    CHECK(row(now += 1000, t, s) == changed("m1,221.2,230,60,100,0.95,ok", ",221.2,,,,,"));
+    // 0.5% de 221.2 = 1.106
+    s.tensaoA = 220.1;
+    CHECK(row(now += 1000, t, s) == "-");
+    // A outra coluna da regra tem faixa própria (230: 1.15)
+    s.tensaoB = 231.1;
+    CHECK(row(now += 1000, t, s) == "-");
+    s.tensaoB = 231.2;
+    CHECK(row(now += 1000, t, s) == changed("m1,220.1,231.2,60,100,0.95,ok", ",,231.2,,,,"));
+
+    // Sem regra: qualquer diferença; inteiro e real iguais não mudam
+    s.energia = 100.001;
+    CHECK(row(now += 1000, t, s) == changed("m1,220.1,231.2,60,100.001,0.95,ok", ",,,,100.001,,"));
+    fill(s);
+    cells[C_ENERGIA].type = FLAT_INT;
+    cells[C_ENERGIA].i = 100;
+    CHECK(deadband.filter(now += 1000, t, text, cells));
+    cells[C_ENERGIA].i = 100;
+    CHECK(!deadband.filter(now += 1000, t, text, cells));
+    s.energia = 100.0;
+    CHECK(row(now += 1000, t, s) == "-");
+
+    // Texto: qualquer diferença; número depois de texto muda
+    s.status = "alarme";
+    CHECK(row(now += 1000, t, s) == changed("m1,220.1,231.2,60,100,0.95,alarme", ",,,,,,alarme"));
+    s.status = "alarme";
+    CHECK(row(now += 1000, t, s) == "-");
+    fill(s);
+    cells[C_STATUS] = num(5);
+    CHECK(deadband.filter(now += 1000, t, text, cells));
+    CHECK(cells[C_STATUS].type == FLAT_REAL);
+
+    // Ausente não conta como mudança, nem apaga o valor guardado
+    Sample partial = { nullptr, NAN, NAN, 60.0, NAN, NAN, nullptr };
+    CHECK(row(now += 1000, t, partial) == "-");
+    partial.fp = 0.97;
+    CHECK(row(now += 1000, t, partial) == changed(",,,60,,0.97,", ",,,,,0.97,"));
+    s.fp = 0.97;
+    s.status = "alarme";
+    CHECK(row(now += 1000, t, s) == changed("m1,220.1,231.2,60,100,0.97,alarme", ",,,,,,alarme"));
+}
+
+static void testHeartbeat() {
+    begin();
+    const char *t = "MiEnergy/02";
+    Sample s = { "m2", 220.0, 230.0, 60.0, 100.0, 0.95, "ok" };
+    const char *full = "m2,220,230,60,100,0.95,ok";
+
+    std::vector<uint32_t> written;
+    std::vector<std::string> rows;
+    for (uint32_t now = 0; now <= 40000; now += 1000) {
+        // Uma mudança no meio: o heartbeat conta da última gravada
+        s.energia = (now >= 15000) ? 101.0 : 100.0;
+        std::string r = row(now, t, s);
+        if (r != "-") {
+            written.push_back(now);
+            rows.push_back(r);
+        }
+    }
+    CHECK((written == std::vector<uint32_t>{ 0, 10000, 15000, 25000, 35000 }));
+    if (CHECK(rows.size() == 5)) {
+        CHECK(rows[0] == full);
+        CHECK(rows[1] == full);
+        CHECK(rows[2] == changed("m2,220,230,60,101,0.95,ok", ",,,,101,,"));
+        CHECK(rows[3] == "m2,220,230,60,101,0.95,ok");
+        CHECK(rows[4] == "m2,220,230,60,101,0.95,ok");
+    }
+}
+
+static void testTopics() {
+    begin();
+    Sample s = { "m", 220.0, 230.0, 60.0, 100.0, 0.95, "ok" };
+    const char *full = "m,220,230,60,100,0.95,ok";
+    char topics[DEADBAND_MAX_TOPICS + 1][16];
+    for (size_t k = 0; k <= DEADBAND_MAX_TOPICS; k++) {
+        snprintf(topics[k], sizeof(topics[k]), "medidor/%u", (unsigned)k);
+    }
+
+    // Primeira de cada tópico: completa; depois, iguais são descartadas
+    uint32_t now = 0;
+    for (size_t k = 0; k < DEADBAND_MAX_TOPICS; k++) {
+        CHECK(row(now += 100, topics[k], s) == full);
+    }
+    for (size_t k = 0; k < DEADBAND_MAX_TOPICS; k++) {
+        CHECK(row(now += 100, topics[k], s) == "-");
+    }
+    // Valores por tópico: a mudança de um não vale para o outro
+    s.freq = 61.0;
+    CHECK(row(now += 100, topics[1], s) == changed("m,220,230,61,100,0.95,ok", ",,,61,,,"));
+    CHECK(row(now += 100, topics[2], s) == changed("m,220,230,61,100,0.95,ok", ",,,61,,,"));
+    s.freq = 60.0;
+    CHECK(row(now += 100, topics[3], s) == "-");
+
+    // Um a mais: sai o de gravação mais antiga (medidor/0)
+    CHECK(row(now += 100, topics[DEADBAND_MAX_TOPICS], s) == full);
+    CHECK(row(now += 100, topics[3], s) == "-");
+    CHECK(row(now += 100, topics[0], s) == full);
+}
+
+// Faixa da coluna i em torno do valor ref (como Deadband::changed())
+static double bandOf(size_t i, double ref) {
+    switch (i) {
+        case C_FREQ:     return (float)0.05;
+        case C_FP:       return (float)0.01;
+        case C_TENSAO_A:
+        case C_TENSAO_B: return fabs(ref) * (float)(0.5 / 100.0);
+        default:         return 0.0;
+    }
+}
+
+// Linha CSV como o logger a grava (ms, client_id, tópico e células)
+static size_t csvBytes(uint32_t now, const char *topic) {
+    size_t n = std::to_string(now).size() + strlen(",esp32_logger,") + strlen(topic) + 2;
+    for (size_t i = 0; i < COLS; i++) {
+        n += 1 + cellText(cells[i]).size();
+    }
+    return n;
+}
+
+static void testReconstruct() {
+    begin();
+    CorpusRng r = { 2024 };
+    const char *topics[2] = { "MiEnergy/01", "MiEnergy/02" };
+
+    struct Meter {
+        double tensaoA, tensaoB, freq, energia, fp;
+        bool alarm;
+        std::string ff[COLS];       // Último valor gravado (texto)
+        double ffNum[COLS];         // ... e o número, se for
+        bool ffIsNum[COLS];
+    } meters[2];
+    for (Meter &m : meters) {
+        m = Meter();
+        m.tensaoA = 220.0;
+        m.tensaoB = 221.0;
+        m.freq = 60.0;
+        m.energia = 1000.0;
+        m.fp = 0.95;
+        m.alarm = false;
+    }
+
+    size_t rawBytes = 0, rowBytes = 0, fieldBytes = 0;
+    unsigned samples = 0, written = 0, outside = 0;
+    for (uint32_t now = 0; now < 3600 * 1000; now += 1000) {
+        for (size_t k = 0; k < 2; k++) {
+            Meter &m = meters[k];
+            // Ruído em torno do nominal até meia faixa, energia subindo a
+            // cada minuto
+            m.tensaoA = 220.0 + (double)r.below(101) / 100.0 - 0.5;
+            m.tensaoB = 221.0 + (double)r.below(101) / 100.0 - 0.5;
+            m.freq = 60.0 + (double)r.below(5) / 100.0 - 0.02;
+            m.fp = 0.95 + (double)r.below(9) / 1000.0 - 0.004;
+            if ((now / 1000) % 60 == 59) {
+                m.energia += 0.01 * (double)(1 + r.below(3));
+            }
+            if (r.below(600) == 0) {
+                m.alarm = !m.alarm;
+            }
+            char device[8];
+            snprintf(device, sizeof(device), "m%u", (unsigned)k);
+            Sample s = { device, m.tensaoA, m.tensaoB, m.freq, m.energia, m.fp,
+                         m.alarm ? "alarme" : "ok" };
+
+            fill(s);
+            FlatValue sample[COLS];
+            memcpy(sample, cells, sizeof(sample));
+            size_t bytes = csvBytes(now, topics[k]);
+            rawBytes += bytes;
+            samples++;
+
+            if (deadband.filter(now, topics[k], text, cells)) {
+                written++;
+                rowBytes += bytes;
+                fieldBytes += csvBytes(now, topics[k]);
+                for (size_t i = 0; i < COLS; i++) {
+                    if (cells[i].type == FLAT_ABSENT) {
+                        continue;
+                    }
+                    m.ff[i] = cellText(cells[i]);
+                    m.ffIsNum[i] = flatIsNumber(cells[i]);
+                    m.ffNum[i] = m.ffIsNum[i] ? flatNumber(cells[i]) : 0.0;
+                }
+            }
+
+            // Forward fill: cada amostra dentro da faixa do valor repetido
+            for (size_t i = 0; i < COLS; i++) {
+                bool ok;
+                if (flatIsNumber(sample[i])) {
+                    double v = flatNumber(sample[i]);
+                    ok = m.ffIsNum[i] && fabs(v - m.ffNum[i]) <= bandOf(i, m.ffNum[i]);
+                } else {
+                    ok = !m.ffIsNum[i] && m.ff[i] == cellText(sample[i]);
+                }
+                if (!ok && outside++ == 0) {
+                    fprintf(stderr, "    %s %u ms: %s = %s, repetido %s\n", topics[k], now,
+                            keyNames[i], cellText(sample[i]).c_str(), m.ff[i].c_str());
+                }
+            }
+        }
+    }
+
+    CHECK_EQ(outside, 0);
+    // Heartbeat a cada 10 s (e a energia a cada minuto): ~1 linha em 10
+    CHECK(written * 4 < samples);
+    CHECK(rowBytes * 4 < rawBytes);
+    CHECK(TEST_FIELDS ? fieldBytes < rowBytes : fieldBytes == rowBytes);
+    printf("{\"case\":\"reconstruct\",\"fields\":%d,\"samples\":%u,\"rows\":%u,"
+           "\"bytes_raw\":%u,\"bytes_rows\":%u,\"bytes\":%u,\"saved\":%.3f}\n",
+           TEST_FIELDS, samples, written, (unsigned)rawBytes, (unsigned)rowBytes,
+           (unsigned)fieldBytes, 1.0 - (double)fieldBytes / (double)rawBytes);
+}
+
+int main() {
+    testBands();
+    testHeartbeat();
+    testTopics();
+    testReconstruct();
+    return testDone(TEST_FIELDS ? "deadband_fields" : "deadband");
+}
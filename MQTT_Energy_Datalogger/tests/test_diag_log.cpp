@@ -0,0 +1,128 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO DIAG LOG (PC)
+================================================================================
+
+Confere diag_log.cpp e o uso dele no pipeline (config.h em vigor):
+
+- ring: sem a task de escoamento, o buffer aceita linhas até
+  DIAG_RING_SIZE bytes e descarta (e conta) as que não cabem, inteiras;
+  diagWrite() é tudo ou nada; linha longa truncada em DIAG_LINE_MAX. Com
+  a task (diagInit()), tudo chega ao Serial, com o aviso de descartes.
+- steady: com o cabeçalho criado, milhares de mensagens pelo
+  processMessage() (e loggerLoop()/loggerFlush()) não geram nenhuma
+  linha de diagnóstico nem escrita no Serial; um JSON inválido gera
+  exatamente uma (DIAG_WARN; nenhuma abaixo de DIAG_LEVEL_WARN). Com
+  ROW_SINK_SERIAL, as linhas do log no Serial passam pelo mesmo buffer:
+  só o aviso do JSON inválido é conferido.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string>
+#include "diag_log.h"
+#include "logger.h"
+#include "check.h"
+
+// Espera a task esvaziar o buffer (o Serial para de crescer)
+static unsigned long drained() {
+    unsigned long last;
+    do {
+        last = Serial.written;
+        delay(DIAG_DRAIN_MS * 3);
+    } while (Serial.written != last);
+    return last;
+}
+
+static void testRing() {
+    // Linhas de 100 bytes com o '\n': cabem DIAG_RING_SIZE / 100
+    std::string body(99, 'x');
+    const size_t fit = DIAG_RING_SIZE / 100;
+    for (size_t i = 0; i < fit + 5; i++) {
+        diagPrintf("%s", body.c_str());
+    }
+    DiagStats s = diagStats();
+    CHECK_EQ(s.lines, fit);
+    CHECK_EQ(s.dropped, 5);
+
+    // Tudo ou nada: o que sobra cabe exato, 1 byte a mais não
+    std::string rest(DIAG_RING_SIZE - fit * 100, 'y');
+    rest.back() = '\n';
+    CHECK(!diagWrite((rest + "z").data(), rest.size() + 1));
+    CHECK(diagWrite(rest.data(), rest.size()));
+    CHECK(!diagWrite("z\n", 2));
+    s = diagStats();
+    CHECK_EQ(s.lines, fit + 1);
+    CHECK_EQ(s.dropped, 7);
+
+    // Com a task: o buffer cheio chega ao Serial, mais o aviso
+    unsigned long before = Serial.written;
+    diagInit();
+    unsigned long after = drained();
+    std::string notice = "[diag] linhas descartadas (buffer cheio): 7\r\n";
+    CHECK_EQ(after - before, DIAG_RING_SIZE + notice.size());
+
+    // Linha longa: truncada em DIAG_LINE_MAX bytes com o '\n'
+    std::string longLine(DIAG_LINE_MAX * 3, 'w');
+    before = Serial.written;
+    diagPrintf("%s", longLine.c_str());
+    CHECK_EQ(drained() - before, DIAG_LINE_MAX);
+    CHECK_EQ(diagStats().dropped, 7);
+}
+
+static std::string payload(unsigned i) {
+    char buf[160];
+    snprintf(buf, sizeof(buf),
+             "{\"device\":\"mi-0\",\"tensao\":{\"value\":%u.%u},\"corrente\":[%u,%u],"
+             "\"status\":\"%s\"}",
+             200 + i % 40, i % 10, i % 7, i % 13, (i % 3) ? "ok" : "alarme");
+    return buf;
+}
+
+static void testSteady() {
+    testSdDir();
+    loggerInit();
+    std::string first = payload(0);
+    processMessage("esp32_logger", "MiEnergy/01", first.data(), first.size());
+    loggerFlush();
+
+    DiagStats s0 = diagStats();
+    unsigned long serial0 = drained();
+    for (unsigned i = 1; i <= 5000; i++) {
+        std::string p = payload(i);
+        processMessage("esp32_logger", (i % 2) ? "MiEnergy/01" : "MiEnergy/02", p.data(), p.size());
+        if (i % 100 == 0) {
+            loggerLoop();
+        }
+        if (i % 1000 == 0) {
+            loggerFlush();
+        }
+    }
+    unsigned long serial1 = drained();
+    DiagStats s1 = diagStats();
+#if ROW_SINK_SERIAL || DIAG_LEVEL >= DIAG_LEVEL_DEBUG
+    // Linhas na serial a cada mensagem: o silêncio não se aplica
+    CHECK(serial1 > serial0);
+#else
+    CHECK_EQ(s1.lines - s0.lines, 0);
+    CHECK_EQ(s1.dropped - s0.dropped, 0);
+    CHECK_EQ(serial1 - serial0, 0);
+#endif
+
+    // O aviso de JSON inválido passa pelo mesmo caminho
+    processMessage("esp32_logger", "MiEnergy/01", "{\"tensao\":", 10);
+#if DIAG_LEVEL >= DIAG_LEVEL_DEBUG
+    CHECK(diagStats().lines - s1.lines >= 1);
+#else
+    CHECK_EQ(diagStats().lines - s1.lines, (DIAG_LEVEL >= DIAG_LEVEL_WARN) ? 1 : 0);
+#endif
+    printf("{\"case\":\"steady\",\"messages\":5000,\"diag_lines\":%u}\n",
+           (unsigned)(s1.lines - s0.lines));
+}
+
+int main() {
+    testRing();
+    testSteady();
+    return testDone("diag_log");
+}
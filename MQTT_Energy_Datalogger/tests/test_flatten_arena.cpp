@@ -0,0 +1,236 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DA FLAT ARENA (PC)
+================================================================================
+
+Confere o achatamento na FlatArena (json_flatten.cpp, json_stream.cpp) e o
+caminho de uma mensagem pelo logger sem heap em regime:
+
+- allocs: malloc/calloc/realloc/new contados durante flattenToArena(),
+  flattenToColumns() (documento já montado), streamFlattenToArena(),
+  streamFlattenToColumns() e processMessage() completo (depois da 1ª
+  mensagem, que cria o cabeçalho; com LOG_SCHEMA_SPARSE, depois de uma
+  volta pelas cargas, que cria as colunas): zero em todos. Imprime a
+  ocupação máxima da arena (peak) de cada carga.
+- reuse: a arena reaproveitada dá o mesmo resultado que uma nova, e
+  used volta a zero a cada mensagem.
+- overflow: texto maior que FLAT_ARENA_SIZE, caminho maior que
+  FLAT_PATH_SIZE e mais de MAX_KEYS campos: campos descartados, overflow
+  sinalizado, o resto intacto e nada escrito fora da arena.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <atomic>
+#include <string>
+#include "column_map.h"
+#include "json_flatten.h"
+#include "json_stream.h"
+#include "logger.h"
+#include "check.h"
+#include "corpus.h"
+
+// -----------------------------------------------------------------------------
+// Contagem de alocações (como em tools/bench_pipeline.cpp)
+// -----------------------------------------------------------------------------
+static std::atomic<unsigned long> allocCount(0);
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t n);
+
+void *malloc(size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, n);
+}
+}
+#else
+#include <new>
+
+void *operator new(size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(n ? n : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+#endif
+
+static FlatArena arena;
+static FlatArena fresh;
+static FlatValue slots[MAX_KEYS];
+static String keys[MAX_KEYS];
+
+// Campos da arena como texto "chave=valor;..."
+static std::string dump(const FlatArena &a, size_t n) {
+    std::string out;
+    for (size_t i = 0; i < n; i++) {
+        char buf[400];
+        int len = flatFormat(a.values[i], a.text, buf, sizeof(buf));
+        out.append(flatText(a, a.keys[i]), a.keys[i].len);
+        out += '=';
+        out.append(buf, len > 0 ? len : 0);
+        out += ';';
+    }
+    return out;
+}
+
+static void testAllocs() {
+    static ColumnMap map;
+    static DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+
+    // Cabeçalho: 1º payload fixo
+    deserializeJson(doc, corpusFixed[0]);
+    size_t count = flattenToArena(doc.as<JsonVariantConst>(), arena);
+    for (size_t i = 0; i < count; i++) {
+        keys[i] = std::string(flatText(arena, arena.keys[i]), arena.keys[i].len).c_str();
+    }
+    map.build(keys, count);
+
+    std::string payloads[64];
+    for (size_t k = 0; k < 64; k++) {
+        payloads[k] = (k < corpusFixedCount) ? corpusFixed[k] : corpusRandom((uint32_t)k);
+    }
+
+    unsigned long domArena = 0, domColumns = 0, streamArena = 0, streamColumns = 0;
+    size_t peak = 0;
+    for (size_t k = 0; k < 64; k++) {
+        const std::string &p = payloads[k];
+        deserializeJson(doc, p.data(), p.size());
+        JsonVariantConst root = doc.as<JsonVariantConst>();
+
+        unsigned long a = allocCount.load();
+        flattenToArena(root, arena);
+        domArena += allocCount.load() - a;
+        a = allocCount.load();
+        flattenToColumns(root, map, arena, slots);
+        domColumns += allocCount.load() - a;
+        a = allocCount.load();
+        streamFlattenToArena(p.data(), p.size(), arena);
+        streamArena += allocCount.load() - a;
+        a = allocCount.load();
+        streamFlattenToColumns(p.data(), p.size(), map, arena, slots);
+        streamColumns += allocCount.load() - a;
+        peak = arena.peak;
+    }
+    CHECK_EQ(domArena, 0);
+    CHECK_EQ(domColumns, 0);
+    CHECK_EQ(streamArena, 0);
+    CHECK_EQ(streamColumns, 0);
+
+    // processMessage(): a 1ª mensagem cria o cabeçalho; depois, nada no heap
+    // (LOG_SCHEMA_SPARSE: depois de o dicionário ter visto todas as chaves)
+    testSdDir();
+    hostMillis = 0;
+    loggerInit();
+    processMessage("esp32_logger", "MiEnergy/01", corpusFixed[0], strlen(corpusFixed[0]));
+    const size_t warmup = (LOG_SCHEMA == LOG_SCHEMA_SPARSE) ? 64 : 8;
+    for (size_t k = 0; k < warmup; k++) {
+        processMessage("esp32_logger", "MiEnergy/01", payloads[k].data(), payloads[k].size());
+    }
+    unsigned long a = allocCount.load();
+    for (size_t round = 0; round < 20; round++) {
+        for (size_t k = 0; k < 64; k++) {
+            hostMillis += 10;
+            processMessage("esp32_logger", "MiEnergy/01", payloads[k].data(), payloads[k].size());
+            loggerLoop();
+        }
+    }
+    unsigned long process = allocCount.load() - a;
+    loggerFlush();
+    CHECK_EQ(process, 0);
+
+    printf("{\"case\":\"allocs\",\"messages\":1280,\"dom_arena\":%lu,\"dom_columns\":%lu,"
+           "\"stream_arena\":%lu,\"stream_columns\":%lu,\"process\":%lu,"
+           "\"arena_peak\":%u,\"arena_size\":%u}\n",
+           domArena, domColumns, streamArena, streamColumns, process,
+           (unsigned)peak, (unsigned)FLAT_ARENA_SIZE);
+}
+
+static void testReuse() {
+    static DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+    for (uint32_t seed = 1; seed <= 300; seed++) {
+        std::string p = corpusRandom(seed);
+        deserializeJson(doc, p.data(), p.size());
+        size_t n = flattenToArena(doc.as<JsonVariantConst>(), arena);
+        size_t used = arena.used;
+        memset(&fresh, 0x5A, sizeof(fresh));
+        size_t m = flattenToArena(doc.as<JsonVariantConst>(), fresh);
+        CHECK_EQ(n, m);
+        CHECK_EQ(used, fresh.used);
+        CHECK(dump(arena, n) == dump(fresh, m));
+    }
+    flattenToArena(JsonVariantConst(), arena);
+    CHECK_EQ(arena.used, 0);
+}
+
+static void testOverflow() {
+    static DynamicJsonDocument doc(64 * 1024);
+
+    // Texto: strings que somadas passam de FLAT_ARENA_SIZE
+    std::string big = "{\"first\":1";
+    for (int i = 0; i < 40; i++) {
+        big += ",\"s" + std::to_string(i) + "\":\"" + std::string(200, 'a' + i % 26) + "\"";
+    }
+    big += ",\"last\":2}";
+    deserializeJson(doc, big.data(), big.size());
+    size_t n = flattenToArena(doc.as<JsonVariantConst>(), arena);
+    CHECK(arena.overflow);
+    CHECK(arena.used <= FLAT_ARENA_SIZE);
+    CHECK(n > 0 && n < 42);
+    CHECK(dump(arena, 1) == "first=1;");
+    int sn = streamFlattenToArena(big.data(), big.size(), fresh);
+    CHECK(fresh.overflow);
+    CHECK_EQ(sn, (int)n);
+    CHECK(dump(arena, n) == dump(fresh, sn));
+
+    // Caminho: chave aninhada maior que FLAT_PATH_SIZE
+    std::string deep = "{\"ok\":1,\"" + std::string(FLAT_PATH_SIZE, 'k') + "\":{\"x\":2},\"fim\":3}";
+    deserializeJson(doc, deep.data(), deep.size());
+    n = flattenToArena(doc.as<JsonVariantConst>(), arena);
+    CHECK(arena.overflow);
+    CHECK(dump(arena, n) == "ok=1;fim=3;");
+    sn = streamFlattenToArena(deep.data(), deep.size(), fresh);
+    CHECK(fresh.overflow);
+    CHECK(sn == (int)n && dump(fresh, sn) == "ok=1;fim=3;");
+
+    // Campos: mais que MAX_KEYS
+    std::string wide = "{";
+    for (int i = 0; i < MAX_KEYS + 20; i++) {
+        wide += (i ? ",\"k" : "\"k") + std::to_string(i) + "\":" + std::to_string(i);
+    }
+    wide += "}";
+    deserializeJson(doc, wide.data(), wide.size());
+    n = flattenToArena(doc.as<JsonVariantConst>(), arena);
+    CHECK(arena.overflow);
+    CHECK_EQ(n, MAX_KEYS);
+    sn = streamFlattenToArena(wide.data(), wide.size(), fresh);
+    CHECK(fresh.overflow);
+    CHECK_EQ(sn, MAX_KEYS);
+}
+
+int main() {
+    testAllocs();
+    testReuse();
+    testOverflow();
+    return testDone("flatten_arena");
+}
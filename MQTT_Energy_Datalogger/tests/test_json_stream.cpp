@@ -0,0 +1,230 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO JSON STREAM (PC)
+================================================================================
+
+Confere o achatamento em uma passada (json_stream.cpp) contra o do
+documento do ArduinoJson (json_flatten.cpp), que ele substitui:
+
+- equivalence: para cada payload de tests/corpus.h, streamFlattenToArena()
+  e flattenToArena() dão as mesmas chaves, tipos e textos, na mesma ordem;
+  streamFlattenToColumns() e flattenToColumns() dão as mesmas células.
+- rules: casos escritos à mão da regra {"value": X} (inclusive "value" ao
+  lado de outros membros e "value" com objeto/array, que vira célula
+  vazia) e dos nomes de índice de arrays ("_0", "_1", arrays dentro de
+  arrays).
+- large: payload maior que JSON_BUFFER_SIZE (indentado, como um medidor
+  que manda o JSON formatado) é aceito e dá o mesmo que o documento.
+- depth: JSON_STREAM_MAX_DEPTH níveis aceitos, um a mais é TooDeep.
+- errors: entrada vazia, sintaxe inválida e todo prefixo de um payload
+  válido (mensagem cortada) dão erro, nunca um resultado parcial.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <string>
+#include "column_map.h"
+#include "json_flatten.h"
+#include "json_stream.h"
+#include "check.h"
+#include "corpus.h"
+
+static FlatArena domArena;
+static FlatArena streamArena;
+static FlatValue domSlots[MAX_KEYS];
+static FlatValue streamSlots[MAX_KEYS];
+static String keys[MAX_KEYS];
+
+static std::string cellText(const FlatValue &v, const char *text) {
+    char buf[400];
+    int n = flatFormat(v, text, buf, sizeof(buf));
+    return (n > 0) ? std::string(buf, n) : std::string();
+}
+
+// Campos da arena como texto "chave=tipo:valor;..."
+static std::string dump(const FlatArena &a, size_t n) {
+    std::string out;
+    for (size_t i = 0; i < n; i++) {
+        out.append(flatText(a, a.keys[i]), a.keys[i].len);
+        out += '=';
+        out += (char)('0' + a.values[i].type);
+        out += ':';
+        out += cellText(a.values[i], a.text);
+        out += ';';
+    }
+    return out;
+}
+
+// Achatamento pelo documento, como texto; "!" se o JSON não é válido
+static std::string domDump(const std::string &json, size_t capacity = JSON_BUFFER_SIZE) {
+    DynamicJsonDocument doc(capacity);
+    if (deserializeJson(doc, json.data(), json.size())) {
+        return "!";
+    }
+    size_t n = flattenToArena(doc.as<JsonVariantConst>(), domArena);
+    return dump(domArena, n);
+}
+
+static std::string streamDump(const std::string &json) {
+    int n = streamFlattenToArena(json.data(), json.size(), streamArena);
+    return (n < 0) ? "!" : dump(streamArena, n);
+}
+
+// As duas formas para json; header define as colunas
+static bool same(const std::string &json, const ColumnMap &map, size_t count) {
+    std::string dom = domDump(json);
+    std::string stream = streamDump(json);
+    bool ok = CHECK(dom != "!" && dom == stream);
+    ok = CHECK(domArena.overflow == streamArena.overflow) && ok;
+
+    DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+    deserializeJson(doc, json.data(), json.size());
+    flattenToColumns(doc.as<JsonVariantConst>(), map, domArena, domSlots);
+    streamFlattenToColumns(json.data(), json.size(), map, streamArena, streamSlots);
+    for (size_t c = 0; c < count; c++) {
+        size_t k = map.canonical(c);
+        ok = CHECK(domSlots[k].type == streamSlots[k].type &&
+                   cellText(domSlots[k], domArena.text) ==
+                   cellText(streamSlots[k], streamArena.text)) && ok;
+    }
+    if (!ok) {
+        fprintf(stderr, "    %s\n    dom:    %s\n    stream: %s\n",
+                json.c_str(), dom.c_str(), stream.c_str());
+    }
+    return ok;
+}
+
+static size_t headerFrom(const std::string &json) {
+    int n = streamFlattenToArena(json.data(), json.size(), streamArena);
+    size_t count = 0;
+    for (int i = 0; i < n; i++) {
+        keys[count++] = std::string(flatText(streamArena, streamArena.keys[i]),
+                                    streamArena.keys[i].len).c_str();
+    }
+    return count;
+}
+
+static void testEquivalence() {
+    static ColumnMap map;
+    size_t messages = 0;
+
+    for (size_t h = 0; h < corpusFixedCount; h++) {
+        size_t count = headerFrom(corpusFixed[h]);
+        map.build(keys, count);
+        for (size_t m = 0; m < corpusFixedCount; m++) {
+            same(corpusFixed[m], map, count);
+            messages++;
+        }
+    }
+    for (uint32_t seed = 1; seed <= 100; seed++) {
+        size_t count = headerFrom(corpusRandom(seed));
+        map.build(keys, count);
+        for (uint32_t k = 0; k < 20; k++) {
+            same(corpusRandom(seed * 1000 + k), map, count);
+            messages++;
+        }
+    }
+    printf("{\"case\":\"equivalence\",\"messages\":%u}\n", (unsigned)messages);
+}
+
+static void expect(const char *json, const char *expected) {
+    std::string stream = streamDump(json);
+    if (!CHECK(stream == expected) || !CHECK(domDump(json) == expected)) {
+        fprintf(stderr, "    %s\n    esperado: %s\n    stream:   %s\n",
+                json, expected, stream.c_str());
+    }
+}
+
+static void testRules() {
+    // {"value": X} -> chave = prefixo
+    expect("{\"tensao\":{\"value\":222.8}}", "tensao=4:222.8;");
+    expect("{\"e\":{\"ativa\":{\"value\":1000000}}}", "e_ativa=3:1000000;");
+    expect("{\"a\":{\"value\":null}}", "a=1:;");
+    // "value" ao lado de outros membros: objeto comum
+    expect("{\"a\":{\"value\":1,\"unit\":\"V\"}}", "a_value=3:1;a_unit=5:V;");
+    // "value" com objeto/array: a coluna do prefixo, vazia
+    expect("{\"b\":{\"value\":{\"x\":1}}}", "b=1:;");
+    expect("{\"c\":{\"value\":[1,2]}}", "c=1:;");
+    // Índices de arrays
+    expect("{\"corrente\":[{\"value\":0.631},{\"value\":1.179}]}",
+           "corrente_0=4:0.631;corrente_1=4:1.179;");
+    expect("{\"m\":[[1,2],[3]]}", "m_0_0=3:1;m_0_1=3:2;m_1_0=3:3;");
+    expect("[1,{\"x\":2}]", "0=3:1;1_x=3:2;");
+    // Vazios não geram campos
+    expect("{\"o\":{},\"v\":[],\"k\":true}", "k=2:true;");
+}
+
+static void testLarge() {
+    // Indentado: o texto passa de JSON_BUFFER_SIZE, o achatado cabe na arena
+    std::string pad(120, ' ');
+    std::string big = "{";
+    for (int i = 0; i < 100; i++) {
+        big += (i ? ",\n" : "\n") + pad + "\"f" + std::to_string(i) + "\" : {" + pad +
+               "\"value\" : " + std::to_string(i * 3) + "." + std::to_string(i % 10) + pad + "}";
+    }
+    big += "\n}";
+    CHECK(big.size() > JSON_BUFFER_SIZE);
+
+    std::string stream = streamDump(big);
+    CHECK(stream != "!");
+    CHECK(!streamArena.overflow);
+    CHECK(stream == domDump(big, 64 * 1024));
+    CHECK(stream.find("f99=4:297.9;") != std::string::npos);
+    printf("{\"case\":\"large\",\"bytes\":%u,\"json_buffer_size\":%u}\n",
+           (unsigned)big.size(), (unsigned)JSON_BUFFER_SIZE);
+}
+
+static std::string nested(int depth) {
+    std::string s;
+    for (int i = 0; i < depth; i++) {
+        s += (i % 2) ? "[" : "{\"d\":";
+    }
+    s += "1";
+    for (int i = depth - 1; i >= 0; i--) {
+        s += (i % 2) ? "]" : "}";
+    }
+    return s;
+}
+
+static void testDepth() {
+    std::string ok = nested(JSON_STREAM_MAX_DEPTH);
+    std::string deep = nested(JSON_STREAM_MAX_DEPTH + 1);
+    CHECK_EQ(streamFlattenToArena(ok.data(), ok.size(), streamArena), 1);
+    CHECK_EQ(streamFlattenToArena(deep.data(), deep.size(), streamArena), JSON_STREAM_TOO_DEEP);
+    CHECK(strcmp(jsonStreamErrorStr(JSON_STREAM_TOO_DEEP), "TooDeep") == 0);
+}
+
+static void testErrors() {
+    CHECK_EQ(streamFlattenToArena("", 0, streamArena), JSON_STREAM_EMPTY);
+    CHECK_EQ(streamFlattenToArena("   ", 3, streamArena), JSON_STREAM_EMPTY);
+    CHECK_EQ(streamFlattenToArena("{a:1}", 5, streamArena), JSON_STREAM_INVALID);
+    CHECK_EQ(streamFlattenToArena("{\"a\":1,}", 8, streamArena), JSON_STREAM_INVALID);
+    CHECK_EQ(streamFlattenToArena("{\"a\" 1}", 7, streamArena), JSON_STREAM_INVALID);
+
+    // Mensagem cortada em qualquer ponto
+    size_t prefixes = 0;
+    for (size_t m = 0; m < corpusFixedCount; m++) {
+        const char *json = corpusFixed[m];
+        size_t len = strlen(json);
+        for (size_t cut = 1; cut < len; cut++) {
+            int n = streamFlattenToArena(json, cut, streamArena);
+            if (!CHECK(n < 0)) {
+                fprintf(stderr, "    aceito com %u de %u bytes: %s\n",
+                        (unsigned)cut, (unsigned)len, json);
+            }
+            prefixes++;
+        }
+    }
+    printf("{\"case\":\"errors\",\"prefixes\":%u}\n", (unsigned)prefixes);
+}
+
+int main() {
+    testEquivalence();
+    testRules();
+    testLarge();
+    testDepth();
+    testErrors();
+    return testDone("json_stream");
+}
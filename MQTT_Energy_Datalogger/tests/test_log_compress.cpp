@@ -0,0 +1,452 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO LOG COMPRESS (PC)
+================================================================================
+
+Confere os frames de log_compress.cpp e os caminhos comprimidos do
+csv_sink, log_segments e log_partitions, que entram aqui com
+LOG_COMPRESS = 1 (o resto do config.h em vigor). Os arquivos são lidos de
+volta por testUnpack() (check.h), com as regras do tools/logunpack.
+
+- empty: bloco vazio não gera frame; arquivo sem dados (ou só zeros da
+  pré-alocação) descomprime vazio; cabeçalho com tamanho 0 é inválido.
+- stored: dados aleatórios (1 byte a LZ_BLOCK_MAX) ficam em LZ_STORED,
+  com o frame = bloco + LZ_FRAME_HEADER.
+- matches: literais e matches nos limites da extensão de comprimento
+  (14, 15, 16, 269, 270, 271, ...), match sobrepondo o destino, um bloco
+  de LZ_BLOCK_MAX bytes iguais e o texto do CSV: ida e volta exata.
+- corrupt: byte trocado em cada posição de um frame: o cabeçalho ou a
+  descompressão recusa, ou o bloco sai do tamanho certo; nada é escrito
+  além do bloco.
+- torn: o último frame cortado em cada posição some inteiro; um frame
+  cortado no meio do arquivo (reboot) é pulado e os seguintes valem.
+- csv_sink: uma escrita maior que o buffer vira frames de até
+  CSV_SINK_BUFFER_SIZE bytes; linhas cruzando blocos e uma escrita
+  incompleta no SD voltam inteiras e na ordem.
+- segments: cada ponto do índice começa um frame (como no logger);
+  logFindRange() dá trechos que se descomprimem sozinhos; arquivo cortado
+  no último frame é recuperado no boot seguinte sem bytes inválidos.
+- partitions: três tópicos intercalados, cada arquivo com o cabeçalho e
+  só as linhas dele.
+
+================================================================================
+*/
+
+#include "config.h"
+#undef LOG_COMPRESS
+#define LOG_COMPRESS 1
+#include "csv_sink.cpp"
+#include "log_segments.cpp"
+#include "log_partitions.cpp"
+
+#include <string>
+#include <vector>
+#include "check.h"
+#include "corpus.h"
+
+static uint8_t frameBuf[LZ_FRAME_MAX(LZ_BLOCK_MAX)];
+
+static std::string encode(const std::string &block) {
+    size_t n = lzFrameEncode((const uint8_t *)block.data(), block.size(), frameBuf);
+    return std::string((const char *)frameBuf, n);
+}
+
+static std::string randomBytes(CorpusRng &r, size_t n) {
+    std::string s(n, '\0');
+    for (size_t i = 0; i < n; i++) {
+        s[i] = (char)r.below(256);
+    }
+    return s;
+}
+
+static std::string rowText(unsigned i, const char *topic = "MiEnergy/01") {
+    char line[128];
+    snprintf(line, sizeof(line), "%u,esp32_logger,%s,%u.%02u,%u,%u.%03u\r\n",
+             i * 100, topic, 220 + i % 7, i % 100, i % 50, i % 3, i % 1000);
+    return line;
+}
+
+// Ida e volta de um bloco; method: o esperado (-1 = qualquer um)
+static bool roundTrip(const std::string &block, int method = -1) {
+    std::string frame = encode(block);
+    LzFrame info;
+    bool ok = CHECK(lzFrameHeader((const uint8_t *)frame.data(), info));
+    ok = ok && CHECK(info.rawLen == block.size() &&
+                     LZ_FRAME_HEADER + (size_t)info.dataLen == frame.size());
+    ok = ok && (method < 0 || CHECK(info.method == method));
+    ok = ok && CHECK(testUnpack(frame) == block);
+    return ok;
+}
+
+static void testEmpty() {
+    CHECK_EQ(lzFrameEncode((const uint8_t *)"", 0, frameBuf), 0);
+    CHECK(testUnpack("").empty());
+    CHECK(testUnpack(std::string(4096, '\0')).empty());
+
+    // Tamanho 0 no cabeçalho, com o check certo
+    uint8_t h[LZ_FRAME_HEADER] = { LZ_MAGIC0, LZ_MAGIC1, LZ_STORED, 0, 0, 0, 0, 0 };
+    h[3] = LZ_CHECK_SEED ^ LZ_STORED;
+    LzFrame info;
+    CHECK(!lzFrameHeader(h, info));
+
+    // flush() sem linhas não grava frame
+    testSdDir();
+    CsvSink sink;
+    CHECK(sink.begin("/empty.csv"));
+    CHECK(sink.flush());
+    sink.end();
+    CHECK_EQ(sink.stats().writes, 0);
+    CHECK(testReadFile("/empty.csv").empty());
+}
+
+static void testStored() {
+    CorpusRng r = { 77 };
+    size_t frames = 0;
+    for (size_t n : { (size_t)1, (size_t)2, (size_t)3, (size_t)4, (size_t)5, (size_t)100,
+                      (size_t)CSV_SINK_BUFFER_SIZE, (size_t)LZ_BLOCK_MAX }) {
+        std::string block = randomBytes(r, n);
+        if (roundTrip(block, LZ_STORED)) {
+            frames++;
+        }
+        CHECK_EQ(encode(block).size(), n + LZ_FRAME_HEADER);
+    }
+    printf("{\"case\":\"stored\",\"frames\":%u}\n", (unsigned)frames);
+}
+
+static void testMatches() {
+    CorpusRng r = { 4242 };
+    static const size_t lengths[] = { 0, 1, 14, 15, 16, 18, 19, 20, 269, 270, 271, 273,
+                                      274, 275, 525, 529, 1000 };
+    size_t cases = 0;
+
+    // Literais de cada comprimento seguidos de um match de cada comprimento
+    for (size_t lit : lengths) {
+        for (size_t match : lengths) {
+            if (match < LZ_MIN_MATCH) {
+                continue;
+            }
+            std::string seed = randomBytes(r, 64);
+            std::string block = seed + randomBytes(r, lit);
+            std::string copy = seed;
+            while (copy.size() < match) {
+                copy += copy;
+            }
+            block += copy.substr(0, match) + randomBytes(r, 8);
+            if (roundTrip(block)) {
+                cases++;
+            }
+        }
+    }
+
+    // Match sobrepondo o destino (distância 1 e 3)
+    CHECK(roundTrip("x" + std::string(3000, 'a') + "y"));
+    std::string abc;
+    for (int i = 0; i < 1000; i++) {
+        abc += "abc";
+    }
+    CHECK(roundTrip(abc));
+
+    // Bloco máximo de bytes iguais: um match longo, frame pequeno
+    std::string same(LZ_BLOCK_MAX, 'z');
+    CHECK(roundTrip(same, LZ_LZ77));
+    size_t sameFrame = encode(same).size();
+    CHECK(sameFrame < 300);
+
+    // Texto do CSV: comprime
+    std::string csv;
+    for (unsigned i = 0; csv.size() < CSV_SINK_BUFFER_SIZE; i++) {
+        csv += rowText(i);
+    }
+    csv.resize(CSV_SINK_BUFFER_SIZE);
+    CHECK(roundTrip(csv, LZ_LZ77));
+    size_t csvFrame = encode(csv).size();
+    CHECK(csvFrame * 2 < csv.size());
+
+    printf("{\"case\":\"matches\",\"cases\":%u,\"same_frame\":%u,\"csv_frame\":%u,\"csv_block\":%u}\n",
+           (unsigned)cases, (unsigned)sameFrame, (unsigned)csvFrame, (unsigned)csv.size());
+}
+
+static void testCorrupt() {
+    std::string csv;
+    for (unsigned i = 0; i < 40; i++) {
+        csv += rowText(i);
+    }
+    std::string frame = encode(csv);
+    static uint8_t out[LZ_BLOCK_MAX + 64];
+    size_t rejected = 0;
+    for (size_t pos = 0; pos < frame.size(); pos++) {
+        for (uint8_t flip : { (uint8_t)0x01, (uint8_t)0x80, (uint8_t)0xFF }) {
+            std::string bad = frame;
+            bad[pos] = (char)(bad[pos] ^ flip);
+            memset(out, 0xA5, sizeof(out));
+            LzFrame info;
+            bool ok = lzFrameHeader((const uint8_t *)bad.data(), info) &&
+                      LZ_FRAME_HEADER + (size_t)info.dataLen <= bad.size() &&
+                      lzFrameDecode(info, (const uint8_t *)bad.data() + LZ_FRAME_HEADER, out);
+            if (!ok) {
+                rejected++;
+                continue;
+            }
+            // Aceito: só com o tamanho do cabeçalho, e nada além dele
+            CHECK(info.rawLen == csv.size());
+            bool guard = true;
+            for (size_t k = info.rawLen; k < sizeof(out) && k < info.rawLen + 64u; k++) {
+                guard = guard && out[k] == 0xA5;
+            }
+            CHECK(guard);
+        }
+    }
+    // O cabeçalho nunca passa trocado
+    CHECK(rejected >= 3 * LZ_FRAME_HEADER);
+    printf("{\"case\":\"corrupt\",\"flips\":%u,\"rejected\":%u}\n",
+           (unsigned)(3 * frame.size()), (unsigned)rejected);
+}
+
+static void testTorn() {
+    std::string blocks[4];
+    std::string frames[4];
+    for (unsigned b = 0; b < 4; b++) {
+        for (unsigned i = 0; i < 30; i++) {
+            blocks[b] += rowText(b * 30 + i);
+        }
+        frames[b] = encode(blocks[b]);
+    }
+    std::string intact = frames[0] + frames[1] + frames[2];
+    std::string text = blocks[0] + blocks[1] + blocks[2];
+
+    // Último frame cortado em cada posição: some inteiro
+    size_t bad = 0;
+    for (size_t cut = 1; cut < frames[3].size(); cut++) {
+        if (testUnpack(intact + frames[3].substr(0, cut)) != text) {
+            bad++;
+        }
+    }
+    CHECK_EQ(bad, 0);
+    CHECK(testUnpack(intact + frames[3]) == text + blocks[3]);
+
+    // Cortado no meio do arquivo (append depois do reboot): pulado
+    size_t skipped = 0;
+    std::string torn = frames[0] + frames[1].substr(0, frames[1].size() / 2) + frames[2] + frames[3];
+    CHECK(testUnpack(torn, &skipped) == blocks[0] + blocks[2] + blocks[3]);
+    CHECK_EQ(skipped, frames[1].size() / 2);
+
+    // Zeros da pré-alocação depois do último frame
+    CHECK(testUnpack(intact + std::string(1000, '\0')) == text);
+    printf("{\"case\":\"torn\",\"cuts\":%u,\"skipped\":%u}\n",
+           (unsigned)(frames[3].size() - 1), (unsigned)skipped);
+}
+
+static void testCsvSink() {
+    testSdDir();
+    hostMillis = 0;
+    CsvSink sink;
+    CHECK(sink.begin("/log.csv.lz"));
+
+    // Linhas em pedaços, cruzando os blocos
+    std::string expected;
+    unsigned i = 0;
+    for (; i < 300; i++) {
+        std::string line = rowText(i);
+        sink.beginRow();
+        sink.write((const uint8_t *)line.data(), 7);
+        sink.write((const uint8_t *)line.data() + 7, line.size() - 7);
+        sink.endRow();
+        expected += line;
+    }
+
+    // Maior que o buffer de uma vez: frames de até CSV_SINK_BUFFER_SIZE
+    std::string big;
+    for (; big.size() < 3 * CSV_SINK_BUFFER_SIZE + 100; i++) {
+        big += rowText(i);
+    }
+    sink.beginRow();
+    sink.write((const uint8_t *)big.data(), big.size());
+    sink.endRow();
+    expected += big;
+
+    // Escrita incompleta: o frame cortado fica, o bloco é regravado
+    for (unsigned n = 0; n < 200; n++, i++) {
+        std::string line = rowText(i);
+        sink.beginRow();
+        sink.write((const uint8_t *)line.data(), line.size());
+        sink.endRow();
+        expected += line;
+        if (n == 100) {
+            hostFs.shortWrites = 1;
+            hostMillis += CSV_SINK_FLUSH_MS;
+            sink.poll();
+            CHECK_EQ(sink.stats().errors, 1);
+            hostMillis += CSV_SINK_RETRY_MS;
+        }
+    }
+    sink.end();
+
+    std::string file = testReadFile("/log.csv.lz");
+    size_t frames = 0;
+    size_t maxRaw = 0;
+    for (size_t pos = 0; pos + LZ_FRAME_HEADER <= file.size();) {
+        LzFrame info;
+        if (!lzFrameHeader((const uint8_t *)file.data() + pos, info) ||
+            pos + LZ_FRAME_HEADER + info.dataLen > file.size()) {
+            pos++;
+            continue;
+        }
+        frames++;
+        maxRaw = (info.rawLen > maxRaw) ? info.rawLen : maxRaw;
+        pos += LZ_FRAME_HEADER + info.dataLen;
+    }
+    size_t skipped = 0;
+    CHECK(testUnpack(file, &skipped) == expected);
+    CHECK(skipped > 0);
+    CHECK_EQ(maxRaw, CSV_SINK_BUFFER_SIZE);
+    CHECK_EQ(sink.stats().rawBytes, expected.size());
+    CHECK_EQ(sink.stats().dropped, 0);
+    printf("{\"case\":\"csv_sink\",\"rows\":%u,\"raw\":%u,\"file\":%u,\"frames\":%u}\n", i,
+           (unsigned)expected.size(), (unsigned)file.size(), (unsigned)frames);
+}
+
+static void segmentCommit(void *ctx, uint32_t offset, const uint8_t *data, size_t len) {
+    ((LogSegments *)ctx)->commit(offset, data, len);
+}
+
+// Timestamps (1ª coluna) das linhas de text, conferindo cada linha
+static std::vector<unsigned> rowsIn(const std::string &text) {
+    std::vector<unsigned> rows;
+    size_t pos = 0;
+    while (pos < text.size()) {
+        size_t end = text.find("\r\n", pos);
+        if (!CHECK(end != std::string::npos)) {
+            break;
+        }
+        unsigned ms = (unsigned)strtoul(text.c_str() + pos, nullptr, 10);
+        CHECK(text.substr(pos, end + 2 - pos) == rowText(ms / 100));
+        rows.push_back(ms);
+        pos = end + 2;
+    }
+    return rows;
+}
+
+static void testSegments() {
+    testSdDir();
+    hostMillis = 0;
+    LogSegments segs;
+    CHECK(segs.begin());
+    CsvSink sink;
+    sink.setCommit(segmentCommit, &segs);
+    CHECK(sink.begin(segs.dataPath()));
+
+    // Como o noteSegmentRow() do logger com LOG_COMPRESS
+    const unsigned total = 40 * LOG_INDEX_EVERY + 10;
+    for (unsigned i = 0; i < total; i++) {
+        if (segs.indexDue()) {
+            sink.flush();
+        }
+        segs.noteRow(i * 100, sink.size());
+        std::string line = rowText(i);
+        sink.beginRow();
+        sink.write((const uint8_t *)line.data(), line.size());
+        sink.endRow();
+        sink.poll();
+    }
+    sink.flush();
+    segs.flush();
+
+    std::string path = segs.dataPath();
+    std::string file = testReadFile(path.c_str());
+    CHECK(rowsIn(testUnpack(file)).size() == total);
+
+    // Trecho do meio: se descomprime sozinho e cobre o intervalo
+    uint32_t from = 1000 * 100 + 50, to = 1600 * 100;
+    LogSpan spans[4];
+    size_t n = logFindRange(segs.boot(), from, to, spans, 4);
+    size_t skipped = 0;
+    std::vector<unsigned> rows;
+    if (CHECK(n == 1)) {
+        rows = rowsIn(testUnpack(file.substr(spans[0].start, spans[0].end - spans[0].start),
+                                 &skipped));
+    }
+    CHECK_EQ(skipped, 0);
+    CHECK(!rows.empty() && rows.front() <= from && from - rows.front() < LOG_INDEX_EVERY * 100);
+    CHECK(!rows.empty() && rows.back() >= to);
+    for (size_t k = 1; k < rows.size(); k++) {
+        CHECK(rows[k] == rows[k - 1] + 100);
+    }
+
+    // Queda no meio do último frame: o boot seguinte recupera
+    LzFrame info;
+    size_t last = 0;
+    for (size_t pos = 0; pos + LZ_FRAME_HEADER <= file.size() &&
+                         lzFrameHeader((const uint8_t *)file.data() + pos, info);
+         pos += LZ_FRAME_HEADER + info.dataLen) {
+        last = pos;
+    }
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    f.write((const uint8_t *)file.data(), last + LZ_FRAME_HEADER + 3);
+    f.close();
+    std::string before = testUnpack(file.substr(0, last));
+
+    LogSegments next;
+    CHECK(next.begin());
+    std::string recovered = testReadFile(path.c_str());
+    CHECK(testUnpack(recovered, &skipped) == before);
+    CHECK_EQ(skipped, 0);
+    printf("{\"case\":\"segments\",\"rows\":%u,\"file\":%u,\"span_rows\":%u,\"recovered_rows\":%u}\n",
+           total, (unsigned)file.size(), (unsigned)rows.size(),
+           (unsigned)rowsIn(before).size());
+}
+
+static void partitionHeader(void *, Print &out) {
+    out.print("ms,client_id,topic,tensao,corrente,fp\r\n");
+}
+
+static void testPartitions() {
+    testSdDir();
+    hostMillis = 0;
+    LogPartitions parts;
+    CHECK(parts.begin(partitionHeader, nullptr));
+
+    const char *topics[3] = { "MiEnergy/01", "MiEnergy/02", "Medidor/casa" };
+    std::string expected[3];
+    for (unsigned k = 0; k < 3; k++) {
+        expected[k] = "ms,client_id,topic,tensao,corrente,fp\r\n";
+    }
+    for (unsigned i = 0; i < 1500; i++) {
+        unsigned k = (i * 7) % 3;
+        std::string line = rowText(i, topics[k]);
+        Print *out = parts.sinkFor(topics[k]);
+        if (CHECK(out != nullptr)) {
+            out->write((const uint8_t *)line.data(), line.size());
+        }
+        expected[k] += line;
+        hostMillis += 10;
+        parts.poll();
+    }
+    parts.end();
+
+    size_t raw = 0, stored = 0;
+    for (unsigned k = 0; k < 3; k++) {
+        char path[PARTITION_PATH_SIZE];
+        LogPartitions::pathFor(topics[k], path);
+        std::string file = testReadFile(path);
+        size_t skipped = 0;
+        if (!CHECK(testUnpack(file, &skipped) == expected[k])) {
+            fprintf(stderr, "    %s\n", path);
+        }
+        CHECK_EQ(skipped, 0);
+        raw += expected[k].size();
+        stored += file.size();
+    }
+    printf("{\"case\":\"partitions\",\"raw\":%u,\"file\":%u}\n", (unsigned)raw, (unsigned)stored);
+}
+
+int main() {
+    testEmpty();
+    testStored();
+    testMatches();
+    testCorrupt();
+    testTorn();
+    testCsvSink();
+    testSegments();
+    testPartitions();
+    return testDone("log_compress");
+}
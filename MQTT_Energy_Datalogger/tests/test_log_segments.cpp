@@ -0,0 +1,368 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO LOG SEGMENTS (PC)
+================================================================================
+
+Confere a numeração, a rotação e o índice de log_segments.cpp sobre o
+"cartão" de tools/host (um diretório temporário por caso):
+
+- numbering: um segmento e um boot novos a cada begin(); LOG_DIR/last
+  vazio, cortado ou ausente (queda no meio da gravação) cai para
+  last.tmp ou para a listagem do diretório; last atrasado nunca reabre
+  um segmento que já existe.
+- rotation: shouldRotate() nos limites exatos de LOG_ROTATE_BYTES e
+  LOG_ROTATE_MS (inclusive com millis() dando a volta); segmento vazio
+  nunca rotaciona.
+- range: logFindRange() em dois segmentos: trecho no meio de um segmento
+  (pontos do índice), intervalo cobrindo os dois, linhas depois do
+  último commit fora, outro boot sem trechos, e o mesmo resultado com
+  last ilegível.
+- recovery: imagens de segmento danificadas como numa queda de energia
+  (arquivo cortado no meio do último bloco, byte trocado nele, commit sem o
+  bloco num arquivo pré-alocado, registro do índice cortado, mais blocos
+  ruins que LOG_RECOVER_MAX_BLOCKS): o boot seguinte acha o fim do último
+  bloco íntegro, zera o resto e um 2º boot não muda nada; os bytes lidos
+  na recuperação não dependem do tamanho do segmento.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <string>
+#include <vector>
+#include "log_segments.h"
+#include "check.h"
+
+
+static void writeFile(const char *path, const char *text) {
+    File f = SD.open(path, FILE_WRITE);
+    f.write((const uint8_t *)text, strlen(text));
+    f.close();
+}
+
+// Um boot: begin() em um LogSegments novo (o anterior "perde a energia")
+static uint32_t bootSegment(uint32_t *boot = nullptr) {
+    static LogSegments segs[16];
+    static size_t used;
+    LogSegments &s = segs[used++ % 16];
+    s = LogSegments();
+    CHECK(s.begin());
+    if (boot) {
+        *boot = s.boot();
+    }
+    return s.segment();
+}
+
+static void testNumbering() {
+    testSdDir();
+    uint32_t boot;
+    CHECK_EQ(bootSegment(&boot), 1);
+    CHECK_EQ(boot, 1);
+    CHECK_EQ(bootSegment(&boot), 2);
+    CHECK_EQ(boot, 2);
+    CHECK(testReadFile("/log/last") == "2 2\n");
+    CHECK(!SD.exists("/log/last.tmp"));
+
+    // Truncado pela queda (FILE_WRITE antes do texto): listagem do diretório
+    writeFile("/log/last", "");
+    CHECK_EQ(bootSegment(&boot), 3);
+    CHECK_EQ(boot, 3);
+
+    // Cortado no meio
+    writeFile("/log/last", "3 ");
+    CHECK_EQ(bootSegment(&boot), 4);
+    CHECK_EQ(boot, 4);
+    writeFile("/log/last", "4 4");
+    CHECK_EQ(bootSegment(&boot), 5);
+
+    // Queda entre apagar last e renomear last.tmp
+    SD.remove("/log/last");
+    writeFile("/log/last.tmp", "5 5\n");
+    CHECK_EQ(bootSegment(&boot), 6);
+    CHECK_EQ(boot, 6);
+    CHECK(testReadFile("/log/last") == "6 6\n");
+
+    // Queda antes de apagar last: vale o maior dos dois
+    writeFile("/log/last.tmp", "6 6\n");
+    writeFile("/log/last", "5 5\n");
+    CHECK_EQ(bootSegment(), 7);
+
+    // last atrasado: o número (e o boot) já usado é pulado
+    writeFile("/log/last", "2 2\n");
+    CHECK_EQ(bootSegment(&boot), 8);
+    CHECK_EQ(boot, 8);
+
+    // Sem last e com os mais antigos apagados
+    SD.remove("/log/last");
+    for (uint32_t s = 1; s <= 5; s++) {
+        char path[LOG_SEG_PATH_SIZE];
+        logSegmentIndexPath(s, path, sizeof(path));
+        SD.remove(path);
+    }
+    CHECK_EQ(bootSegment(&boot), 9);
+    CHECK_EQ(boot, 9);
+
+    // Um arquivo de dados sem índice também conta
+    char path[LOG_SEG_PATH_SIZE];
+    logSegmentDataPath(10, path, sizeof(path));
+    writeFile(path, "timestamp\r\n");
+    writeFile("/log/last", "x");
+    CHECK_EQ(bootSegment(), 11);
+}
+
+static void testRotation() {
+    testSdDir();
+    LogSegments s;
+    CHECK(s.begin());
+
+    // Vazio: nunca rotaciona
+    CHECK(!s.shouldRotate(0xFFFFFFFFu, 0xFFFFFFFFu));
+
+    s.noteRow(1000, 0);
+    CHECK(!s.shouldRotate(1000, (uint32_t)LOG_ROTATE_BYTES - 1));
+    CHECK(s.shouldRotate(1000, (uint32_t)LOG_ROTATE_BYTES));
+    CHECK(!s.shouldRotate(1000 + (uint32_t)LOG_ROTATE_MS - 1, 0));
+    CHECK(s.shouldRotate(1000 + (uint32_t)LOG_ROTATE_MS, 0));
+
+    CHECK(s.rotate());
+    CHECK_EQ(s.segment(), 2);
+    CHECK_EQ(s.boot(), 1);
+    CHECK_EQ(s.rows(), 0);
+    CHECK(testReadFile("/log/last") == "2 1\n");
+
+    // millis() dando a volta
+    uint32_t first = 0xFFFFF000u;
+    s.noteRow(first, 0);
+    CHECK(!s.shouldRotate(first + (uint32_t)LOG_ROTATE_MS - 1, 0));
+    CHECK(s.shouldRotate(first + (uint32_t)LOG_ROTATE_MS, 0));
+}
+
+// Linhas de 10 bytes a cada 100 ms; commit a cada 32 linhas
+static uint32_t writeRows(LogSegments &s, uint32_t firstMs, uint32_t rows, uint32_t committed) {
+    static const uint8_t block[320] = { 0 };
+    uint32_t blockStart = 0;
+    for (uint32_t i = 0; i < rows; i++) {
+        s.noteRow(firstMs + i * 100, i * 10);
+        if ((i + 1) % 32 == 0 && i < committed) {
+            s.commit(blockStart, block, (i + 1) * 10 - blockStart);
+            blockStart = (i + 1) * 10;
+        }
+    }
+    return blockStart;
+}
+
+static bool expectSpans(uint32_t boot, uint32_t fromMs, uint32_t toMs,
+                        std::initializer_list<LogSpan> expected) {
+    LogSpan spans[8];
+    size_t n = logFindRange(boot, fromMs, toMs, spans, 8);
+    bool ok = CHECK(n == expected.size());
+    size_t i = 0;
+    for (const LogSpan &e : expected) {
+        if (i < n) {
+            ok = CHECK(spans[i].segment == e.segment && spans[i].start == e.start &&
+                       spans[i].end == e.end) && ok;
+        }
+        i++;
+    }
+    if (!ok) {
+        for (i = 0; i < n; i++) {
+            fprintf(stderr, "    [%lu, %lu) no segmento %lu\n", (unsigned long)spans[i].start,
+                    (unsigned long)spans[i].end, (unsigned long)spans[i].segment);
+        }
+    }
+    return ok;
+}
+
+static void testRange() {
+    testSdDir();
+    LogSegments s;
+    CHECK(s.begin());
+
+    // Segmento 1: 320 linhas (ms 0..31900), todas com commit
+    uint32_t end1 = writeRows(s, 0, 320, 320);
+    CHECK_EQ(end1, 3200);
+    CHECK(s.rotate());
+    // Segmento 2: 300 linhas (ms 40000..69900), commit só até a linha 256
+    uint32_t end2 = writeRows(s, 40000, 300, 256);
+    CHECK_EQ(end2, 2560);
+    s.flush();
+    CHECK_EQ(logSegmentDataEnd(1), end1);
+    CHECK_EQ(logSegmentDataEnd(2), end2);
+
+    // Meio do segmento 1: do ponto 64 (6400 ms) ao ponto 192 (19200 ms)
+    expectSpans(1, 7000, 15000, { { 1, 640, 1920 } });
+    // Exatamente em pontos do índice
+    expectSpans(1, 6400, 12799, { { 1, 640, 1280 } });
+    // Desde antes da 1ª linha: o cabeçalho entra
+    expectSpans(1, 0, 100, { { 1, 0, 640 } });
+    // Os dois segmentos
+    expectSpans(1, 20000, 45000, { { 1, 1920, 3200 }, { 2, 0, 640 } });
+    // Depois do último commit do segmento 2: linhas indexadas fora
+    expectSpans(1, 66000, 70000, { { 2, 1920, 2560 } });
+    // Entre os segmentos
+    expectSpans(1, 33000, 39000, {});
+    // Outro boot
+    expectSpans(2, 0, 100000, {});
+
+    // Mesmo resultado com last ilegível (listagem do diretório)
+    writeFile("/log/last", "2");
+    expectSpans(1, 20000, 45000, { { 1, 1920, 3200 }, { 2, 0, 640 } });
+    SD.remove("/log/last");
+    expectSpans(1, 20000, 45000, { { 1, 1920, 3200 }, { 2, 0, 640 } });
+}
+
+// writeFile() com bytes nulos no meio
+static void writeBytes(const std::string &path, const std::string &bytes) {
+    File f = SD.open(path.c_str(), FILE_WRITE);
+    f.write((const uint8_t *)bytes.data(), bytes.size());
+    f.close();
+}
+
+// Segmento 1 com blocks blocos de ~200 bytes, gravado como o csv_sink faria
+// (commit antes do bloco), e o boot interrompido sem fechar o índice
+struct Image {
+    std::string data;                // Conteúdo completo dos blocos
+    std::vector<uint32_t> starts;    // Início de cada bloco
+    std::string dataPath;
+    std::string indexPath;
+};
+
+static Image makeSegment(size_t blocks, size_t prealloc) {
+    static LogSegments writer;
+    Image img;
+    testSdDir();
+    writer = LogSegments();
+    CHECK(writer.begin());
+    img.dataPath = writer.dataPath();
+    char path[LOG_SEG_PATH_SIZE];
+    logSegmentIndexPath(1, path, sizeof(path));
+    img.indexPath = path;
+
+    for (size_t k = 0; k < blocks; k++) {
+        // Blocos do mesmo tamanho em qualquer segmento
+        std::string block;
+        for (size_t r = 0; r < 6; r++) {
+            char row[64];
+            snprintf(row, sizeof(row), "T+00h00m%05us,esp32_logger,MiEnergy/01,%06u\r\n",
+                     (unsigned)k, (unsigned)(k * 6 + r));
+            block += row;
+        }
+        img.starts.push_back((uint32_t)img.data.size());
+        writer.commit((uint32_t)img.data.size(), (const uint8_t *)block.data(), block.size());
+        img.data += block;
+    }
+    writer.flush();
+    writeBytes(img.dataPath, img.data + std::string(prealloc, '\0'));
+    return img;
+}
+
+// Boot seguinte (recupera o segmento 1); bytes lidos na recuperação
+static unsigned long recoverBoot() {
+    static LogSegments next;
+    unsigned long before = hostFs.readBytes;
+    next = LogSegments();
+    CHECK(next.begin());
+    return hostFs.readBytes - before;
+}
+
+// Fim em good, [good, fim dos blocos) zerado, o resto intacto
+static void expectRecovered(const Image &img, const std::string &damaged, uint32_t good) {
+    std::string now = testReadFile(img.dataPath.c_str());
+    if (!CHECK(logSegmentDataEnd(1) == good)) {
+        fprintf(stderr, "    fim %lu, esperado %lu\n", (unsigned long)logSegmentDataEnd(1),
+                (unsigned long)good);
+        return;
+    }
+    CHECK(now.size() == damaged.size());
+    CHECK(now.compare(0, good, damaged, 0, good) == 0);
+    size_t torn = std::min(img.data.size(), now.size());
+    CHECK(good > torn || now.find_first_not_of('\0', good) >= torn);
+    CHECK(now.compare(torn, std::string::npos, damaged, torn, std::string::npos) == 0);
+
+    // 2º boot: nada a recuperar
+    std::string index = testReadFile(img.indexPath.c_str());
+    recoverBoot();
+    CHECK(testReadFile(img.dataPath.c_str()) == now);
+    CHECK(testReadFile(img.indexPath.c_str()) == index);
+    CHECK_EQ(logSegmentDataEnd(1), good);
+}
+
+static void testRecovery() {
+    const size_t blocks = 40;
+
+    // Íntegro: nada muda (nem o índice)
+    Image img = makeSegment(blocks, 4096);
+    std::string damaged = img.data + std::string(4096, '\0');
+    std::string index = testReadFile(img.indexPath.c_str());
+    recoverBoot();
+    CHECK(testReadFile(img.indexPath.c_str()) == index);
+    expectRecovered(img, damaged, (uint32_t)img.data.size());
+
+    // Arquivo cortado no meio do último bloco (sem pré-alocação)
+    img = makeSegment(blocks, 0);
+    damaged = img.data.substr(0, img.starts.back() + 17);
+    writeBytes(img.dataPath, damaged);
+    recoverBoot();
+    expectRecovered(img, damaged, img.starts.back());
+
+    // Byte trocado no último bloco (pré-alocado)
+    img = makeSegment(blocks, 4096);
+    damaged = img.data + std::string(4096, '\0');
+    damaged[img.starts.back() + 5] ^= 0x20;
+    writeBytes(img.dataPath, damaged);
+    recoverBoot();
+    expectRecovered(img, damaged, img.starts.back());
+
+    // Pré-alocado: commit no índice, bloco nunca gravado (zeros)
+    img = makeSegment(blocks, 4096);
+    damaged = img.data.substr(0, img.starts.back()) +
+              std::string(img.data.size() - img.starts.back() + 4096, '\0');
+    writeBytes(img.dataPath, damaged);
+    recoverBoot();
+    expectRecovered(img, damaged, img.starts.back());
+
+    // Registro do índice cortado (queda durante o commit): o bloco dele
+    // não conta, o anterior está íntegro
+    img = makeSegment(blocks, 0);
+    index = testReadFile(img.indexPath.c_str());
+    writeBytes(img.indexPath, index.substr(0, index.size() - 5));
+    damaged = img.data.substr(0, img.starts.back());
+    writeBytes(img.dataPath, damaged);
+    recoverBoot();
+    CHECK_EQ(logSegmentDataEnd(1), img.starts.back());
+    CHECK(testReadFile(img.dataPath.c_str()) == damaged);
+
+    // Mais blocos ruins que o limite: só LOG_RECOVER_MAX_BLOCKS conferidos
+    img = makeSegment(blocks, 0);
+    damaged = img.data;
+    for (size_t k = blocks - LOG_RECOVER_MAX_BLOCKS - 2; k < blocks; k++) {
+        damaged[img.starts[k]] = '#';
+    }
+    writeBytes(img.dataPath, damaged);
+    recoverBoot();
+    expectRecovered(img, damaged, img.starts[blocks - LOG_RECOVER_MAX_BLOCKS]);
+
+    // Recuperação limitada: mesmos bytes lidos com 40 e 4000 blocos
+    unsigned long read[2];
+    size_t sizes[2] = { blocks, 100 * blocks };
+    for (size_t i = 0; i < 2; i++) {
+        img = makeSegment(sizes[i], 0);
+        damaged = img.data;
+        damaged[img.starts.back()] = '#';
+        writeBytes(img.dataPath, damaged);
+        read[i] = recoverBoot();
+        CHECK_EQ(logSegmentDataEnd(1), img.starts.back());
+    }
+    CHECK_EQ(read[0], read[1]);
+    printf("{\"case\":\"recovery\",\"blocks\":%u,\"read_bytes\":%lu,\"segment_bytes\":%u}\n",
+           (unsigned)sizes[1], read[1], (unsigned)img.data.size());
+}
+
+int main() {
+    testNumbering();
+    testRotation();
+    testRange();
+    testRecovery();
+    return testDone("log_segments");
+}
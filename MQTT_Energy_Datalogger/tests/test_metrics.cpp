@@ -0,0 +1,169 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO METRICS (PC)
+================================================================================
+
+Confere metrics.cpp com micros() virtual (hostMicros, tools/host), lendo
+o snapshot de volta pelo próprio json_stream (chaves achatadas, como
+"parse_h_3"):
+
+- buckets: durações nos limites de cada bucket (0, 1, 2^i - 1, 2^i, ...,
+  acima do último) caem no bucket certo; n, sum_us e max_us conferem;
+  micros() dando a volta no meio da etapa mede a duração certa.
+- counters: metricsCount() em cada contador aparece com o nome do
+  snapshot; as etapas não se misturam.
+- snapshot: JSON válido; com cap menor que o texto, 0 e nada escrito
+  além de cap.
+- disabled (METRICS_ENABLED = 0, no lugar dos anteriores): as chamadas
+  não fazem nada e o snapshot é vazio (0, nada escrito).
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <map>
+#include <string>
+#include "metrics.h"
+#include "json_flatten.h"
+#include "json_stream.h"
+#include "check.h"
+
+#if METRICS_ENABLED
+static FlatArena arena;
+
+// Snapshot achatado: chave -> valor inteiro
+static std::map<std::string, long long> snapshot() {
+    static char buf[METRICS_SNAPSHOT_SIZE];
+    std::map<std::string, long long> out;
+    size_t len = metricsSnapshot(buf, sizeof(buf));
+    if (!CHECK(len > 0)) {
+        return out;
+    }
+    int n = streamFlattenToArena(buf, len, arena);
+    if (!CHECK(n > 0)) {
+        fprintf(stderr, "    %s\n", buf);
+        return out;
+    }
+    for (int i = 0; i < n; i++) {
+        CHECK(arena.values[i].type == FLAT_INT);
+        out[std::string(flatText(arena, arena.keys[i]), arena.keys[i].len)] = arena.values[i].i;
+    }
+    return out;
+}
+
+static void record(MetricStage stage, uint32_t us) {
+    uint32_t t = metricsStart();
+    hostMicros += us;
+    metricsRecord(stage, t);
+}
+
+static void testBuckets() {
+    hostMicros = 1000;
+
+    // Duração -> bucket: 0 -> 0; [2^(i-1), 2^i) -> i; o último acumula
+    struct { uint32_t us; int bucket; } cases[] = {
+        { 0, 0 }, { 1, 1 }, { 2, 2 }, { 3, 2 }, { 4, 3 }, { 7, 3 }, { 8, 4 },
+        { 1023, 10 }, { 1024, 11 }, { 16383, 14 }, { 16384, 15 },
+        { 32768, 15 }, { 5000000, 15 }
+    };
+    long long expected[METRIC_BUCKETS] = { 0 };
+    long long sum = 0;
+    for (const auto &c : cases) {
+        record(METRIC_PARSE, c.us);
+        expected[c.bucket]++;
+        sum += c.us;
+    }
+
+    std::map<std::string, long long> m = snapshot();
+    for (int b = 0; b < METRIC_BUCKETS; b++) {
+        CHECK_EQ(m["parse_h_" + std::to_string(b)], expected[b]);
+    }
+    CHECK_EQ(m["parse_n"], sizeof(cases) / sizeof(cases[0]));
+    CHECK_EQ(m["parse_sum_us"], sum);
+    CHECK_EQ(m["parse_max_us"], 5000000);
+    CHECK_EQ(m["flatten_n"], 0);
+
+    // micros() (32 bits na ESP32) dando a volta durante a etapa
+    hostMicros = 0xFFFFFFF0L;
+    record(METRIC_SD_WRITE, 100);
+    m = snapshot();
+    CHECK_EQ(m["sd_n"], 1);
+    CHECK_EQ(m["sd_max_us"], 100);
+    CHECK_EQ(m["sd_h_7"], 1);
+    hostMicros = 5000;
+}
+
+static void testCounters() {
+    static const char *names[METRIC_COUNTERS] = {
+        "msgs", "bytes", "filtered", "drops", "json_err", "rows", "unchanged", "lost"
+    };
+    for (int c = 0; c < METRIC_COUNTERS; c++) {
+        for (int k = 0; k <= c; k++) {
+            metricsCount((MetricCounter)c);
+        }
+    }
+    metricsCount(METRIC_BYTES, 4000000000u);
+
+    std::map<std::string, long long> m = snapshot();
+    for (int c = 0; c < METRIC_COUNTERS; c++) {
+        long long expected = c + 1 + ((c == METRIC_BYTES) ? 4000000000LL : 0);
+        if (!CHECK(m.count(names[c]) && m[names[c]] == expected)) {
+            fprintf(stderr, "    %s = %lld\n", names[c], m[names[c]]);
+        }
+    }
+    for (const char *stage : { "recv", "parse", "flatten", "format", "sd", "lz" }) {
+        CHECK(m.count(std::string(stage) + "_h_15"));
+    }
+    CHECK(m.count("up"));
+}
+
+static void testSnapshotCap() {
+    static char full[METRICS_SNAPSHOT_SIZE];
+    size_t len = metricsSnapshot(full, sizeof(full));
+    CHECK(len > 0 && len < sizeof(full));
+    CHECK(full[len] == '\0');
+
+    // O '\0' também precisa caber
+    char buf[METRICS_SNAPSHOT_SIZE + 16];
+    for (size_t cap : { (size_t)0, (size_t)1, len / 2, len - 1, len, len + 1 }) {
+        memset(buf, '#', sizeof(buf));
+        size_t n = metricsSnapshot(buf, cap);
+        if (cap > len) {
+            CHECK_EQ(n, len);
+            CHECK(memcmp(buf, full, len + 1) == 0);
+        } else {
+            CHECK_EQ(n, 0);
+        }
+        CHECK(buf[cap] == '#');
+    }
+    printf("{\"case\":\"snapshot\",\"bytes\":%u,\"capacity\":%u}\n",
+           (unsigned)len, (unsigned)METRICS_SNAPSHOT_SIZE);
+}
+
+#else
+static void testDisabled() {
+    hostMicros = 1000;
+    uint32_t t = metricsStart();
+    CHECK_EQ(t, 0);
+    hostMicros += 100;
+    metricsRecord(METRIC_PARSE, t);
+    metricsCount(METRIC_ROWS, 10);
+
+    char buf[64];
+    memset(buf, '#', sizeof(buf));
+    CHECK_EQ(metricsSnapshot(buf, sizeof(buf)), 0);
+    CHECK(buf[0] == '#');
+    printf("{\"case\":\"disabled\",\"bytes\":0}\n");
+}
+#endif
+
+int main() {
+#if METRICS_ENABLED
+    testBuckets();
+    testCounters();
+    testSnapshotCap();
+#else
+    testDisabled();
+#endif
+    return testDone("metrics");
+}
@@ -0,0 +1,384 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DA MSG QUEUE (PC)
+================================================================================
+
+Confere a fila SPSC (msg_queue.cpp) com a política de estouro TEST_POLICY
+(INGEST_DROP_NEWEST, INGEST_DROP_OLDEST ou INGEST_BLOCK). O CMakeLists.txt
+compila este arquivo uma vez por política; o msg_queue.cpp entra aqui com
+INGEST_OVERFLOW_POLICY trocada, o resto do config.h em vigor.
+
+- overflow: fila cheia e mais MSG_QUEUE_SLOTS mensagens: DROP_NEWEST
+  recusa as novas, DROP_OLDEST descarta as antigas, BLOCK espera o
+  consumidor (outra thread); o que sai é o esperado, na ordem, e os
+  contadores (gerais e por tópico) batem.
+- oversize: tópico/payload no limite entram; um byte a mais é recusado
+  e contado.
+- concurrent: produtor e consumidor em threads, sem pausa: sequência
+  crescente, nenhum payload misturado e enviadas = entregues + descartadas.
+- coalesce: MSG_LATEST só substitui com a fila cheia, na posição da
+  mensagem do mesmo tópico (inclusive a mais antiga), que sai com o
+  payload novo e na ordem original; sem mensagem do tópico na fila, vale
+  a política.
+- critical: as posições de reserva ficam só para MSG_CRITICAL; uma
+  crítica nunca é descartada (com a fila toda crítica, espera o
+  consumidor) e nenhuma outra descarta uma crítica.
+
+================================================================================
+*/
+
+#include "config.h"
+#undef INGEST_OVERFLOW_POLICY
+#define INGEST_OVERFLOW_POLICY TEST_POLICY
+#include "msg_queue.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include "check.h"
+
+static const char *policyName() {
+#if TEST_POLICY == INGEST_DROP_NEWEST
+    return "drop_newest";
+#elif TEST_POLICY == INGEST_DROP_OLDEST
+    return "drop_oldest";
+#else
+    return "block";
+#endif
+}
+
+static QueuedMsg out;
+
+// Payload da mensagem seq: "seq:" e o número repetido até um tamanho que
+// varia com seq, para que uma cópia misturada não passe
+static size_t makePayload(uint32_t seq, char *buf, size_t cap) {
+    size_t len = 0;
+    size_t target = 16 + (seq * 37) % 400;
+    len += snprintf(buf, cap, "%u:", (unsigned)seq);
+    while (len < target && len + 12 < cap) {
+        len += snprintf(buf + len, cap - len, "%u,", (unsigned)seq);
+    }
+    return len;
+}
+
+static bool push(MsgQueue &q, uint32_t seq) {
+    char payload[512];
+    size_t len = makePayload(seq, payload, sizeof(payload));
+    return q.push("MiEnergy/01", 11, (const uint8_t *)payload, len);
+}
+
+// Número da mensagem em out, ou -1 se o payload não é o de makePayload()
+static long checkPayload() {
+    char expected[512];
+    unsigned seq = (unsigned)strtoul(out.payload, nullptr, 10);
+    size_t len = makePayload(seq, expected, sizeof(expected));
+    if (len != out.payloadLen || memcmp(expected, out.payload, len) != 0 ||
+        strcmp(out.topic, "MiEnergy/01") != 0) {
+        return -1;
+    }
+    return seq;
+}
+
+static void testOverflow() {
+    static MsgQueue q;
+    const uint32_t n = MSG_QUEUE_SLOTS;
+
+    for (uint32_t i = 0; i < n; i++) {
+        CHECK(push(q, i));
+    }
+    CHECK_EQ(q.depth(), n);
+
+    uint32_t accepted = 0;
+#if TEST_POLICY == INGEST_BLOCK
+    // O consumidor só começa depois que o produtor já está esperando
+    std::atomic<uint32_t> popped(0);
+    std::thread consumer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        QueuedMsg m;
+        while (popped.load() < 2 * n) {
+            if (q.pop(m)) {
+                CHECK_EQ(strtoul(m.payload, nullptr, 10), popped.load());
+                popped++;
+            } else {
+                std::this_thread::yield();
+            }
+        }
+    });
+    for (uint32_t i = n; i < 2 * n; i++) {
+        accepted += push(q, i);
+    }
+    consumer.join();
+    CHECK_EQ(accepted, n);
+    CHECK(q.stats().blocked > 0);
+    CHECK_EQ(q.stats().dropped, 0);
+    CHECK_EQ(q.stats().popped, 2 * n);
+#else
+    for (uint32_t i = n; i < 2 * n; i++) {
+        accepted += push(q, i);
+    }
+    // DROP_NEWEST: ficam 0..n-1; DROP_OLDEST: n..2n-1
+#if TEST_POLICY == INGEST_DROP_NEWEST
+    CHECK_EQ(accepted, 0);
+    uint32_t first = 0;
+#else
+    CHECK_EQ(accepted, n);
+    uint32_t first = n;
+#endif
+    CHECK_EQ(q.depth(), n);
+    for (uint32_t i = 0; i < n; i++) {
+        CHECK(q.pop(out));
+        CHECK_EQ(checkPayload(), first + i);
+    }
+    CHECK(!q.pop(out));
+    CHECK_EQ(q.stats().dropped, n);
+    CHECK_EQ(q.stats().blocked, 0);
+    CHECK_EQ(q.topicStatsCount(), 1);
+    CHECK(strcmp(q.topicStats(0).topic, "MiEnergy/01") == 0);
+    CHECK_EQ(q.topicStats(0).dropped, n);
+#endif
+
+    MsgQueueStats st = q.stats();
+    CHECK_EQ(st.pushed, n + accepted);
+    CHECK_EQ(st.depth, 0);
+    CHECK_EQ(st.highWater, n);
+    printf("{\"case\":\"overflow\",\"policy\":\"%s\",\"pushed\":%lu,\"popped\":%lu,"
+           "\"dropped\":%lu,\"blocked\":%lu}\n",
+           policyName(), (unsigned long)st.pushed, (unsigned long)st.popped,
+           (unsigned long)st.dropped, (unsigned long)st.blocked);
+}
+
+static void testOversize() {
+    static MsgQueue q;
+    static char topic[MSG_TOPIC_MAX + 2];
+    static uint8_t payload[MSG_PAYLOAD_MAX + 2];
+    memset(topic, 't', sizeof(topic));
+    memset(payload, 'p', sizeof(payload));
+
+    CHECK(q.push(topic, MSG_TOPIC_MAX, payload, MSG_PAYLOAD_MAX));
+    CHECK(!q.push(topic, MSG_TOPIC_MAX + 1, payload, 1));
+    CHECK(!q.push(topic, 1, payload, MSG_PAYLOAD_MAX + 1));
+    CHECK_EQ(q.stats().oversize, 2);
+    CHECK_EQ(q.stats().pushed, 1);
+
+    CHECK(q.pop(out));
+    CHECK_EQ(out.topicLen, MSG_TOPIC_MAX);
+    CHECK_EQ(out.payloadLen, MSG_PAYLOAD_MAX);
+    CHECK_EQ(out.topic[MSG_TOPIC_MAX], '\0');
+    CHECK_EQ(out.payload[MSG_PAYLOAD_MAX], '\0');
+}
+
+static void testConcurrent() {
+    static MsgQueue q;
+    const uint32_t total = 200000;
+    std::atomic<bool> done(false);
+    uint32_t refused = 0;
+
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < total; i++) {
+            refused += !push(q, i);
+        }
+        done.store(true);
+    });
+
+    unsigned long t0 = micros();
+    uint32_t popped = 0;
+    uint32_t bad = 0;
+    long last = -1;
+    while (true) {
+        bool finished = done.load();
+        if (!q.pop(out)) {
+            if (finished) {
+                break;
+            }
+            // Com um núcleo só, o produtor precisa da vez
+            std::this_thread::yield();
+            continue;
+        }
+        long seq = checkPayload();
+        bad += (seq < 0 || seq <= last);
+        last = seq;
+        popped++;
+    }
+    producer.join();
+    unsigned long us = micros() - t0;
+
+    MsgQueueStats st = q.stats();
+    CHECK_EQ(bad, 0);
+    CHECK_EQ(st.popped, popped);
+#if TEST_POLICY == INGEST_DROP_NEWEST
+    CHECK_EQ(st.pushed + refused, total);
+    CHECK_EQ(st.dropped, refused);
+    CHECK_EQ(popped, st.pushed);
+#elif TEST_POLICY == INGEST_DROP_OLDEST
+    CHECK_EQ(refused, 0);
+    CHECK_EQ(popped + st.dropped, total);
+#else
+    CHECK_EQ(refused, 0);
+    CHECK_EQ(st.dropped, 0);
+    CHECK_EQ(popped, total);
+#endif
+    printf("{\"case\":\"concurrent\",\"policy\":\"%s\",\"messages\":%u,\"popped\":%u,"
+           "\"dropped\":%lu,\"blocked\":%lu,\"us\":%lu}\n",
+           policyName(), (unsigned)total, (unsigned)popped,
+           (unsigned long)st.dropped, (unsigned long)st.blocked, us);
+}
+
+static bool pushMsg(MsgQueue &q, const char *topic, unsigned seq, MsgClass cls) {
+    char payload[16];
+    int len = snprintf(payload, sizeof(payload), "%u", seq);
+    return q.push(topic, strlen(topic), (const uint8_t *)payload, len, cls);
+}
+
+// Esvazia a fila como "tópico=seq;..."
+static std::string drain(MsgQueue &q) {
+    std::string s;
+    while (q.pop(out)) {
+        s += std::string(out.topic) + "=" + out.payload + ";";
+    }
+    return s;
+}
+
+static uint32_t topicCoalesced(const MsgQueue &q, const char *topic) {
+    for (size_t i = 0; i < q.topicStatsCount(); i++) {
+        if (strcmp(q.topicStats(i).topic, topic) == 0) {
+            return q.topicStats(i).coalesced;
+        }
+    }
+    return 0;
+}
+
+static void testCoalesce() {
+    static MsgQueue q;
+
+    // Fila com espaço: nada é substituído
+    CHECK(pushMsg(q, "m/a", 1, MSG_LATEST));
+    CHECK(pushMsg(q, "m/a", 2, MSG_LATEST));
+    CHECK(drain(q) == "m/a=1;m/a=2;");
+
+    // Cheia: m/a na mais antiga, m/b na mais nova
+    CHECK(pushMsg(q, "m/a", 10, MSG_LATEST));
+    for (unsigned i = 0; i < MSG_QUEUE_SLOTS - 2; i++) {
+        CHECK(pushMsg(q, "m/n", 20 + i, MSG_NORMAL));
+    }
+    CHECK(pushMsg(q, "m/b", 30, MSG_LATEST));
+    CHECK(pushMsg(q, "m/b", 31, MSG_LATEST));
+    CHECK(pushMsg(q, "m/a", 11, MSG_LATEST));
+    CHECK(pushMsg(q, "m/a", 12, MSG_LATEST));
+    CHECK_EQ(q.depth(), MSG_QUEUE_SLOTS);
+    CHECK_EQ(q.stats().coalesced, 3);
+    CHECK_EQ(q.stats().dropped, 0);
+    CHECK_EQ(topicCoalesced(q, "m/a"), 2);
+    CHECK_EQ(topicCoalesced(q, "m/b"), 1);
+
+    std::string expected = "m/a=12;";
+    for (unsigned i = 0; i < MSG_QUEUE_SLOTS - 2; i++) {
+        expected += "m/n=" + std::to_string(20 + i) + ";";
+    }
+#if TEST_POLICY == INGEST_BLOCK
+    expected += "m/b=31;";
+#else
+    // Tópico sem mensagem na fila: a política decide
+    bool queued = pushMsg(q, "m/c", 40, MSG_LATEST);
+#if TEST_POLICY == INGEST_DROP_NEWEST
+    CHECK(!queued);
+    expected += "m/b=31;";
+#else
+    CHECK(queued);
+    expected = expected.substr(expected.find(';') + 1) + "m/b=31;m/c=40;";
+#endif
+    CHECK_EQ(q.stats().dropped, 1);
+#endif
+    std::string got = drain(q);
+    if (!CHECK(got == expected)) {
+        fprintf(stderr, "    obtido:   %s\n    esperado: %s\n", got.c_str(), expected.c_str());
+    }
+}
+
+// Consumidor que tira uma mensagem depois de ms (a crítica que espera)
+static std::string popLater(MsgQueue &q, int ms) {
+    std::string first;
+    std::thread consumer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+        while (!q.pop(out)) {
+            std::this_thread::yield();
+        }
+        first = std::string(out.topic) + "=" + out.payload + ";";
+    });
+    CHECK(pushMsg(q, "m/crit", 99, MSG_CRITICAL));
+    consumer.join();
+    return first;
+}
+
+static void testCritical() {
+    static MsgQueue q;
+    const uint32_t reserve = 2;
+    const uint32_t normal = MSG_QUEUE_SLOTS - reserve;
+    q.setCriticalReserve(reserve);
+
+    for (unsigned i = 0; i < normal; i++) {
+        CHECK(pushMsg(q, "m/n", i, MSG_NORMAL));
+    }
+    // A reserva não é das normais
+#if TEST_POLICY != INGEST_BLOCK
+    bool queued = pushMsg(q, "m/n", 100, MSG_NORMAL);
+    CHECK_EQ(q.depth(), normal);
+#if TEST_POLICY == INGEST_DROP_NEWEST
+    CHECK(!queued);
+#else
+    CHECK(queued);
+#endif
+#endif
+    for (unsigned i = 0; i < reserve; i++) {
+        CHECK(pushMsg(q, "m/crit", 50 + i, MSG_CRITICAL));
+    }
+    CHECK_EQ(q.depth(), MSG_QUEUE_SLOTS);
+
+    // Cheia: a crítica descarta a normal mais antiga (DROP_OLDEST) ou
+    // espera o consumidor
+    uint32_t blockedBefore = q.stats().blocked;
+    std::string popped;
+#if TEST_POLICY == INGEST_DROP_OLDEST
+    CHECK(pushMsg(q, "m/crit", 99, MSG_CRITICAL));
+    CHECK_EQ(q.stats().blocked, blockedBefore);
+#else
+    popped = popLater(q, 20);
+    CHECK(popped == "m/n=0;");
+    CHECK(q.stats().blocked > blockedBefore);
+#endif
+
+    // Só críticas na fila: nada é descartado para as normais
+    std::string rest = drain(q);
+    for (unsigned i = 0; i < MSG_QUEUE_SLOTS; i++) {
+        CHECK(pushMsg(q, "m/crit", 200 + i, MSG_CRITICAL));
+    }
+#if TEST_POLICY != INGEST_BLOCK
+    CHECK(!pushMsg(q, "m/n", 300, MSG_NORMAL));
+#endif
+    CHECK(popLater(q, 20) == "m/crit=200;");
+    std::string crit = drain(q);
+    std::string expected;
+    for (unsigned i = 1; i < MSG_QUEUE_SLOTS; i++) {
+        expected += "m/crit=" + std::to_string(200 + i) + ";";
+    }
+    CHECK(crit == expected + "m/crit=99;");
+
+    // Nenhuma crítica perdida
+    size_t criticals = 0;
+    for (size_t pos = (popped + rest).find("m/crit="); pos != std::string::npos;
+         pos = (popped + rest).find("m/crit=", pos + 1)) {
+        criticals++;
+    }
+    CHECK_EQ(criticals, reserve + 1);
+    printf("{\"case\":\"critical\",\"policy\":\"%s\",\"dropped\":%lu,\"blocked\":%lu}\n",
+           policyName(), (unsigned long)q.stats().dropped, (unsigned long)q.stats().blocked);
+}
+
+int main() {
+    testOverflow();
+    testOversize();
+    testConcurrent();
+    testCoalesce();
+    testCritical();
+    return testDone("msg_queue");
+}
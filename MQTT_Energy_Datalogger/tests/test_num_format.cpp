@@ -0,0 +1,193 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO NUM FORMAT (PC)
+================================================================================
+
+Confere num_format.cpp contra o printf que ele substitui:
+
+- fixed: formatDecimal(v, d) é o mesmo texto de "%.*f" para d = 0..17 e
+  valores de várias grandezas: leituras típicas, empates exatos em
+  binário (x.5, x.125, ...), vizinhos de 2^53 / 10^d (troca entre o
+  caminho rápido e o snprintf), negativos que arredondam para zero
+  ("-0.00"), -0, inf e nan.
+- shortest: com FLOAT_DECIMALS_SHORTEST, o texto relido (strtod) é o
+  mesmo double e, em decimal fixo, uma casa a menos não basta.
+- integer: formatInteger() igual a "%lld", inclusive LLONG_MIN/LLONG_MAX.
+- cap: com cap menor que o texto, -1 e nada escrito além de cap.
+- rules: decimalsForKey()/ruleForKey() (exata, prefixo "*", 1ª que casa,
+  limites) e parseNumber().
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <limits.h>
+#include <math.h>
+#include <string>
+#include <vector>
+#include "num_format.h"
+#include "check.h"
+#include "corpus.h"
+
+static std::string viaPrintf(double v, int d) {
+    char buf[400];
+    int n = snprintf(buf, sizeof(buf), "%.*f", d, v);
+    return std::string(buf, n);
+}
+
+static std::string viaFormat(double v, int d) {
+    char buf[400];
+    int n = formatDecimal(v, d, buf, sizeof(buf));
+    return (n < 0) ? std::string("<-1>") : std::string(buf, n);
+}
+
+static std::vector<double> values() {
+    std::vector<double> out = {
+        0.0, -0.0, 1.0, -1.0, 0.5, 1.5, 2.5, -2.5, 0.125, 0.375, 1.0625,
+        222.8, 224.01, 0.631, 1.179, 60.0, 123.456789, -0.00325, 1e-7,
+        -0.0001, -0.004, 0.005, 0.015, 0.025, 1.005, 2.675, 1000000.0,
+        9007199254740991.0, 9007199254740992.0, 9007199254740993.0, 1e20, -1e20,
+        1.7976931348623157e308, 4.9e-324, 2.2250738585072014e-308,
+        INFINITY, -INFINITY, NAN
+    };
+    // Vizinhos do limite do caminho rápido para cada número de casas
+    for (int d = 0; d <= NUM_FAST_DECIMALS; d++) {
+        double edge = 9007199254740992.0 / pow(10.0, d);
+        out.push_back(nextafter(edge, 0.0));
+        out.push_back(edge);
+        out.push_back(nextafter(edge, INFINITY));
+    }
+    // Empates exatos: k / 2^s
+    for (int s = 1; s <= 12; s++) {
+        for (int k = 1; k < 64; k += 2) {
+            out.push_back(k / pow(2.0, s));
+            out.push_back(-(k + 1000) / pow(2.0, s));
+        }
+    }
+    // Leituras sintéticas de várias grandezas
+    CorpusRng r = { 777 };
+    for (int i = 0; i < 20000; i++) {
+        double mant = (double)r.next() / 4294967296.0;
+        int exp = (int)r.below(24) - 12;
+        double v = mant * pow(10.0, exp);
+        out.push_back(r.below(2) ? v : -v);
+        // Decimal curto, como os medidores mandam
+        out.push_back((double)(int)r.below(100000) / pow(10.0, r.below(6)));
+    }
+    return out;
+}
+
+static void testFixed(const std::vector<double> &vals) {
+    size_t checks = 0;
+    for (double v : vals) {
+        for (int d = 0; d <= 17; d++) {
+            std::string got = viaFormat(v, d);
+            std::string expected = viaPrintf(v, d);
+            if (!CHECK(got == expected)) {
+                fprintf(stderr, "    %.17g com %d casas: '%s' != '%s'\n",
+                        v, d, got.c_str(), expected.c_str());
+            }
+            checks++;
+        }
+    }
+    printf("{\"case\":\"fixed\",\"values\":%u,\"checks\":%u}\n",
+           (unsigned)vals.size(), (unsigned)checks);
+}
+
+static void testShortest(const std::vector<double> &vals) {
+    size_t fixed = 0;
+    for (double v : vals) {
+        if (!isfinite(v)) {
+            continue;
+        }
+        std::string s = viaFormat(v, FLOAT_DECIMALS_SHORTEST);
+        double back = strtod(s.c_str(), nullptr);
+        if (!CHECK(back == v && signbit(back) == signbit(v))) {
+            fprintf(stderr, "    %.17g -> '%s'\n", v, s.c_str());
+        }
+        // Decimal fixo: uma casa a menos não relê o mesmo valor
+        if (s.find_first_of("eE") == std::string::npos) {
+            size_t dot = s.find('.');
+            if (dot != std::string::npos) {
+                int d = (int)(s.size() - dot - 1);
+                CHECK(strtod(viaPrintf(v, d - 1).c_str(), nullptr) != v);
+            }
+            fixed++;
+        }
+    }
+    CHECK(viaFormat(223.5, FLOAT_DECIMALS_SHORTEST) == "223.5");
+    CHECK(viaFormat(1000000.0, FLOAT_DECIMALS_SHORTEST) == "1000000");
+    CHECK(viaFormat(0.1, FLOAT_DECIMALS_SHORTEST) == "0.1");
+    CHECK(viaFormat(-0.0, FLOAT_DECIMALS_SHORTEST) == "-0");
+    printf("{\"case\":\"shortest\",\"values\":%u,\"fixed\":%u}\n",
+           (unsigned)vals.size(), (unsigned)fixed);
+}
+
+static void testInteger() {
+    CorpusRng r = { 99 };
+    std::vector<long long> vals = { 0, 1, -1, 9, 10, -10, LLONG_MIN, LLONG_MAX,
+                                    LLONG_MIN + 1, 12345678901LL, -9007199254740993LL };
+    for (int i = 0; i < 5000; i++) {
+        long long v = (long long)(((uint64_t)r.next() << 32) | r.next()) >> r.below(63);
+        vals.push_back(v);
+    }
+    for (long long v : vals) {
+        char buf[32], expected[32];
+        int n = formatInteger(v, buf, sizeof(buf));
+        int m = snprintf(expected, sizeof(expected), "%lld", v);
+        if (!CHECK(n == m && memcmp(buf, expected, m) == 0)) {
+            fprintf(stderr, "    %lld\n", v);
+        }
+    }
+}
+
+static void testCap() {
+    char buf[64];
+    for (double v : { 222.8, -0.00325, 1e20, 123456.789 }) {
+        for (int d : { 0, 3, 12, FLOAT_DECIMALS_SHORTEST }) {
+            std::string full = viaFormat(v, d);
+            memset(buf, '#', sizeof(buf));
+            CHECK_EQ(formatDecimal(v, d, buf, full.size()), full.size());
+            CHECK(std::string(buf, full.size()) == full);
+            memset(buf, '#', sizeof(buf));
+            CHECK_EQ(formatDecimal(v, d, buf, full.size() - 1), -1);
+            CHECK(buf[full.size() - 1] == '#');
+        }
+    }
+    CHECK_EQ(formatInteger(-12345, buf, 6), 6);
+    CHECK_EQ(formatInteger(-12345, buf, 5), -1);
+}
+
+static void testRules() {
+    const char *rules = "tensao_a:1;tensao*:2;energia*:-1;fp:4;x:99";
+    CHECK_EQ(decimalsForKey(rules, "tensao_a", 8, 3), 1);
+    CHECK_EQ(decimalsForKey(rules, "tensao_b", 8, 3), 2);
+    CHECK_EQ(decimalsForKey(rules, "tensao", 6, 3), 2);
+    CHECK_EQ(decimalsForKey(rules, "energia_ativa", 13, 3), FLOAT_DECIMALS_SHORTEST);
+    CHECK_EQ(decimalsForKey(rules, "fp", 2, 3), 4);
+    CHECK_EQ(decimalsForKey(rules, "fp_a", 4, 3), 3);
+    CHECK_EQ(decimalsForKey(rules, "x", 1, 3), 17);
+    CHECK_EQ(decimalsForKey("", "fp", 2, 3), 3);
+    CHECK(ruleForKey("a:x;b", "b", 1) == nullptr);
+    const char *v = ruleForKey("a:min;b*:max;b2:avg", "b2", 2);
+    CHECK(v && strncmp(v, "max;", 4) == 0);
+
+    double d;
+    CHECK(parseNumber("-12.5e1", 7, d) && d == -125.0);
+    CHECK(parseNumber("0", 1, d) && d == 0.0);
+    CHECK(parseNumber("12abc", 2, d) && d == 12.0);
+    CHECK(!parseNumber("12abc", 5, d));
+    CHECK(!parseNumber("", 0, d));
+    CHECK(!parseNumber("true", 4, d));
+    CHECK(!parseNumber("+1", 2, d));
+}
+
+int main() {
+    std::vector<double> vals = values();
+    testFixed(vals);
+    testShortest(vals);
+    testInteger();
+    testCap();
+    testRules();
+    return testDone("num_format");
+}
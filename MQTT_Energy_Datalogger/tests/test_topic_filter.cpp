@@ -0,0 +1,191 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TESTE DO TOPIC FILTER (PC)
+================================================================================
+
+Confere a trie de regras (topic_filter.cpp):
+
+- rules: casos escritos à mão: "+", "#" (inclusive "a/#" casando "a"),
+  rejeição vencendo aceitação, só rejeições, tópicos "$..." fora dos
+  curingas do 1º nível, níveis vazios; regras inválidas desativam o
+  filtro (compile() false, tudo passa).
+- wide: 64 regras que seguem 64 caminhos da trie ao mesmo tempo no mesmo
+  tópico; a única regra de rejeição, no último caminho, continua valendo.
+- random: regras e tópicos sintéticos contra a conferência regra a regra
+  da especificação MQTT; mesma decisão em todos.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string>
+#include <vector>
+#include "topic_filter.h"
+#include "check.h"
+#include "corpus.h"
+
+static std::vector<std::string> split(const std::string &s, char sep) {
+    std::vector<std::string> out;
+    size_t pos = 0;
+    while (true) {
+        size_t end = s.find(sep, pos);
+        out.push_back(s.substr(pos, end == std::string::npos ? std::string::npos : end - pos));
+        if (end == std::string::npos) {
+            return out;
+        }
+        pos = end + 1;
+    }
+}
+
+// Uma regra (sem '!') contra o tópico, direto da especificação
+static bool ruleMatches(const std::string &rule, const std::string &topic) {
+    std::vector<std::string> r = split(rule, '/');
+    std::vector<std::string> t = split(topic, '/');
+    bool sys = !topic.empty() && topic[0] == '$';
+    for (size_t i = 0; i < r.size(); i++) {
+        if (r[i] == "#") {
+            return !(i == 0 && sys);
+        }
+        if (i >= t.size()) {
+            return false;
+        }
+        if (r[i] == "+") {
+            if (i == 0 && sys) {
+                return false;
+            }
+            continue;
+        }
+        if (r[i] != t[i]) {
+            return false;
+        }
+    }
+    return r.size() == t.size();
+}
+
+static bool reference(const std::string &rules, const std::string &topic) {
+    bool hasAllow = false, allowed = false;
+    for (std::string rule : split(rules, ';')) {
+        if (rule.empty()) {
+            continue;
+        }
+        bool deny = (rule[0] == '!');
+        if (deny) {
+            rule.erase(0, 1);
+        }
+        bool m = ruleMatches(rule, topic);
+        if (deny && m) {
+            return false;
+        }
+        if (!deny) {
+            hasAllow = true;
+            allowed = allowed || m;
+        }
+    }
+    return allowed || !hasAllow;
+}
+
+static TopicFilter filter;
+
+static void expect(const char *rules, const char *topic, bool accepted) {
+    filter.compile(rules);
+    if (!CHECK(filter.accepts(topic) == accepted)) {
+        fprintf(stderr, "    regras \"%s\", tópico \"%s\"\n", rules, topic);
+    }
+}
+
+static void testRules() {
+    expect("", "qualquer/coisa", true);
+    expect("MiEnergy/#", "MiEnergy/01/power", true);
+    expect("MiEnergy/#", "MiEnergy", true);
+    expect("MiEnergy/#", "MiEnergyX/01", false);
+    expect("meters/+/power", "meters/7/power", true);
+    expect("meters/+/power", "meters/7/8/power", false);
+    expect("meters/+/power", "meters//power", true);
+    expect("meters/+", "meters", false);
+    expect("MiEnergy/#;!MiEnergy/+/debug", "MiEnergy/01/debug", false);
+    expect("MiEnergy/#;!MiEnergy/+/debug", "MiEnergy/01/power", true);
+    expect("!MiEnergy/#", "MiEnergy/01", false);
+    expect("!MiEnergy/#", "outro/01", true);
+    expect("#", "$SYS/datalogger/metrics", false);
+    expect("+/datalogger/#", "$SYS/datalogger/metrics", false);
+    expect("$SYS/#", "$SYS/datalogger/metrics", true);
+    expect(" a/b ; ;c/# ", "c/d", true);
+
+    // Inválidas: o filtro é desativado
+    CHECK(!filter.compile("a/#/b"));
+    CHECK(filter.accepts("x/y"));
+    CHECK_EQ(filter.ruleCount(), 0);
+    CHECK(!filter.compile("a/b+"));
+    CHECK(!filter.compile("!"));
+}
+
+static void testWide() {
+    // Todas as combinações de "a"/"+" em 6 níveis: 64 caminhos ativos no
+    // tópico a/a/a/a/a/a; a rejeição é o último deles
+    std::string rules;
+    for (unsigned mask = 0; mask < 64; mask++) {
+        std::string rule = (mask == 63) ? "!" : "";
+        for (unsigned level = 0; level < 6; level++) {
+            rule += (level ? "/" : "");
+            rule += (mask & (1u << level)) ? "+" : "a";
+        }
+        rules += rule + ";";
+    }
+    CHECK(filter.compile(rules.c_str()));
+    CHECK_EQ(filter.ruleCount(), 64);
+    CHECK(!filter.accepts("a/a/a/a/a/a"));
+    CHECK(!filter.accepts("b/b/b/b/b/b"));
+    CHECK(!filter.accepts("a/a/a/a/a"));
+    CHECK_EQ(reference(rules, "a/a/a/a/a/a"), false);
+}
+
+static std::string randomTopic(CorpusRng &r, bool rule) {
+    static const char *levels[] = { "MiEnergy", "meters", "01", "02", "power", "debug", "", "$SYS" };
+    size_t n = 1 + r.below(4);
+    std::string s;
+    for (size_t i = 0; i < n; i++) {
+        s += i ? "/" : "";
+        uint32_t k = r.below(rule ? 11 : 8);
+        if (k == 8 || k == 9) {
+            s += "+";
+        } else if (k == 10) {
+            s += "#";
+            break;
+        } else if (k != 7 || i == 0) {
+            s += levels[k];
+        }
+    }
+    // Regra vazia ("!" sozinho) é inválida
+    return (rule && s.empty()) ? "MiEnergy" : s;
+}
+
+static void testRandom() {
+    CorpusRng r = { 12345 };
+    size_t checks = 0;
+    for (size_t set = 0; set < 400; set++) {
+        std::string rules;
+        size_t n = 1 + r.below(6);
+        for (size_t i = 0; i < n; i++) {
+            rules += (r.below(3) == 0 ? "!" : "") + randomTopic(r, true) + ";";
+        }
+        if (!CHECK(filter.compile(rules.c_str()))) {
+            fprintf(stderr, "    regras \"%s\"\n", rules.c_str());
+            continue;
+        }
+        for (size_t t = 0; t < 50; t++) {
+            std::string topic = randomTopic(r, false);
+            if (!CHECK(filter.accepts(topic.c_str()) == reference(rules, topic))) {
+                fprintf(stderr, "    regras \"%s\", tópico \"%s\"\n", rules.c_str(), topic.c_str());
+            }
+            checks++;
+        }
+    }
+    printf("{\"case\":\"random\",\"topics\":%u}\n", (unsigned)checks);
+}
+
+int main() {
+    testRules();
+    testWide();
+    testRandom();
+    return testDone("topic_filter");
+}
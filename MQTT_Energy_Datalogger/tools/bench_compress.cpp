@@ -0,0 +1,153 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BENCH COMPRESS (FERRAMENTA DE PC)
+================================================================================
+
+Mede a compressão do log (log_compress.cpp) sobre arquivos de log sem
+compressão (ex.: o CSV gerado pelo replay), cortados nos mesmos blocos do
+firmware: CSV_SINK_BUFFER_SIZE (csv_sink) e PARTITION_BUFFER_SIZE
+(log_partitions), com o config.h em vigor.
+
+Uma linha JSON por arquivo e tamanho de bloco:
+- ratio: bytes originais / bytes gravados (frames com cabeçalho);
+- stored: frames que não comprimiram (gravados como estão);
+- ns_per_kb: CPU para comprimir / descomprimir 1 KiB do original;
+- sd_ms_saved_per_mb: tempo de SD poupado por MiB de log, com o SD
+  gravando a --sd-kbs KiB/s (o número de blocos gravados não muda, só o
+  tamanho de cada um);
+- check: todos os blocos voltam idênticos na descompressão.
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/. O core da
+ESP32 compila com -Os: usar o mesmo para comparar versões do compressor.
+O custo absoluto na ESP32 (240 MHz) vem da etapa "lz" das métricas
+(METRIC_COMPRESS) com LOG_COMPRESS = 1.
+    g++ -Os -std=gnu++17 -I . log_compress.cpp \
+        tools/bench_compress.cpp -o bench_compress
+
+Uso:
+    ./bench_compress [--sd-kbs 400] energy_log.csv [outro.csv ...]
+
+================================================================================
+*/
+
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../config.h"
+#include "../log_compress.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static bool readFile(const char *path, std::vector<uint8_t> &data) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+    return true;
+}
+
+static double elapsedNs(Clock::time_point t0) {
+    return std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+}
+
+static void runBlocks(const char *path, const std::vector<uint8_t> &data,
+                      size_t blockSize, double sdKbs) {
+    size_t blocks = (data.size() + blockSize - 1) / blockSize;
+    std::vector<uint8_t> frames(blocks * LZ_FRAME_MAX(blockSize));
+    std::vector<size_t> frameLen(blocks);
+
+    // Repete até ~0,2 s para o tempo ficar estável
+    unsigned long reps = 0;
+    size_t written = 0;
+    Clock::time_point t0 = Clock::now();
+    do {
+        written = 0;
+        for (size_t b = 0; b < blocks; b++) {
+            size_t off = b * blockSize;
+            size_t n = (data.size() - off < blockSize) ? data.size() - off : blockSize;
+            frameLen[b] = lzFrameEncode(&data[off], n, &frames[b * LZ_FRAME_MAX(blockSize)]);
+            written += frameLen[b];
+        }
+        reps++;
+    } while (elapsedNs(t0) < 2e8);
+    double encodeNs = elapsedNs(t0) / reps;
+
+    unsigned long stored = 0;
+    bool ok = true;
+    std::vector<uint8_t> out(blockSize);
+    reps = 0;
+    t0 = Clock::now();
+    do {
+        for (size_t b = 0; b < blocks; b++) {
+            const uint8_t *frame = &frames[b * LZ_FRAME_MAX(blockSize)];
+            LzFrame info;
+            if (!lzFrameHeader(frame, info) ||
+                (size_t)info.dataLen + LZ_FRAME_HEADER != frameLen[b] ||
+                !lzFrameDecode(info, frame + LZ_FRAME_HEADER, out.data())) {
+                ok = false;
+                continue;
+            }
+            if (reps == 0) {
+                size_t off = b * blockSize;
+                stored += (info.method == LZ_STORED) ? 1 : 0;
+                ok = ok && info.rawLen == ((data.size() - off < blockSize) ? data.size() - off : blockSize) &&
+                     memcmp(out.data(), &data[off], info.rawLen) == 0;
+            }
+        }
+        reps++;
+    } while (elapsedNs(t0) < 2e8);
+    double decodeNs = elapsedNs(t0) / reps;
+
+    double kb = data.size() / 1024.0;
+    double ratio = (double)data.size() / written;
+    double savedMsPerMb = (1.0 - 1.0 / ratio) * 1024.0 / sdKbs * 1000.0;
+    printf("{\"file\":\"%s\",\"block\":%lu,\"bytes\":%lu,\"frames\":%lu,\"stored\":%lu,"
+           "\"written\":%lu,\"ratio\":%.2f,\"ns_per_kb\":{\"compress\":%.0f,\"decompress\":%.0f},"
+           "\"sd_ms_saved_per_mb\":%.0f,\"check\":\"%s\"}\n",
+           path, (unsigned long)blockSize, (unsigned long)data.size(), (unsigned long)blocks,
+           stored, (unsigned long)written, ratio, encodeNs / kb, decodeNs / kb,
+           savedMsPerMb, ok ? "ok" : "falhou");
+    fflush(stdout);
+    if (!ok) {
+        exit(1);
+    }
+}
+
+int main(int argc, char **argv) {
+    double sdKbs = 400;
+    int files = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--sd-kbs") == 0 && i + 1 < argc) {
+            sdKbs = atof(argv[++i]);
+            continue;
+        }
+        std::vector<uint8_t> data;
+        if (!readFile(argv[i], data)) {
+            return 1;
+        }
+        if (data.empty()) {
+            fprintf(stderr, "%s: vazio\n", argv[i]);
+            continue;
+        }
+        const size_t sizes[] = { CSV_SINK_BUFFER_SIZE, PARTITION_BUFFER_SIZE };
+        for (size_t blockSize : sizes) {
+            runBlocks(argv[i], data, blockSize, sdKbs);
+        }
+        files++;
+    }
+    if (files == 0) {
+        fprintf(stderr, "uso: %s [--sd-kbs KiB/s] <log> [...]\n", argv[0]);
+        return 2;
+    }
+    return 0;
+}
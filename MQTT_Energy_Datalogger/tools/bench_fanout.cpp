@@ -0,0 +1,668 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BENCH FANOUT (FERRAMENTA DE PC)
+================================================================================
+
+Confere e mede o fan-out das linhas (row_fanout.cpp) com as três saídas
+de row_sinks.cpp, com o config.h em vigor, "cartão" em um diretório
+temporário (tools/host). Linha de teste: COLUMNS colunas (texto, inteiros,
+reais com 2 casas, algumas ausentes), tópico MiEnergy/01.
+
+Conferência (sai com 1 se alguma falha):
+- delivery: log + binária + Serial + MQTT. Cada saída recebe cada linha
+  uma vez, e o mesmo objeto LogRow passado a write() (sem cópia); o JSON
+  republicado é o esperado, no tópico ROW_SINK_MQTT_PREFIX + tópico; o
+  arquivo binário tem o esquema das linhas.
+- isolation: relógio virtual, uma linha a cada 10 ms. Uma saída que
+  sempre falha e uma que passa de ROW_SINK_SLOW_US ficam suspensas como
+  no modelo de referência (ROW_SINK_STRIKES, ROW_SINK_BACKOFF_MS); a
+  saída normal e o log (não isolado, falhando) recebem todas as linhas.
+- mqtt_full: sem consumidor, o buffer do MqttRowSink enche, a saída é
+  suspensa e o que ficou nele sai inteiro depois.
+- stall: relógio virtual, uma linha a cada ROW_US com poll() depois
+  dela, como na task de logging. A cópia binária trava STALL_US a cada
+  bloco gravado (em write() ou poll()); a taxa de linhas do log fica a
+  mesma de uma cópia binária normal, menos os travamentos até cada
+  suspensão (ROW_SINK_STRIKES, depois um por ROW_SINK_BACKOFF_MS).
+- flush_suspended: uma cópia binária lenta é suspensa com linhas no
+  buffer; RowFanout::flush() as grava (nada fica pendente) sem mudar a
+  suspensão.
+
+Custo (uma linha JSON por conjunto de saídas): ns por linha em
+RowFanout::write() e marginal_ns, o acréscimo sobre o conjunto anterior
+(null: saída que não faz nada, o custo do próprio fan-out). As linhas vão
+em rajadas de BURST, com pausa entre elas fora da medição para o diag_log
+esvaziar o buffer, como acontece entre as mensagens dos medidores; o
+MqttRowSink é lido depois de cada linha (o loop() roda no outro núcleo).
+O Serial do diag_log vai para stderr.
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -std=gnu++17 -I tools/host -I . -I <ArduinoJson>/src \
+        row_fanout.cpp row_sinks.cpp bin_log.cpp csv_sink.cpp json_flatten.cpp column_map.cpp \
+        num_format.cpp log_compress.cpp metrics.cpp diag_log.cpp \
+        tools/host/host.cpp tools/bench_fanout.cpp -o bench_fanout -lpthread
+
+Uso:
+    ./bench_fanout [-n linhas] > resultado.jsonl 2>/dev/null
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+#include "../config.h"
+#include "../diag_log.h"
+#include "../row_fanout.h"
+#include "../row_sinks.h"
+
+#if LOG_COMPRESS
+#error "bench_fanout relê o esquema do arquivo binário: compilar com LOG_COMPRESS = 0"
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+#define COLUMNS  12
+#define BURST    16
+#define STEP_MS  10         // Intervalo entre linhas no relógio virtual
+#define ROW_US   2000       // stall: processamento de uma linha
+#define STALL_US 200000     // stall: cada bloco no cartão travado
+
+static const char TOPIC[] = "MiEnergy/01";
+static const char CLIENT[] = "esp32_logger";
+static const char BIN_PATH[] = "/fanout.bin";
+
+// -----------------------------------------------------------------------------
+// Linha de teste
+// -----------------------------------------------------------------------------
+static const char rowText[] = "mi-0mi-1mi-2mi-3";
+static FlatValue cells[COLUMNS];
+static char keyNames[COLUMNS][16];
+
+static size_t benchKey(size_t i, char *buf, size_t cap) {
+    size_t n = strlen(keyNames[i]);
+    n = (n < cap) ? n : cap;
+    memcpy(buf, keyNames[i], n);
+    return n;
+}
+
+// Coluna 0: texto; múltiplas de 3: inteiros; 7: ausente; demais: reais
+static LogRow makeRow(unsigned long seq) {
+    for (size_t c = 0; c < COLUMNS; c++) {
+        snprintf(keyNames[c], sizeof(keyNames[c]), "campo_%02u", (unsigned)c);
+        FlatValue &v = cells[c];
+        if (c == 0) {
+            v.type = FLAT_TEXT;
+            v.text.off = (uint16_t)((seq % 4) * 4);
+            v.text.len = 4;
+        } else if (c == 7) {
+            v.type = FLAT_ABSENT;
+        } else if (c % 3 == 0) {
+            v.type = FLAT_INT;
+            v.i = (int64_t)(seq * c);
+        } else {
+            v.type = FLAT_REAL;
+            v.decimals = 2;
+            v.d = 220.0 + (double)((seq + c) % 100) * 0.01;
+        }
+    }
+    LogRow row = { seq * STEP_MS, CLIENT, TOPIC, rowText, cells, COLUMNS, benchKey };
+    return row;
+}
+
+// O JSON que o MqttRowSink deve publicar para a linha seq
+static std::string expectedJson(unsigned long seq) {
+    char buf[256];
+    snprintf(buf, sizeof(buf), "{\"ts\":%lu,\"client_id\":\"%s\"", seq * STEP_MS, CLIENT);
+    std::string s = buf;
+    for (size_t c = 0; c < COLUMNS; c++) {
+        const FlatValue &v = cells[c];
+        if (v.type == FLAT_ABSENT) {
+            continue;
+        }
+        if (v.type == FLAT_TEXT) {
+            snprintf(buf, sizeof(buf), ",\"%s\":\"%.*s\"", keyNames[c], (int)v.text.len,
+                     rowText + v.text.off);
+        } else if (v.type == FLAT_INT) {
+            snprintf(buf, sizeof(buf), ",\"%s\":%lld", keyNames[c], (long long)v.i);
+        } else {
+            snprintf(buf, sizeof(buf), ",\"%s\":%.2f", keyNames[c], v.d);
+        }
+        s += buf;
+    }
+    return s + "}";
+}
+
+// -----------------------------------------------------------------------------
+// Saídas de teste
+// -----------------------------------------------------------------------------
+static const LogRow *currentRow = nullptr;
+
+// Repassa a outra saída, contando as chamadas e se o LogRow é o original
+class ProbeSink : public RowSink {
+public:
+    explicit ProbeSink(RowSink *inner) : inner(inner), calls(0), copies(0) {}
+
+    const char *name() const override { return inner->name(); }
+    bool write(const LogRow &row) override {
+        calls++;
+        if (&row != currentRow || row.cells != cells) {
+            copies++;
+        }
+        return inner->write(row);
+    }
+    void poll() override { inner->poll(); }
+    void flush() override { inner->flush(); }
+
+    RowSink *inner;
+    unsigned long calls;
+    unsigned long copies;
+};
+
+// Resultado fixo, com atraso opcional (espera ativa, como uma escrita lenta)
+class FixedSink : public RowSink {
+public:
+    FixedSink(const char *name, bool result, uint32_t delayUs)
+        : _name(name), _result(result), _delayUs(delayUs), calls(0) {}
+
+    const char *name() const override { return _name; }
+    bool write(const LogRow &) override {
+        calls++;
+        uint32_t t = micros();
+        while (micros() - t < _delayUs) {
+        }
+        return _result;
+    }
+
+    const char *_name;
+    bool _result;
+    uint32_t _delayUs;
+    unsigned long calls;
+};
+
+// Relógio virtual (hostMillis / hostMicros) em µs
+static unsigned long long virtualUs;
+
+static void virtualSet(unsigned long long us) {
+    virtualUs = us;
+    hostMicros = (long)virtualUs;
+    hostMillis = (long)(virtualUs / 1000);
+}
+
+// Saída binária num cartão que trava: cada bloco que ela grava custa
+// stallUs no relógio virtual, dentro da chamada
+class StallSink : public RowSink {
+public:
+    StallSink(BinaryRowSink *inner, uint32_t stallUs)
+        : inner(inner), stallUs(stallUs), stalls(0) {}
+
+    const char *name() const override { return "bin_travada"; }
+    bool write(const LogRow &row) override {
+        uint32_t before = blocks();
+        bool ok = inner->write(row);
+        stall(before);
+        return ok;
+    }
+    void poll() override {
+        uint32_t before = blocks();
+        inner->poll();
+        stall(before);
+    }
+    void flush() override {
+        uint32_t before = blocks();
+        inner->flush();
+        stall(before);
+    }
+
+    BinaryRowSink *inner;
+    uint32_t stallUs;
+    unsigned long stalls;
+
+private:
+    uint32_t blocks() const { return inner->fileStats().writes; }
+    void stall(uint32_t before) {
+        if (blocks() != before && stallUs > 0) {
+            virtualSet(virtualUs + stallUs);
+            stalls++;
+        }
+    }
+};
+
+// Saída binária lenta: cada write() custa lagUs no relógio virtual
+class LagSink : public RowSink {
+public:
+    LagSink(BinaryRowSink *inner, uint32_t lagUs) : inner(inner), lagUs(lagUs) {}
+
+    const char *name() const override { return "bin_lenta"; }
+    bool write(const LogRow &row) override {
+        virtualSet(virtualUs + lagUs);
+        return inner->write(row);
+    }
+    void poll() override { inner->poll(); }
+    void flush() override { inner->flush(); }
+
+    BinaryRowSink *inner;
+    uint32_t lagUs;
+};
+
+static std::string newSdDir() {
+    char sd[] = "/tmp/bench_fanout_XXXXXX";
+    if (!mkdtemp(sd)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    hostSdRoot(sd);
+    return sd;
+}
+
+// Pausa fora da medição: o diag_log esvazia a cada DIAG_DRAIN_MS
+static void drainDiag() {
+    delay(2 * DIAG_DRAIN_MS);
+}
+
+// "loop()": lê tudo o que o MqttRowSink tem pendente
+static unsigned long drainMqtt(MqttRowSink &mqtt, std::vector<std::string> *out) {
+    static char topic[ROW_SINK_MQTT_TOPIC_MAX + 1];
+    static char payload[ROW_SINK_MQTT_PAYLOAD_MAX];
+    size_t len;
+    unsigned long n = 0;
+    while (mqtt.pop(topic, payload, len)) {
+        if (out) {
+            out->push_back(std::string(topic) + " " + std::string(payload, len));
+        }
+        n++;
+    }
+    return n;
+}
+
+// -----------------------------------------------------------------------------
+// Conferência
+// -----------------------------------------------------------------------------
+static bool failed = false;
+
+static void check(bool ok, const char *what, unsigned long got, unsigned long want) {
+    if (!ok) {
+        fprintf(stderr, "check: %s (%lu, esperado %lu)\n", what, got, want);
+        failed = true;
+    }
+}
+
+static bool binKey(void *, size_t i, const char *key, size_t len) {
+    char buf[16];
+    return i < COLUMNS && benchKey(i, buf, sizeof(buf)) == len && memcmp(buf, key, len) == 0;
+}
+
+static void checkDelivery(unsigned long rows) {
+    newSdDir();
+    FixedSink log("log", true, 0);
+    BinaryRowSink *bin = new BinaryRowSink(BIN_PATH);
+    SerialRowSink serial;
+    MqttRowSink mqtt;
+    ProbeSink probes[3] = { ProbeSink(bin), ProbeSink(&serial), ProbeSink(&mqtt) };
+
+    RowFanout fanout;
+    fanout.add(&log, false);
+    for (ProbeSink &p : probes) {
+        fanout.add(&p, true);
+    }
+
+    unsigned long badJson = 0;
+    unsigned long published = 0;
+    std::vector<std::string> msgs;
+    for (unsigned long seq = 0; seq < rows; seq++) {
+        LogRow row = makeRow(seq);
+        currentRow = &row;
+        fanout.write(row);
+
+        msgs.clear();
+        published += drainMqtt(mqtt, &msgs);
+        std::string want = std::string(ROW_SINK_MQTT_PREFIX) + TOPIC + " " + expectedJson(seq);
+        if (msgs.size() != 1 || msgs[0] != want) {
+            if (badJson == 0) {
+                fprintf(stderr, "mqtt: %s\nesperado: %s\n",
+                        msgs.empty() ? "(nada)" : msgs[0].c_str(), want.c_str());
+            }
+            badJson++;
+        }
+        if (seq % BURST == BURST - 1) {
+            drainDiag();
+        }
+    }
+    fanout.flush();
+
+    check(log.calls == rows, "delivery: linhas no log", log.calls, rows);
+    for (size_t i = 1; i < fanout.count(); i++) {
+        const ProbeSink &p = probes[i - 1];
+        const RowSinkStats &st = fanout.stats(i);
+        check(p.calls == rows, p.name(), p.calls, rows);
+        check(p.copies == 0, "delivery: LogRow diferente do original", p.copies, 0);
+        check(st.rows == rows && st.failures == 0 && st.skipped == 0,
+              "delivery: linhas aceitas", st.rows, rows);
+    }
+    check(published == rows, "delivery: publicações MQTT", published, rows);
+    check(badJson == 0, "delivery: JSON diferente do esperado", badJson, 0);
+
+    File f = SD.open(BIN_PATH, FILE_READ);
+    size_t schema = f ? binLogReadSchema(f, binKey, nullptr) : 0;
+    if (f) {
+        f.close();
+    }
+    check(schema == COLUMNS, "delivery: esquema do arquivo binário", schema, COLUMNS);
+    check(bin->fileStats().errors == 0, "delivery: erros do arquivo binário",
+          bin->fileStats().errors, 0);
+    delete bin;
+
+    printf("{\"check_delivery\":\"%s\",\"rows\":%lu}\n", failed ? "falhou" : "ok", rows);
+}
+
+// Modelo de referência: chamadas e suspensões de uma saída que sempre
+// falha (ou é lenta), uma linha a cada STEP_MS
+static void expectedStrikes(unsigned long rows, unsigned long &calls, unsigned long &suspensions) {
+    calls = 0;
+    suspensions = 0;
+    bool suspended = false;
+    unsigned long resumeAt = 0;
+    int strikes = 0;
+    for (unsigned long seq = 0; seq < rows; seq++) {
+        unsigned long now = seq * STEP_MS;
+        if (suspended) {
+            if (now < resumeAt) {
+                continue;
+            }
+            suspended = false;
+            strikes = ROW_SINK_STRIKES - 1;
+        }
+        calls++;
+        if (++strikes >= ROW_SINK_STRIKES) {
+            suspended = true;
+            resumeAt = now + ROW_SINK_BACKOFF_MS;
+            suspensions++;
+        }
+    }
+}
+
+static void checkIsolation() {
+    // Três períodos de suspensão
+    unsigned long rows = 3 * ROW_SINK_BACKOFF_MS / STEP_MS + 10;
+    FixedSink log("log", false, 0);
+    FixedSink failing("falha", false, 0);
+    FixedSink slow("lenta", true, ROW_SINK_SLOW_US + 500);
+    FixedSink good("normal", true, 0);
+
+    RowFanout fanout;
+    fanout.add(&log, false);
+    fanout.add(&failing, true);
+    fanout.add(&slow, true);
+    fanout.add(&good, true);
+
+    bool before = failed;
+    for (unsigned long seq = 0; seq < rows; seq++) {
+        hostMillis = (long)(seq * STEP_MS);
+        LogRow row = makeRow(seq);
+        fanout.write(row);
+    }
+    hostMillis = -1;
+
+    unsigned long calls, suspensions;
+    expectedStrikes(rows, calls, suspensions);
+    check(log.calls == rows && fanout.stats(0).suspensions == 0,
+          "isolation: log não isolado recebe tudo", log.calls, rows);
+    check(good.calls == rows && fanout.stats(3).rows == rows,
+          "isolation: saída normal recebe tudo", good.calls, rows);
+    for (size_t i = 1; i <= 2; i++) {
+        const FixedSink &s = (i == 1) ? failing : slow;
+        const RowSinkStats &st = fanout.stats(i);
+        check(s.calls == calls, s.name(), s.calls, calls);
+        check(st.suspensions == suspensions, "isolation: suspensões", st.suspensions, suspensions);
+        check(s.calls + st.skipped == rows, "isolation: chamadas + puladas", s.calls + st.skipped, rows);
+    }
+    check(fanout.stats(2).slow == calls, "isolation: escritas lentas", fanout.stats(2).slow, calls);
+
+    printf("{\"check_isolation\":\"%s\",\"rows\":%lu,\"calls\":%lu,\"suspensions\":%lu}\n",
+           (failed && !before) ? "falhou" : "ok", rows, calls, suspensions);
+}
+
+static void checkMqttFull() {
+    MqttRowSink mqtt;
+    RowFanout fanout;
+    fanout.add(&mqtt, true);
+
+    // Sem consumidor: enche, falha ROW_SINK_STRIKES vezes e é suspensa
+    unsigned long rows = 2 * ROW_SINK_MQTT_BUFFER / 64;
+    for (unsigned long seq = 0; seq < rows; seq++) {
+        LogRow row = makeRow(seq);
+        fanout.write(row);
+    }
+    const RowSinkStats &st = fanout.stats(0);
+    bool before = failed;
+    check(st.failures == ROW_SINK_STRIKES && st.suspensions == 1,
+          "mqtt_full: falhas até a suspensão", st.failures, ROW_SINK_STRIKES);
+    check(st.rows + st.failures + st.skipped == rows, "mqtt_full: linhas",
+          st.rows + st.failures + st.skipped, rows);
+
+    // As aceitas saem inteiras, na ordem
+    std::vector<std::string> msgs;
+    drainMqtt(mqtt, &msgs);
+    unsigned long bad = 0;
+    for (size_t i = 0; i < msgs.size(); i++) {
+        makeRow(i);
+        if (msgs[i] != std::string(ROW_SINK_MQTT_PREFIX) + TOPIC + " " + expectedJson(i)) {
+            bad++;
+        }
+    }
+    check(msgs.size() == st.rows, "mqtt_full: publicações", msgs.size(), st.rows);
+    check(bad == 0, "mqtt_full: JSON diferente do esperado", bad, 0);
+    check(mqtt.pending() == 0, "mqtt_full: buffer vazio no fim", mqtt.pending(), 0);
+
+    printf("{\"check_mqtt_full\":\"%s\",\"accepted\":%lu,\"failures\":%lu,\"skipped\":%lu}\n",
+           (failed && !before) ? "falhou" : "ok", (unsigned long)st.rows,
+           (unsigned long)st.failures, (unsigned long)st.skipped);
+}
+
+struct StallResult {
+    unsigned long rows;         // Linhas no log
+    unsigned long stalls;       // Blocos travados
+    unsigned long suspensions;
+};
+
+// runMs de relógio virtual com a cópia binária travando stallUs por bloco
+static StallResult stallRun(unsigned long runMs, uint32_t stallUs) {
+    newSdDir();
+    virtualSet(0);
+    FixedSink log("log", true, 0);
+    BinaryRowSink bin(BIN_PATH);
+    StallSink stalled(&bin, stallUs);
+
+    RowFanout fanout;
+    fanout.add(&log, false);
+    fanout.add(&stalled, true);
+    for (unsigned long seq = 0; virtualUs < runMs * 1000ULL; seq++) {
+        virtualSet(virtualUs + ROW_US);
+        LogRow row = makeRow(seq);
+        fanout.write(row);
+        fanout.poll();
+    }
+    fanout.flush();
+    hostMillis = -1;
+    hostMicros = -1;
+
+    StallResult r = { log.calls, stalled.stalls, fanout.stats(1).suspensions };
+    return r;
+}
+
+static void checkStall() {
+    // Três voltas da suspensão
+    unsigned long runMs = 3 * ROW_SINK_BACKOFF_MS + ROW_SINK_BACKOFF_MS / 2;
+    bool before = failed;
+    StallResult normal = stallRun(runMs, 0);
+    StallResult r = stallRun(runMs, STALL_US);
+
+    // Travamentos: ROW_SINK_STRIKES até a 1ª suspensão, um em cada volta
+    unsigned long turns = runMs / ROW_SINK_BACKOFF_MS;
+    unsigned long maxStalls = ROW_SINK_STRIKES + turns;
+    unsigned long lost = (r.rows < normal.rows) ? normal.rows - r.rows : 0;
+    unsigned long maxLost = maxStalls * (STALL_US / ROW_US) + 1;
+    check(r.suspensions >= turns, "stall: suspensões", r.suspensions, turns);
+    check(r.stalls <= maxStalls, "stall: blocos travados", r.stalls, maxStalls);
+    check(r.rows <= normal.rows && lost <= maxLost, "stall: linhas do log a menos", lost, maxLost);
+    check(r.rows * 100 >= normal.rows * 95, "stall: linhas do log", r.rows, normal.rows);
+
+    printf("{\"check_stall\":\"%s\",\"rows\":%lu,\"rows_normal\":%lu,\"stalls\":%lu,"
+           "\"suspensions\":%lu,\"rate\":%.3f}\n",
+           (failed && !before) ? "falhou" : "ok", r.rows, normal.rows, r.stalls,
+           r.suspensions, (double)r.rows / (double)normal.rows);
+}
+
+static void checkFlushSuspended() {
+    newSdDir();
+    virtualSet(0);
+    BinaryRowSink bin(BIN_PATH);
+    LagSink lag(&bin, ROW_SINK_SLOW_US + 500);
+
+    RowFanout fanout;
+    fanout.add(&lag, true);
+    unsigned long rows = ROW_SINK_STRIKES + 5;
+    for (unsigned long seq = 0; seq < rows; seq++) {
+        virtualSet(virtualUs + ROW_US);
+        LogRow row = makeRow(seq);
+        fanout.write(row);
+        fanout.poll();
+    }
+    const RowSinkStats &st = fanout.stats(0);
+    bool before = failed;
+    check(st.suspensions == 1 && st.rows == ROW_SINK_STRIKES,
+          "flush_suspended: suspensa com linhas no buffer", st.rows, ROW_SINK_STRIKES);
+    uint32_t writes = bin.fileStats().writes;
+    check(writes == 0, "flush_suspended: nada gravado antes do flush()", writes, 0);
+
+    fanout.flush();
+    uint32_t flushed = bin.fileStats().writes;
+    bin.flush();
+    check(flushed > writes, "flush_suspended: buffer gravado", flushed, writes + 1);
+    check(bin.fileStats().writes == flushed, "flush_suspended: nada pendente",
+          bin.fileStats().writes, flushed);
+    check(st.suspensions == 1, "flush_suspended: suspensões", st.suspensions, 1);
+
+    File f = SD.open(BIN_PATH, FILE_READ);
+    size_t schema = f ? binLogReadSchema(f, binKey, nullptr) : 0;
+    if (f) {
+        f.close();
+    }
+    check(schema == COLUMNS, "flush_suspended: esquema do arquivo binário", schema, COLUMNS);
+    hostMillis = -1;
+    hostMicros = -1;
+
+    printf("{\"check_flush_suspended\":\"%s\",\"rows\":%lu,\"buffered\":%lu,\"bytes\":%lu}\n",
+           (failed && !before) ? "falhou" : "ok", rows, (unsigned long)st.rows,
+           (unsigned long)bin.fileStats().bytes);
+}
+
+// -----------------------------------------------------------------------------
+// Custo por saída
+// -----------------------------------------------------------------------------
+struct SinkSet {
+    const char *name;
+    int base;           // Conjunto de referência do marginal_ns (-1 = nenhum)
+    bool null, bin, serial, mqtt;
+};
+
+static const SinkSet sets[] = {
+    { "none",            -1, false, false, false, false },
+    { "null",             0, true,  false, false, false },
+    { "bin",              0, false, true,  false, false },
+    { "bin+serial",       2, false, true,  true,  false },
+    { "bin+serial+mqtt",  3, false, true,  true,  true  },
+};
+
+static double runSet(const SinkSet &set, unsigned long rows) {
+    newSdDir();
+    FixedSink null("null", true, 0);
+    BinaryRowSink *bin = new BinaryRowSink(BIN_PATH);
+    SerialRowSink serial;
+    MqttRowSink mqtt;
+
+    RowFanout fanout;
+    if (set.null) {
+        fanout.add(&null, true);
+    }
+    if (set.bin) {
+        fanout.add(bin, true);
+    }
+    if (set.serial) {
+        fanout.add(&serial, true);
+    }
+    if (set.mqtt) {
+        fanout.add(&mqtt, true);
+    }
+
+    // 1ª linha fora da medição (abre o arquivo e grava o esquema)
+    LogRow first = makeRow(0);
+    fanout.write(first);
+
+    double ns = 0;
+    for (unsigned long seq = 1; seq <= rows; seq++) {
+        LogRow row = makeRow(seq);
+        Clock::time_point t0 = Clock::now();
+        fanout.write(row);
+        ns += std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+
+        // O loop() publica em paralelo, no outro núcleo
+        drainMqtt(mqtt, nullptr);
+        if (set.serial && seq % BURST == 0) {
+            drainDiag();
+        }
+    }
+    fanout.flush();
+
+    for (size_t i = 0; i < fanout.count(); i++) {
+        const RowSinkStats &st = fanout.stats(i);
+        if (st.failures || st.skipped) {
+            fprintf(stderr, "%s: saída %s com %lu falhas, %lu puladas (medição não vale)\n",
+                    set.name, fanout.sink(i)->name(), (unsigned long)st.failures,
+                    (unsigned long)st.skipped);
+            failed = true;
+        }
+    }
+    delete bin;
+    return ns / rows;
+}
+
+int main(int argc, char **argv) {
+    unsigned long rows = 2000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            rows = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "uso: %s [-n linhas]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (rows < BURST) {
+        rows = BURST;
+    }
+
+    diagInit();
+    checkDelivery(rows / 4);
+    checkIsolation();
+    checkMqttFull();
+    checkStall();
+    checkFlushSuspended();
+
+    double ns[sizeof(sets) / sizeof(sets[0])];
+    for (size_t s = 0; s < sizeof(sets) / sizeof(sets[0]); s++) {
+        ns[s] = runSet(sets[s], rows);
+        printf("{\"sinks\":\"%s\",\"columns\":%d,\"rows\":%lu,\"ns_per_row\":%.0f",
+               sets[s].name, COLUMNS, rows, ns[s]);
+        if (sets[s].base >= 0) {
+            printf(",\"marginal_ns\":%.0f", ns[s] - ns[sets[s].base]);
+        }
+        printf("}\n");
+        fflush(stdout);
+    }
+    return failed ? 1 : 0;
+}
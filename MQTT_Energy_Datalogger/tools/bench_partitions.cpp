@@ -0,0 +1,326 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BENCH PARTITIONS (FERRAMENTA DE PC)
+================================================================================
+
+Mede e confere o log por partição (log_partitions.cpp, com o config.h em
+vigor) no PC, "cartão" em um diretório temporário (tools/host).
+
+Vazão, para 1, 8 e 64 tópicos ativos em rodízio (como medidores que
+publicam no mesmo período):
+    single        tudo em um CsvSink (LOG_PARTITION_NONE)
+    partitioned   LogPartitions: PARTITION_MAX buffers, PARTITION_OPEN_MAX
+                  arquivos abertos (LRU)
+    open_per_row  SD.open() + write + close a cada linha (sem cache)
+Uma linha JSON por quantidade de tópicos: linhas/s de cada modo e, do
+partitioned, SD.open() e blocos gravados por 1000 linhas e acerto dos
+buffers.
+
+Conferência (check, em cada rodada e numa carga aleatória com 65 tópicos,
+dois deles com o mesmo nome de arquivo, gravada duas vezes como em um
+reboot):
+- nunca mais de PARTITION_OPEN_MAX arquivos abertos;
+- faltas de buffer = faltas de um LRU de referência com PARTITION_MAX
+  posições;
+- com até PARTITION_OPEN_MAX arquivos, um SD.open() por arquivo;
+- cada arquivo: cabeçalho uma vez, na 1ª linha, e as linhas de cada
+  tópico completas, na ordem, sem perda nem repetição.
+Sai com 1 se alguma conferência falha.
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -std=gnu++17 -I tools/host -I . csv_sink.cpp log_partitions.cpp \
+        metrics.cpp num_format.cpp diag_log.cpp tools/host/host.cpp \
+        tools/bench_partitions.cpp -o bench_partitions -lpthread
+
+Uso:
+    ./bench_partitions [-n linhas] > resultado.jsonl
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <stdlib.h>
+#include <string.h>
+#include <list>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../config.h"
+#include "../csv_sink.h"
+#include "../diag_log.h"
+#include "../log_partitions.h"
+
+#if LOG_COMPRESS
+#error "bench_partitions confere os CSV em texto: compilar com LOG_COMPRESS = 0"
+#endif
+
+typedef std::chrono::steady_clock Clock;
+
+static const char HEADER[] = "timestamp,client_id,topic,seq,valor";
+
+static void printHeader(void *, Print &out) {
+    out.print(HEADER);
+    out.println();
+}
+
+static size_t formatRow(char *buf, size_t cap, const std::string &topic, unsigned long seq) {
+    int n = snprintf(buf, cap, "T+00h00m00s,esp32_logger,%s,%lu,%.2f\r\n",
+                     topic.c_str(), seq, 220.0 + (seq % 100) * 0.01);
+    return (n > 0) ? (size_t)n : 0;
+}
+
+static std::string newSdDir() {
+    char sd[] = "/tmp/bench_parts_XXXXXX";
+    if (!mkdtemp(sd)) {
+        perror("mkdtemp");
+        exit(1);
+    }
+    hostSdRoot(sd);
+    return sd;
+}
+
+// -----------------------------------------------------------------------------
+// Conferência
+// -----------------------------------------------------------------------------
+static bool failed = false;
+
+static void fail(const char *what, const std::string &detail) {
+    fprintf(stderr, "check: %s (%s)\n", what, detail.c_str());
+    failed = true;
+}
+
+// Faltas de um LRU de arquivos com capacity posições
+static unsigned long lruMisses(const std::vector<std::string> &keys, size_t capacity) {
+    std::list<std::string> lru;
+    unsigned long misses = 0;
+    for (const std::string &key : keys) {
+        char path[PARTITION_PATH_SIZE];
+        LogPartitions::pathFor(key.c_str(), path);
+
+        std::list<std::string>::iterator it = lru.begin();
+        while (it != lru.end() && *it != path) {
+            ++it;
+        }
+        if (it != lru.end()) {
+            lru.erase(it);
+        } else {
+            misses++;
+            if (lru.size() == capacity) {
+                lru.pop_back();
+            }
+        }
+        lru.push_front(path);
+    }
+    return misses;
+}
+
+// Grava keys[i] com seq = i + base; confere o limite de abertos a cada linha
+static LogPartitionStats writeAll(const std::vector<std::string> &keys, unsigned long base) {
+    LogPartitions *owned = new LogPartitions();     // Grande para a pilha
+    LogPartitions &parts = *owned;
+    parts.begin(printHeader, nullptr);
+
+    char row[MSG_TOPIC_MAX + 64];
+    for (size_t i = 0; i < keys.size(); i++) {
+        Print *sink = parts.sinkFor(keys[i].c_str());
+        if (!sink) {
+            fail("arquivo não abriu", keys[i]);
+            break;
+        }
+        sink->write(row, formatRow(row, sizeof(row), keys[i], i + base));
+        if (parts.openCount() > PARTITION_OPEN_MAX) {
+            fail("arquivos abertos acima de PARTITION_OPEN_MAX", keys[i]);
+        }
+    }
+    parts.end();
+    LogPartitionStats st = parts.stats();
+    delete owned;
+    return st;
+}
+
+// Contadores de uma gravação de keys
+static void checkStats(const LogPartitionStats &st, const std::vector<std::string> &keys,
+                       const std::string &sd) {
+    std::map<std::string, bool> files;
+    for (const std::string &key : keys) {
+        char path[PARTITION_PATH_SIZE];
+        LogPartitions::pathFor(key.c_str(), path);
+        files[path] = true;
+    }
+
+    if (st.hits + st.misses != keys.size()) {
+        fail("linhas sem buffer", sd);
+    }
+    if (st.misses != lruMisses(keys, PARTITION_MAX)) {
+        fail("faltas de buffer diferentes do LRU de referência", sd);
+    }
+    if (files.size() <= PARTITION_OPEN_MAX && st.opens != files.size()) {
+        fail("arquivo reaberto com espaço no cache", sd);
+    }
+    if (st.opens > st.misses + st.blocks) {
+        fail("SD.open() sem linha nova nem bloco", sd);
+    }
+}
+
+// Confere os arquivos contra as linhas gravadas (em passes sucessivos)
+static void checkFiles(const std::string &sd, const std::vector<std::string> &keys, int passes) {
+    std::map<std::string, std::vector<unsigned long> > expected;   // tópico -> seqs
+    std::map<std::string, bool> paths;
+    for (int p = 0; p < passes; p++) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            expected[keys[i]].push_back(i + p * keys.size());
+            char path[PARTITION_PATH_SIZE];
+            LogPartitions::pathFor(keys[i].c_str(), path);
+            paths[path] = true;
+        }
+    }
+
+    std::map<std::string, std::vector<unsigned long> > found;
+    for (const auto &entry : paths) {
+        std::string file = sd + entry.first;
+        FILE *f = fopen(file.c_str(), "rb");
+        if (!f) {
+            fail("arquivo ausente", file);
+            continue;
+        }
+        char line[MSG_TOPIC_MAX + 128];
+        bool first = true;
+        while (fgets(line, sizeof(line), f)) {
+            line[strcspn(line, "\r\n")] = '\0';
+            if (first != (strcmp(line, HEADER) == 0)) {
+                fail(first ? "sem cabeçalho na 1ª linha" : "cabeçalho repetido", file);
+            }
+            if (!first) {
+                // T+...,client,topic,seq,valor
+                char *topic = strchr(strchr(line, ',') + 1, ',') + 1;
+                char *seq = strrchr(line, ',');
+                *seq = '\0';
+                seq = strrchr(topic, ',');
+                *seq++ = '\0';
+
+                char path[PARTITION_PATH_SIZE];
+                LogPartitions::pathFor(topic, path);
+                if (entry.first != path) {
+                    fail("linha no arquivo errado", topic);
+                }
+                found[topic].push_back(strtoul(seq, nullptr, 10));
+            }
+            first = false;
+        }
+        fclose(f);
+    }
+
+    if (found != expected) {
+        fail("linhas perdidas, repetidas ou fora de ordem", sd);
+    }
+}
+
+// Carga aleatória (metade das linhas em 4 tópicos), 2 passes no mesmo cartão
+static void checkRandom(unsigned long rows) {
+    std::vector<std::string> topics;
+    for (int t = 0; t < 64; t++) {
+        char name[32];
+        snprintf(name, sizeof(name), "MiEnergy/%02d", t);
+        topics.push_back(name);
+    }
+    topics.push_back("MiEnergy_07");     // Mesmo arquivo de "MiEnergy/07"
+
+    std::vector<std::string> keys;
+    uint32_t seed = 12345;
+    for (unsigned long i = 0; i < rows; i++) {
+        seed = seed * 1103515245u + 12345u;
+        uint32_t r = seed >> 8;
+        keys.push_back((r & 1) ? topics[(r >> 1) % 4] : topics[(r >> 1) % topics.size()]);
+    }
+
+    std::string sd = newSdDir();
+    for (int pass = 0; pass < 2; pass++) {
+        checkStats(writeAll(keys, pass * keys.size()), keys, sd);
+    }
+    checkFiles(sd, keys, 2);
+}
+
+// -----------------------------------------------------------------------------
+// Vazão
+// -----------------------------------------------------------------------------
+static double perSecond(unsigned long rows, Clock::time_point t0) {
+    double s = std::chrono::duration<double>(Clock::now() - t0).count();
+    return rows / s;
+}
+
+static void runTopics(int topicCount, unsigned long rows) {
+    std::vector<std::string> keys;
+    for (unsigned long i = 0; i < rows; i++) {
+        char name[32];
+        snprintf(name, sizeof(name), "MiEnergy/%02lu", i % topicCount);
+        keys.push_back(name);
+    }
+    char row[MSG_TOPIC_MAX + 64];
+
+    // Tudo em um arquivo
+    newSdDir();
+    static CsvSink single;
+    single = CsvSink();
+    single.begin(CSV_FILE_PATH);
+    Clock::time_point t0 = Clock::now();
+    for (unsigned long i = 0; i < rows; i++) {
+        single.write(row, formatRow(row, sizeof(row), keys[i], i));
+        single.poll();
+    }
+    single.end();
+    double singleRate = perSecond(rows, t0);
+
+    // Partições com cache de arquivos abertos
+    std::string sd = newSdDir();
+    t0 = Clock::now();
+    LogPartitionStats st = writeAll(keys, 0);
+    double partRate = perSecond(rows, t0);
+    checkStats(st, keys, sd);
+    checkFiles(sd, keys, 1);
+
+    // Uma abertura por linha
+    newSdDir();
+    SD.mkdir(PARTITION_DIR);
+    t0 = Clock::now();
+    for (unsigned long i = 0; i < rows; i++) {
+        char path[PARTITION_PATH_SIZE];
+        LogPartitions::pathFor(keys[i].c_str(), path);
+        File f = SD.open(path, FILE_APPEND);
+        f.write((const uint8_t *)row, formatRow(row, sizeof(row), keys[i], i));
+        f.close();
+    }
+    double openRate = perSecond(rows, t0);
+
+    printf("{\"topics\":%d,\"rows\":%lu,\"partitions\":%d,\"open_max\":%d,"
+           "\"rows_per_sec\":{\"single\":%.0f,\"partitioned\":%.0f,\"open_per_row\":%.0f},"
+           "\"per_1000_rows\":{\"opens\":%.2f,\"blocks\":%.2f},"
+           "\"buffer_hit_rate\":%.4f,\"check\":\"%s\"}\n",
+           topicCount, rows, PARTITION_MAX, PARTITION_OPEN_MAX, singleRate, partRate, openRate,
+           1000.0 * st.opens / rows, 1000.0 * st.blocks / rows,
+           (double)st.hits / rows, failed ? "falhou" : "ok");
+    fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+    unsigned long rows = 200000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            rows = strtoul(argv[++i], nullptr, 10);
+        } else {
+            fprintf(stderr, "uso: %s [-n linhas]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    diagInit();
+    const int topics[] = { 1, 8, 64 };
+    for (int t : topics) {
+        runTopics(t, rows);
+    }
+
+    checkRandom(rows / 4);
+    printf("{\"check_random\":\"%s\"}\n", failed ? "falhou" : "ok");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,472 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BENCH PIPELINE (FERRAMENTA DE PC)
+================================================================================
+
+Mede no PC o caminho de uma mensagem pelo logger, com os mesmos .cpp do
+firmware (Arduino/SD substituídos por tools/host, "cartão" em um
+diretório temporário):
+
+    stream_flatten  streamFlattenToArena()        (JSON_PARSER_STREAM)
+    stream_columns  streamFlattenToColumns() com as colunas do cabeçalho
+    dom_parse       deserializeJson() em DynamicJsonDocument(JSON_BUFFER_SIZE)
+    dom_filtered    idem, com o filtro de buildParseFilter() (JSON_PARSE_FILTER)
+    dom_flatten     flattenToArena() sobre o documento
+    process         processMessage() completo: parse, colunas, formatação
+                    e gravação no arquivo (config.h em vigor)
+
+Para cada carga (small: 2 campos; typical: medidor MiEnergy trifásico;
+wide: MAX_KEYS campos; wide50/wide10: o mesmo payload, com cabeçalho
+criado por uma mensagem com só 50%/10% dos campos) imprime uma linha JSON
+em stdout com ns e alocações (malloc/new) por mensagem de cada etapa,
+bytes ocupados no documento sem e com filtro, e mensagens/s do process.
+
+A carga mixed (medidores de tipos diferentes, cada um em dois tópicos)
+compara o log binário denso (writeRow sobre a união das colunas, como
+se o cabeçalho tivesse todas) com o esparso (column_dict + writeSparseRow):
+bytes e ns por linha (achatamento + colunas + codificação) e acerto do
+cache de esquema por tópico.
+Diagnósticos do firmware vão para stderr. Os números do PC não são os da
+ESP32, mas servem para comparar duas versões do código.
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -std=gnu++17 -I tools/host -I . -I <ArduinoJson>/src \
+        $(ls *.cpp | grep -v -e main.cpp -e broker_handler.cpp -e wifi_ap.cpp) \
+        tools/host/host.cpp tools/bench_pipeline.cpp -o bench_pipeline -lpthread
+
+Uso:
+    ./bench_pipeline [small|typical|wide|wide50|wide10|mixed] [-n mensagens] > resultado.jsonl
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+#include <SD.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../bin_log.h"
+#include "../column_dict.h"
+#include "../column_map.h"
+#include "../config.h"
+#include "../diag_log.h"
+#include "../json_flatten.h"
+#include "../json_stream.h"
+#include "../logger.h"
+
+// -----------------------------------------------------------------------------
+// Contagem de alocações
+// glibc: toda alocação (inclusive operator new) passa por malloc/calloc/realloc.
+// Demais: só operator new.
+// -----------------------------------------------------------------------------
+static std::atomic<unsigned long> allocCount(0);
+
+#if defined(__GLIBC__)
+extern "C" {
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t n);
+
+void *malloc(size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    return __libc_realloc(p, n);
+}
+}
+#else
+#include <new>
+
+void *operator new(size_t n) {
+    allocCount.fetch_add(1, std::memory_order_relaxed);
+    void *p = malloc(n ? n : 1);
+    if (!p) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+#endif
+
+// -----------------------------------------------------------------------------
+// Cargas
+// Variantes pré-montadas: a montagem do texto não entra na medição, e os
+// valores mudam de uma mensagem para a outra como em um medidor real.
+// -----------------------------------------------------------------------------
+static const size_t VARIANTS = 64;
+
+struct Case {
+    const char *name;
+    const char *topic;
+    unsigned long defaultCount;
+    int logged;         // % dos campos no cabeçalho
+};
+
+static const Case cases[] = {
+    { "small",   "MiEnergy/small",   200000, 100 },
+    { "typical", "MiEnergy/01",      100000, 100 },
+    { "wide",    "MiEnergy/wide",    10000,  100 },
+    { "wide50",  "MiEnergy/wide",    10000,  50 },
+    { "wide10",  "MiEnergy/wide",    10000,  10 },
+    { "mixed",   "MiEnergy/mixed",   100000, 100 },
+};
+
+// Carga mixed: tipo de medidor de cada tópico
+static const char *const mixedTopics[] = {
+    "MiEnergy/tri/01", "MiEnergy/tri/02", "MiEnergy/mono/01", "MiEnergy/mono/02",
+    "MiEnergy/inv/01", "MiEnergy/inv/02", "MiEnergy/pq/01",   "MiEnergy/pq/02",
+};
+static const size_t MIXED_TOPICS = sizeof(mixedTopics) / sizeof(mixedTopics[0]);
+
+static std::string fmt(const char *f, double v) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), f, v);
+    return buf;
+}
+
+// fields: campos da carga wide (os primeiros)
+static std::string buildPayload(const char *name, size_t k, int fields = MAX_KEYS) {
+    double t = (double)k;
+    std::string s;
+
+    if (strcmp(name, "small") == 0) {
+        s = "{\"tensao\":{\"value\":" + fmt("%.1f", 220.0 + t * 0.1) +
+            "},\"corrente\":{\"value\":" + fmt("%.3f", 1.0 + t * 0.013) + "}}";
+    } else if (strcmp(name, "typical") == 0) {
+        s = "{\"device\":\"mi-01\"";
+        for (int f = 0; f < 3; f++) {
+            char key[16];
+            snprintf(key, sizeof(key), "tensao_%c", 'a' + f);
+            s += std::string(",\"") + key + "\":{\"value\":" + fmt("%.1f", 219.5 + f + t * 0.1) + "}";
+            snprintf(key, sizeof(key), "corrente_%c", 'a' + f);
+            s += std::string(",\"") + key + "\":{\"value\":" + fmt("%.3f", 0.5 + f + t * 0.017) + "}";
+            snprintf(key, sizeof(key), "potencia_%c", 'a' + f);
+            s += std::string(",\"") + key + "\":{\"value\":" + fmt("%.2f", 110.0 + f * 7 + t * 3.1) + "}";
+        }
+        s += ",\"fp\":{\"value\":" + fmt("%.3f", 0.9 + t * 0.001) + "}";
+        s += ",\"freq\":{\"value\":" + fmt("%.2f", 59.95 + t * 0.001) + "}";
+        s += ",\"energia\":{\"ativa\":{\"value\":" + fmt("%.0f", 1000000 + t * 7) +
+             "},\"reativa\":{\"value\":" + fmt("%.3f", 123.456 + t) + "}}";
+        s += ",\"status\":{\"ok\":true,\"rssi\":" + fmt("%.0f", -60 - t) + "}}";
+    } else if (strcmp(name, "mixed") == 0) {
+        // Tópico k % MIXED_TOPICS; os tipos têm poucos campos em comum
+        size_t kind = (k % MIXED_TOPICS) / 2;
+        if (kind == 0) {
+            return buildPayload("typical", k);
+        }
+        if (kind == 1) {
+            s = "{\"device\":\"mono-" + fmt("%.0f", (double)(k % 2)) + "\"" +
+                ",\"tensao\":{\"value\":" + fmt("%.1f", 127.0 + t * 0.1) + "}" +
+                ",\"corrente\":{\"value\":" + fmt("%.3f", 2.0 + t * 0.011) + "}" +
+                ",\"fp\":{\"value\":" + fmt("%.3f", 0.95 - t * 0.001) + "}" +
+                ",\"energia\":{\"value\":" + fmt("%.0f", 50000 + t * 3) + "}}";
+        } else if (kind == 2) {
+            s = "{\"device\":\"inv-" + fmt("%.0f", (double)(k % 2)) + "\",\"pv\":[";
+            for (int f = 0; f < 4; f++) {
+                s += std::string(f ? "," : "") + "{\"v\":" + fmt("%.1f", 380.0 + f + t * 0.2) +
+                     ",\"i\":" + fmt("%.2f", 8.0 + f + t * 0.01) + "}";
+            }
+            s += "],\"potencia_ac\":" + fmt("%.0f", 11000 + t * 13) +
+                 ",\"temp\":" + fmt("%.1f", 41.0 + t * 0.05) + ",\"status\":\"ok\"}";
+        } else {
+            s = "{\"device\":\"pq-" + fmt("%.0f", (double)(k % 2)) + "\",\"thd\":{";
+            for (int f = 0; f < 3; f++) {
+                char key[16];
+                snprintf(key, sizeof(key), "%s\"v_%c\":", f ? "," : "", 'a' + f);
+                s += key + fmt("%.2f", 2.1 + f * 0.3 + t * 0.01);
+            }
+            s += "},\"harm\":[";
+            for (int h = 3; h <= 15; h += 2) {
+                s += std::string(h > 3 ? "," : "") + fmt("%.3f", 1.0 / h + t * 0.0001);
+            }
+            s += "],\"flicker\":" + fmt("%.3f", 0.2 + t * 0.001) + "}";
+        }
+        return s;
+    } else {
+        s = "{";
+        for (int f = 0; f < fields; f++) {
+            char key[24];
+            snprintf(key, sizeof(key), "%s\"canal_%03d\":{\"value\":", f ? "," : "", f);
+            s += key + fmt("%.2f", f * 1.5 + t * 0.25) + "}";
+        }
+        s += "}";
+    }
+    return s;
+}
+
+// -----------------------------------------------------------------------------
+// Medição
+// -----------------------------------------------------------------------------
+struct Stage {
+    double ns;
+    double allocs;
+};
+
+template <typename F>
+static Stage measure(unsigned long count, F run) {
+    unsigned long a0 = allocCount.load();
+    auto t0 = std::chrono::steady_clock::now();
+    for (unsigned long i = 0; i < count; i++) {
+        run(i % VARIANTS);
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    unsigned long a1 = allocCount.load();
+
+    Stage s;
+    s.ns = std::chrono::duration<double, std::nano>(t1 - t0).count() / count;
+    s.allocs = (double)(a1 - a0) / count;
+    return s;
+}
+
+static int runCase(const Case &c, unsigned long count) {
+    char sd[] = "/tmp/bench_sd_XXXXXX";
+    if (!mkdtemp(sd)) {
+        perror("mkdtemp");
+        return 1;
+    }
+    hostSdRoot(sd);
+    diagInit();
+    loggerInit();
+
+    std::vector<std::string> payloads;
+    size_t bytes = 0;
+    for (size_t k = 0; k < VARIANTS; k++) {
+        payloads.push_back(buildPayload(c.name, k));
+        bytes += payloads.back().size();
+    }
+
+    static FlatArena arena;
+    int fields = streamFlattenToArena(payloads[0].data(), payloads[0].size(), arena);
+
+    // Cabeçalho: mensagem com só os primeiros c.logged % dos campos
+    std::string first = payloads[0];
+    if (c.logged < 100) {
+        first = buildPayload(c.name, 0, MAX_KEYS * c.logged / 100);
+    }
+
+    // Aquecimento: primeira mensagem fixa o cabeçalho
+    processMessage("esp32_logger", c.topic, first.data(), first.size());
+
+    // As mesmas colunas e filtro que o logger monta
+    static String keys[MAX_KEYS];
+    static ColumnMap columns;
+    static FlatValue slots[MAX_KEYS];
+    size_t logged = (size_t)streamFlattenToArena(first.data(), first.size(), arena);
+    for (size_t i = 0; i < logged; i++) {
+        keys[i] = std::string(flatText(arena, arena.keys[i]), arena.keys[i].len).c_str();
+    }
+    columns.build(keys, logged);
+
+    DynamicJsonDocument filter(JSON_FILTER_SIZE);
+    {
+        DynamicJsonDocument firstDoc(JSON_BUFFER_SIZE);
+        deserializeJson(firstDoc, first.data(), first.size());
+        buildParseFilter(firstDoc.as<JsonVariantConst>(), columns, arena, filter);
+    }
+
+    Stage stream = measure(count, [&](size_t k) {
+        streamFlattenToArena(payloads[k].data(), payloads[k].size(), arena);
+    });
+
+    Stage streamColumns = measure(count, [&](size_t k) {
+        streamFlattenToColumns(payloads[k].data(), payloads[k].size(), columns, arena, slots);
+    });
+
+    Stage domParse = measure(count, [&](size_t k) {
+        DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+        deserializeJson(doc, payloads[k].data(), payloads[k].size());
+    });
+
+    Stage domFiltered = measure(count, [&](size_t k) {
+        DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+        deserializeJson(doc, payloads[k].data(), payloads[k].size(),
+                        DeserializationOption::Filter(filter));
+    });
+
+    // Um documento só: aqui interessa o percurso, não o parse
+    DynamicJsonDocument doc(JSON_BUFFER_SIZE);
+    deserializeJson(doc, payloads[0].data(), payloads[0].size());
+    size_t domBytes = doc.memoryUsage();
+    size_t filteredBytes;
+    {
+        DynamicJsonDocument filtered(JSON_BUFFER_SIZE);
+        deserializeJson(filtered, payloads[0].data(), payloads[0].size(),
+                        DeserializationOption::Filter(filter));
+        filteredBytes = filtered.memoryUsage();
+    }
+    Stage domFlatten = measure(count, [&](size_t) {
+        flattenToArena(doc.as<JsonVariantConst>(), arena);
+    });
+
+    Stage process = measure(count, [&](size_t k) {
+        processMessage("esp32_logger", c.topic, payloads[k].data(), payloads[k].size());
+    });
+    loggerFlush();
+    fprintf(stderr, "%s: arquivo gravado em %s\n", c.name, sd);
+
+    DiagStats diag = diagStats();
+    printf("{\"case\":\"%s\",\"messages\":%lu,\"payload_bytes\":%lu,\"fields\":%d,"
+           "\"logged\":%lu,\"msgs_per_sec\":%.0f,"
+           "\"ns\":{\"stream_flatten\":%.0f,\"stream_columns\":%.0f,\"dom_parse\":%.0f,"
+           "\"dom_filtered\":%.0f,\"dom_flatten\":%.0f,\"process\":%.0f},"
+           "\"allocs\":{\"stream_flatten\":%.2f,\"stream_columns\":%.2f,\"dom_parse\":%.2f,"
+           "\"dom_filtered\":%.2f,\"dom_flatten\":%.2f,\"process\":%.2f},"
+           "\"dom_bytes\":{\"full\":%lu,\"filtered\":%lu},"
+           "\"diag_dropped\":%lu}\n",
+           c.name, count, (unsigned long)(bytes / VARIANTS), fields,
+           (unsigned long)logged, 1e9 / process.ns,
+           stream.ns, streamColumns.ns, domParse.ns, domFiltered.ns, domFlatten.ns, process.ns,
+           stream.allocs, streamColumns.allocs, domParse.allocs, domFiltered.allocs,
+           domFlatten.allocs, process.allocs,
+           (unsigned long)domBytes, (unsigned long)filteredBytes,
+           (unsigned long)diag.dropped);
+    fflush(stdout);
+    return 0;
+}
+
+// Conta os bytes gravados, sem guardá-los
+class CountingPrint : public Print {
+public:
+    size_t bytes = 0;
+    size_t write(uint8_t) override { bytes++; return 1; }
+    size_t write(const uint8_t *, size_t len) override { bytes += len; return len; }
+};
+
+static int runMixed(const Case &c, unsigned long count) {
+    std::vector<std::string> payloads;
+    size_t bytes = 0;
+    for (size_t k = 0; k < VARIANTS; k++) {
+        payloads.push_back(buildPayload(c.name, k));
+        bytes += payloads.back().size();
+    }
+
+    // Denso: cabeçalho com a união das chaves de todos os tipos
+    static FlatArena arena;
+    static String keys[MAX_KEYS];
+    static ColumnMap columns;
+    static FlatValue slots[MAX_KEYS];
+    static FlatValue cells[MAX_KEYS];
+    size_t header = 0;
+    size_t fields = 0;
+    for (size_t k = 0; k < VARIANTS; k++) {
+        fields += (size_t)streamFlattenToArena(payloads[k].data(), payloads[k].size(), arena);
+        for (size_t i = 0; i < arena.count; i++) {
+            String key(std::string(flatText(arena, arena.keys[i]), arena.keys[i].len).c_str());
+            size_t j = 0;
+            while (j < header && !(keys[j] == key.c_str())) {
+                j++;
+            }
+            if (j == header && header < MAX_KEYS) {
+                keys[header++] = key;
+            }
+        }
+    }
+    columns.build(keys, header);
+
+    CountingPrint denseOut;
+    static BinLogWriter dense;
+    dense.begin(denseOut);
+    dense.writeSchema(header);
+    for (size_t i = 0; i < header; i++) {
+        dense.writeSchemaKey(keys[i].c_str(), keys[i].length());
+    }
+    dense.beginSession();
+
+    Stage denseRow = measure(count, [&](size_t k) {
+        streamFlattenToColumns(payloads[k].data(), payloads[k].size(), columns, arena, slots);
+        for (size_t i = 0; i < header; i++) {
+            cells[i] = slots[columns.canonical(i)];
+        }
+        dense.writeRow(k * 100, "esp32_logger", mixedTopics[k % MIXED_TOPICS],
+                       arena.text, cells, header);
+    });
+
+    // Esparso: colunas pelo dicionário, declaradas quando surgem
+    CountingPrint sparseOut;
+    static ColumnDict dict;
+    static BinLogWriter sparse;
+    sparse.begin(sparseOut);
+    sparse.writeSchema(0);
+    sparse.beginSession();
+
+    Stage sparseRow = measure(count, [&](size_t k) {
+        streamFlattenToArena(payloads[k].data(), payloads[k].size(), arena);
+        size_t before = dict.count();
+        const uint16_t *ids = dict.resolve(mixedTopics[k % MIXED_TOPICS], arena);
+        for (size_t i = before; i < dict.count(); i++) {
+            sparse.writeColumn(i, dict.keys()[i].c_str(), dict.keys()[i].length());
+        }
+        sparse.writeSparseRow(k * 100, "esp32_logger", mixedTopics[k % MIXED_TOPICS],
+                              arena.text, arena.values, ids, arena.count);
+    });
+
+    const ColumnDictStats &st = dict.stats();
+    printf("{\"case\":\"%s\",\"messages\":%lu,\"payload_bytes\":%lu,\"fields\":%.1f,"
+           "\"columns\":%lu,\"topics\":%lu,"
+           "\"ns\":{\"dense_row\":%.0f,\"sparse_row\":%.0f},"
+           "\"bytes_per_row\":{\"dense\":%.2f,\"sparse\":%.2f},"
+           "\"allocs\":{\"dense_row\":%.2f,\"sparse_row\":%.2f},"
+           "\"schema_cache_hit\":%.4f}\n",
+           c.name, count, (unsigned long)(bytes / VARIANTS), (double)fields / VARIANTS,
+           (unsigned long)header, (unsigned long)MIXED_TOPICS,
+           denseRow.ns, sparseRow.ns,
+           (double)denseOut.bytes / count, (double)sparseOut.bytes / count,
+           denseRow.allocs, sparseRow.allocs,
+           (double)st.hits / (st.hits + st.misses));
+    fflush(stdout);
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    const char *only = nullptr;
+    unsigned long count = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            count = strtoul(argv[++i], nullptr, 10);
+        } else if (argv[i][0] != '-') {
+            only = argv[i];
+        } else {
+            fprintf(stderr, "uso: %s [small|typical|wide|wide50|wide10|mixed] [-n mensagens]\n",
+                    argv[0]);
+            return 2;
+        }
+    }
+
+    // Cada carga em um processo próprio: o logger fixa o cabeçalho na
+    // primeira mensagem e não tem como ser reiniciado
+    int status = 0;
+    for (const Case &c : cases) {
+        if (only && strcmp(only, c.name) != 0) {
+            continue;
+        }
+        pid_t pid = fork();
+        if (pid == 0) {
+            unsigned long n = count ? count : c.defaultCount;
+            _exit(strcmp(c.name, "mixed") == 0 ? runMixed(c, n) : runCase(c, n));
+        }
+        int st = 1;
+        if (pid < 0 || waitpid(pid, &st, 0) < 0 || !WIFEXITED(st) || WEXITSTATUS(st) != 0) {
+            fprintf(stderr, "%s: falhou\n", c.name);
+            status = 1;
+        }
+    }
+    return status;
+}
@@ -0,0 +1,442 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - BINLOG2CSV (FERRAMENTA DE PC)
+================================================================================
+
+Converte o log binário (LOG_FORMAT_BINARY, ver bin_log_format.h) no mesmo
+CSV que o firmware gravaria com LOG_FORMAT_CSV:
+
+    timestamp,client_id,topic,<chaves JSON>
+    T+00h00m05s,esp32_logger,MiEnergy/...,...
+
+Compilação (Linux / macOS):
+    g++ -O2 -o binlog2csv tools/binlog2csv.cpp
+
+Uso:
+    ./binlog2csv energy_log.bin > energy_log.csv
+
+Com esquema esparso (LOG_SCHEMA_SPARSE, registros BIN_REC_COLUMN e
+BIN_REC_SPARSE), o cabeçalho é a união das colunas declaradas no arquivo,
+na ordem em que aparecem; cada linha preenche só as suas.
+
+Um arquivo truncado (ex.: queda de energia no meio de um bloco) é
+convertido até o último registro completo, com aviso em stderr. Em um
+segmento pré-alocado (LOG_PREALLOCATE), os dados terminam no primeiro
+byte zero onde começaria um registro.
+
+================================================================================
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "../bin_log_format.h"
+
+struct Reader {
+    const uint8_t *p;
+    const uint8_t *end;
+
+    bool byte(uint8_t &b) {
+        if (p >= end) {
+            return false;
+        }
+        b = *p++;
+        return true;
+    }
+
+    bool varint(uint64_t &v) {
+        v = 0;
+        for (int shift = 0; shift < 64; shift += 7) {
+            uint8_t c;
+            if (!byte(c)) {
+                return false;
+            }
+            v |= (uint64_t)(c & 0x7F) << shift;
+            if (!(c & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool bytes(std::string &s, uint64_t len) {
+        if ((uint64_t)(end - p) < len) {
+            return false;
+        }
+        s.assign((const char *)p, (size_t)len);
+        p += len;
+        return true;
+    }
+
+    bool str(std::string &s) {
+        uint64_t len;
+        return varint(len) && bytes(s, len);
+    }
+};
+
+// Estado da sessão corrente (espelha BinLogWriter)
+struct Session {
+    uint32_t ms;
+    std::vector<std::string> dict;
+    std::vector<uint64_t> prev;
+    std::vector<std::vector<uint64_t> > layouts;
+    size_t layoutUsed;
+
+    void reset() {
+        ms = 0;
+        dict.clear();
+        prev.assign(prev.size(), 0);
+        layouts.clear();
+        layoutUsed = 0;
+    }
+
+    // Valor anterior da coluna (ids esparsos crescem sob demanda)
+    uint64_t &prevOf(size_t col) {
+        if (col >= prev.size()) {
+            prev.resize(col + 1, 0);
+        }
+        return prev[col];
+    }
+};
+
+// Colunas do CSV: as do esquema e depois as declaradas (BIN_REC_COLUMN)
+struct Layout {
+    std::vector<std::string> names;
+    std::map<std::string, size_t> byName;
+    std::vector<long> sparse;        // id esparso -> coluna do CSV (-1 = não declarado)
+
+    size_t add(const std::string &key) {
+        std::map<std::string, size_t>::iterator it = byName.find(key);
+        if (it != byName.end()) {
+            return it->second;
+        }
+        names.push_back(key);
+        byName[key] = names.size() - 1;
+        return names.size() - 1;
+    }
+
+    void declare(uint64_t id, const std::string &key) {
+        if (id >= sparse.size()) {
+            sparse.resize((size_t)id + 1, -1);
+        }
+        sparse[(size_t)id] = (long)add(key);
+    }
+};
+
+static bool readStrRef(Reader &r, Session &ss, std::string &out) {
+    uint64_t ref;
+    if (!r.varint(ref)) {
+        return false;
+    }
+    if (ref == 0) {
+        if (!r.str(out)) {
+            return false;
+        }
+        if (ss.dict.size() < BIN_DICT_MAX) {
+            size_t used = 0;
+            for (size_t k = 0; k < ss.dict.size(); k++) {
+                used += ss.dict[k].size();
+            }
+            if (used + out.size() <= BIN_DICT_POOL) {
+                ss.dict.push_back(out);
+            }
+        }
+        return true;
+    }
+    if (ref > ss.dict.size()) {
+        return false;
+    }
+    out = ss.dict[ref - 1];
+    return true;
+}
+
+static bool readLayoutRef(Reader &r, Session &ss, std::vector<uint64_t> &out) {
+    uint64_t ref, n;
+    if (!r.varint(ref)) {
+        return false;
+    }
+    if (ref > 0) {
+        if (ref > ss.layouts.size()) {
+            return false;
+        }
+        out = ss.layouts[ref - 1];
+        return true;
+    }
+    if (!r.varint(n) || n > (uint64_t)(r.end - r.p)) {
+        return false;
+    }
+    out.resize((size_t)n);
+    for (size_t j = 0; j < out.size(); j++) {
+        if (!r.varint(out[j])) {
+            return false;
+        }
+    }
+    if (ss.layouts.size() < BIN_LAYOUT_MAX && ss.layoutUsed + out.size() <= BIN_LAYOUT_POOL) {
+        ss.layouts.push_back(out);
+        ss.layoutUsed += out.size();
+    }
+    return true;
+}
+
+static bool readValue(Reader &r, uint64_t &prev, std::string &out) {
+    uint8_t tag;
+    uint64_t v;
+    char buf[64];
+
+    if (!r.byte(tag)) {
+        return false;
+    }
+    switch (tag & BIN_T_MASK) {
+        case BIN_T_INT32: {
+            if (!r.varint(v)) {
+                return false;
+            }
+            int32_t x = (int32_t)((int64_t)(int32_t)(uint32_t)prev + binUnzigzag(v));
+            prev = (uint32_t)x;
+            snprintf(buf, sizeof(buf), "%ld", (long)x);
+            out = buf;
+            return true;
+        }
+        case BIN_T_F32: {
+            if (!r.varint(v)) {
+                return false;
+            }
+            uint32_t b = (uint32_t)v ^ (uint32_t)prev;
+            float f;
+            memcpy(&f, &b, 4);
+            prev = b;
+            snprintf(buf, sizeof(buf), "%.6f", (double)f);
+            out = buf;
+            return true;
+        }
+        case BIN_T_F64: {
+            if (!r.varint(v)) {
+                return false;
+            }
+            uint64_t b = v ^ prev;
+            double d;
+            memcpy(&d, &b, 8);
+            prev = b;
+            snprintf(buf, sizeof(buf), "%.6f", d);
+            out = buf;
+            return true;
+        }
+        case BIN_T_DEC: {
+            if (!r.varint(v)) {
+                return false;
+            }
+            int64_t m = (int64_t)prev + binUnzigzag(v);
+            prev = (uint64_t)m;
+            out.assign(buf, binRenderDecimal(m, tag >> BIN_T_SCALE_SHIFT, buf));
+            return true;
+        }
+        case BIN_T_BOOL:
+            out = (tag & BIN_T_BOOL_TRUE) ? "true" : "false";
+            return true;
+        case BIN_T_STR:
+            return r.str(out);
+        default:
+            return false;
+    }
+}
+
+// Início comum de BIN_REC_ROW e BIN_REC_SPARSE: "timestamp,client,topic"
+static bool readRowStart(Reader &r, Session &ss, std::string &line) {
+    uint64_t dt;
+    std::string client, topic;
+    if (!r.varint(dt) || !readStrRef(r, ss, client) || !readStrRef(r, ss, topic)) {
+        return false;
+    }
+    ss.ms += (uint32_t)dt;
+
+    unsigned long s = ss.ms / 1000;
+    unsigned long m = s / 60;
+    unsigned long h = m / 60;
+    char ts[32];
+    snprintf(ts, sizeof(ts), "T+%02luh%02lum%02lus", h, m % 60, s % 60);
+
+    line = ts;
+    line += ',';
+    line += client;
+    line += ',';
+    line += topic;
+    return true;
+}
+
+static void appendCells(std::string &line, const std::vector<std::string> &cells) {
+    for (size_t i = 0; i < cells.size(); i++) {
+        line += ',';
+        line += cells[i];
+    }
+}
+
+static bool readRow(Reader &r, Session &ss, size_t cols, size_t width, std::string &line) {
+    if (!readRowStart(r, ss, line)) {
+        return false;
+    }
+
+    std::vector<uint8_t> present((cols + 7) / 8);
+    for (size_t k = 0; k < present.size(); k++) {
+        if (!r.byte(present[k])) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> cells(width);
+    for (size_t i = 0; i < cols; i++) {
+        if (present[i / 8] & (1 << (i & 7))) {
+            if (!readValue(r, ss.prevOf(i), cells[i])) {
+                return false;
+            }
+        }
+    }
+    appendCells(line, cells);
+    return true;
+}
+
+static bool readSparseRow(Reader &r, Session &ss, const Layout &layout, std::string &line) {
+    std::vector<uint64_t> ids;
+    if (!readRowStart(r, ss, line) || !readLayoutRef(r, ss, ids)) {
+        return false;
+    }
+
+    std::vector<uint8_t> present((ids.size() + 7) / 8);
+    for (size_t k = 0; k < present.size(); k++) {
+        if (!r.byte(present[k])) {
+            return false;
+        }
+    }
+
+    std::vector<std::string> cells(layout.names.size());
+    for (size_t j = 0; j < ids.size(); j++) {
+        if (!(present[j / 8] & (1 << (j & 7)))) {
+            continue;
+        }
+        uint64_t id = ids[j];
+        if (id >= layout.sparse.size() || layout.sparse[(size_t)id] < 0) {
+            return false;    // Coluna não declarada
+        }
+        if (!readValue(r, ss.prevOf((size_t)id), cells[(size_t)layout.sparse[(size_t)id]])) {
+            return false;
+        }
+    }
+    appendCells(line, cells);
+    return true;
+}
+
+// Percorre os registros a partir de r. Com emit = false só coleta as
+// colunas declaradas em layout (1ª passada); com emit = true imprime as linhas.
+static unsigned long readRecords(Reader r, const uint8_t *base, const char *name,
+                                 size_t cols, Layout &layout, bool emit) {
+    Session ss;
+    ss.prev.assign(cols, 0);
+    ss.reset();
+    unsigned long rows = 0;
+    std::string line;
+
+    while (r.p < r.end) {
+        const uint8_t *rec = r.p;
+        uint8_t type;
+        r.byte(type);
+        if (type == 0) {
+            break;   // Área pré-alocada ainda não usada
+        }
+
+        bool ok;
+        if (type == BIN_REC_SESSION) {
+            ss.reset();
+            ok = true;
+        } else if (type == BIN_REC_COLUMN) {
+            uint64_t id;
+            std::string key;
+            ok = r.varint(id) && r.str(key);
+            if (ok) {
+                layout.declare(id, key);
+            }
+        } else if (type == BIN_REC_ROW || type == BIN_REC_SPARSE) {
+            ok = (type == BIN_REC_ROW)
+                ? readRow(r, ss, cols, layout.names.size(), line)
+                : readSparseRow(r, ss, layout, line);
+            if (ok) {
+                if (emit) {
+                    printf("%s\r\n", line.c_str());
+                }
+                rows++;
+            }
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            if (emit) {
+                fprintf(stderr, "%s: registro inválido/truncado no byte %ld; parando\n",
+                        name, (long)(rec - base));
+            }
+            break;
+        }
+    }
+    return rows;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "uso: %s <arquivo.bin>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror(argv[1]);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    Reader r = { data.data(), data.data() + data.size() };
+
+    // Esquema
+    std::string magic;
+    uint8_t version;
+    uint64_t cols;
+    // v1 (F32/F64) continua legível
+    if (!r.bytes(magic, 4) || magic != BIN_MAGIC || !r.byte(version) ||
+        version < 1 || version > BIN_VERSION || !r.varint(cols)) {
+        fprintf(stderr, "%s: não é um log binário v1..v%d\n", argv[1], BIN_VERSION);
+        return 1;
+    }
+
+    Layout layout;
+    for (uint64_t i = 0; i < cols; i++) {
+        std::string key;
+        if (!r.str(key)) {
+            fprintf(stderr, "%s: esquema truncado\n", argv[1]);
+            return 1;
+        }
+        layout.names.push_back(key);     // Chaves repetidas no esquema ficam como estão
+        layout.byName.insert(std::make_pair(key, (size_t)i));
+    }
+
+    // 1ª passada: colunas declaradas ao longo do arquivo (esquema esparso)
+    readRecords(r, data.data(), argv[1], (size_t)cols, layout, false);
+
+    std::string header = "timestamp,client_id,topic";
+    for (size_t i = 0; i < layout.names.size(); i++) {
+        header += ',';
+        header += layout.names[i];
+    }
+    printf("%s\r\n", header.c_str());
+
+    unsigned long rows = readRecords(r, data.data(), argv[1], (size_t)cols, layout, true);
+
+    fprintf(stderr, "%lu linhas\n", rows);
+    return 0;
+}
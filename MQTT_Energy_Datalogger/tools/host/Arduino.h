@@ -0,0 +1,134 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - ARDUINO HOST (SUBSTITUTO PARA PC)
+================================================================================
+
+Subconjunto mínimo da API do Arduino usado pelos módulos do pipeline
+(logger, json_*, csv_sink, bin_log, log_segments, ...), para compilá-los
+no PC (Linux / macOS) junto com as ferramentas de tools/.
+
+- millis()/micros(): relógio monotônico do sistema. Com hostMillis >= 0,
+  millis() devolve esse valor (relógio virtual, ex.: replay de captura);
+  idem hostMicros para micros() (durações exatas nos testes).
+- String: apoiada em std::string (no PC a alocação não importa).
+- Serial: escreve em stderr, para o stdout das ferramentas ficar só com
+  os resultados; Serial.written conta os bytes (testes).
+
+Não define ARDUINO: o ArduinoJson compila no modo "C++ puro".
+
+================================================================================
+*/
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+
+typedef uint8_t byte;
+
+extern long hostMillis;
+extern long hostMicros;
+
+inline unsigned long micros() {
+    static const auto t0 = std::chrono::steady_clock::now();
+    if (hostMicros >= 0) {
+        return (unsigned long)hostMicros;
+    }
+    return (unsigned long)std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+}
+
+inline unsigned long millis() {
+    return hostMillis >= 0 ? (unsigned long)hostMillis : micros() / 1000;
+}
+
+inline void delay(unsigned long ms) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+inline void yield() {
+}
+
+// -----------------------------------------------------------------------------
+// String
+// -----------------------------------------------------------------------------
+class String {
+public:
+    String() {}
+    String(const char *s) : _s(s ? s : "") {}
+
+    String &operator=(const char *s) {
+        _s = s ? s : "";
+        return *this;
+    }
+
+    unsigned length() const { return (unsigned)_s.size(); }
+    const char *c_str() const { return _s.c_str(); }
+    bool operator==(const char *s) const { return _s == s; }
+
+private:
+    std::string _s;
+};
+
+// -----------------------------------------------------------------------------
+// Print / Serial
+// -----------------------------------------------------------------------------
+class Print {
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t c) = 0;
+    virtual size_t write(const uint8_t *data, size_t len) {
+        size_t n = 0;
+        while (len--) {
+            n += write(*data++);
+        }
+        return n;
+    }
+    size_t write(const char *s, size_t len) { return write((const uint8_t *)s, len); }
+
+    size_t print(const char *s) { return write((const uint8_t *)s, strlen(s)); }
+    size_t print(const String &s) { return write((const uint8_t *)s.c_str(), s.length()); }
+    size_t print(char c) { return write((uint8_t)c); }
+    size_t print(unsigned long v) { return printf("%lu", v); }
+    size_t print(long v) { return printf("%ld", v); }
+    size_t print(unsigned v) { return printf("%u", v); }
+    size_t print(int v) { return printf("%d", v); }
+
+    size_t println() { return print("\r\n"); }
+    template <typename T>
+    size_t println(T v) { return print(v) + println(); }
+
+    size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3))) {
+        char buf[256];
+        va_list ap;
+        va_start(ap, fmt);
+        int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+        va_end(ap);
+        if (n < 0) {
+            return 0;
+        }
+        return write((const uint8_t *)buf, (size_t)n < sizeof(buf) ? (size_t)n : sizeof(buf) - 1);
+    }
+};
+
+class HardwareSerial : public Print {
+public:
+    std::atomic<unsigned long> written{0};   // Bytes escritos
+
+    void begin(unsigned long) {}
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t len) override {
+        written += len;
+        return fwrite(data, 1, len, stderr);
+    }
+    using Print::write;
+    operator bool() const { return true; }
+};
+
+extern HardwareSerial Serial;
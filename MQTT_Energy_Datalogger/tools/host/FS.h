@@ -0,0 +1,123 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - FS HOST (SUBSTITUTO PARA PC)
+================================================================================
+
+File / FS do core da ESP32 sobre arquivos comuns do PC. Os caminhos do
+cartão ("/log/seg_00001.csv") ficam sob um diretório raiz, definido por
+hostSdRoot() (ver SD.h).
+
+hostFs conta aberturas, escritas, flushes e bytes lidos no "cartão" e
+simula falhas: com shortWrites > 0, cada uma das próximas escritas grava
+só a metade dos bytes (escrita incompleta, como a de um cartão com
+defeito).
+
+Diretórios: FS::open() de um diretório e File::openNextFile()/name(),
+como no core (name() sem o caminho).
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+#include <dirent.h>
+
+#define FILE_READ   "r"
+#define FILE_WRITE  "w"
+#define FILE_APPEND "a"
+
+struct HostFsStats {
+    unsigned long opens;         // FS::open() bem-sucedidos
+    unsigned long writes;        // File::write()
+    unsigned long flushes;       // File::flush()
+    unsigned long readBytes;     // Bytes lidos por File::read()
+    unsigned long shortWrites;   // Próximas escritas incompletas (simulação)
+};
+
+extern HostFsStats hostFs;
+
+class File : public Print {
+public:
+    File() : _fp(nullptr), _dir(nullptr) {}
+    explicit File(FILE *fp, const std::string &path = std::string())
+        : _fp(fp), _dir(nullptr), _path(path) {}
+    File(DIR *dir, const std::string &path) : _fp(nullptr), _dir(dir), _path(path) {}
+
+    operator bool() const { return _fp != nullptr || _dir != nullptr; }
+
+    bool isDirectory() const { return _dir != nullptr; }
+    const char *name() const {
+        size_t slash = _path.rfind('/');
+        return _path.c_str() + ((slash == std::string::npos) ? 0 : slash + 1);
+    }
+    File openNextFile();
+
+    size_t write(uint8_t c) override { return write(&c, 1); }
+    size_t write(const uint8_t *data, size_t len) override {
+        if (!_fp) {
+            return 0;
+        }
+        hostFs.writes++;
+        if (hostFs.shortWrites > 0) {
+            hostFs.shortWrites--;
+            len /= 2;
+        }
+        return fwrite(data, 1, len, _fp);
+    }
+    using Print::write;
+
+    int read() {
+        int c = _fp ? fgetc(_fp) : -1;
+        hostFs.readBytes += (c >= 0);
+        return c;
+    }
+    size_t read(uint8_t *buf, size_t len) {
+        size_t n = _fp ? fread(buf, 1, len, _fp) : 0;
+        hostFs.readBytes += n;
+        return n;
+    }
+
+    bool seek(uint32_t pos) { return _fp && fseek(_fp, (long)pos, SEEK_SET) == 0; }
+    size_t position() const { return _fp ? (size_t)ftell(_fp) : 0; }
+    size_t size() const {
+        if (!_fp) {
+            return 0;
+        }
+        long cur = ftell(_fp);
+        fseek(_fp, 0, SEEK_END);
+        long end = ftell(_fp);
+        fseek(_fp, cur, SEEK_SET);
+        return (size_t)end;
+    }
+
+    void flush() {
+        if (_fp) {
+            hostFs.flushes++;
+            fflush(_fp);
+        }
+    }
+
+    void close() {
+        if (_fp) {
+            fclose(_fp);
+            _fp = nullptr;
+        }
+        if (_dir) {
+            closedir(_dir);
+            _dir = nullptr;
+        }
+    }
+
+private:
+    FILE *_fp;
+    DIR  *_dir;
+    std::string _path;   // Caminho no cartão (host: sob hostSdRoot())
+};
+
+class FS {
+public:
+    File open(const char *path, const char *mode = FILE_READ);
+    bool exists(const char *path);
+    bool mkdir(const char *path);
+    bool remove(const char *path);
+    bool rename(const char *from, const char *to);
+};
@@ -0,0 +1,21 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - SD HOST (SUBSTITUTO PARA PC)
+================================================================================
+
+"Cartão SD" em um diretório do PC: hostSdRoot("dir") antes de
+loggerInit(). Padrão: diretório corrente.
+
+================================================================================
+*/
+#pragma once
+#include <FS.h>
+
+class SDFS : public FS {
+public:
+    bool begin(int) { return true; }
+};
+
+extern SDFS SD;
+
+void hostSdRoot(const char *dir);
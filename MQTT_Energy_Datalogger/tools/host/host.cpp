@@ -0,0 +1,83 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - HOST (IMPLEMENTAÇÃO)
+================================================================================
+
+Objetos globais (Serial, SD, relógio virtual, contadores do cartão) e o
+mapeamento dos caminhos do cartão para o diretório escolhido em
+hostSdRoot().
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <sys/stat.h>
+
+HardwareSerial Serial;
+SDFS SD;
+long hostMillis = -1;
+long hostMicros = -1;
+HostFsStats hostFs;
+
+static std::string sdRoot = ".";
+
+void hostSdRoot(const char *dir) {
+    sdRoot = dir;
+}
+
+static std::string hostPath(const char *path) {
+    return sdRoot + path;
+}
+
+File FS::open(const char *path, const char *mode) {
+    struct stat st;
+    if (strcmp(mode, FILE_READ) == 0 && stat(hostPath(path).c_str(), &st) == 0 &&
+        S_ISDIR(st.st_mode)) {
+        DIR *dir = opendir(hostPath(path).c_str());
+        if (dir) {
+            hostFs.opens++;
+        }
+        return dir ? File(dir, path) : File();
+    }
+
+    // "r+" do core da ESP32 = leitura e escrita sem truncar
+    std::string m = mode;
+    m += 'b';
+    FILE *fp = fopen(hostPath(path).c_str(), m.c_str());
+    if (fp) {
+        hostFs.opens++;
+    }
+    return File(fp, path);
+}
+
+File File::openNextFile() {
+    if (!_dir) {
+        return File();
+    }
+    struct dirent *e;
+    while ((e = readdir(_dir)) != nullptr) {
+        if (strcmp(e->d_name, ".") != 0 && strcmp(e->d_name, "..") != 0) {
+            return SD.open((_path + "/" + e->d_name).c_str(), FILE_READ);
+        }
+    }
+    return File();
+}
+
+bool FS::exists(const char *path) {
+    struct stat st;
+    return stat(hostPath(path).c_str(), &st) == 0;
+}
+
+bool FS::mkdir(const char *path) {
+    return ::mkdir(hostPath(path).c_str(), 0755) == 0;
+}
+
+bool FS::remove(const char *path) {
+    return ::remove(hostPath(path).c_str()) == 0;
+}
+
+// Como o FAT da ESP32: não substitui um destino que já existe
+bool FS::rename(const char *from, const char *to) {
+    return !exists(to) && ::rename(hostPath(from).c_str(), hostPath(to).c_str()) == 0;
+}
@@ -0,0 +1,145 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - LOGUNPACK (FERRAMENTA DE PC)
+================================================================================
+
+Descomprime um log gravado com LOG_COMPRESS = 1 (frames de
+log_compress.h) de volta ao arquivo original (CSV, ou binário para o
+binlog2csv), frame a frame.
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -o logunpack tools/logunpack.cpp log_compress.cpp
+
+Uso:
+    ./logunpack energy_log.csv.lz > energy_log.csv
+    ./logunpack -r <início> <fim> seg_00007.csv.lz    só o trecho [início, fim)
+    ./logunpack -l seg_00007.csv.lz                   lista os frames
+
+- -r: posições no arquivo comprimido, como as de logFindRange() e do
+  índice do segmento (cada ponto indexado começa um frame). Só os frames
+  que começam no trecho são lidos; os anteriores são pulados pelo
+  cabeçalho, sem descomprimir.
+- Os dados terminam no primeiro byte zero onde começaria um frame
+  (segmento pré-alocado). Um frame inválido no meio (escrita incompleta
+  antes de um reboot) é pulado até o próximo frame válido, com aviso em
+  stderr.
+
+================================================================================
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "../log_compress.h"
+
+// Frame válido em pos (cabeçalho e dados); out recebe o bloco.
+static bool decodeAt(const std::vector<uint8_t> &data, size_t pos, LzFrame &frame,
+                     uint8_t *out) {
+    if (data.size() - pos < LZ_FRAME_HEADER || !lzFrameHeader(&data[pos], frame)) {
+        return false;
+    }
+    if (data.size() - pos - LZ_FRAME_HEADER < frame.dataLen) {
+        return false;
+    }
+    return lzFrameDecode(frame, &data[pos + LZ_FRAME_HEADER], out);
+}
+
+static bool zerosFrom(const std::vector<uint8_t> &data, size_t pos) {
+    for (size_t i = pos; i < data.size(); i++) {
+        if (data[i] != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    bool list = false;
+    unsigned long from = 0;
+    unsigned long to = (unsigned long)-1;
+    const char *path = nullptr;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-l") == 0) {
+            list = true;
+        } else if (strcmp(argv[i], "-r") == 0 && i + 2 < argc) {
+            from = strtoul(argv[++i], nullptr, 10);
+            to = strtoul(argv[++i], nullptr, 10);
+        } else if (!path) {
+            path = argv[i];
+        } else {
+            path = nullptr;
+            break;
+        }
+    }
+    if (!path) {
+        fprintf(stderr, "uso: %s [-l] [-r início fim] <arquivo.lz>\n", argv[0]);
+        return 2;
+    }
+
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return 1;
+    }
+    std::vector<uint8_t> data;
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    static uint8_t block[LZ_BLOCK_MAX];
+    unsigned long frames = 0;
+    unsigned long raw = 0;
+    size_t pos = 0;
+
+    // Até o início do trecho: só os cabeçalhos
+    while (pos < from) {
+        LzFrame frame;
+        if (data.size() - pos < LZ_FRAME_HEADER || !lzFrameHeader(&data[pos], frame)) {
+            fprintf(stderr, "%s: sem frame em %lu antes do início do trecho\n",
+                    path, (unsigned long)pos);
+            return 1;
+        }
+        pos += LZ_FRAME_HEADER + frame.dataLen;
+    }
+    if (pos != from) {
+        fprintf(stderr, "%s: %lu não é início de frame\n", path, from);
+        return 1;
+    }
+
+    while (pos < data.size() && pos < to) {
+        LzFrame frame;
+        if (decodeAt(data, pos, frame, block)) {
+            if (list) {
+                printf("%lu %s %u %u\n", (unsigned long)pos,
+                       frame.method == LZ_STORED ? "stored" : "lz",
+                       frame.rawLen, frame.dataLen);
+            } else {
+                fwrite(block, 1, frame.rawLen, stdout);
+            }
+            frames++;
+            raw += frame.rawLen;
+            pos += LZ_FRAME_HEADER + frame.dataLen;
+            continue;
+        }
+        if (zerosFrom(data, pos)) {
+            break;      // Fim de um segmento pré-alocado
+        }
+
+        // Frame incompleto: procura o próximo válido
+        size_t bad = pos;
+        do {
+            pos++;
+        } while (pos < data.size() && pos < to && !decodeAt(data, pos, frame, block));
+        fprintf(stderr, "%s: %lu bytes inválidos ignorados em %lu\n",
+                path, (unsigned long)(pos - bad), (unsigned long)bad);
+    }
+
+    fprintf(stderr, "%s: %lu frames, %lu -> %lu bytes\n",
+            path, frames, (unsigned long)pos - from, raw);
+    return 0;
+}
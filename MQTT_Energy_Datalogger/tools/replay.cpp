@@ -0,0 +1,289 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - REPLAY (FERRAMENTA DE PC)
+================================================================================
+
+Reenvia uma captura de tráfego MQTT (gravada com mqttsnifer.py --capture)
+pelo processMessage() do firmware, compilado no PC com tools/host, e
+mede quanto o logger aguenta. O "cartão" é um diretório (--sd, padrão um
+diretório temporário novo).
+
+Formato da captura (.mqcap, inteiros little-endian):
+----------------------------------------------------
+    "MQCP" <versão u8 = 1>                              cabeçalho
+    <ms u32> <tam. tópico u16> <tam. payload u32> <tópico> <payload>
+                                                        um por mensagem
+- ms: tempo desde o início da captura.
+
+Ritmo:
+------
+- --speed 0 (padrão): o mais rápido possível.
+- --speed N: tempo real acelerado N vezes (1 = tempo real); se o logger
+  atrasa, as mensagens seguintes saem sem espera até alcançar.
+
+Em qualquer ritmo millis() segue o tempo da captura (relógio virtual), e
+loggerLoop() é chamado após cada mensagem. Assim o arquivo gerado é o
+mesmo em qualquer velocidade e o checksum serve para comparar versões.
+
+Saída (stdout, uma linha JSON):
+-------------------------------
+    messages, payload_bytes, seconds, msgs_per_sec, mb_per_sec
+    latency_us: p50/p99/p999/max
+        --speed 0: tempo de processMessage() de cada mensagem;
+        --speed N: do instante previsto da mensagem até o fim do
+        processamento (inclui o atraso acumulado).
+    output_bytes, output_crc32: arquivos do diretório do cartão, em ordem
+        de nome (o CSV/bin e, com LOG_SEGMENTS, os segmentos e índices).
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -std=gnu++17 -I tools/host -I . -I <ArduinoJson>/src \
+        $(ls *.cpp | grep -v -e main.cpp -e broker_handler.cpp -e wifi_ap.cpp) \
+        tools/host/host.cpp tools/replay.cpp -o replay -lpthread
+
+Uso:
+    ./replay captura.mqcap [--speed N] [--sd diretório]
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../diag_log.h"
+#include "../logger.h"
+
+#define CAPTURE_MAGIC    "MQCP"
+#define CAPTURE_VERSION  1
+
+struct Message {
+    uint32_t ms;
+    size_t   topic;     // Deslocamentos em data
+    size_t   payload;
+    size_t   payloadLen;
+};
+
+static uint32_t getU32(const uint8_t *p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Lê a captura inteira para a RAM. Os tópicos são copiados para o fim do
+// buffer, cada um com '\0', para irem direto ao processMessage().
+static bool loadCapture(const char *path, std::vector<uint8_t> &data,
+                        std::vector<Message> &msgs) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    uint8_t chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        data.insert(data.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    if (data.size() < 5 || memcmp(data.data(), CAPTURE_MAGIC, 4) != 0 ||
+        data[4] != CAPTURE_VERSION) {
+        fprintf(stderr, "%s: não é uma captura v%d\n", path, CAPTURE_VERSION);
+        return false;
+    }
+
+    std::vector<uint8_t> topics;
+    size_t p = 5;
+    while (p + 10 <= data.size()) {
+        uint32_t ms = getU32(&data[p]);
+        size_t topicLen = (size_t)data[p + 4] | ((size_t)data[p + 5] << 8);
+        size_t payloadLen = getU32(&data[p + 6]);
+        p += 10;
+        if (data.size() - p < topicLen + payloadLen) {
+            break;
+        }
+        Message m;
+        m.ms = ms;
+        m.topic = topics.size();
+        topics.insert(topics.end(), data.begin() + p, data.begin() + p + topicLen);
+        topics.push_back(0);
+        m.payload = p + topicLen;
+        m.payloadLen = payloadLen;
+        msgs.push_back(m);
+        p += topicLen + payloadLen;
+    }
+    if (p != data.size()) {
+        fprintf(stderr, "%s: captura truncada no byte %lu; usando %lu mensagens\n",
+                path, (unsigned long)p, (unsigned long)msgs.size());
+    }
+
+    size_t base = data.size();
+    data.insert(data.end(), topics.begin(), topics.end());
+    for (Message &m : msgs) {
+        m.topic += base;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+// Checksum dos arquivos gerados
+// -----------------------------------------------------------------------------
+static uint32_t crc32Update(uint32_t crc, const uint8_t *p, size_t n) {
+    crc = ~crc;
+    for (size_t i = 0; i < n; i++) {
+        crc ^= p[i];
+        for (int k = 0; k < 8; k++) {
+            crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+        }
+    }
+    return ~crc;
+}
+
+static void listFiles(const std::string &dir, std::vector<std::string> &out) {
+    DIR *d = opendir(dir.c_str());
+    if (!d) {
+        return;
+    }
+    struct dirent *e;
+    while ((e = readdir(d)) != nullptr) {
+        if (e->d_name[0] == '.') {
+            continue;
+        }
+        std::string path = dir + "/" + e->d_name;
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode)) {
+            listFiles(path, out);
+        } else {
+            out.push_back(path);
+        }
+    }
+    closedir(d);
+}
+
+static uint32_t outputCrc(const std::string &dir, unsigned long &bytes) {
+    std::vector<std::string> files;
+    listFiles(dir, files);
+    std::sort(files.begin(), files.end());
+
+    uint32_t crc = 0;
+    bytes = 0;
+    for (const std::string &path : files) {
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) {
+            continue;
+        }
+        uint8_t buf[65536];
+        size_t n;
+        while ((n = fread(buf, 1, sizeof(buf), f)) > 0) {
+            crc = crc32Update(crc, buf, n);
+            bytes += n;
+        }
+        fclose(f);
+    }
+    return crc;
+}
+
+// -----------------------------------------------------------------------------
+// main
+// -----------------------------------------------------------------------------
+typedef std::chrono::steady_clock Clock;
+
+static double percentile(std::vector<double> &v, double q) {
+    if (v.empty()) {
+        return 0;
+    }
+    size_t k = (size_t)(q * (v.size() - 1) + 0.5);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+int main(int argc, char **argv) {
+    const char *capture = nullptr;
+    const char *sdDir = nullptr;
+    double speed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--sd") == 0 && i + 1 < argc) {
+            sdDir = argv[++i];
+        } else if (argv[i][0] != '-' && !capture) {
+            capture = argv[i];
+        } else {
+            capture = nullptr;
+            break;
+        }
+    }
+    if (!capture) {
+        fprintf(stderr, "uso: %s <captura.mqcap> [--speed N] [--sd diretório]\n", argv[0]);
+        return 2;
+    }
+
+    std::vector<uint8_t> data;
+    std::vector<Message> msgs;
+    if (!loadCapture(capture, data, msgs)) {
+        return 1;
+    }
+
+    static char tmp[] = "/tmp/replay_sd_XXXXXX";
+    if (!sdDir) {
+        sdDir = mkdtemp(tmp);
+        if (!sdDir) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+    hostSdRoot(sdDir);
+
+    hostMillis = msgs.empty() ? 0 : msgs[0].ms;
+    diagInit();
+    loggerInit();
+
+    std::vector<double> latency;
+    latency.reserve(msgs.size());
+    unsigned long payloadBytes = 0;
+
+    Clock::time_point start = Clock::now();
+    for (const Message &m : msgs) {
+        Clock::time_point due = start;
+        if (speed > 0) {
+            due += std::chrono::microseconds((long long)((m.ms - msgs[0].ms) * 1000.0 / speed));
+            std::this_thread::sleep_until(due);
+        }
+
+        hostMillis = m.ms;
+        Clock::time_point t0 = Clock::now();
+        processMessage("esp32_logger", (const char *)&data[m.topic],
+                       (const char *)&data[m.payload], m.payloadLen);
+        loggerLoop();
+        Clock::time_point t1 = Clock::now();
+
+        Clock::time_point from = (speed > 0) ? due : t0;
+        latency.push_back(std::chrono::duration<double, std::micro>(t1 - from).count());
+        payloadBytes += m.payloadLen;
+    }
+    loggerFlush();
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    unsigned long outBytes;
+    uint32_t crc = outputCrc(sdDir, outBytes);
+    fprintf(stderr, "arquivos em %s\n", sdDir);
+
+    printf("{\"messages\":%lu,\"payload_bytes\":%lu,\"seconds\":%.3f,"
+           "\"msgs_per_sec\":%.0f,\"mb_per_sec\":%.2f,"
+           "\"latency_us\":{\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f},"
+           "\"output_bytes\":%lu,\"output_crc32\":\"%08lx\"}\n",
+           (unsigned long)msgs.size(), payloadBytes, seconds,
+           seconds > 0 ? msgs.size() / seconds : 0,
+           seconds > 0 ? payloadBytes / seconds / 1e6 : 0,
+           percentile(latency, 0.50), percentile(latency, 0.99),
+           percentile(latency, 0.999), percentile(latency, 1.0),
+           outBytes, (unsigned long)crc);
+    return 0;
+}
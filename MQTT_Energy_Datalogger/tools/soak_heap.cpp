@@ -0,0 +1,359 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - SOAK HEAP (FERRAMENTA DE PC)
+================================================================================
+
+Teste longo do heap: milhões de mensagens pelo processMessage() do
+firmware (config.h em vigor) com um heap simulado do tamanho do da ESP32,
+que registra ocupação, maior bloco livre e fragmentação ao longo do tempo.
+
+Heap simulado:
+--------------
+- Uma área fixa (--heap KiB, padrão 96) com blocos first-fit, divididos e
+  reunidos na liberação, como um heap embarcado simples.
+- Depois da 1ª mensagem (cabeçalho), todo malloc/calloc/realloc do
+  processo vai para essa área. Em regime o firmware não deveria pedir
+  nada: o contador firmware_allocs mostra se pede.
+- Carga de fundo no mesmo heap (WiFi, broker): a cada mensagem, blocos de
+  16 a 1024 bytes com vida de 1 a 300 mensagens (1 em 1000: até 50000).
+- --dynamic-doc: simula o padrão anterior ao json_pool, um bloco de
+  JSON_BUFFER_SIZE pedido antes de cada mensagem e liberado depois;
+  doc_fail conta as mensagens em que ele não coube (JSON recusado).
+
+Saída (stdout, uma linha JSON a cada --every mensagens e uma no fim):
+    messages, heap_free, heap_block (maior bloco livre), heap_frag (% do
+    livre fora do maior bloco), firmware_allocs, alloc_fail (pedidos não
+    atendidos pelo heap simulado), doc_fail
+Perfil plano = heap_block e heap_frag estáveis de uma linha para outra.
+
+Só Linux (glibc): os mallocs são interceptados como no bench_pipeline.
+
+Compilação, dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -std=gnu++17 -I tools/host -I . -I <ArduinoJson>/src \
+        $(ls *.cpp | grep -v -e main.cpp -e broker_handler.cpp -e wifi_ap.cpp) \
+        tools/host/host.cpp tools/soak_heap.cpp -o soak_heap -lpthread
+
+Uso:
+    ./soak_heap [-n mensagens] [--every n] [--heap KiB] [--dynamic-doc] [--sd diretório]
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <SD.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "../config.h"
+#include "../diag_log.h"
+#include "../logger.h"
+
+#if !defined(__GLIBC__)
+#error "soak_heap intercepta o malloc da glibc (Linux)"
+#endif
+
+// -----------------------------------------------------------------------------
+// Heap simulado
+// Blocos contíguos com cabeçalho de 8 bytes; size inclui o cabeçalho.
+// -----------------------------------------------------------------------------
+struct SimBlock {
+    uint32_t size;
+    uint32_t free;
+};
+
+static uint8_t *simBase = nullptr;
+static size_t simSize = 0;
+static std::atomic<bool> simOn(false);
+static std::atomic_flag simLock = ATOMIC_FLAG_INIT;
+static unsigned long simFailures = 0;
+
+static bool inSim(const void *p) {
+    return simBase && (const uint8_t *)p >= simBase && (const uint8_t *)p < simBase + simSize;
+}
+
+static void simInit(uint8_t *area, size_t size) {
+    simBase = area;
+    simSize = size & ~(size_t)7;
+    SimBlock *b = (SimBlock *)simBase;
+    b->size = (uint32_t)simSize;
+    b->free = 1;
+}
+
+static void *simAlloc(size_t n) {
+    size_t need = ((n + 7) & ~(size_t)7) + sizeof(SimBlock);
+    while (simLock.test_and_set(std::memory_order_acquire)) {
+    }
+
+    void *out = nullptr;
+    for (size_t off = 0; off < simSize;) {
+        SimBlock *b = (SimBlock *)(simBase + off);
+        if (b->free) {
+            // Reúne os livres seguidos
+            size_t next = off + b->size;
+            while (next < simSize && ((SimBlock *)(simBase + next))->free) {
+                b->size += ((SimBlock *)(simBase + next))->size;
+                next = off + b->size;
+            }
+            if (b->size >= need) {
+                if (b->size - need >= sizeof(SimBlock) + 8) {
+                    SimBlock *rest = (SimBlock *)(simBase + off + need);
+                    rest->size = (uint32_t)(b->size - need);
+                    rest->free = 1;
+                    b->size = (uint32_t)need;
+                }
+                b->free = 0;
+                out = b + 1;
+                break;
+            }
+        }
+        off += b->size;
+    }
+    if (!out) {
+        simFailures++;
+    }
+    simLock.clear(std::memory_order_release);
+    return out;
+}
+
+static void simFree(void *p) {
+    while (simLock.test_and_set(std::memory_order_acquire)) {
+    }
+    ((SimBlock *)p - 1)->free = 1;
+    simLock.clear(std::memory_order_release);
+}
+
+static size_t simBlockSize(void *p) {
+    return ((SimBlock *)p - 1)->size - sizeof(SimBlock);
+}
+
+// Livre total e maior bloco livre (blocos livres seguidos contam como um)
+static void simScan(size_t &freeBytes, size_t &largest) {
+    freeBytes = 0;
+    largest = 0;
+    size_t run = 0;
+    for (size_t off = 0; off < simSize;) {
+        SimBlock *b = (SimBlock *)(simBase + off);
+        if (b->free) {
+            freeBytes += b->size - sizeof(SimBlock);
+            run += b->size;
+        } else {
+            run = 0;
+        }
+        if (run > sizeof(SimBlock) && run - sizeof(SimBlock) > largest) {
+            largest = run - sizeof(SimBlock);
+        }
+        off += b->size;
+    }
+}
+
+// -----------------------------------------------------------------------------
+// Interceptação do malloc
+// -----------------------------------------------------------------------------
+static std::atomic<unsigned long> firmwareAllocs(0);
+
+extern "C" {
+void *__libc_malloc(size_t n);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *p, size_t n);
+void __libc_free(void *p);
+
+void *malloc(size_t n) {
+    if (simOn.load(std::memory_order_relaxed)) {
+        firmwareAllocs.fetch_add(1, std::memory_order_relaxed);
+        return simAlloc(n);
+    }
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+    if (simOn.load(std::memory_order_relaxed)) {
+        firmwareAllocs.fetch_add(1, std::memory_order_relaxed);
+        void *p = simAlloc(n * size);
+        if (p) {
+            memset(p, 0, n * size);
+        }
+        return p;
+    }
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+    if (!inSim(p) && !simOn.load(std::memory_order_relaxed)) {
+        return __libc_realloc(p, n);
+    }
+    firmwareAllocs.fetch_add(1, std::memory_order_relaxed);
+    if (!inSim(p) && p) {
+        return __libc_realloc(p, n);
+    }
+    void *q = simAlloc(n);
+    if (q && p) {
+        size_t old = simBlockSize(p);
+        memcpy(q, p, old < n ? old : n);
+    }
+    if (q && p) {
+        simFree(p);
+    }
+    return q;
+}
+
+void free(void *p) {
+    if (inSim(p)) {
+        simFree(p);
+        return;
+    }
+    __libc_free(p);
+}
+}
+
+// -----------------------------------------------------------------------------
+// Carga
+// -----------------------------------------------------------------------------
+static uint32_t rng = 12345;
+
+static uint32_t nextRand() {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return rng;
+}
+
+// Payload MiEnergy com valores que mudam; às vezes com campos extras
+static size_t buildPayload(unsigned long k, char *out, size_t cap) {
+    double t = (double)(k % 10000);
+    int n = snprintf(out, cap,
+                     "{\"tensao_a\":{\"value\":%.1f},\"tensao_b\":{\"value\":%.1f},"
+                     "\"corrente_a\":{\"value\":%.3f},\"potencia_a\":{\"value\":%.2f},"
+                     "\"fp\":{\"value\":%.3f},\"freq\":{\"value\":%.2f},"
+                     "\"energia\":{\"ativa\":{\"value\":%.0f}}",
+                     219.5 + t * 0.01, 220.1 - t * 0.01, 0.5 + t * 0.001,
+                     110.0 + t * 0.3, 0.9 + (k % 100) * 0.001, 59.95 + (k % 10) * 0.01,
+                     1000000.0 + k);
+    unsigned extra = nextRand() % 8;
+    for (unsigned i = 0; i < extra && n < (int)cap - 48; i++) {
+        n += snprintf(out + n, cap - n, ",\"extra_%u\":\"%08x\"", i, nextRand());
+    }
+    n += snprintf(out + n, cap - n, "}");
+    return (size_t)n;
+}
+
+struct Background {
+    void *p;
+    unsigned long until;
+};
+
+int main(int argc, char **argv) {
+    unsigned long total = 2000000;
+    unsigned long every = 100000;
+    size_t heapKiB = 96;
+    bool dynamicDoc = false;
+    const char *sdDir = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            total = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--every") == 0 && i + 1 < argc) {
+            every = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--heap") == 0 && i + 1 < argc) {
+            heapKiB = strtoul(argv[++i], nullptr, 10);
+        } else if (strcmp(argv[i], "--dynamic-doc") == 0) {
+            dynamicDoc = true;
+        } else if (strcmp(argv[i], "--sd") == 0 && i + 1 < argc) {
+            sdDir = argv[++i];
+        } else {
+            fprintf(stderr, "uso: %s [-n mensagens] [--every n] [--heap KiB] "
+                            "[--dynamic-doc] [--sd diretório]\n", argv[0]);
+            return 2;
+        }
+    }
+    if (every == 0) {
+        every = total;
+    }
+
+    static char tmp[] = "/tmp/soak_sd_XXXXXX";
+    if (!sdDir) {
+        sdDir = mkdtemp(tmp);
+        if (!sdDir) {
+            perror("mkdtemp");
+            return 1;
+        }
+    }
+    hostSdRoot(sdDir);
+    diagInit();
+    loggerInit();
+
+    // Buffer próprio: o 1º printf não aloca no heap simulado
+    static char outBuf[4096];
+    setvbuf(stdout, outBuf, _IOFBF, sizeof(outBuf));
+
+    static char payload[2048];
+    static const char *const topics[3] = { "MiEnergy/01", "MiEnergy/02", "MiEnergy/03" };
+
+    // Cabeçalho e alocações de inicialização ainda no heap do sistema
+    size_t len = buildPayload(0, payload, sizeof(payload));
+    processMessage("esp32_logger", topics[0], payload, len);
+
+    std::vector<Background> background;
+    background.reserve(4096);
+    // Nunca devolvida: blocos da área podem ser liberados até o fim do processo
+    size_t areaSize = heapKiB * 1024;
+    simInit((uint8_t *)__libc_malloc(areaSize), areaSize);
+    simOn.store(true);
+
+    unsigned long docFail = 0;
+    for (unsigned long k = 1; k <= total; k++) {
+        void *doc = nullptr;
+        if (dynamicDoc) {
+            doc = simAlloc(JSON_BUFFER_SIZE);
+            if (!doc) {
+                docFail++;
+            }
+        }
+
+        // Fundo: alguns blocos novos, os vencidos liberados
+        for (unsigned b = nextRand() % 3; b > 0 && background.size() < background.capacity(); b--) {
+            size_t size = 16 + (nextRand() % 1009) / (1 + nextRand() % 4);   // Mais blocos pequenos
+            void *p = simAlloc(size);
+            if (p) {
+                // 1 em 1000 vive bem mais (conexões, sessões)
+                unsigned long life = (nextRand() % 1000 == 0) ? nextRand() % 50000 : nextRand() % 300;
+                background.push_back({ p, k + 1 + life });
+            }
+        }
+        for (size_t i = 0; i < background.size();) {
+            if (background[i].until <= k) {
+                simFree(background[i].p);
+                background[i] = background.back();
+                background.pop_back();
+            } else {
+                i++;
+            }
+        }
+
+        if (!dynamicDoc || doc) {
+            len = buildPayload(k, payload, sizeof(payload));
+            processMessage("esp32_logger", topics[k % 3], payload, len);
+            loggerLoop();
+        }
+        if (doc) {
+            simFree(doc);
+        }
+
+        if (k % every == 0 || k == total) {
+            size_t freeBytes, largest;
+            simScan(freeBytes, largest);
+            printf("{\"messages\":%lu,\"heap_free\":%lu,\"heap_block\":%lu,\"heap_frag\":%lu,"
+                   "\"firmware_allocs\":%lu,\"alloc_fail\":%lu,\"doc_fail\":%lu}\n",
+                   k, (unsigned long)freeBytes, (unsigned long)largest,
+                   freeBytes ? 100 - (unsigned long)(largest * 100 / freeBytes) : 0,
+                   firmwareAllocs.load(), simFailures, docFail);
+            fflush(stdout);
+        }
+    }
+    simOn.store(false);
+    loggerFlush();
+    fprintf(stderr, "arquivos em %s\n", sdDir);
+    return 0;
+}
@@ -0,0 +1,175 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - STRESS INGEST (FERRAMENTA DE PC)
+================================================================================
+
+Exercita a MsgQueue do firmware (msg_queue.cpp, com o config.h em vigor)
+com um produtor em ritmo fixo e um consumidor lento que simula o SD:
+tempo fixo por mensagem e, periodicamente, uma parada longa (wear
+leveling / atualização da FAT).
+
+Tópicos (classe escolhida aqui, como fazem as regras INGEST_* do logger):
+    crit/<n>      MSG_CRITICAL
+    meter/<n>     MSG_LATEST
+    log/<n>       MSG_NORMAL
+
+Uma linha JSON em stdout, por classe: enviadas, entregues, descartadas,
+substituídas, e se a última mensagem enviada de cada tópico foi a última
+entregue. Também a ocupação máxima da fila e o tamanho fixo da MsgQueue
+(a memória não cresce com a carga). A perda esperada é a do tempo parado:
+cerca de (taxa x parada - posições livres) mensagens não críticas por
+parada.
+
+Compilação (Linux / macOS), dentro de MQTT_Energy_Datalogger/:
+    g++ -O2 -std=gnu++17 -I tools/host -I . msg_queue.cpp \
+        tools/stress_ingest.cpp -o stress_ingest -lpthread
+
+Uso:
+    ./stress_ingest [--rate msgs/s] [--seconds s] [--service us]
+                    [--stall ms] [--every ms] [--reserve posições]
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <thread>
+
+#include "../msg_queue.h"
+
+typedef std::chrono::steady_clock Clock;
+
+static MsgQueue queue;
+static QueuedMsg current;
+static std::atomic<bool> producing(true);
+
+struct TopicState {
+    MsgClass cls;
+    unsigned long sent;
+    unsigned long delivered;
+    unsigned long lastSent;         // Último seq enviado
+    unsigned long lastDelivered;    // Último seq entregue
+};
+
+// Escrito pelo produtor (sent/lastSent) e pelo consumidor (delivered/
+// lastDelivered), lido só no fim
+static std::map<std::string, TopicState> topics;
+
+static const char *const GROUPS[3] = { "log", "meter", "crit" };
+static const MsgClass CLASSES[3] = { MSG_NORMAL, MSG_LATEST, MSG_CRITICAL };
+
+static void consumer(unsigned serviceUs, unsigned stallMs, unsigned everyMs) {
+    Clock::time_point nextStall = Clock::now() + std::chrono::milliseconds(everyMs);
+    while (true) {
+        if (everyMs > 0 && Clock::now() >= nextStall) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(stallMs));
+            nextStall += std::chrono::milliseconds(everyMs);
+        }
+        if (!queue.pop(current)) {
+            if (!producing.load()) {
+                return;
+            }
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+            continue;
+        }
+        TopicState &t = topics[current.topic];
+        t.delivered++;
+        t.lastDelivered = strtoul(current.payload + 7, nullptr, 10);   // {"seq":N}
+        std::this_thread::sleep_for(std::chrono::microseconds(serviceUs));
+    }
+}
+
+int main(int argc, char **argv) {
+    double rate = 2000;
+    double seconds = 10;
+    unsigned serviceUs = 200;
+    unsigned stallMs = 300;
+    unsigned everyMs = 2000;
+    unsigned reserve = 2;
+
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "--rate") == 0) {
+            rate = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--seconds") == 0) {
+            seconds = atof(argv[i + 1]);
+        } else if (strcmp(argv[i], "--service") == 0) {
+            serviceUs = (unsigned)atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--stall") == 0) {
+            stallMs = (unsigned)atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--every") == 0) {
+            everyMs = (unsigned)atoi(argv[i + 1]);
+        } else if (strcmp(argv[i], "--reserve") == 0) {
+            reserve = (unsigned)atoi(argv[i + 1]);
+        } else {
+            fprintf(stderr, "opção desconhecida: %s\n", argv[i]);
+            return 2;
+        }
+    }
+
+    // 1 crítico a cada 50 mensagens; o resto meio a meio
+    char name[32];
+    for (int n = 0; n < 8; n++) {
+        for (int g = 0; g < 3; g++) {
+            snprintf(name, sizeof(name), "%s/%d", GROUPS[g], n);
+            topics[name] = TopicState{ CLASSES[g], 0, 0, 0, 0 };
+        }
+    }
+    queue.setCriticalReserve(reserve);
+
+    std::thread cons(consumer, serviceUs, stallMs, everyMs);
+
+    unsigned long total = (unsigned long)(rate * seconds);
+    Clock::time_point start = Clock::now();
+    for (unsigned long seq = 1; seq <= total; seq++) {
+        std::this_thread::sleep_until(start + std::chrono::microseconds((long long)(seq * 1e6 / rate)));
+
+        int g = (seq % 50 == 0) ? 2 : (int)(seq & 1);
+        snprintf(name, sizeof(name), "%s/%d", GROUPS[g], (int)((seq / 3) % 8));
+        char payload[32];
+        int len = snprintf(payload, sizeof(payload), "{\"seq\":%lu}", seq);
+
+        TopicState &t = topics[name];
+        t.sent++;
+        t.lastSent = seq;
+        queue.push(name, strlen(name), (const uint8_t *)payload, len, CLASSES[g]);
+    }
+    producing.store(false);
+    cons.join();
+
+    MsgQueueStats st = queue.stats();
+    printf("{\"queue\":{\"slots\":%d,\"reserve\":%u,\"bytes\":%lu,\"high\":%lu,"
+           "\"pushed\":%lu,\"dropped\":%lu,\"coalesced\":%lu,\"blocked\":%lu},\"classes\":[",
+           MSG_QUEUE_SLOTS, reserve, (unsigned long)sizeof(MsgQueue),
+           (unsigned long)st.highWater, (unsigned long)st.pushed,
+           (unsigned long)st.dropped, (unsigned long)st.coalesced, (unsigned long)st.blocked);
+
+    for (int g = 0; g < 3; g++) {
+        unsigned long sent = 0, delivered = 0, dropped = 0, coalesced = 0, latest = 0, count = 0;
+        for (const auto &kv : topics) {
+            const TopicState &t = kv.second;
+            if (t.cls != CLASSES[g] || t.sent == 0) {
+                continue;
+            }
+            sent += t.sent;
+            delivered += t.delivered;
+            count++;
+            latest += (t.lastDelivered == t.lastSent);
+            for (size_t i = 0; i < queue.topicStatsCount(); i++) {
+                MsgTopicStats s = queue.topicStats(i);
+                if (kv.first == s.topic) {
+                    dropped += s.dropped;
+                    coalesced += s.coalesced;
+                }
+            }
+        }
+        printf("%s{\"class\":\"%s\",\"topics\":%lu,\"sent\":%lu,\"delivered\":%lu,"
+               "\"dropped\":%lu,\"coalesced\":%lu,\"latest_delivered\":%lu}",
+               g ? "," : "", GROUPS[g], count, sent, delivered, dropped, coalesced, latest);
+    }
+    printf("]}\n");
+    return 0;
+}
@@ -0,0 +1,248 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TOPIC FILTER (IMPLEMENTAÇÃO)
+================================================================================
+
+Implementa a trie de regras descrita em topic_filter.h.
+
+- Cada nó é um nível de regra; o nó raiz (0) representa o início do tópico.
+- Flags no nó:
+    NODE_ALLOW / NODE_DENY         -> uma regra termina exatamente aqui;
+    NODE_ALLOW_ALL / NODE_DENY_ALL -> regra com "#" logo abaixo deste nó.
+- Filhos literais na tabela hash _slots, chave (pai, hash do nível);
+  o filho "+" fica direto no nó.
+- accepts() segue, nível a nível, todos os nós ativos (literal e "+"),
+  como um autômato não determinístico.
+
+================================================================================
+*/
+
+#include <Arduino.h>
+#include <string.h>
+#include "topic_filter.h"
+#include "column_map.h"
+#include "diag_log.h"
+
+#define NODE_ALLOW      0x01
+#define NODE_DENY       0x02
+#define NODE_ALLOW_ALL  0x04
+#define NODE_DENY_ALL   0x08
+
+// Posição inicial do par (pai, nível) na tabela de filhos
+static inline size_t slotOf(int parent, uint32_t h) {
+    return (h ^ ((uint32_t)parent * 2654435761u)) & (TOPIC_FILTER_SLOTS - 1);
+}
+
+TopicFilter::TopicFilter() {
+    clear();
+}
+
+void TopicFilter::clear() {
+    _nodeCount = 0;
+    _poolUsed = 0;
+    _rules = 0;
+    _hasAllow = false;
+    for (size_t i = 0; i < TOPIC_FILTER_SLOTS; i++) {
+        _slots[i] = -1;
+    }
+    addNode(-1, "", 0, 0);  // Raiz
+}
+
+int TopicFilter::addNode(int parent, const char *level, size_t len, uint32_t h) {
+    if (_nodeCount >= TOPIC_FILTER_MAX_NODES || _poolUsed + len > TOPIC_FILTER_POOL) {
+        return -1;
+    }
+    Node &n = _nodes[_nodeCount];
+    memcpy(_pool + _poolUsed, level, len);
+    n.hash = h;
+    n.off = (uint16_t)_poolUsed;
+    n.len = (uint16_t)len;
+    n.parent = (int16_t)parent;
+    n.plus = -1;
+    n.flags = 0;
+    _poolUsed += len;
+    return (int)_nodeCount++;
+}
+
+int TopicFilter::findChild(int parent, const char *level, size_t len, uint32_t h) const {
+    for (size_t pos = slotOf(parent, h); _slots[pos] >= 0;
+         pos = (pos + 1) & (TOPIC_FILTER_SLOTS - 1)) {
+        const Node &n = _nodes[_slots[pos]];
+        if (n.parent == parent && n.hash == h && n.len == len &&
+            memcmp(_pool + n.off, level, len) == 0) {
+            return _slots[pos];
+        }
+    }
+    return -1;
+}
+
+bool TopicFilter::addRule(const char *rule, size_t len) {
+    bool deny = false;
+    if (len > 0 && rule[0] == '!') {
+        deny = true;
+        rule++;
+        len--;
+    }
+    if (len == 0) {
+        return false;
+    }
+
+    int node = 0;
+    size_t pos = 0;
+    while (true) {
+        const char *level = rule + pos;
+        const char *slash = (const char *)memchr(level, '/', len - pos);
+        size_t levelLen = slash ? (size_t)(slash - level) : len - pos;
+        bool last = (slash == nullptr);
+
+        if (levelLen == 1 && level[0] == '#') {
+            if (!last) {
+                return false;   // "#" só no último nível
+            }
+            _nodes[node].flags |= deny ? NODE_DENY_ALL : NODE_ALLOW_ALL;
+            break;
+        }
+
+        if (levelLen == 1 && level[0] == '+') {
+            if (_nodes[node].plus < 0) {
+                int c = addNode(node, "+", 1, 0);
+                if (c < 0) {
+                    return false;
+                }
+                _nodes[node].plus = (int16_t)c;
+            }
+            node = _nodes[node].plus;
+        } else {
+            if (memchr(level, '+', levelLen) || memchr(level, '#', levelLen)) {
+                return false;   // Curinga misturado com texto no nível
+            }
+            uint32_t h = ColumnMap::hash(level, levelLen);
+            int c = findChild(node, level, levelLen, h);
+            if (c < 0) {
+                c = addNode(node, level, levelLen, h);
+                if (c < 0) {
+                    return false;
+                }
+                size_t pos = slotOf(node, h);
+                while (_slots[pos] >= 0) {
+                    pos = (pos + 1) & (TOPIC_FILTER_SLOTS - 1);
+                }
+                _slots[pos] = (int16_t)c;
+            }
+            node = c;
+        }
+
+        if (last) {
+            _nodes[node].flags |= deny ? NODE_DENY : NODE_ALLOW;
+            break;
+        }
+        pos += levelLen + 1;
+    }
+
+    if (!deny) {
+        _hasAllow = true;
+    }
+    _rules++;
+    return true;
+}
+
+bool TopicFilter::compile(const char *rules) {
+    clear();
+
+    const char *p = rules;
+    while (*p) {
+        const char *end = strchr(p, ';');
+        size_t len = end ? (size_t)(end - p) : strlen(p);
+
+        // Ignora espaços nas pontas e regras vazias ("a/#; b/#;")
+        while (len > 0 && *p == ' ') {
+            p++;
+            len--;
+        }
+        while (len > 0 && p[len - 1] == ' ') {
+            len--;
+        }
+
+        if (len > 0 && !addRule(p, len)) {
+            DIAG_ERROR("Regra de tópico inválida ou sem espaço: \"%.*s\". Filtro desativado.",
+                       (int)len, p);
+            clear();
+            return false;
+        }
+
+        if (!end) {
+            break;
+        }
+        p = end + 1;
+    }
+    return true;
+}
+
+bool TopicFilter::accepts(const char *topic) const {
+    if (_rules == 0) {
+        return true;
+    }
+
+    // Os nós ativos de um nível são distintos (cada nó tem um só caminho
+    // desde a raiz), então cabem em TOPIC_FILTER_MAX_NODES
+    int16_t active[TOPIC_FILTER_MAX_NODES];
+    int16_t next[TOPIC_FILTER_MAX_NODES];
+    size_t activeCount = 1;
+    active[0] = 0;
+
+    bool allowed = false;
+    bool sys = (topic[0] == '$');
+    const char *level = topic;
+
+    while (activeCount > 0) {
+        const char *slash = strchr(level, '/');
+        size_t levelLen = slash ? (size_t)(slash - level) : strlen(level);
+        uint32_t h = ColumnMap::hash(level, levelLen);
+        bool firstLevel = (level == topic);
+        size_t nextCount = 0;
+
+        for (size_t i = 0; i < activeCount; i++) {
+            const Node &n = _nodes[active[i]];
+
+            // "#" abaixo de n casa este nível e todos os seguintes
+            if (!(firstLevel && sys)) {
+                if (n.flags & NODE_DENY_ALL) {
+                    return false;
+                }
+                if (n.flags & NODE_ALLOW_ALL) {
+                    allowed = true;
+                }
+            }
+
+            int c = findChild(active[i], level, levelLen, h);
+            if (c >= 0) {
+                next[nextCount++] = (int16_t)c;
+            }
+            if (n.plus >= 0 && !(firstLevel && sys)) {
+                next[nextCount++] = n.plus;
+            }
+        }
+
+        memcpy(active, next, nextCount * sizeof(next[0]));
+        activeCount = nextCount;
+
+        if (!slash) {
+            break;
+        }
+        level = slash + 1;
+    }
+
+    // Tópico consumido: regras que terminam aqui ou com "#" logo abaixo
+    // ("a/#" também casa "a")
+    for (size_t i = 0; i < activeCount; i++) {
+        uint8_t f = _nodes[active[i]].flags;
+        if (f & (NODE_DENY | NODE_DENY_ALL)) {
+            return false;
+        }
+        if (f & (NODE_ALLOW | NODE_ALLOW_ALL)) {
+            allowed = true;
+        }
+    }
+
+    return allowed || !_hasAllow;
+}
@@ -0,0 +1,76 @@
+/*
+================================================================================
+DATALOGGER ANALISADOR DE ENERGIA MQTT - TOPIC FILTER (HEADER)
+================================================================================
+
+Responsabilidade:
+-----------------
+Filtro de tópicos com curingas MQTT ("+" e "#") e regras de aceitação e
+rejeição. As regras são compiladas uma única vez (brokerInit) em uma trie
+por nível de tópico; a verificação percorre os níveis do tópico uma vez,
+independente do número de regras.
+
+Sintaxe (TOPIC_FILTER em config.h):
+-----------------------------------
+- Regras separadas por ';'. Prefixo '!' = rejeitar.
+      "MiEnergy/#;meters/+/power;!MiEnergy/+/debug"
+- Um tópico passa se nenhuma regra de rejeição casa e, havendo regras de
+  aceitação, pelo menos uma delas casa. Sem regras, tudo passa.
+- Curingas como na especificação MQTT: "+" = exatamente um nível,
+  "#" = este nível e todos abaixo (só no fim). Curingas no primeiro nível
+  não casam tópicos que começam com '$'.
+
+Memória:
+--------
+Nós e texto dos níveis em tabelas estáticas (TOPIC_FILTER_MAX_NODES,
+TOPIC_FILTER_POOL). Sem heap. accepts() usa na pilha dois vetores de
+TOPIC_FILTER_MAX_NODES índices (os caminhos seguidos em paralelo nunca
+passam do número de nós, então nenhum é perdido). Os filhos literais de cada nó ficam em uma
+tabela hash (pai, nível) -> filho, então cada nível custa O(1) mesmo com
+dezenas de regras no mesmo ponto da trie.
+
+================================================================================
+*/
+#pragma once
+#include <Arduino.h>
+
+#define TOPIC_FILTER_MAX_NODES   128    // Níveis distintos somando todas as regras
+#define TOPIC_FILTER_POOL        1024   // Bytes para o texto dos níveis
+#define TOPIC_FILTER_SLOTS       256    // Potência de 2, >= 2 * TOPIC_FILTER_MAX_NODES
+
+class TopicFilter {
+public:
+    TopicFilter();
+
+    // Compila as regras. Em caso de erro de sintaxe/capacidade, imprime o
+    // motivo no Serial, descarta as regras (tudo passa) e retorna false.
+    bool compile(const char *rules);
+
+    // true se o tópico deve ser registrado.
+    bool accepts(const char *topic) const;
+
+    size_t ruleCount() const { return _rules; }
+
+private:
+    struct Node {
+        uint32_t hash;      // Hash do texto do nível (ColumnMap::hash)
+        uint16_t off;       // Texto em _pool
+        uint16_t len;
+        int16_t  parent;
+        int16_t  plus;      // Filho "+" (-1 = nenhum)
+        uint8_t  flags;
+    };
+
+    void clear();
+    int  addNode(int parent, const char *level, size_t len, uint32_t h);
+    int  findChild(int parent, const char *level, size_t len, uint32_t h) const;
+    bool addRule(const char *rule, size_t len);
+
+    Node    _nodes[TOPIC_FILTER_MAX_NODES];
+    int16_t _slots[TOPIC_FILTER_SLOTS];     // Filhos literais (-1 = vazio)
+    size_t _nodeCount;
+    char   _pool[TOPIC_FILTER_POOL];
+    size_t _poolUsed;
+    size_t _rules;
+    bool   _hasAllow;
+};
@@ -11,7 +11,7 @@ Comportamento:
 --------------
 - Inicia o AP MQTT_Energy_LOGGER com a senha especificada.
 - Em caso de falha, mantém o sistema em loop de erro.
-- Em caso de sucesso, exibe via Serial:
+- Em caso de sucesso, exibe (diag_log):
     - SSID ativo.
     - IP da ESP32 (endereço do broker MQTT).
 
@@ -21,21 +21,19 @@ Comportamento:
 #include <Arduino.h>
 #include <WiFi.h>
 #include "config.h"
+#include "diag_log.h"
 
 void setupAccessPoint() {
-    Serial.println("Iniciando Access Point...");
+    DIAG_INFO("Iniciando Access Point...");
 
     WiFi.mode(WIFI_AP);
     if (!WiFi.softAP(AP_SSID, AP_PASS)) {
-        Serial.println("Falha ao iniciar AP.");
+        DIAG_ERROR("Falha ao iniciar AP.");
         while (true) {
             delay(1000);
         }
     }
 
-    Serial.print("AP ativo. SSID: ");
-    Serial.println(AP_SSID);
-
-    Serial.print("IP do broker (ESP32): ");
-    Serial.println(WiFi.softAPIP());
+    DIAG_INFO("AP ativo. SSID: %s", AP_SSID);
+    DIAG_INFO("IP do broker (ESP32): %s", WiFi.softAPIP().toString().c_str());
 }